@@ -167,7 +167,8 @@ public:
 		\param nSigma number of sigmas under which the points should be kept
 		\param removeIsolatedPoints whether to remove isolated points (i.e. whith 3 points or less in the neighborhood)
 		\param useKnn whether to use a constant number of neighbors instead of a radius
-		\param number of neighbors (if useKnn is true)
+		\param knn number of neighbors, not counting the point itself (if useKnn is true). Exactly 'knn'
+		neighbors are used (older versions used 'at least knn' points, including the point itself)
 		\param useAbsoluteError whether to use an absolute error instead of 'n' sigmas
 		\param absoluteError absolute error (if useAbsoluteError is true)
 		\param theOctree associated octree if available
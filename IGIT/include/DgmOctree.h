@@ -28,6 +28,8 @@
 
 //system
 #include <vector>
+#include <iterator>
+#include <cstddef>
 #include <assert.h>
 #include <string.h>
 
@@ -48,7 +50,9 @@ namespace CCLib
 {
 
 class ReferenceCloud;
+class GenericIndexedCloud;
 class GenericIndexedCloudPersist;
+class NormalizedProgress;
 
 /*** MACROS ***/
 
@@ -261,6 +265,8 @@ public:
 		unsigned theNearestPointIndex;
 
 		//! Default constructor
+		/** The containers are taken from the thread scratch buffers (see AcquireScratchBuffers).
+		**/
 		NearestNeighboursSearchStruct()
 			: queryPoint(0,0,0)
 			, level(1)
@@ -271,6 +277,15 @@ public:
 		{
 			memset(cellPos,0,sizeof(int)*3);
 			memset(cellCenter,0,sizeof(PointCoordinateType)*3);
+			AcquireScratchBuffers(minimalCellsSetToVisit,pointsInNeighbourhood);
+		}
+
+		//! Destructor
+		/** The containers are given back to the thread scratch buffers (see ReleaseScratchBuffers).
+		**/
+		~NearestNeighboursSearchStruct()
+		{
+			ReleaseScratchBuffers(minimalCellsSetToVisit,pointsInNeighbourhood);
 		}
 	};
 
@@ -317,6 +332,55 @@ public:
 		{}
 	};
 
+	//! Container of in/out parameters for batch nearest neighbours search
+	/** Batch version of NearestNeighboursSearchStruct: a whole block of query points
+		lying in the same octree cell is processed by a single call (see
+		DgmOctree::findNearestNeighborsForPointsInCell and DgmOctree::findNeighborsInASphereForPointsInCell).
+		The points of the cell neighbourhood are gathered once in 'pointsInNeighbourhood'
+		(and their coordinates in the 'candidatesX/Y/Z' arrays) and are shared by all the queries.
+		As for NearestNeighboursSearchStruct, 'level', 'cellPos' and 'cellCenter' should be
+		set before the first search, and reset() should be called when the cell changes.
+		The 'queryPoint' and 'minNumberOfNeighbors' fields are not used.
+	**/
+	struct NearestNeighboursBatchSearchStruct : public NearestNeighboursSearchStruct
+	{
+		//! Candidate points coordinates (structure of arrays - same order as 'pointsInNeighbourhood')
+		std::vector<PointCoordinateType> candidatesX, candidatesY, candidatesZ;
+
+		/*** Result ***/
+
+		//! Neighbours of all the query points
+		/** The neighbours of the i-th query point are stored between indexes neighboursStart[i]
+			(included) and neighboursStart[i+1] (excluded), along with their square distance to
+			the query point. They are sorted by increasing distance (if requested).
+		**/
+		NeighboursSet neighbours;
+		//! Index of the first neighbour of each query point in 'neighbours' (size = number of query points + 1)
+		std::vector<unsigned> neighboursStart;
+
+		/*** Internal buffers ***/
+
+		//! Square distances between the current query point and the candidate points
+		std::vector<PointCoordinateType> squareDistances;
+		//! Selected candidates (indexes in 'pointsInNeighbourhood')
+		std::vector<unsigned> selection;
+
+		//! Returns the number of neighbours found for a given query point
+		inline unsigned getNeighbourCount(unsigned queryIndex) const { return neighboursStart[queryIndex+1] - neighboursStart[queryIndex]; }
+		//! Returns the neighbours found for a given query point
+		inline const PointDescriptor* getNeighbours(unsigned queryIndex) const { return &neighbours[neighboursStart[queryIndex]]; }
+
+		//! Forgets the gathered neighbourhood (to be called when the cell changes)
+		inline void reset()
+		{
+			pointsInNeighbourhood.clear();
+			candidatesX.clear();
+			candidatesY.clear();
+			candidatesZ.clear();
+			alreadyVisitedNeighbourhoodSize = 0;
+		}
+	};
+
 	//! Association between an index and the code of an octree cell
 	/** Index could be the index of a point, in which case the code
 		would correspond to the octree cell where the point lies.
@@ -369,11 +433,209 @@ public:
 			return a.theIndex < b.theIndex;
 		}
 
+		//! Code-based comparison operator (then index-based for identical codes)
+		/** Gives the same order as a stable sort by code of a container sorted by index.
+			\param a first IndexAndCode structure
+			\param b second IndexAndCode structure
+			\return whether 'a' is before 'b'
+		**/
+		static bool codeAndIndexComp(const IndexAndCode& a, const IndexAndCode& b) throw()
+		{
+			return a.theCode < b.theCode || (a.theCode == b.theCode && a.theIndex < b.theIndex);
+		}
+
 	};
 
 	//! Container of 'IndexAndCode' structures
 	typedef std::vector<IndexAndCode> cellsContainer;
 
+	//! Container of the octree 'structure' (i.e. the points indexes and their cell codes, sorted by code)
+	/** Two storage modes are available:
+		- the standard mode simply stores the 'IndexAndCode' structures (see cellsContainer)
+		- the compact mode stores the points indexes (32 bits) and their codes separately.
+		The codes are grouped by blocks of CODES_PER_BLOCK consecutive values, and each
+		code is stored as a bit-packed delta relatively to the first code of its block
+		(the number of bits depends on the block range). The blocks first codes also act
+		as a skip index for binary searches (see lowerBound).
+		In both modes, elements are accessed (read-only) by index or with a random access
+		iterator. Both return 'IndexAndCode' structures by value.
+	**/
+	class CC_CORE_LIB_API pointsAndCodesContainer
+	{
+	public:
+
+		//! Number of codes per block (compact mode)
+		static const unsigned CODES_PER_BLOCK = 64;
+
+		//! Default constructor
+		pointsAndCodesContainer()
+			: m_count(0)
+			, m_compact(false)
+		{
+		}
+
+		//! Returns the number of elements
+		inline unsigned size() const { return m_count; }
+		//! Returns whether the container is empty
+		inline bool empty() const { return m_count == 0; }
+		//! Returns whether the compact storage mode is used
+		inline bool isCompact() const { return m_compact; }
+
+		//! Returns the index of the ith point
+		inline unsigned getIndex(unsigned i) const { assert(i < m_count); return m_compact ? m_indexes[i] : m_plain[i].theIndex; }
+		//! Returns the cell code of the ith point
+		inline OctreeCellCodeType getCode(unsigned i) const { assert(i < m_count); return m_compact ? decodeCode(i) : m_plain[i].theCode; }
+		//! Returns the ith element
+		inline IndexAndCode operator[](unsigned i) const { return IndexAndCode(getIndex(i),getCode(i)); }
+
+		//! Read-only random access iterator
+		class const_iterator
+		{
+		public:
+
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef IndexAndCode value_type;
+			typedef ptrdiff_t difference_type;
+			typedef const IndexAndCode* pointer;
+			typedef IndexAndCode reference;
+
+			//! Proxy returned by operator-> (as elements are returned by value)
+			struct arrow
+			{
+				IndexAndCode value;
+				arrow(const IndexAndCode& v) : value(v) {}
+				inline const IndexAndCode* operator->() const { return &value; }
+			};
+
+			//! Default constructor
+			const_iterator() : m_container(0), m_pos(0) {}
+			//! Constructor from a container and a position
+			const_iterator(const pointsAndCodesContainer* container, unsigned pos) : m_container(container), m_pos(pos) {}
+
+			inline IndexAndCode operator*() const { return (*m_container)[m_pos]; }
+			inline arrow operator->() const { return arrow((*m_container)[m_pos]); }
+			inline IndexAndCode operator[](difference_type n) const { return (*m_container)[static_cast<unsigned>(m_pos+n)]; }
+
+			inline const_iterator& operator++() { ++m_pos; return *this; }
+			inline const_iterator operator++(int) { const_iterator it(*this); ++m_pos; return it; }
+			inline const_iterator& operator--() { --m_pos; return *this; }
+			inline const_iterator operator--(int) { const_iterator it(*this); --m_pos; return it; }
+			inline const_iterator& operator+=(difference_type n) { m_pos = static_cast<unsigned>(m_pos+n); return *this; }
+			inline const_iterator& operator-=(difference_type n) { m_pos = static_cast<unsigned>(m_pos-n); return *this; }
+			inline const_iterator operator+(difference_type n) const { return const_iterator(m_container,static_cast<unsigned>(m_pos+n)); }
+			inline const_iterator operator-(difference_type n) const { return const_iterator(m_container,static_cast<unsigned>(m_pos-n)); }
+			inline difference_type operator-(const const_iterator& it) const { return static_cast<difference_type>(m_pos)-static_cast<difference_type>(it.m_pos); }
+
+			inline bool operator==(const const_iterator& it) const { return m_pos == it.m_pos; }
+			inline bool operator!=(const const_iterator& it) const { return m_pos != it.m_pos; }
+			inline bool operator<(const const_iterator& it) const { return m_pos < it.m_pos; }
+			inline bool operator>(const const_iterator& it) const { return m_pos > it.m_pos; }
+			inline bool operator<=(const const_iterator& it) const { return m_pos <= it.m_pos; }
+			inline bool operator>=(const const_iterator& it) const { return m_pos >= it.m_pos; }
+
+		protected:
+
+			//! Associated container
+			const pointsAndCodesContainer* m_container;
+			//! Current position
+			unsigned m_pos;
+		};
+
+		//! Returns an iterator on the first element
+		inline const_iterator begin() const { return const_iterator(this,0); }
+		//! Returns an iterator past the last element
+		inline const_iterator end() const { return const_iterator(this,m_count); }
+
+		//! Replaces the content of the container
+		/** \param codes the points indexes and their cell codes (sorted by code). Emptied by this method.
+			\param compact whether to use the compact storage mode
+			\return false if there's not enough memory to use the compact mode (the standard mode is used instead)
+		**/
+		bool assign(cellsContainer& codes, bool compact);
+
+		//! Replaces the content of the container by the (unsorted) cell codes of a cloud, in compact mode
+		/** The points indexes are sorted by code (then by index) directly in compact
+			form: the standard form and the sort buffer are never allocated (roughly
+			12 bytes per point at most instead of 32 with 64 bits codes).
+			\param pointCodes cell code of each point of the cloud (INVALID_CELL_CODE for the filtered points). Emptied by this method.
+			\param count number of (valid) cell codes
+			\return false if there's not enough memory (the container is left empty and 'pointCodes' unchanged)
+		**/
+		bool assignCompact(std::vector<OctreeCellCodeType>& pointCodes, unsigned count);
+
+		//! Changes the storage mode
+		/** \return false if there's not enough memory (the container is left unchanged)
+		**/
+		bool setCompact(bool state);
+
+		//! Clears the container
+		void clear();
+
+		//! Sets the points indexes in the container order (i.e. the index of the ith element becomes i)
+		/** See DgmOctree::reindexInOctreeOrder.
+		**/
+		void setIndexesInOrder();
+
+		//! Returns the position of the first element having a code greater than or equal to a given one
+		/** Elements are searched in the range [first,last).
+			\return the position of the element (or 'last' if there's none)
+		**/
+		unsigned lowerBound(OctreeCellCodeType code, unsigned first, unsigned last) const;
+
+		//! Returns the memory used by the container (in bytes)
+		size_t memoryUsage() const;
+
+	protected:
+
+		//! Block of codes (compact mode)
+		struct codesBlock
+		{
+			//! First code of the block
+			OctreeCellCodeType base;
+			//! Index of the first word of the block bit-packed deltas (in m_words)
+			unsigned firstWord;
+			//! Number of bits per delta
+			uchar bitCount;
+		};
+
+		//! Appends a block of (sorted) codes (compact mode only)
+		/** \param codes block codes (CODES_PER_BLOCK at most)
+			\param count number of codes
+		**/
+		void appendBlock(const OctreeCellCodeType* codes, unsigned count);
+
+		//! Decodes the ith code (compact mode only)
+		inline OctreeCellCodeType decodeCode(unsigned i) const
+		{
+			const codesBlock& block = m_blocks[i / CODES_PER_BLOCK];
+			if (block.bitCount == 0)
+				return block.base;
+
+			unsigned bitPos = (i % CODES_PER_BLOCK) * block.bitCount;
+			const quint64* word = &m_words[block.firstWord + (bitPos >> 6)];
+			unsigned shift = (bitPos & 63);
+			quint64 delta = (word[0] >> shift);
+			if (shift + block.bitCount > 64)
+				delta |= (word[1] << (64-shift));
+			delta &= ((static_cast<quint64>(1) << block.bitCount) - 1);
+
+			return block.base + static_cast<OctreeCellCodeType>(delta);
+		}
+
+		//! 'IndexAndCode' structures (standard mode)
+		cellsContainer m_plain;
+		//! Points indexes (compact mode)
+		std::vector<unsigned> m_indexes;
+		//! Codes blocks (compact mode)
+		std::vector<codesBlock> m_blocks;
+		//! Bit-packed codes deltas (compact mode)
+		std::vector<quint64> m_words;
+		//! Number of elements
+		unsigned m_count;
+		//! Whether the compact mode is used
+		bool m_compact;
+	};
+
 	//! Octree cell descriptor
 	struct octreeCell
 	{
@@ -405,12 +667,121 @@ public:
 	**/
 	typedef bool (*octreeCellFunc)(const octreeCell& cell, void**, NormalizedProgress*);
 
+	//! Takes containers from the current thread scratch buffers
+	/** Each thread keeps the containers of the released search structures (see
+		NearestNeighboursSearchStruct) and gives them back, emptied but with their
+		capacity, to the next ones. Therefore, after the first cells, the search
+		structures created by cell functions don't allocate memory anymore.
+		\param cellIndexes empty container (swapped with a scratch one, if any)
+		\param points empty container (swapped with a scratch one, if any)
+	**/
+	static void AcquireScratchBuffers(cellIndexesContainer& cellIndexes, NeighboursSet& points);
+
+	//! Gives containers back to the current thread scratch buffers
+	/** See AcquireScratchBuffers. The containers are emptied (their memory is kept
+		for the next search structures, unless the thread already has enough spare
+		containers).
+	**/
+	static void ReleaseScratchBuffers(cellIndexesContainer& cellIndexes, NeighboursSet& points);
+
+	/**** SEARCH STATISTICS ****/
+
+	//! Number of bins of the cells population histogram (see SearchStatistics)
+	static const unsigned POPULATION_HISTOGRAM_SIZE = 24;
+
+	//! Statistics on the cells traversals and on the neighbourhood searches
+	/** Only gathered if enabled (see EnableSearchStatistics). During a cells
+		traversal, each thread records its searches for this traversal only (see
+		SearchStatisticsReporter). They are then added to the thread's own global
+		counters, summed on demand (see GetSearchStatistics). Times are expressed
+		in nanoseconds, and summed over all threads (the cell functions time
+		includes the neighbourhoods extraction time).
+	**/
+	struct CC_CORE_LIB_API SearchStatistics
+	{
+		//! Number of processed cells (see executeFunctionForAllCellsAtLevel, etc.)
+		quint64 processedCells;
+		//! Histogram of the processed cells population
+		/** Bin #i counts the cells with 2^i to 2^(i+1)-1 points (the last bin
+			counts all the bigger cells).
+		**/
+		quint64 cellPopulationHistogram[POPULATION_HISTOGRAM_SIZE];
+		//! Number of neighbourhood searches (one per query point)
+		quint64 searches;
+		//! Number of points whose distance to a query point has been computed
+		quint64 testedPoints;
+		//! Number of points accepted or rejected without any distance computation
+		/** Only when the cells are tested as a whole (see TEST_CELLS_FOR_SPHERICAL_NN).
+		**/
+		quint64 skippedPoints;
+		//! Number of points gathered from the neighbour cells
+		quint64 gatheredPoints;
+		//! Number of cell code lookups (binary searches in the octree structure)
+		quint64 binarySearches;
+		//! Number of binary searches iterations
+		quint64 binarySearchJumps;
+		//! Time spent to gather the points of the processed cells
+		quint64 cellExtractionTime_ns;
+		//! Time spent in the cell functions
+		quint64 cellFunctionTime_ns;
+		//! Time spent to gather the points of the neighbour cells
+		quint64 neighbourhoodExtractionTime_ns;
+		//! Elapsed (wall-clock) time of the process (only set for reports, see SearchStatisticsReporter)
+		quint64 elapsedTime_ns;
+
+		//! Default constructor
+		SearchStatistics() { reset(); }
+		//! Resets all counters
+		void reset();
+		//! Adds the counters of another set of statistics
+		void add(const SearchStatistics& stats);
+		//! Records a processed cell
+		void addProcessedCell(unsigned population);
+	};
+
+	//! Enables or disables the gathering of the search statistics
+	/** When disabled (default), the searches are not slowed down. Statistics
+		already gathered are kept (see ResetSearchStatistics).
+	**/
+	static void EnableSearchStatistics(bool state);
+	//! Returns whether the search statistics are gathered or not
+	static bool SearchStatisticsEnabled();
+	//! Resets the search statistics (of all threads)
+	/** Should not be called while a process is running.
+	**/
+	static void ResetSearchStatistics();
+	//! Returns the search statistics gathered so far (sum over all threads)
+	/** The statistics of the running cells traversals are only added at their
+		end. The searches made outside of any traversal (e.g. direct calls to
+		findNeighborsInASphereStartingFromCell) are counted as they go, without
+		synchronization: while such searches run in other threads, their
+		counters are approximate.
+	**/
+	static void GetSearchStatistics(SearchStatistics& stats);
+
+	//! Search statistics report function
+	/** Called at the end of each cells traversal (see executeFunctionForAllCellsAtLevel,
+		etc.) with the statistics of this process only: the searches made by the
+		calling thread and by the worker threads for this traversal. Other
+		traversals running at the same time (or nested in a cell function) are
+		reported separately.
+		\param functionTitle title of the process (may be 0)
+		\param stats statistics of the process
+	**/
+	typedef void (*SearchStatisticsReporter)(const char* functionTitle, const SearchStatistics& stats);
+
+	//! Sets the search statistics report function (see SearchStatisticsReporter)
+	static void SetSearchStatisticsReporter(SearchStatisticsReporter reporter);
+
 	/******************************/
 	/**          METHODS         **/
 	/******************************/
 
 	//! DgmOctree constructor
-	/** \param cloud the cloud to construct the octree on
+	/** The octree 'structure' is stored in compact form if this is the default
+		mode (see SetCompactStorageByDefault) or if the cloud has a limited working
+		set (see setCompactStorage).
+		\param cloud the cloud to construct the octree on
 	**/
 	DgmOctree(GenericIndexedCloudPersist* cloud);
 
@@ -444,6 +815,57 @@ public:
 				const CCVector3* pointsMaxFilter = 0,
 				GenericProgressCallback* progressCb = 0);
 
+	//! Adds points to the octree structure (without rebuilding it)
+	/** The points [firstIndex,size[ of the associated cloud (typically just
+		appended to it) are projected in the octree and merged in the sorted
+		structure. The cells statistics are updated incrementally. As the octree
+		limits can't change, the process fails if one of the new points falls
+		outside the octree box (the octree should then be rebuilt). Otherwise
+		the 'accepted points' box is extended to the new points.
+		\warning the octree must have been built already
+		\param firstIndex index of the first new point in the associated cloud
+		\return false if a new point falls outside the octree box or if there's not enough memory (the octree is left unchanged)
+	**/
+	virtual bool addPoints(unsigned firstIndex);
+
+	//! Removes points from the octree structure (without rebuilding it)
+	/** The associated cloud is supposed to be compacted in place: the remaining
+		points keep their relative order (i.e. point #i is moved to index i minus
+		the number of removed points before it). The removed points are dropped
+		from the structure and the others are re-indexed accordingly, in a single
+		compaction pass. The cells statistics are updated incrementally.
+		\param removedPoints for each point of the associated cloud (before compaction), whether it is removed or not
+		\return false if the input table is too small or if there's not enough memory (the octree is left unchanged)
+	**/
+	virtual bool removePoints(const std::vector<bool>& removedPoints);
+
+	//! Updates the octree structure once the associated cloud has been reordered in the octree order
+	/** The points of the associated cloud must have been permuted so that the ith
+		point of the octree structure (see pointsAndTheirCellCodes) is now the ith
+		point of the cloud (the points that are not projected in the octree coming
+		after them). The cells then correspond to contiguous ranges of points, and
+		the neighbourhood searches read the cloud (almost) sequentially.
+	**/
+	virtual void reindexInOctreeOrder();
+
+	//! Projects a range of points in the octree (see genericBuild)
+	/** Points outside of the 'accepted points' box are skipped. Can be called
+		concurrently on different ranges.
+		\param firstIndex index of the first point
+		\param lastIndex index of the last point (excluded)
+		\param output output codes (at least lastIndex-firstIndex elements)
+		\param projectedCount number of points actually projected (i.e. written in 'output')
+		\param fillIndexes min and max occupied cells indexes at MAX_OCTREE_LEVEL (only valid if 'projectedCount' > 0)
+		\param nprogress optional progress notification
+		\return false if the process was cancelled
+	**/
+	bool projectPoints(	unsigned firstIndex,
+						unsigned lastIndex,
+						IndexAndCode* output,
+						unsigned& projectedCount,
+						int fillIndexes[6],
+						NormalizedProgress* nprogress = 0) const;
+
 	/**** GETTERS ****/
 
 	//! Returns the number of points projected into the octree
@@ -623,6 +1045,45 @@ public:
 												double radius,
 												bool sortValues = true) const;
 
+	//! Batch form of the nearest neighbours search algorithm (k nearest neighbours)
+	/** Looks for the k nearest neighbours of several query points lying in the same
+		octree cell. The neighbourhood of the cell is gathered once for all the queries,
+		distances are computed with vectorized kernels (SSE/AVX if available) and the k
+		nearest neighbours are selected without sorting the whole neighbourhood.
+		If nNBSS.maxSearchSquareDistd is positive, only the neighbours closer than
+		this distance are returned. See DgmOctree::NearestNeighboursBatchSearchStruct
+		for more details.
+		\param nNBSS batch NN search parameters (and results)
+		\param queryPoints cloud holding the query points
+		\param firstQueryIndex index of the first query point in 'queryPoints'
+		\param queryCount number of (consecutive) query points
+		\param k number of neighbours to find for each query point
+		\return the total number of neighbours found
+	**/
+	unsigned findNearestNeighborsForPointsInCell(	NearestNeighboursBatchSearchStruct &nNBSS,
+													const GenericIndexedCloud* queryPoints,
+													unsigned firstQueryIndex,
+													unsigned queryCount,
+													unsigned k) const;
+
+	//! Batch form of the nearest neighbours search algorithm (in a sphere)
+	/** Looks for the neighbours inside a sphere of several query points lying in the
+		same octree cell (see DgmOctree::findNearestNeighborsForPointsInCell).
+		\param nNBSS batch NN search parameters (and results)
+		\param queryPoints cloud holding the query points
+		\param firstQueryIndex index of the first query point in 'queryPoints'
+		\param queryCount number of (consecutive) query points
+		\param radius the sphere radius
+		\param sortValues specifies if the neighbours needs to be sorted by their distance to the query point or not
+		\return the total number of neighbours found
+	**/
+	unsigned findNeighborsInASphereForPointsInCell(	NearestNeighboursBatchSearchStruct &nNBSS,
+													const GenericIndexedCloud* queryPoints,
+													unsigned firstQueryIndex,
+													unsigned queryCount,
+													PointCoordinateType radius,
+													bool sortValues = true) const;
+
 	//deprecated
 	//int getPointsInSphericalNeighbourhood(const CCVector3& sphereCenter, PointCoordinateType radius, NeighboursSet& neighbours) const;
 
@@ -874,7 +1335,7 @@ public:
 	uchar findBestLevelForAGivenCellNumber(unsigned indicativeNumberOfCells) const;
 
 	//! Returns the ith cell code
-	inline const OctreeCellCodeType& getCellCode(unsigned index) const { return m_thePointsAndTheirCellCodes[index].theCode; }
+	inline OctreeCellCodeType getCellCode(unsigned index) const { return m_thePointsAndTheirCellCodes.getCode(index); }
 
 	//! Returns the list of codes corresponding to the octree cells for a given level of subdivision
 	/** Only the non empty cells are represented in the octree structure.
@@ -926,7 +1387,7 @@ public:
 		\param cellsA the number of cells of the first octree for the given number of subdivision
 		\param cellsB the number of cells of the second octree for the given number of subdivision
 	**/
-	void diff(uchar octreeLevel, const cellsContainer &codesA, const cellsContainer &codesB, int &diffA, int &diffB, int &cellsA, int &cellsB) const;
+	void diff(uchar octreeLevel, const pointsAndCodesContainer &codesA, const pointsAndCodesContainer &codesB, int &diffA, int &diffB, int &cellsA, int &cellsB) const;
 
 	//! Returns the number of cells for a given level of subdivision
 	inline const unsigned& getCellNumber(uchar level) const
@@ -1039,10 +1500,19 @@ public:
 												GenericProgressCallback* progressCb = 0,
 												const char* functionTitle = 0);
 
+	//! Sets the max. number of threads used by the multi-threaded cell functions
+	/** See executeFunctionForAllCellsAtLevel_MT and executeFunctionForAllCellsAtStartingLevel_MT.
+		\param count max. number of threads (0 = as many as the number of cores)
+	**/
+	static void SetMaxThreadCount(int count);
+	//! Returns the max. number of threads used by the multi-threaded cell functions (0 = as many as the number of cores)
+	static int GetMaxThreadCount();
+
 #ifdef ENABLE_MT_OCTREE
 	//! Multi-threaded version of executeFunctionForAllCellsAtLevel
-	/** Based on QtConcurrent::map system. Dispatches automatically
-		computation on as much cores on the system.
+	/** Contiguous cells are grouped in batches of similar cost (number of
+		points). Batches are processed heaviest first: each thread takes the
+		next remaining batch as soon as it's idle (see SetMaxThreadCount).
 		\return the number of processed cells (or 0 is something went wrong)
 	**/
 	unsigned executeFunctionForAllCellsAtLevel_MT(uchar level,
@@ -1051,9 +1521,8 @@ public:
 													GenericProgressCallback* progressCb = 0,
 													const char* functionTitle = 0);
 
-	//! Multi-threaded version of executeFunctionForAllCellsAtLevel
-	/** Based on QtConcurrent::map system. Dispatches automatically
-		computation on as much cores on the system.
+	//! Multi-threaded version of executeFunctionForAllCellsAtStartingLevel
+	/** Same scheduling as executeFunctionForAllCellsAtLevel_MT.
 		\return the number of processed cells (or 0 is something went wrong)
 	**/
 	unsigned executeFunctionForAllCellsAtStartingLevel_MT(	uchar level,
@@ -1071,12 +1540,44 @@ public:
 		return m_theAssociatedCloud;
 	}
 
+	//! Sets a cloud whose points should be released along with the associated cloud ones
+	/** The cell function dispatchers release the points of the associated cloud
+		after each cell (or group of cells): see GenericIndexedCloudPersist::releasePointsPointers.
+		If the cell function uses the points of another cloud (e.g. the reference cloud
+		of a cloud-to-cloud distance computation), they can be released at the same time.
+		\param cloud other cloud (or 0)
+	**/
+	inline void setSecondaryCloud(GenericIndexedCloudPersist* cloud) { m_secondaryCloud = cloud; }
+
+	//! Releases the points of the associated cloud (and of the secondary cloud, if any)
+	void releaseCloudsPointers() const;
+
 	//! Returns the octree 'structure'
-	const cellsContainer& pointsAndTheirCellCodes() const
+	const pointsAndCodesContainer& pointsAndTheirCellCodes() const
 	{
 		return m_thePointsAndTheirCellCodes;
 	}
 
+	//! Sets whether the octree 'structure' should be stored in a compact form
+	/** In compact form, the points indexes and their cell codes take roughly 10 bytes
+		per point (instead of 16 with 64 bits codes), at the expense of slightly slower
+		accesses. See DgmOctree::pointsAndCodesContainer. If the octree is already built,
+		its structure is converted.
+		\param state whether to use the compact form or not
+		\return false if there's not enough memory to convert the structure
+	**/
+	bool setCompactStorage(bool state);
+
+	//! Returns whether the octree 'structure' is stored in a compact form
+	inline bool hasCompactStorage() const { return m_compactStorage; }
+
+	//! Sets whether the octrees created afterwards store their 'structure' in a compact form
+	/** Disabled by default (see setCompactStorage).
+	**/
+	static void SetCompactStorageByDefault(bool state);
+	//! Returns whether the octrees store their 'structure' in a compact form by default
+	static bool CompactStorageByDefault();
+
 protected:
 
 	/*******************************/
@@ -1099,11 +1600,17 @@ protected:
 	/********************************/
 
 	//! The coded octree structure
-	cellsContainer m_thePointsAndTheirCellCodes;
+	pointsAndCodesContainer m_thePointsAndTheirCellCodes;
+
+	//! Whether the octree structure should be stored in a compact form
+	bool m_compactStorage;
 
 	//! Associated cloud
 	GenericIndexedCloudPersist* m_theAssociatedCloud;
 
+	//! Secondary cloud (see setSecondaryCloud)
+	GenericIndexedCloudPersist* m_secondaryCloud;
+
 	//! Number of points projected in the octree
 	unsigned m_numberOfProjectedPoints;
 
@@ -1129,6 +1636,10 @@ protected:
 	double m_averageCellPopulation[MAX_OCTREE_LEVEL+1];
 	//! Std. dev. of cell population per level of subdivision
 	double m_stdDevCellPopulation[MAX_OCTREE_LEVEL+1];
+	//! Number of cells with the max population per level of subdivision
+	unsigned m_mostPopulatedCellCount[MAX_OCTREE_LEVEL+1];
+	//! Sum of the squared cells population per level of subdivision
+	quint64 m_cellPopulationSquareSum[MAX_OCTREE_LEVEL+1];
 
 	/******************************/
 	/**         METHODS          **/
@@ -1156,6 +1667,19 @@ protected:
 	**/
 	void computeCellsStatistics(uchar level);
 
+	//! Updates the cells statistics before some points are inserted in or removed from the octree structure
+	/** Only the cells containing these points are visited (instead of the whole
+		structure with computeCellsStatistics). Must be called before the octree
+		structure is actually updated.
+		\param codes codes of the inserted or removed points (sorted by ascending code)
+		\param inserted whether the points are inserted or removed
+		\param levelsToUpdate for each level of subdivision, whether its statistics should be recomputed once the structure is updated (see computeCellsStatistics)
+	**/
+	void updateCellsStatistics(const cellsContainer& codes, bool inserted, bool levelsToUpdate[]);
+
+	//! Deduces the lower levels 'fill indexes' from the highest level ones
+	void updateFillIndexesTable();
+
 	//! Returns the indexes of the neighbourhing (existing) cells of a given cell
 	/** This function is used by the nearest neighbours search algorithms.
 		\param cellPos the query cell
@@ -1183,6 +1707,14 @@ protected:
 												int maxNeighbourhoodLength) const;
 #endif
 
+	//! Extends the neighbourhood gathered for a batch NN search
+	/** Gets the points of the neighbourhing cells (see getPointsInNeighbourCellsAround)
+		up to a given distance and appends their coordinates to the candidates arrays.
+		\param nNBSS batch NN search parameters
+		\param neighbourhoodSize the new size of the visited neighbourhood (see NearestNeighboursSearchStruct::alreadyVisitedNeighbourhoodSize)
+	**/
+	void extendBatchNeighbourhood(NearestNeighboursBatchSearchStruct &nNBSS, int neighbourhoodSize) const;
+
 	//! Returns the index of a given cell represented by its code
 	/** The index is found thanks to a binary search. The index of an existing cell
 		is between 0 and the number of points projected in the octree minus 1. If
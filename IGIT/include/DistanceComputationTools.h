@@ -147,10 +147,18 @@ public: //distance to clouds or meshes
 										DgmOctree* compOctree = 0,
 										DgmOctree* refOctree = 0);
 
+	//! Cloud-to-mesh distance computation engines
+	enum CLOUD2MESH_ENGINE {	C2M_GRID_ENGINE,	/**< Triangles are projected in a regular grid (see intersectMeshWithOctree) **/
+								C2M_BVH_ENGINE,		/**< Triangles are indexed by a bounding volume hierarchy (see MeshBVH) **/
+	};
+
 	//! Computes the distance between a point cloud and a mesh
 	/** The algorithm, inspired from METRO by Cignoni et al., is described
 		in Daniel Girardeau-Montaut's PhD manuscript (Chapter 2, section 2.2).
 		It is the general way to compare a point cloud with a triangular mesh.
+		With the BVH engine, the triangles are not projected in a grid anymore (less memory
+		for large or elongated meshes): the octree cells are only used to build coherent
+		packets of points that are processed at once.
 		\param pointCloud the compared cloud (the distances will be computed on these points)
 		\param theMesh the reference mesh (the distances will be computed relatively to its triangles)
 		\param octreeLevel the level of subdivision of the octree at witch to apply the algorithm
@@ -158,9 +166,10 @@ public: //distance to clouds or meshes
 		\param useDistanceMap if true, the distances over "maxSearchDist" will be aproximated by the Chamfer 3-4-5 distance transform (acceleration)
 		\param signedDistances if true, the computed distances will be signed (in this case, Chamfer distances can't be computed and useDistanceMap is ignored)
 		\param flipNormals specify whether triangle normals should be computed in the 'direct' order (true) or 'indirect' (false)
-		\param multiThread specify whether to use multi-thread or single thread mode (if maxSearchDist>=0, single thread mode is forced)
+		\param multiThread specify whether to use multi-thread or single thread mode (if useDistanceMap is true, single thread mode is forced)
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
 		\param cloudOctree the pre-computed octree of the compared cloud (warning: its bounding box should be equal to the union of both point cloud and mesh bbs and it should be cubical - it is automatically computed if 0)
+		\param engine distance computation engine (useDistanceMap is ignored by the BVH engine)
 		\return 0 if ok, a negative value otherwise
 	**/
 	static int computePointCloud2MeshDistance(	GenericIndexedCloudPersist* pointCloud,
@@ -172,7 +181,8 @@ public: //distance to clouds or meshes
 												bool flipNormals = false,
 												bool multiThread = true,
 												GenericProgressCallback* progressCb = 0,
-												DgmOctree* cloudOctree = 0);
+												DgmOctree* cloudOctree = 0,
+												CLOUD2MESH_ENGINE engine = C2M_GRID_ENGINE);
 
 	//! Computes the Chamfer distances (approximated distances) between two point clouds
 	/** This methods uses a 3D grid to perfrom the Chamfer Distance propagation.
@@ -363,21 +373,45 @@ protected:
 														GenericProgressCallback* progressCb = 0);
 
 #ifdef ENABLE_CLOUD2MESH_DIST_MT
-	//! Multi-thread version of computePointCloud2MeshSignedDistanceWithOctree and computePointCloud2MeshSquareDistanceWithOctree
-	/** Warning: doesn't support the 'maxSearchDist' feature.
+	//! Multi-thread version of computePointCloud2MeshDistanceWithOctree
+	/** Warning: doesn't support the Chamfer distance transform acceleration.
 		\param theIntersection a specific structure corresponding the intersection of the mesh with the grid
 		\param octreeLevel the octree subdivision level corresponding to the grid
 		\param signedDistances whether to compute signed or positive (squared) distances
 		\param flipTriangleNormals if 'signedDistances' is true, specify whether triangle normals should be computed in the 'direct' order (true) or 'indirect' (false)
+		\param maxSearchDist if greater than 0 (default value: '-1'), then the algorithm won't compute distances over this value (the farther points get this value)
 		\param progressCb the client method can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
 	**/
 	static int computePointCloud2MeshDistanceWithOctree_MT(	OctreeAndMeshIntersection* theIntersection,
 															uchar octreeLevel,
 															bool signedDistances,
-															bool flipTriangleNormals=false,
+															bool flipTriangleNormals = false,
+															ScalarType maxSearchDist = -1.0,
 															GenericProgressCallback* progressCb = 0);
 #endif
 
+	//! Computes the distances between a point cloud and a mesh with a bounding volume hierarchy (see MeshBVH)
+	/** This method is used by computePointCloud2MeshDistance (BVH engine).
+		The points of each octree cell are processed by packets (see MeshBVH::findNearestTriangles).
+		\param theOctree the octree of the compared cloud
+		\param octreeLevel the octree subdivision level at which the cells are processed
+		\param theMesh the reference mesh
+		\param signedDistances whether to compute signed or positive (squared) distances
+		\param flipTriangleNormals if 'signedDistances' is true, specify whether triangle normals should be computed in the 'direct' order (true) or 'indirect' (false)
+		\param maxSearchDist if greater than 0 (default value: '-1'), then the algorithm won't compute distances over this value (the farther points get this value)
+		\param multiThread specify whether to use multi-thread or single thread mode
+		\param progressCb the client method can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return 0 if ok, a negative value otherwise
+	**/
+	static int computePointCloud2MeshDistanceWithBVH(	DgmOctree* theOctree,
+														uchar octreeLevel,
+														GenericIndexedMesh* theMesh,
+														bool signedDistances,
+														bool flipTriangleNormals = false,
+														ScalarType maxSearchDist = -1.0,
+														bool multiThread = true,
+														GenericProgressCallback* progressCb = 0);
+
 	//! Computes the "nearest neighbour distance" without local modeling for all points of an octree cell
 	/** This method has the generic syntax of a "cellular function" (see DgmOctree::localFunctionPtr).
 		Specific parameters are transmitted via the "additionalParameters" structure.
@@ -45,6 +45,21 @@ public:
 	**/
 	//صָ(벢зʽ)
 	virtual const CCVector3* getPointPersistentPtr(unsigned index) = 0;
+
+	//! Returns the max. number of points that should be used at the same time
+	/** For clouds that are not entirely loaded in memory (see OutOfCoreCloud).
+		The algorithms that use many points (e.g. the DgmOctree cell functions)
+		work by groups of points (or cells) of this size at most, and call
+		releasePointsPointers after each group.
+		\return max. number of points (or 0 if there's no limit)
+	**/
+	virtual unsigned getWorkingSetSize() const { return 0; }
+
+	//! Notifies the cloud that the points previously returned are not used anymore
+	/** The pointers returned by getPoint or getPointPersistentPtr before this
+		call may become invalid (see getWorkingSetSize).
+	**/
+	virtual void releasePointsPointers() {}
 };
 
 }
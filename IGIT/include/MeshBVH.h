@@ -0,0 +1,155 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef MESH_BVH_HEADER
+#define MESH_BVH_HEADER
+
+//Local
+#include "CCCoreLib.h"
+#include "CCTypes.h"
+#include "CCGeom.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedMesh;
+class GenericProgressCallback;
+
+//! Bounding volume hierarchy over the triangles of a mesh
+/** The hierarchy is built with the Surface Area Heuristic (binned version) and
+	is stored as a flat array of nodes (depth-first order: the left child of a node
+	always follows its parent). It is used to find the nearest triangle(s) of
+	small packets of points at once (see DistanceComputationTools::computePointCloud2MeshDistance).
+	\warning assumes PointCoordinateType is 'float' (see CCTypes.h)
+**/
+class CC_CORE_LIB_API MeshBVH
+{
+public:
+
+	//! Max number of points per query packet
+	static const unsigned MAX_PACKET_SIZE = 16;
+
+	//! Max number of triangles per leaf
+	static const unsigned MAX_LEAF_SIZE = 4;
+
+	//! Invalid triangle index (returned when no triangle is found)
+	static const unsigned INVALID_INDEX = static_cast<unsigned>(-1);
+
+	//! Tree node (32 bytes)
+	struct Node
+	{
+		//! Bounding-box min corner
+		PointCoordinateType bbMin[3];
+		//! Index of the first triangle (leaf) or of the right child (inner node)
+		unsigned first;
+		//! Bounding-box max corner
+		PointCoordinateType bbMax[3];
+		//! Number of triangles (0 for inner nodes)
+		unsigned count;
+
+		//! Returns whether the node is a leaf
+		inline bool isLeaf() const { return count != 0; }
+	};
+
+	//! Triangle data pre-computed for the distance kernels
+	struct PackedTriangle
+	{
+		//! Summits (as returned by GenericIndexedMesh::getTriangleSummits)
+		CCVector3 A, B, C;
+		//! Edges (AB, BC and CA)
+		CCVector3 e0, e1, e2;
+		//! Inverse of the edges square length (0 if null)
+		PointCoordinateType invE0, invE1, invE2;
+		//! Unit normal (AB x AC)
+		CCVector3 N;
+		//! Whether the triangle is degenerate (in which case only its edges are considered)
+		bool degenerate;
+		//! Unit in-plane normals of the edges (pointing inside the triangle)
+		CCVector3 n0, n1, n2;
+		//! Tolerance for the 'inside' test (the plane distance is a lower bound anyway)
+		PointCoordinateType insideTol;
+		//! Triangle index in the original mesh
+		unsigned index;
+	};
+
+	//! Default constructor
+	MeshBVH();
+
+	//! Destructor
+	~MeshBVH();
+
+	//! Builds the hierarchy
+	/** \param mesh mesh
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool build(GenericIndexedMesh* mesh, GenericProgressCallback* progressCb = 0);
+
+	//! Clears structure
+	void clear();
+
+	//! Returns the associated mesh
+	inline GenericIndexedMesh* associatedMesh() const { return m_associatedMesh; }
+
+	//! Returns the number of nodes
+	inline unsigned nodeCount() const { return static_cast<unsigned>(m_nodes.size()); }
+
+	//! Returns the number of (indexed) triangles
+	inline unsigned triangleCount() const { return static_cast<unsigned>(m_triangles.size()); }
+
+	//! Finds the nearest triangle of each point of a packet
+	/** Distances are expressed as in DistanceComputationTools::computePoint2TriangleDistance
+		(i.e. signed distances or unsigned squared distances) and are computed by this method
+		(in double precision) for the retained triangles. The input distances act as bounds: a
+		point keeps its current distance (and gets INVALID_INDEX) if no triangle is strictly
+		closer. NaN (i.e. invalid) input distances mean 'no bound'.
+		\param points query points (at most MAX_PACKET_SIZE)
+		\param count number of points
+		\param signedDistances whether distances are signed or unsigned (squared)
+		\param[in,out] distances distance of each point to its nearest triangle
+		\param[out] triangleIndexes index (in the original mesh) of the nearest triangle of each point
+	**/
+	void findNearestTriangles(	const CCVector3* const* points,
+								unsigned count,
+								bool signedDistances,
+								ScalarType* distances,
+								unsigned* triangleIndexes) const;
+
+protected:
+
+	//! Nodes (the root is the first one)
+	std::vector<Node> m_nodes;
+
+	//! Triangles (sorted in leaf order)
+	std::vector<PackedTriangle> m_triangles;
+
+	//! Associated mesh
+	GenericIndexedMesh* m_associatedMesh;
+
+	//! Absolute margin applied to the (single precision) culling bounds
+	double m_absoluteMargin;
+
+	//! Max depth of the tree
+	unsigned m_maxDepth;
+};
+
+} //namespace CCLib
+
+#endif //MESH_BVH_HEADER
@@ -0,0 +1,249 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef OUT_OF_CORE_CLOUD_HEADER
+#define OUT_OF_CORE_CLOUD_HEADER
+
+//Local
+#include "CCCoreLib.h"
+#include "GenericIndexedCloudPersist.h"
+
+//Qt
+#include <QFile>
+#include <QMutex>
+#include <QAtomicInt>
+
+//system
+#include <vector>
+#include <algorithm>
+
+namespace CCLib
+{
+
+class GenericProgressCallback;
+
+//! A point cloud stored on disk (for clouds bigger than the available memory)
+/** Implements the GenericIndexedCloudPersist interface. Points (and their
+	scalar value) are stored in a file, by pages of POINTS_PER_PAGE points.
+	Only a bounded number of pages are loaded in memory at the same time
+	(LRU cache).
+
+	Once imported (see addPoint), the points are sorted by octree cell code
+	(see sortPoints): the cells of a DgmOctree built on this cloud are then
+	contiguous ranges of pages, and the octree cell functions only load the
+	pages of the cells currently processed (and of their neighbours).
+
+	Persistent pointers:
+	The pointers returned by getPoint/getPointPersistentPtr remain valid until
+	the next call to releasePointsPointers (the DgmOctree cell functions call
+	it after each cell, or group of cells for the multi-threaded versions). The
+	pages used in the meantime are never unloaded: the memory limit is a soft
+	limit that can be exceeded if too many points are used between two calls.
+**/
+class CC_CORE_LIB_API OutOfCoreCloud : public GenericIndexedCloudPersist
+{
+public:
+
+	//! Number of points per page
+	static const unsigned POINTS_PER_PAGE = (1 << 16);
+
+	//! Default max. size of the loaded pages (in bytes)
+	static const size_t DEFAULT_MAX_RESIDENT_SIZE = (size_t(1) << 30);
+
+	//! Default constructor
+	/** \param maxResidentSize max. size of the loaded pages (in bytes)
+	**/
+	OutOfCoreCloud(size_t maxResidentSize = DEFAULT_MAX_RESIDENT_SIZE);
+
+	//! Destructor
+	/** The file is closed (see close).
+	**/
+	virtual ~OutOfCoreCloud();
+
+	//**** inherited form GenericCloud ****//
+	virtual unsigned size() const { return m_pointCount; }
+	virtual void forEach(genericPointAction& anAction);
+	virtual void getBoundingBox(PointCoordinateType bbMin[], PointCoordinateType bbMax[]);
+	virtual void placeIteratorAtBegining();
+	virtual const CCVector3* getNextPoint();
+	virtual bool enableScalarField();
+	virtual bool isScalarFieldEnabled() const { return m_scalarFieldEnabled; }
+	virtual void setPointScalarValue(unsigned pointIndex, ScalarType value);
+	virtual ScalarType getPointScalarValue(unsigned pointIndex) const;
+
+	//**** inherited form GenericIndexedCloud ****//
+	inline virtual const CCVector3* getPoint(unsigned index) { return getPointPersistentPtr(index); }
+	virtual void getPoint(unsigned index, CCVector3& P) const;
+
+	//**** inherited form GenericIndexedCloudPersist ****//
+	virtual const CCVector3* getPointPersistentPtr(unsigned index);
+	virtual unsigned getWorkingSetSize() const;
+	virtual void releasePointsPointers();
+
+	//! Creates a new cloud file
+	/** The points must then be added with addPoint, and sorted with sortPoints.
+		\param filename cloud file (overwritten if it already exists)
+		\return success
+	**/
+	bool create(const char* filename);
+
+	//! Adds a point to a new cloud (see create)
+	/** Points are first stored in a temporary file (next to the cloud file).
+		\param P the point to insert
+		\return success
+	**/
+	bool addPoint(const CCVector3& P);
+
+	//! Sorts the points added to a new cloud and makes it usable
+	/** Points are sorted by octree cell code (with the same bounding-box as
+		DgmOctree::build) with an external sort: they are first dispatched in
+		groups of contiguous cells that fit in memory, then each group is sorted.
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool sortPoints(GenericProgressCallback* progressCb = 0);
+
+	//! Opens an existing cloud file
+	/** \param filename cloud file (see create)
+		\return success
+	**/
+	bool open(const char* filename);
+
+	//! Saves the modified pages and closes the cloud file
+	/** \return success (false if some data couldn't be written)
+	**/
+	bool close();
+
+	//! Returns whether the points are sorted by octree cell code (see sortPoints)
+	bool isSorted() const { return m_sorted; }
+
+	//! Returns the current size of the loaded pages (in bytes)
+	size_t getResidentSize() const;
+
+	//! Returns the max. size of the loaded pages (in bytes)
+	size_t getMaxResidentSize() const { return m_maxResidentSize; }
+
+protected:
+
+	//! Page of points
+	struct Page
+	{
+		//! Points (or 0 if the page is not loaded)
+		CCVector3* points;
+		//! Scalar values
+		ScalarType* values;
+		//! Last use time (for the LRU policy)
+		quint64 lastUse;
+		//! Last epoch during which the page has been pinned (see releasePointsPointers)
+		/** 0 if the page is not loaded. Read without lock by the 'fast path' of the
+			point accessors: it is set (with release semantics) once the page is loaded,
+			and read with acquire semantics.
+		**/
+		QAtomicInt epoch;
+		//! Whether the page has been modified since it has been loaded
+		bool modified;
+
+		Page() : points(0), values(0), lastUse(0), epoch(0), modified(false) {}
+	};
+
+	//! Returns the number of points of a given page
+	inline unsigned getPagePointCount(unsigned pageIndex) const { return std::min(POINTS_PER_PAGE, m_pointCount - pageIndex * POINTS_PER_PAGE); }
+
+	//! Loads a page (if necessary) and pins it until the next call to releasePointsPointers
+	/** Warning: m_cacheMutex must be locked.
+		\param pageIndex page index
+		\param pin whether the page should be pinned or not
+		\return the page (or 0 if an error occurred)
+	**/
+	Page* usePage(unsigned pageIndex, bool pin) const;
+
+	//! Loads a page
+	/** Warning: m_cacheMutex must be locked.
+		\param pageIndex page index
+		\return success
+	**/
+	bool loadPage(unsigned pageIndex) const;
+
+	//! Unloads the least recently used pages (not pinned) until a new page can be loaded
+	/** Warning: m_cacheMutex must be locked.
+		\return false if some data couldn't be written
+	**/
+	bool makeRoomForOnePage() const;
+
+	//! Writes a page in the file (if it has been modified)
+	/** Warning: m_cacheMutex must be locked.
+	**/
+	bool writePage(unsigned pageIndex) const;
+
+	//! Unloads all pages (after having saved the modified ones)
+	bool unloadAllPages();
+
+	//! Writes the import buffer in the import file
+	bool flushImportBuffer();
+
+	//! Writes the file header
+	bool writeHeader();
+
+	//! Clears everything (without saving anything)
+	void clear();
+
+	//! Cloud file
+	mutable QFile m_file;
+	//! Temporary file used to import points (see addPoint)
+	QFile m_importFile;
+	//! Import buffer
+	std::vector<CCVector3> m_importBuffer;
+	//! Number of imported points
+	unsigned m_importCount;
+
+	//! Number of points
+	unsigned m_pointCount;
+	//! Bounding-box
+	CCVector3 m_bbMin, m_bbMax;
+	//! Whether the points are sorted by octree cell code
+	bool m_sorted;
+	//! Whether the scalar field is enabled
+	bool m_scalarFieldEnabled;
+
+	//! Pages
+	mutable std::vector<Page> m_pages;
+	//! Loaded pages (indexes)
+	mutable std::vector<unsigned> m_loadedPages;
+	//! Max. size of the loaded pages (in bytes)
+	size_t m_maxResidentSize;
+	//! Page use counter (for the LRU policy)
+	mutable quint64 m_useCounter;
+	//! Current epoch (see releasePointsPointers)
+	/** Only changed by releasePointsPointers, which is never called while
+		the points are accessed by other threads.
+	**/
+	unsigned m_epoch;
+	//! Whether an I/O error occurred
+	mutable bool m_ioError;
+
+	//! Mutex protecting the pages cache
+	mutable QMutex m_cacheMutex;
+
+	//! Iterator on the points
+	unsigned m_globalIterator;
+	//! Copy of the last point returned by getNextPoint
+	CCVector3 m_iteratorPoint;
+};
+
+}
+
+#endif //OUT_OF_CORE_CLOUD_HEADER
@@ -61,6 +61,8 @@ public:
 
 	//**** inherited form GenericIndexedCloudPersist ****//
 	inline virtual const CCVector3* getPointPersistentPtr(unsigned index) { assert(m_theAssociatedCloud && index < size()); return m_theAssociatedCloud->getPointPersistentPtr(m_theIndexes->getValue(index)); }
+	inline virtual unsigned getWorkingSetSize() const { return (m_theAssociatedCloud ? m_theAssociatedCloud->getWorkingSetSize() : 0); }
+	inline virtual void releasePointsPointers() { if (m_theAssociatedCloud) m_theAssociatedCloud->releasePointsPointers(); }
 
 	//! Returns global index (i.e. relative to the associated cloud) of a given element
 	/** \param localIndex local index (i.e. relative to the internal index container)
@@ -625,43 +625,86 @@ bool CloudSamplingTools::applySORFilterAtLevel(	const DgmOctree::octreeCell& cel
 	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
 	nNSS.level = cell.level;
 	nNSS.prepare(kernelRadius,cell.parentOctree->getCellSize(nNSS.level));
-	if (useKnn)
-		nNSS.minNumberOfNeighbors = knn;
 	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
 	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
 
 	unsigned n = cell.points->size(); //number of points in the current cell
 
+	//in 'knn' mode, we look for the nearest neighbors of all the points of the cell at once
+	//(knn+1 as the query point itself is generally part of the result)
+	DgmOctree::NearestNeighboursBatchSearchStruct nNBSS;
+	DgmOctree::NeighboursSet knnNeighbours;
+	if (useKnn)
+	{
+		nNBSS.level = cell.level;
+		cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNBSS.cellPos,true);
+		cell.parentOctree->computeCellCenter(nNBSS.cellPos,cell.level,nNBSS.cellCenter);
+		cell.parentOctree->findNearestNeighborsForPointsInCell(nNBSS,cell.points,0,n,static_cast<unsigned>(knn)+1);
+		if (nNBSS.neighboursStart.empty()) //not enough memory
+			return false;
+		try
+		{
+			knnNeighbours.reserve(knn+1);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return false;
+		}
+	}
+	DgmOctree::NeighboursSet& neighbours = (useKnn ? knnNeighbours : nNSS.pointsInNeighbourhood);
+
 	//for each point in the cell
 	for (unsigned i=0; i<n; ++i)
 	{
 		cell.points->getPoint(i,nNSS.queryPoint);
+		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
 
-		//look for neighbors in a sphere
-		//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (neighborCount)!
-		unsigned neighborCount = 0;
+		//number of neighbors (other than the point itself)
+		unsigned realNeighborCount = 0;
 
 		if (useKnn)
-			neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
+		{
+			//we keep the 'knn' nearest neighbors other than the query point itself (identified by its index, as it may have duplicates)
+			unsigned neighborCount = nNBSS.getNeighbourCount(i);
+			knnNeighbours.clear();
+			if (neighborCount != 0)
+			{
+				const DgmOctree::PointDescriptor* knnSet = nNBSS.getNeighbours(i);
+				for (unsigned j=0; j<neighborCount; ++j)
+					if (knnSet[j].pointIndex != globalIndex)
+						knnNeighbours.push_back(knnSet[j]);
+			}
+			if (knnNeighbours.size() > static_cast<size_t>(knn)) //the query point was not part of the result (more than 'knn' duplicates)
+				knnNeighbours.resize(knn);
+			realNeighborCount = static_cast<unsigned>(knnNeighbours.size());
+		}
 		else
-			neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,kernelRadius,false);
-
-		if (neighborCount > 3) //we want 3 points or more (other than the point itself!)
 		{
-			//find the query point in the nearest neighbors set and place it at the end
-			const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+			//look for neighbors in a sphere
+			//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (neighborCount)!
+			unsigned neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,kernelRadius,false);
+
+			//find the query point in the neighbors set and place it at the end
 			unsigned localIndex = 0;
-			while (localIndex < neighborCount && nNSS.pointsInNeighbourhood[localIndex].pointIndex != globalIndex)
+			while (localIndex < neighborCount && neighbours[localIndex].pointIndex != globalIndex)
 				++localIndex;
-			//the query point should be in the nearest neighbors set!
+			//the query point should be in the neighbors set!
 			assert(localIndex < neighborCount);
-			if (localIndex+1 < neighborCount) //no need to swap with another point if it's already at the end!
+			if (localIndex < neighborCount)
 			{
-				std::swap(nNSS.pointsInNeighbourhood[localIndex],nNSS.pointsInNeighbourhood[neighborCount-1]);
+				if (localIndex+1 < neighborCount) //no need to swap with another point if it's already at the end!
+					std::swap(neighbours[localIndex],neighbours[neighborCount-1]);
+				realNeighborCount = neighborCount-1;
 			}
+			else
+			{
+				realNeighborCount = neighborCount;
+			}
+		}
 
-			unsigned realNeighborCount = neighborCount-1;
-			DgmOctreeReferenceCloud neighboursCloud(&nNSS.pointsInNeighbourhood,realNeighborCount); //we don't take the query point into account!
+		if (realNeighborCount >= 3) //we want 3 points or more (other than the point itself!)
+		{
+			DgmOctreeReferenceCloud neighboursCloud(&neighbours,realNeighborCount); //we don't take the query point into account!
 			Neighbourhood Z(&neighboursCloud);
 
 			const PointCoordinateType* lsq = Z.getLSQPlane();
@@ -702,7 +745,6 @@ bool CloudSamplingTools::applySORFilterAtLevel(	const DgmOctree::octreeCell& cel
 			if (!removeIsolatedPoints)
 			{
 				//we keep the point
-				unsigned globalIndex = cell.points->getPointGlobalIndex(i);
 				cloud->addPointIndex(globalIndex);
 			}
 		}
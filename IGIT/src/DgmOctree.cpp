@@ -31,8 +31,28 @@
 #include <stdio.h>
 #include <set>
 
+//SIMD (for the batch NN search distance kernels)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define OCTREE_NN_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCTREE_NN_SSE
+#endif
+
+//Qt
+#include <QThreadStorage>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#ifdef ENABLE_MT_OCTREE
+//Qt
+#include <QtCore>
+#include <QApplication>
+#include <QtConcurrentMap>
+#endif
+
 //DGM: tests in progress
-//#define COMPUTE_NN_SEARCH_STATISTICS
 //#define ADAPTATIVE_BINARY_SEARCH
 //#define OCTREE_TREE_TEST
 
@@ -150,8 +170,329 @@ void getPointsInTreeCell(octreeTreeCell* cell, CCLib::DgmOctree::NeighboursSet&
 
 using namespace CCLib;
 
+/*** Search statistics ***/
+
+//! Whether the search statistics are gathered or not
+static bool s_searchStatisticsEnabled = false;
+//! Search statistics report function
+static DgmOctree::SearchStatisticsReporter s_searchStatisticsReporter = 0;
+
+//! Search statistics of one thread
+struct SearchStatisticsSlot
+{
+	DgmOctree::SearchStatistics stats;
+	//! Whether a (living) thread currently uses this slot
+	bool used;
+
+	SearchStatisticsSlot() : used(false) {}
+};
+
+//! All search statistics slots (slots of ended threads are recycled, so that their statistics are kept)
+static std::vector<SearchStatisticsSlot*> s_searchStatisticsSlots;
+//! Mutex protecting s_searchStatisticsSlots
+static QMutex s_searchStatisticsMutex;
+
+//! Link between a thread and its search statistics slot (automatically deleted when the thread ends)
+struct SearchStatisticsLink
+{
+	SearchStatisticsSlot* slot;
+	//! Statistics currently recording the searches of the thread (see SearchStatisticsRecorder)
+	DgmOctree::SearchStatistics* recording;
+
+	SearchStatisticsLink() : slot(0), recording(0) {}
+
+	~SearchStatisticsLink()
+	{
+		if (slot)
+		{
+			QMutexLocker locker(&s_searchStatisticsMutex);
+			slot->used = false;
+		}
+	}
+};
+
+static QThreadStorage<SearchStatisticsLink*> s_searchStatisticsLinks;
+
+//! Returns the search statistics link of the current thread (or 0 if not enough memory)
+static SearchStatisticsLink* GetThreadSearchStatisticsLink()
+{
+	if (!s_searchStatisticsLinks.hasLocalData())
+	{
+		SearchStatisticsLink* link = 0;
+		try
+		{
+			link = new SearchStatisticsLink;
+
+			QMutexLocker locker(&s_searchStatisticsMutex);
+			for (size_t i=0; i<s_searchStatisticsSlots.size(); ++i)
+			{
+				if (!s_searchStatisticsSlots[i]->used)
+				{
+					link->slot = s_searchStatisticsSlots[i];
+					break;
+				}
+			}
+			if (!link->slot)
+			{
+				s_searchStatisticsSlots.reserve(s_searchStatisticsSlots.size()+1); //so that 'push_back' can't throw
+				link->slot = new SearchStatisticsSlot;
+				s_searchStatisticsSlots.push_back(link->slot);
+			}
+			link->slot->used = true;
+		}
+		catch(const std::bad_alloc&)
+		{
+			//not enough memory: no statistics for this thread
+			delete link;
+			return 0;
+		}
+		s_searchStatisticsLinks.setLocalData(link);
+	}
+
+	return s_searchStatisticsLinks.localData();
+}
+
+//! Returns the search statistics of the current thread (or 0 if they are disabled)
+/** During a cells traversal, these are the statistics of the traversal (see
+	SearchStatisticsSession). Otherwise, the searches are directly counted in
+	the thread slot.
+**/
+static inline DgmOctree::SearchStatistics* ThreadSearchStatistics()
+{
+	if (!s_searchStatisticsEnabled)
+		return 0;
+
+	SearchStatisticsLink* link = GetThreadSearchStatisticsLink();
+	if (!link)
+		return 0;
+
+	return link->recording ? link->recording : &link->slot->stats;
+}
+
+//! Returns the time elapsed since the timer (re)start (in ns) and restarts it
+static inline quint64 RestartTimer(QElapsedTimer& timer)
+{
+	quint64 elapsed = static_cast<quint64>(timer.nsecsElapsed());
+	timer.start();
+	return elapsed;
+}
+
+//! Records the searches of the current thread in a given set of statistics
+/** Recordings can be nested (the previous one is restored when the last one
+	stops). When it stops, the recorded statistics are added to the thread
+	slot as well (so that they are part of the global statistics).
+**/
+class SearchStatisticsRecorder
+{
+public:
+
+	SearchStatisticsRecorder() : m_link(0), m_previous(0) {}
+	~SearchStatisticsRecorder() { stop(); }
+
+	//! Starts recording the searches of the current thread in 'stats'
+	void start(DgmOctree::SearchStatistics* stats)
+	{
+		assert(!m_link && stats);
+		m_link = GetThreadSearchStatisticsLink();
+		if (m_link)
+		{
+			m_previous = m_link->recording;
+			m_link->recording = stats;
+		}
+	}
+
+	//! Stops recording
+	void stop()
+	{
+		if (!m_link)
+			return;
+
+		{
+			QMutexLocker locker(&s_searchStatisticsMutex);
+			m_link->slot->stats.add(*m_link->recording);
+		}
+		m_link->recording = m_previous;
+		m_link = 0;
+	}
+
+protected:
+
+	SearchStatisticsLink* m_link;
+	DgmOctree::SearchStatistics* m_previous;
+};
+
+//! Search statistics of a cells traversal (sent to the report function at the end)
+/** Only the searches made for this traversal are counted: the ones of the
+	calling thread, and the ones of the worker threads (see SearchStatisticsWorkerScope).
+	Other traversals running at the same time (or nested in a cell function)
+	have their own session.
+**/
+class SearchStatisticsSession
+{
+public:
+
+	SearchStatisticsSession()
+		: m_active(s_searchStatisticsEnabled && s_searchStatisticsReporter != 0)
+	{
+		if (m_active)
+		{
+			m_recorder.start(&m_callerStats);
+			m_timer.start();
+		}
+	}
+
+	//! Returns whether the searches are recorded
+	inline bool isActive() const { return m_active; }
+
+	//! Adds the statistics recorded by a worker thread (thread-safe)
+	void addWorkerStats(const DgmOctree::SearchStatistics& stats)
+	{
+		QMutexLocker locker(&m_workersMutex);
+		m_workersStats.add(stats);
+	}
+
+	//! Sends the statistics of the traversal to the report function
+	void report(const char* functionTitle)
+	{
+		if (!m_active)
+			return;
+
+		m_recorder.stop();
+		m_active = false;
+		if (!s_searchStatisticsReporter)
+			return;
+
+		DgmOctree::SearchStatistics stats = m_callerStats;
+		{
+			QMutexLocker locker(&m_workersMutex);
+			stats.add(m_workersStats);
+		}
+		stats.elapsedTime_ns = static_cast<quint64>(m_timer.nsecsElapsed());
+
+		s_searchStatisticsReporter(functionTitle,stats);
+	}
+
+protected:
+
+	bool m_active;
+	//! Searches of the calling thread
+	DgmOctree::SearchStatistics m_callerStats;
+	SearchStatisticsRecorder m_recorder;
+	//! Searches of the worker threads (see SearchStatisticsWorkerScope)
+	DgmOctree::SearchStatistics m_workersStats;
+	QMutex m_workersMutex;
+	QElapsedTimer m_timer;
+};
+
+//! Records the searches of a worker thread for a session (while it exists)
+class SearchStatisticsWorkerScope
+{
+public:
+
+	SearchStatisticsWorkerScope(SearchStatisticsSession* session)
+		: m_session(session && session->isActive() ? session : 0)
+	{
+		if (m_session)
+			m_recorder.start(&m_stats);
+	}
+
+	~SearchStatisticsWorkerScope()
+	{
+		if (m_session)
+		{
+			m_recorder.stop();
+			m_session->addWorkerStats(m_stats);
+		}
+	}
+
+protected:
+
+	SearchStatisticsSession* m_session;
+	DgmOctree::SearchStatistics m_stats;
+	SearchStatisticsRecorder m_recorder;
+};
+
+void DgmOctree::SearchStatistics::reset()
+{
+	memset(this,0,sizeof(SearchStatistics));
+}
+
+void DgmOctree::SearchStatistics::add(const SearchStatistics& stats)
+{
+	processedCells += stats.processedCells;
+	for (unsigned i=0; i<POPULATION_HISTOGRAM_SIZE; ++i)
+		cellPopulationHistogram[i] += stats.cellPopulationHistogram[i];
+	searches += stats.searches;
+	testedPoints += stats.testedPoints;
+	skippedPoints += stats.skippedPoints;
+	gatheredPoints += stats.gatheredPoints;
+	binarySearches += stats.binarySearches;
+	binarySearchJumps += stats.binarySearchJumps;
+	cellExtractionTime_ns += stats.cellExtractionTime_ns;
+	cellFunctionTime_ns += stats.cellFunctionTime_ns;
+	neighbourhoodExtractionTime_ns += stats.neighbourhoodExtractionTime_ns;
+	elapsedTime_ns += stats.elapsedTime_ns;
+}
+
+void DgmOctree::SearchStatistics::addProcessedCell(unsigned population)
+{
+	++processedCells;
+
+	//bin = floor(log2(population))
+	unsigned bin = 0;
+	while (bin+1 < POPULATION_HISTOGRAM_SIZE && (population >> (bin+1)) != 0)
+		++bin;
+	++cellPopulationHistogram[bin];
+}
+
+void DgmOctree::EnableSearchStatistics(bool state)
+{
+	s_searchStatisticsEnabled = state;
+}
+
+bool DgmOctree::SearchStatisticsEnabled()
+{
+	return s_searchStatisticsEnabled;
+}
+
+void DgmOctree::ResetSearchStatistics()
+{
+	QMutexLocker locker(&s_searchStatisticsMutex);
+	for (size_t i=0; i<s_searchStatisticsSlots.size(); ++i)
+		s_searchStatisticsSlots[i]->stats.reset();
+}
+
+void DgmOctree::GetSearchStatistics(SearchStatistics& stats)
+{
+	stats.reset();
+
+	QMutexLocker locker(&s_searchStatisticsMutex);
+	for (size_t i=0; i<s_searchStatisticsSlots.size(); ++i)
+		stats.add(s_searchStatisticsSlots[i]->stats);
+}
+
+void DgmOctree::SetSearchStatisticsReporter(SearchStatisticsReporter reporter)
+{
+	s_searchStatisticsReporter = reporter;
+}
+
+//! Whether the octrees store their 'structure' in a compact form by default
+static bool s_compactStorageByDefault = false;
+
+void DgmOctree::SetCompactStorageByDefault(bool state)
+{
+	s_compactStorageByDefault = state;
+}
+
+bool DgmOctree::CompactStorageByDefault()
+{
+	return s_compactStorageByDefault;
+}
+
 DgmOctree::DgmOctree(GenericIndexedCloudPersist* cloud)
-	: m_theAssociatedCloud(cloud)
+	: m_compactStorage(s_compactStorageByDefault || (cloud && cloud->getWorkingSetSize() != 0)) //memory is scarce with out-of-core clouds
+	, m_theAssociatedCloud(cloud)
+	, m_secondaryCloud(0)
 	, m_numberOfProjectedPoints(0)
 {
 	clear();
@@ -210,146 +551,810 @@ int DgmOctree::build(	const CCVector3& octreeMin,
 	return genericBuild(progressCb);
 }
 
-int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
+void DgmOctree::releaseCloudsPointers() const
 {
-	unsigned pointCount = (m_theAssociatedCloud ? m_theAssociatedCloud->size() : 0);
-	if (pointCount == 0)
-	{
-		//no cloud/point?!
-		return -1;
-	}
+	m_theAssociatedCloud->releasePointsPointers();
+	if (m_secondaryCloud)
+		m_secondaryCloud->releasePointsPointers();
+}
 
-	//allocate memory
-	try
-	{
-		m_thePointsAndTheirCellCodes.resize(pointCount); //resize + operator[] is faster than reserve + push_back!
-	}
-	catch (.../*const std::bad_alloc&*/) //out of memory
-	{
-		return -1;
-	}
-	m_numberOfProjectedPoints = 0;
+bool DgmOctree::setCompactStorage(bool state)
+{
+	if (!m_thePointsAndTheirCellCodes.setCompact(state))
+		return false;
 
-	//update the pre-computed 'cell size per level of subdivision' array
-	updateCellSizeTable();
+	m_compactStorage = state;
+	return true;
+}
 
-	//progress notification (optional)
-	if (progressCb)
-	{
-		progressCb->reset();
-		progressCb->setMethodTitle("Build Octree");
-		char infosBuffer[256];
-		sprintf(infosBuffer,"Projecting %u points\nMax. depth: %i",pointCount,MAX_OCTREE_LEVEL);
-		progressCb->setInfo(infosBuffer);
-		progressCb->start();
-	}
-	NormalizedProgress nprogress(progressCb,pointCount,90); //first phase: 90% (we keep 10% for sort)
+void DgmOctree::pointsAndCodesContainer::clear()
+{
+	//we release the memory as well
+	cellsContainer().swap(m_plain);
+	std::vector<unsigned>().swap(m_indexes);
+	std::vector<codesBlock>().swap(m_blocks);
+	std::vector<quint64>().swap(m_words);
+
+	m_count = 0;
+	m_compact = false;
+}
 
-	//fill indexes table (we'll fill the max. level, then deduce the others from this one)
-	int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL*6);
+bool DgmOctree::pointsAndCodesContainer::assign(cellsContainer& codes, bool compact)
+{
+	clear();
 
-	//for all points
-	cellsContainer::iterator it = m_thePointsAndTheirCellCodes.begin();
-	for (unsigned i=0; i<pointCount; i++)
+	if (compact)
 	{
-		const CCVector3* P = m_theAssociatedCloud->getPoint(i);
+		unsigned count = static_cast<unsigned>(codes.size());
+		unsigned blockCount = (count + CODES_PER_BLOCK - 1) / CODES_PER_BLOCK;
 
-		//does the point falls in the 'accepted points' box?
-		//(potentially different from the octree box - see DgmOctree::build)
-		if (	(P->x >= m_pointsMin[0]) && (P->x <= m_pointsMax[0])
-			&&	(P->y >= m_pointsMin[1]) && (P->y <= m_pointsMax[1])
-			&&	(P->z >= m_pointsMin[2]) && (P->z <= m_pointsMax[2]) )
+		try
 		{
-			//compute the position of the cell that includes this point
-			int cellPos[3];
-			getTheCellPosWhichIncludesThePoint(P,cellPos);
-
-			//clipping X
-			if (cellPos[0] < 0)
-				cellPos[0] = 0;
-			else if (cellPos[0] > MAX_OCTREE_LENGTH)
-				cellPos[0] = MAX_OCTREE_LENGTH;
-			//clipping Y
-			if (cellPos[1] < 0)
-				cellPos[1] = 0;
-			else if (cellPos[1] > MAX_OCTREE_LENGTH)
-				cellPos[1] = MAX_OCTREE_LENGTH;
-			//clipping Z
-			if (cellPos[2] < 0)
-				cellPos[2] = 0;
-			else if (cellPos[2] > MAX_OCTREE_LENGTH)
-				cellPos[2] = MAX_OCTREE_LENGTH;
-
-			it->theIndex = i;
-			it->theCode = generateTruncatedCellCode(cellPos,MAX_OCTREE_LEVEL);
+			m_indexes.resize(count);
+			m_blocks.resize(blockCount);
 
-			if (m_numberOfProjectedPoints)
-			{
-				if (fillIndexesAtMaxLevel[0] > cellPos[0])
-					fillIndexesAtMaxLevel[0] = cellPos[0];
-				else if (fillIndexesAtMaxLevel[3] < cellPos[0])
-					fillIndexesAtMaxLevel[3] = cellPos[0];
-
-				if (fillIndexesAtMaxLevel[1] > cellPos[1])
-					fillIndexesAtMaxLevel[1] = cellPos[1];
-				else if (fillIndexesAtMaxLevel[4] < cellPos[1])
-					fillIndexesAtMaxLevel[4] = cellPos[1];
-
-				if (fillIndexesAtMaxLevel[2] > cellPos[2])
-					fillIndexesAtMaxLevel[2] = cellPos[2];
-				else if (fillIndexesAtMaxLevel[5] < cellPos[2])
-					fillIndexesAtMaxLevel[5] = cellPos[2];
-			}
-			else
+			//first pass: blocks base codes and deltas size
+			unsigned wordCount = 0;
+			for (unsigned b=0; b<blockCount; ++b)
 			{
-				fillIndexesAtMaxLevel[0] = fillIndexesAtMaxLevel[3] = cellPos[0];
-				fillIndexesAtMaxLevel[1] = fillIndexesAtMaxLevel[4] = cellPos[1];
-				fillIndexesAtMaxLevel[2] = fillIndexesAtMaxLevel[5] = cellPos[2];
+				unsigned first = b * CODES_PER_BLOCK;
+				unsigned last = std::min(first + CODES_PER_BLOCK, count) - 1;
+
+				//codes are sorted: the biggest delta is the last one
+				codesBlock& block = m_blocks[b];
+				block.base = codes[first].theCode;
+				quint64 maxDelta = static_cast<quint64>(codes[last].theCode - block.base);
+				block.bitCount = 0;
+				while (maxDelta)
+				{
+					++block.bitCount;
+					maxDelta >>= 1;
+				}
+				block.firstWord = wordCount;
+				wordCount += ((last - first + 1) * block.bitCount + 63) / 64;
 			}
-
-			++it;
-			++m_numberOfProjectedPoints;
+			m_words.resize(wordCount,0);
 		}
-
-		if (!nprogress.oneStep())
+		catch (const std::bad_alloc&) //out of memory
 		{
-			m_thePointsAndTheirCellCodes.clear();
-			m_numberOfProjectedPoints = 0;
-			progressCb->stop();
-			return 0;
+			clear();
+			m_plain.swap(codes);
+			m_count = static_cast<unsigned>(m_plain.size());
+			return false;
 		}
-	}
 
-	//we deduce the lower levels 'fill indexes' from the highest level
-	{
-		for (int k=MAX_OCTREE_LEVEL-1; k>=0; k--)
+		//second pass: points indexes and bit-packed deltas
+		for (unsigned i=0; i<count; ++i)
 		{
-			int* fillIndexes = m_fillIndexes + (k*6);
-			for (int dim=0; dim<6; ++dim)
-			{
-				fillIndexes[dim] = (fillIndexes[dim+6] >> 1);
-			}
+			m_indexes[i] = codes[i].theIndex;
+
+			const codesBlock& block = m_blocks[i / CODES_PER_BLOCK];
+			if (block.bitCount == 0)
+				continue;
+
+			quint64 delta = static_cast<quint64>(codes[i].theCode - block.base);
+			unsigned bitPos = (i % CODES_PER_BLOCK) * block.bitCount;
+			quint64* word = &m_words[block.firstWord + (bitPos >> 6)];
+			unsigned shift = (bitPos & 63);
+			word[0] |= (delta << shift);
+			if (shift + block.bitCount > 64)
+				word[1] |= (delta >> (64-shift));
 		}
-	}
 
-	if (m_numberOfProjectedPoints < pointCount)
-		m_thePointsAndTheirCellCodes.resize(m_numberOfProjectedPoints); //smaller --> should always be ok
+		m_count = count;
+		m_compact = true;
+		cellsContainer().swap(codes);
+	}
+	else
+	{
+		m_plain.swap(codes);
+		m_count = static_cast<unsigned>(m_plain.size());
+	}
 
-	if (progressCb)
-		progressCb->setInfo("Sorting cells...");
+	return true;
+}
 
-	//we sort the 'cells' by ascending code order
-	std::sort(m_thePointsAndTheirCellCodes.begin(),m_thePointsAndTheirCellCodes.end(),IndexAndCode::codeComp);
+bool DgmOctree::pointsAndCodesContainer::setCompact(bool state)
+{
+	if (state == m_compact)
+		return true;
 
-	//update the pre-computed 'number of cells per level of subdivision' array
-	updateCellCountTable();
+	if (state)
+	{
+		cellsContainer plain;
+		plain.swap(m_plain);
+		return assign(plain,true);
+	}
 
-	//end of process notification
-	if (progressCb)
+	//back to the standard mode
+	cellsContainer plain;
+	try
 	{
-		progressCb->update(100.0f);
+		plain.resize(m_count);
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		return false;
+	}
+	for (unsigned i=0; i<m_count; ++i)
+		plain[i] = (*this)[i];
 
-		char buffer[256];
+	return assign(plain,false);
+}
+
+void DgmOctree::pointsAndCodesContainer::appendBlock(const OctreeCellCodeType* codes, unsigned count)
+{
+	assert(count != 0 && count <= CODES_PER_BLOCK);
+
+	//codes are sorted: the biggest delta is the last one
+	codesBlock block;
+	block.base = codes[0];
+	block.firstWord = static_cast<unsigned>(m_words.size());
+	quint64 maxDelta = static_cast<quint64>(codes[count-1] - block.base);
+	block.bitCount = 0;
+	while (maxDelta)
+	{
+		++block.bitCount;
+		maxDelta >>= 1;
+	}
+	m_blocks.push_back(block);
+
+	if (block.bitCount == 0)
+		return;
+
+	m_words.resize(m_words.size() + (count * block.bitCount + 63) / 64, 0);
+	quint64* words = &m_words[block.firstWord];
+	for (unsigned i=0; i<count; ++i)
+	{
+		quint64 delta = static_cast<quint64>(codes[i] - block.base);
+		unsigned bitPos = i * block.bitCount;
+		quint64* word = words + (bitPos >> 6);
+		unsigned shift = (bitPos & 63);
+		word[0] |= (delta << shift);
+		if (shift + block.bitCount > 64)
+			word[1] |= (delta >> (64-shift));
+	}
+}
+
+//! Level of subdivision of the cells used to bucket the points (see DgmOctree::pointsAndCodesContainer::assignCompact)
+static const int c_compactBucketLevel = 6;
+
+//! Compares two points indexes by cell code, then by index (see DgmOctree::pointsAndCodesContainer::assignCompact)
+struct IndexesByCodeComp
+{
+	const std::vector<DgmOctree::OctreeCellCodeType>& pointCodes;
+	IndexesByCodeComp(const std::vector<DgmOctree::OctreeCellCodeType>& codes) : pointCodes(codes) {}
+	inline bool operator()(unsigned a, unsigned b) const
+	{
+		return pointCodes[a] < pointCodes[b] || (pointCodes[a] == pointCodes[b] && a < b);
+	}
+};
+
+bool DgmOctree::pointsAndCodesContainer::assignCompact(std::vector<OctreeCellCodeType>& pointCodes, unsigned count)
+{
+	clear();
+
+	const unsigned pointCount = static_cast<unsigned>(pointCodes.size());
+	const unsigned char bucketShift = GET_BIT_SHIFT(c_compactBucketLevel);
+	const unsigned bucketCount = (1 << (3*c_compactBucketLevel));
+
+	std::vector<unsigned> bucketStart;
+	try
+	{
+		bucketStart.resize(bucketCount+1,0);
+		m_indexes.resize(count);
+		m_blocks.reserve((count + CODES_PER_BLOCK - 1) / CODES_PER_BLOCK);
+		m_words.reserve(count / 4); //16 bits per code (may grow afterwards)
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		clear();
+		return false;
+	}
+
+	//the points are first bucketed by cell at a low level of subdivision
+	//(counting sort, stable: indexes remain sorted inside each bucket)
+	for (unsigned i=0; i<pointCount; ++i)
+		if (pointCodes[i] != INVALID_CELL_CODE)
+			++bucketStart[static_cast<unsigned>(pointCodes[i] >> bucketShift) + 1];
+	unsigned maxBucketSize = 0;
+	for (unsigned b=0; b<bucketCount; ++b)
+	{
+		maxBucketSize = std::max(maxBucketSize, bucketStart[b+1]);
+		bucketStart[b+1] += bucketStart[b];
+	}
+	assert(bucketStart[bucketCount] == count);
+	for (unsigned i=0; i<pointCount; ++i)
+		if (pointCodes[i] != INVALID_CELL_CODE)
+			m_indexes[bucketStart[static_cast<unsigned>(pointCodes[i] >> bucketShift)]++] = i;
+	//now bucketStart[b] is the end of bucket b
+
+	//then each bucket is sorted (by code, then by index) and its codes are bit-packed
+	cellsContainer buffer;
+	try
+	{
+		buffer.resize(maxBucketSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not a problem: indexes will be sorted in place (slower)
+	}
+
+	try
+	{
+		OctreeCellCodeType blockCodes[CODES_PER_BLOCK];
+		unsigned blockSize = 0;
+		unsigned first = 0;
+		for (unsigned b=0; b<bucketCount; ++b)
+		{
+			unsigned last = bucketStart[b];
+			if (last - first > 1)
+			{
+				if (!buffer.empty())
+				{
+					for (unsigned i=first; i<last; ++i)
+						buffer[i-first] = IndexAndCode(m_indexes[i],pointCodes[m_indexes[i]]);
+					std::sort(buffer.begin(),buffer.begin()+(last-first),IndexAndCode::codeAndIndexComp);
+					for (unsigned i=first; i<last; ++i)
+						m_indexes[i] = buffer[i-first].theIndex;
+				}
+				else
+				{
+					std::sort(m_indexes.begin()+first,m_indexes.begin()+last,IndexesByCodeComp(pointCodes));
+				}
+			}
+
+			for (unsigned i=first; i<last; ++i)
+			{
+				blockCodes[blockSize++] = pointCodes[m_indexes[i]];
+				if (blockSize == CODES_PER_BLOCK)
+				{
+					appendBlock(blockCodes,blockSize);
+					blockSize = 0;
+				}
+			}
+
+			first = last;
+		}
+		if (blockSize != 0)
+			appendBlock(blockCodes,blockSize);
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		clear();
+		return false;
+	}
+
+	m_count = count;
+	m_compact = true;
+	std::vector<OctreeCellCodeType>().swap(pointCodes);
+
+	//the bit-packed codes may have been over-allocated
+	if (m_words.capacity() > m_words.size())
+	{
+		try
+		{
+			std::vector<quint64>(m_words).swap(m_words);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not a problem
+		}
+	}
+
+	return true;
+}
+
+unsigned DgmOctree::pointsAndCodesContainer::lowerBound(OctreeCellCodeType code, unsigned first, unsigned last) const
+{
+	assert(last <= m_count);
+	if (first >= last)
+		return last;
+
+	if (!m_compact)
+	{
+		cellsContainer::const_iterator it = std::lower_bound(m_plain.begin()+first,m_plain.begin()+last,IndexAndCode(0,code),IndexAndCode::codeComp);
+		return static_cast<unsigned>(it - m_plain.begin());
+	}
+
+	//skip index: we look for the last block of the range starting with a code smaller than the input one
+	//(all the codes of the next blocks are greater than or equal to the input code)
+	unsigned firstBlock = first / CODES_PER_BLOCK;
+	unsigned lo = firstBlock + 1;
+	unsigned hi = (last - 1) / CODES_PER_BLOCK + 1;
+	while (lo < hi)
+	{
+		unsigned middle = (lo + hi) / 2;
+		if (m_blocks[middle].base < code)
+			lo = middle + 1;
+		else
+			hi = middle;
+	}
+	unsigned block = lo - 1;
+
+	//then we look inside this block
+	unsigned i = std::max(first, block * CODES_PER_BLOCK);
+	unsigned j = std::min(last, (block + 1) * CODES_PER_BLOCK);
+	while (i < j)
+	{
+		unsigned middle = (i + j) / 2;
+		if (decodeCode(middle) < code)
+			i = middle + 1;
+		else
+			j = middle;
+	}
+
+	return i;
+}
+
+void DgmOctree::pointsAndCodesContainer::setIndexesInOrder()
+{
+	if (m_compact)
+	{
+		for (unsigned i=0; i<m_count; ++i)
+			m_indexes[i] = i;
+	}
+	else
+	{
+		for (unsigned i=0; i<m_count; ++i)
+			m_plain[i].theIndex = i;
+	}
+}
+
+size_t DgmOctree::pointsAndCodesContainer::memoryUsage() const
+{
+	return	m_plain.capacity() * sizeof(IndexAndCode)
+		+	m_indexes.capacity() * sizeof(unsigned)
+		+	m_blocks.capacity() * sizeof(codesBlock)
+		+	m_words.capacity() * sizeof(quint64);
+}
+
+//! Minimum number of points per octree build job
+static const unsigned c_minPointsPerBuildJob = 65536;
+//! Number of groups of points projected in turn when building a compact octree (see DgmOctree::genericBuild)
+static const unsigned c_compactBuildGroupCount = 16;
+
+//! Returns the number of jobs used to build the octree of a given cloud
+static unsigned GetBuildJobCount(unsigned pointCount)
+{
+#ifdef ENABLE_MT_OCTREE
+	unsigned maxJobCount = std::max<unsigned>(1, pointCount / c_minPointsPerBuildJob);
+	return std::max(1, std::min(QThread::idealThreadCount(), static_cast<int>(std::min<unsigned>(maxJobCount, 1024))));
+#else
+	return 1;
+#endif
+}
+
+//! Points projection job (see DgmOctree::genericBuild)
+struct ProjectionJob
+{
+	const DgmOctree* octree;
+	unsigned firstIndex, lastIndex;
+	DgmOctree::IndexAndCode* output;
+	unsigned projectedCount;
+	int fillIndexes[6];
+	NormalizedProgress* nprogress;
+	bool success;
+};
+
+static void ProjectPoints_MT(ProjectionJob& job)
+{
+	job.success = job.octree->projectPoints(job.firstIndex, job.lastIndex, job.output, job.projectedCount, job.fillIndexes, job.nprogress);
+}
+
+bool DgmOctree::projectPoints(	unsigned firstIndex,
+								unsigned lastIndex,
+								IndexAndCode* output,
+								unsigned& projectedCount,
+								int fillIndexes[6],
+								NormalizedProgress* nprogress/*=0*/) const
+{
+	//progress is notified by blocks of points (the counter is shared by all threads)
+	static const unsigned c_progressStep = 4096;
+
+	projectedCount = 0;
+	IndexAndCode* it = output;
+
+	for (unsigned i=firstIndex; i<lastIndex; i++)
+	{
+		const CCVector3* P = m_theAssociatedCloud->getPoint(i);
+
+		//does the point falls in the 'accepted points' box?
+		//(potentially different from the octree box - see DgmOctree::build)
+		if (	(P->x >= m_pointsMin[0]) && (P->x <= m_pointsMax[0])
+			&&	(P->y >= m_pointsMin[1]) && (P->y <= m_pointsMax[1])
+			&&	(P->z >= m_pointsMin[2]) && (P->z <= m_pointsMax[2]) )
+		{
+			//compute the position of the cell that includes this point
+			int cellPos[3];
+			getTheCellPosWhichIncludesThePoint(P,cellPos);
+
+			//clipping X
+			if (cellPos[0] < 0)
+				cellPos[0] = 0;
+			else if (cellPos[0] > MAX_OCTREE_LENGTH)
+				cellPos[0] = MAX_OCTREE_LENGTH;
+			//clipping Y
+			if (cellPos[1] < 0)
+				cellPos[1] = 0;
+			else if (cellPos[1] > MAX_OCTREE_LENGTH)
+				cellPos[1] = MAX_OCTREE_LENGTH;
+			//clipping Z
+			if (cellPos[2] < 0)
+				cellPos[2] = 0;
+			else if (cellPos[2] > MAX_OCTREE_LENGTH)
+				cellPos[2] = MAX_OCTREE_LENGTH;
+
+			it->theIndex = i;
+			it->theCode = generateTruncatedCellCode(cellPos,MAX_OCTREE_LEVEL);
+
+			if (projectedCount)
+			{
+				if (fillIndexes[0] > cellPos[0])
+					fillIndexes[0] = cellPos[0];
+				else if (fillIndexes[3] < cellPos[0])
+					fillIndexes[3] = cellPos[0];
+
+				if (fillIndexes[1] > cellPos[1])
+					fillIndexes[1] = cellPos[1];
+				else if (fillIndexes[4] < cellPos[1])
+					fillIndexes[4] = cellPos[1];
+
+				if (fillIndexes[2] > cellPos[2])
+					fillIndexes[2] = cellPos[2];
+				else if (fillIndexes[5] < cellPos[2])
+					fillIndexes[5] = cellPos[2];
+			}
+			else
+			{
+				fillIndexes[0] = fillIndexes[3] = cellPos[0];
+				fillIndexes[1] = fillIndexes[4] = cellPos[1];
+				fillIndexes[2] = fillIndexes[5] = cellPos[2];
+			}
+
+			++it;
+			++projectedCount;
+		}
+
+		if (nprogress && ((i-firstIndex+1) % c_progressStep) == 0)
+		{
+			if (!nprogress->steps(c_progressStep))
+				return false;
+		}
+	}
+
+	if (nprogress && ((lastIndex-firstIndex) % c_progressStep) != 0)
+	{
+		if (!nprogress->steps((lastIndex-firstIndex) % c_progressStep))
+			return false;
+	}
+
+	return true;
+}
+
+//! Radix sort: number of bits per pass
+static const unsigned c_radixBits = 11;
+//! Radix sort: number of buckets
+static const unsigned c_radixSize = (1 << c_radixBits);
+
+//! Radix sort job (one contiguous range of codes)
+struct RadixSortJob
+{
+	const DgmOctree::IndexAndCode* input;
+	DgmOctree::IndexAndCode* output;
+	size_t first, last;
+	unsigned shift;
+	//! Number of codes per bucket (histogram step), then output position of each bucket (scatter step)
+	std::vector<size_t> buckets;
+};
+
+static inline unsigned GetRadixBucket(DgmOctree::OctreeCellCodeType code, unsigned shift)
+{
+	return static_cast<unsigned>(code >> shift) & (c_radixSize-1);
+}
+
+static void RadixHistogram_MT(RadixSortJob& job)
+{
+	std::fill(job.buckets.begin(), job.buckets.end(), 0);
+	for (size_t i=job.first; i<job.last; ++i)
+		++job.buckets[GetRadixBucket(job.input[i].theCode, job.shift)];
+}
+
+static void RadixScatter_MT(RadixSortJob& job)
+{
+	//the input range is read in order: the sort is stable
+	for (size_t i=job.first; i<job.last; ++i)
+		job.output[job.buckets[GetRadixBucket(job.input[i].theCode, job.shift)]++] = job.input[i];
+}
+
+//! Sorts octree codes (parallel LSD radix sort)
+/** The sort is stable: as the input is sorted by index, codes are sorted by
+	code then by index (as with IndexAndCode::codeAndIndexComp). The result
+	doesn't depend on the number of jobs.
+	\param codes codes to sort
+	\param jobCount number of concurrent jobs
+	\return false if not enough memory
+**/
+static bool SortCodes(DgmOctree::cellsContainer& codes, unsigned jobCount)
+{
+	size_t count = codes.size();
+	if (count < 2)
+		return true;
+
+	//codes may already be sorted (e.g. if the points have been sorted by cell code, see OutOfCoreCloud)
+	{
+		size_t i = 1;
+		while (i < count && codes[i-1].theCode <= codes[i].theCode)
+			++i;
+		if (i == count)
+			return true;
+	}
+
+	DgmOctree::cellsContainer buffer;
+	std::vector<RadixSortJob> jobs;
+	try
+	{
+		buffer.resize(count);
+		jobs.resize(std::max<unsigned>(jobCount,1));
+		for (size_t k=0; k<jobs.size(); ++k)
+			jobs[k].buckets.resize(c_radixSize);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	for (size_t k=0; k<jobs.size(); ++k)
+	{
+		jobs[k].first = (count * k) / jobs.size();
+		jobs[k].last = (count * (k+1)) / jobs.size();
+	}
+
+	DgmOctree::cellsContainer* input = &codes;
+	DgmOctree::cellsContainer* output = &buffer;
+	const unsigned codeBits = 3*DgmOctree::MAX_OCTREE_LEVEL;
+
+	for (unsigned shift=0; shift<codeBits; shift+=c_radixBits)
+	{
+		for (size_t k=0; k<jobs.size(); ++k)
+		{
+			jobs[k].input = &(*input)[0];
+			jobs[k].output = &(*output)[0];
+			jobs[k].shift = shift;
+		}
+
+#ifdef ENABLE_MT_OCTREE
+		if (jobs.size() > 1)
+			QtConcurrent::blockingMap(jobs, RadixHistogram_MT);
+		else
+#endif
+			RadixHistogram_MT(jobs[0]);
+
+		//output position of each bucket, for each job (bucket by bucket, then job by job)
+		size_t position = 0;
+		bool singleBucket = false;
+		for (unsigned b=0; b<c_radixSize && !singleBucket; ++b)
+		{
+			size_t bucketCount = 0;
+			for (size_t k=0; k<jobs.size(); ++k)
+			{
+				size_t jobBucketCount = jobs[k].buckets[b];
+				jobs[k].buckets[b] = position + bucketCount;
+				bucketCount += jobBucketCount;
+			}
+			position += bucketCount;
+			singleBucket = (bucketCount == count);
+		}
+
+		//all codes have the same digit: nothing to do for this pass
+		if (singleBucket)
+			continue;
+
+#ifdef ENABLE_MT_OCTREE
+		if (jobs.size() > 1)
+			QtConcurrent::blockingMap(jobs, RadixScatter_MT);
+		else
+#endif
+			RadixScatter_MT(jobs[0]);
+
+		std::swap(input, output);
+	}
+
+	if (input != &codes)
+		codes.swap(buffer);
+
+	return true;
+}
+
+int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
+{
+	unsigned pointCount = (m_theAssociatedCloud ? m_theAssociatedCloud->size() : 0);
+	if (pointCount == 0)
+	{
+		//no cloud/point?!
+		return -1;
+	}
+
+	//the cloud is split in contiguous ranges of points, projected concurrently
+	//(group by group if the cloud has a limited working set, see GenericIndexedCloudPersist::getWorkingSetSize)
+	unsigned jobCount = GetBuildJobCount(pointCount);
+	unsigned workingSetSize = m_theAssociatedCloud->getWorkingSetSize();
+	unsigned groupSize = (workingSetSize != 0 ? std::max<unsigned>(workingSetSize/2,1) : pointCount);
+
+	//in compact mode, only the cell code of each point is kept and the structure is
+	//directly built in compact form (see pointsAndCodesContainer::assignCompact): the
+	//projected points are then only buffered group by group
+	bool compact = m_compactStorage;
+	std::vector<OctreeCellCodeType> pointCodes;
+	if (compact)
+		groupSize = std::min(groupSize, std::max(pointCount/c_compactBuildGroupCount, c_minPointsPerBuildJob*jobCount));
+
+	//allocate memory
+	cellsContainer codes;
+	try
+	{
+		if (compact)
+			pointCodes.resize(pointCount,static_cast<OctreeCellCodeType>(INVALID_CELL_CODE));
+		codes.resize(compact ? groupSize : pointCount); //resize + operator[] is faster than reserve + push_back!
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return -1;
+	}
+	m_numberOfProjectedPoints = 0;
+
+	//update the pre-computed 'cell size per level of subdivision' array
+	updateCellSizeTable();
+
+	//progress notification (optional)
+	if (progressCb)
+	{
+		progressCb->reset();
+		progressCb->setMethodTitle("Build Octree");
+		char infosBuffer[256];
+		sprintf(infosBuffer,"Projecting %u points\nMax. depth: %i",pointCount,MAX_OCTREE_LEVEL);
+		progressCb->setInfo(infosBuffer);
+		progressCb->start();
+	}
+	NormalizedProgress nprogress(progressCb,pointCount,90); //first phase: 90% (we keep 10% for sort)
+
+	//fill indexes table (we'll fill the max. level, then deduce the others from this one)
+	int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL*6);
+
+	std::vector<ProjectionJob> jobs(jobCount);
+	for (unsigned groupFirstIndex=0; groupFirstIndex<pointCount; )
+	{
+		unsigned groupPointCount = std::min(groupSize, pointCount-groupFirstIndex);
+		//in compact mode, the buffer only holds the current group
+		unsigned outputOffset = (compact ? groupFirstIndex : 0);
+		unsigned outputCount = (compact ? 0 : m_numberOfProjectedPoints);
+		for (unsigned k=0; k<jobCount; ++k)
+		{
+			jobs[k].octree = this;
+			jobs[k].firstIndex = groupFirstIndex + static_cast<unsigned>((static_cast<qint64>(groupPointCount) * k) / jobCount);
+			jobs[k].lastIndex = groupFirstIndex + static_cast<unsigned>((static_cast<qint64>(groupPointCount) * (k+1)) / jobCount);
+			jobs[k].output = &(codes[jobs[k].firstIndex - outputOffset]);
+			jobs[k].projectedCount = 0;
+			jobs[k].nprogress = &nprogress;
+			jobs[k].success = true;
+		}
+
+#ifdef ENABLE_MT_OCTREE
+		if (jobCount > 1)
+			QtConcurrent::blockingMap(jobs, ProjectPoints_MT);
+		else
+#endif
+			ProjectPoints_MT(jobs[0]);
+
+		//merge the results (in the same order as a sequential projection)
+		for (unsigned k=0; k<jobCount; ++k)
+		{
+			const ProjectionJob& job = jobs[k];
+			if (!job.success)
+			{
+				m_numberOfProjectedPoints = 0;
+				m_theAssociatedCloud->releasePointsPointers();
+				if (progressCb)
+					progressCb->stop();
+				return 0;
+			}
+			if (job.projectedCount == 0)
+				continue;
+
+			if (m_numberOfProjectedPoints)
+			{
+				for (int dim=0; dim<3; ++dim)
+				{
+					fillIndexesAtMaxLevel[dim]   = std::min(fillIndexesAtMaxLevel[dim],   job.fillIndexes[dim]);
+					fillIndexesAtMaxLevel[dim+3] = std::max(fillIndexesAtMaxLevel[dim+3], job.fillIndexes[dim+3]);
+				}
+			}
+			else
+			{
+				memcpy(fillIndexesAtMaxLevel, job.fillIndexes, sizeof(int)*6);
+			}
+
+			//filtered points leave 'holes' between the ranges
+			if (outputCount != job.firstIndex - outputOffset)
+				std::copy(job.output, job.output+job.projectedCount, codes.begin()+outputCount);
+			outputCount += job.projectedCount;
+			m_numberOfProjectedPoints += job.projectedCount;
+		}
+
+		if (compact)
+		{
+			for (unsigned i=0; i<outputCount; ++i)
+				pointCodes[codes[i].theIndex] = codes[i].theCode;
+		}
+
+		//the points of this group are not used anymore
+		m_theAssociatedCloud->releasePointsPointers();
+		groupFirstIndex += groupPointCount;
+	}
+
+	//we deduce the lower levels 'fill indexes' from the highest level
+	updateFillIndexesTable();
+
+	if (progressCb)
+		progressCb->setInfo("Sorting cells...");
+
+	if (compact)
+	{
+		//the projection buffer is not needed anymore
+		cellsContainer().swap(codes);
+
+		//we sort the 'cells' and store the result in compact form
+		if (!m_thePointsAndTheirCellCodes.assignCompact(pointCodes, m_numberOfProjectedPoints))
+		{
+			//not enough memory: we fall back to the standard form
+			try
+			{
+				codes.resize(m_numberOfProjectedPoints);
+			}
+			catch (.../*const std::bad_alloc&*/) //out of memory
+			{
+				m_numberOfProjectedPoints = 0;
+				if (progressCb)
+					progressCb->stop();
+				return -1;
+			}
+			for (unsigned i=0, j=0; i<pointCount; ++i)
+				if (pointCodes[i] != INVALID_CELL_CODE)
+					codes[j++] = IndexAndCode(i,pointCodes[i]);
+			std::vector<OctreeCellCodeType>().swap(pointCodes);
+			compact = false;
+
+			if (progressCb)
+				progressCb->setInfo("Not enough memory to compact the octree structure");
+		}
+	}
+	else if (m_numberOfProjectedPoints < pointCount)
+	{
+		codes.resize(m_numberOfProjectedPoints); //smaller --> should always be ok
+	}
+
+	if (!compact)
+	{
+		//we sort the 'cells' by ascending code order (and by index inside each cell)
+		if (!SortCodes(codes, jobCount))
+		{
+			//not enough memory for the radix sort: same order, but slower
+			std::sort(codes.begin(),codes.end(),IndexAndCode::codeAndIndexComp);
+		}
+
+		//we store the result
+		m_thePointsAndTheirCellCodes.assign(codes, false);
+	}
+
+	//update the pre-computed 'number of cells per level of subdivision' array
+	updateCellCountTable();
+
+	//end of process notification
+	if (progressCb)
+	{
+		progressCb->update(100.0f);
+
+		char buffer[256];
 		if (m_numberOfProjectedPoints == pointCount)
 		{
 			sprintf(buffer,"[Octree::build] Octree successfully built... %i points (ok)!",m_numberOfProjectedPoints);
@@ -381,7 +1386,7 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 		octreeTreeCellLeaf* currentLeafCell = 0;
 		cellStack.push_back(root);
 
-		cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+		pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
 		for (; p != m_thePointsAndTheirCellCodes.end(); ++p)
 		{
 			//different cell?
@@ -439,20 +1444,264 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 			currentLeafCell->pointIndexes.push_back(p->theIndex);
 		}
 
-		assert(!s_root);
-		s_root = root;
-		//delete root;
-		//root = 0;
+		assert(!s_root);
+		s_root = root;
+		//delete root;
+		//root = 0;
+
+		//check
+#ifdef _DEBUG
+		for (it=m_thePointsAndTheirCellCodes.begin();it!=m_thePointsAndTheirCellCodes.end();++it)
+			assert(getCell(it->theCode,MAX_OCTREE_LEVEL));
+#endif
+	}
+#endif
+
+	return static_cast<int>(m_numberOfProjectedPoints);
+}
+
+//! Returns the position of the cell including a point at MAX_OCTREE_LEVEL, along one dimension
+/** Same result as DgmOctree::getCellPos but much faster (the bits of the
+	requested dimension are directly extracted from the interleaved code).
+	\param code cell code (at MAX_OCTREE_LEVEL)
+	\param dim dimension (0=X, 1=Y, 2=Z)
+**/
+static inline int GetCellPosAtMaxLevel(DgmOctree::OctreeCellCodeType code, int dim)
+{
+	quint64 x = (static_cast<quint64>(code) >> dim) & 0x1249249249249249ULL;
+	x = (x ^ (x >>  2)) & 0x10C30C30C30C30C3ULL;
+	x = (x ^ (x >>  4)) & 0x100F00F00F00F00FULL;
+	x = (x ^ (x >>  8)) & 0x001F0000FF0000FFULL;
+	x = (x ^ (x >> 16)) & 0x001F00000000FFFFULL;
+	x = (x ^ (x >> 32)) & 0x00000000001FFFFFULL;
+	return static_cast<int>(x);
+}
+
+bool DgmOctree::addPoints(unsigned firstIndex)
+{
+	unsigned pointCount = (m_theAssociatedCloud ? m_theAssociatedCloud->size() : 0);
+	if (m_numberOfProjectedPoints == 0 || firstIndex > pointCount)
+	{
+		//octree not built?!
+		return false;
+	}
+	if (firstIndex == pointCount)
+	{
+		//nothing to do
+		return true;
+	}
+	unsigned count = pointCount - firstIndex;
+
+	//the octree limits can't change: the new points must fall inside the octree box
+	CCVector3 newPointsMin = *m_theAssociatedCloud->getPoint(firstIndex);
+	CCVector3 newPointsMax = newPointsMin;
+	for (unsigned i=firstIndex+1; i<pointCount; ++i)
+	{
+		const CCVector3* P = m_theAssociatedCloud->getPoint(i);
+		for (int dim=0; dim<3; ++dim)
+		{
+			if (newPointsMin.u[dim] > P->u[dim])
+				newPointsMin.u[dim] = P->u[dim];
+			else if (newPointsMax.u[dim] < P->u[dim])
+				newPointsMax.u[dim] = P->u[dim];
+		}
+	}
+	for (int dim=0; dim<3; ++dim)
+	{
+		if (newPointsMin.u[dim] < m_dimMin.u[dim] || newPointsMax.u[dim] > m_dimMax.u[dim])
+			return false;
+	}
+
+	cellsContainer newCodes;
+	cellsContainer codes;
+	try
+	{
+		newCodes.resize(count);
+		codes.resize(m_numberOfProjectedPoints+count);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	//the 'accepted points' box is extended to the new points
+	for (int dim=0; dim<3; ++dim)
+	{
+		if (m_pointsMin.u[dim] > newPointsMin.u[dim])
+			m_pointsMin.u[dim] = newPointsMin.u[dim];
+		if (m_pointsMax.u[dim] < newPointsMax.u[dim])
+			m_pointsMax.u[dim] = newPointsMax.u[dim];
+	}
+
+	//we project the new points
+	unsigned projectedCount = 0;
+	int fillIndexes[6];
+	projectPoints(firstIndex,pointCount,&(newCodes[0]),projectedCount,fillIndexes);
+	assert(projectedCount == count);
+
+	int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL*6);
+	for (int dim=0; dim<3; ++dim)
+	{
+		fillIndexesAtMaxLevel[dim]   = std::min(fillIndexesAtMaxLevel[dim],   fillIndexes[dim]);
+		fillIndexesAtMaxLevel[dim+3] = std::max(fillIndexesAtMaxLevel[dim+3], fillIndexes[dim+3]);
+	}
+	updateFillIndexesTable();
+
+	//we sort the new 'cells' and merge them with the existing ones
+	//(the new indexes are greater than the previous ones, so that the merged
+	//structure is sorted by code and by index inside each cell as with build)
+	std::sort(newCodes.begin(),newCodes.end(),IndexAndCode::codeAndIndexComp);
+	std::merge(	m_thePointsAndTheirCellCodes.begin(),
+				m_thePointsAndTheirCellCodes.end(),
+				newCodes.begin(),
+				newCodes.end(),
+				codes.begin(),
+				IndexAndCode::codeAndIndexComp);
+
+	//the statistics are updated before the structure (see updateCellsStatistics)
+	bool levelsToUpdate[MAX_OCTREE_LEVEL+1];
+	updateCellsStatistics(newCodes,true,levelsToUpdate);
+
+	//we store the result (in compact form if required and if possible)
+	m_thePointsAndTheirCellCodes.assign(codes,m_compactStorage);
+	m_numberOfProjectedPoints += count;
+
+	for (uchar level=0; level<=MAX_OCTREE_LEVEL; ++level)
+		if (levelsToUpdate[level])
+			computeCellsStatistics(level);
+
+	return true;
+}
+
+bool DgmOctree::removePoints(const std::vector<bool>& removedPoints)
+{
+	if (m_numberOfProjectedPoints == 0)
+	{
+		//octree not built?!
+		return false;
+	}
+
+	//number of removed points (in the octree structure)
+	unsigned removedCount = 0;
+	{
+		for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin(); p != m_thePointsAndTheirCellCodes.end(); ++p)
+		{
+			if (p->theIndex >= removedPoints.size())
+			{
+				//invalid input table
+				return false;
+			}
+			if (removedPoints[p->theIndex])
+				++removedCount;
+		}
+	}
+
+	std::vector<unsigned> newIndexes;
+	cellsContainer removedCodes;
+	cellsContainer codes;
+	try
+	{
+		newIndexes.resize(removedPoints.size());
+		removedCodes.resize(removedCount);
+		codes.resize(m_numberOfProjectedPoints-removedCount);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	//new index of each point once the cloud is compacted
+	{
+		unsigned lastIndex = 0;
+		for (size_t i=0; i<removedPoints.size(); ++i)
+		{
+			newIndexes[i] = lastIndex;
+			if (!removedPoints[i])
+				++lastIndex;
+		}
+	}
+
+	//compaction pass: the removed points are dropped and the others are re-indexed
+	//(as the remaining points keep their relative order, the structure remains sorted)
+	bool fillIndexesChanged = false;
+	{
+		const int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL*6);
+		cellsContainer::iterator itRemoved = removedCodes.begin();
+		cellsContainer::iterator itRemaining = codes.begin();
+		for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin(); p != m_thePointsAndTheirCellCodes.end(); ++p)
+		{
+			IndexAndCode element = *p;
+			if (removedPoints[element.theIndex])
+			{
+				*itRemoved++ = element;
+
+				//if a removed point lies on the border of the occupied area, the 'fill indexes' may shrink
+				for (int dim=0; dim<3 && !fillIndexesChanged; ++dim)
+				{
+					int cellPos = GetCellPosAtMaxLevel(element.theCode,dim);
+					fillIndexesChanged = (cellPos == fillIndexesAtMaxLevel[dim] || cellPos == fillIndexesAtMaxLevel[dim+3]);
+				}
+			}
+			else
+			{
+				element.theIndex = newIndexes[element.theIndex];
+				*itRemaining++ = element;
+			}
+		}
+	}
+
+	//the 'fill indexes' are updated (if necessary) from the remaining points
+	if (fillIndexesChanged && !codes.empty())
+	{
+		int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL*6);
+		for (int dim=0; dim<3; ++dim)
+			fillIndexesAtMaxLevel[dim] = fillIndexesAtMaxLevel[dim+3] = GetCellPosAtMaxLevel(codes[0].theCode,dim);
+
+		for (cellsContainer::const_iterator it = codes.begin()+1; it != codes.end(); ++it)
+		{
+			for (int dim=0; dim<3; ++dim)
+			{
+				int cellPos = GetCellPosAtMaxLevel(it->theCode,dim);
+				if (fillIndexesAtMaxLevel[dim] > cellPos)
+					fillIndexesAtMaxLevel[dim] = cellPos;
+				else if (fillIndexesAtMaxLevel[dim+3] < cellPos)
+					fillIndexesAtMaxLevel[dim+3] = cellPos;
+			}
+		}
+		updateFillIndexesTable();
+	}
+
+	//the statistics are updated before the structure (see updateCellsStatistics)
+	bool levelsToUpdate[MAX_OCTREE_LEVEL+1];
+	updateCellsStatistics(removedCodes,false,levelsToUpdate);
 
-		//check
-#ifdef _DEBUG
-		for (it=m_thePointsAndTheirCellCodes.begin();it!=m_thePointsAndTheirCellCodes.end();++it)
-			assert(getCell(it->theCode,MAX_OCTREE_LEVEL));
-#endif
-	}
-#endif
+	//we store the result (in compact form if required and if possible)
+	m_thePointsAndTheirCellCodes.assign(codes,m_compactStorage);
+	m_numberOfProjectedPoints -= removedCount;
 
-	return static_cast<int>(m_numberOfProjectedPoints);
+	for (uchar level=0; level<=MAX_OCTREE_LEVEL; ++level)
+		if (levelsToUpdate[level])
+			computeCellsStatistics(level);
+
+	return true;
+}
+
+void DgmOctree::reindexInOctreeOrder()
+{
+	//the codes (and therefore the cells statistics) are unchanged
+	m_thePointsAndTheirCellCodes.setIndexesInOrder();
+}
+
+void DgmOctree::updateFillIndexesTable()
+{
+	for (int k=MAX_OCTREE_LEVEL-1; k>=0; k--)
+	{
+		int* fillIndexes = m_fillIndexes + (k*6);
+		for (int dim=0; dim<6; ++dim)
+		{
+			fillIndexes[dim] = (fillIndexes[dim+6] >> 1);
+		}
+	}
 }
 
 void DgmOctree::updateMinAndMaxTables()
@@ -497,6 +1746,8 @@ void DgmOctree::computeCellsStatistics(uchar level)
 		m_maxCellPopulation[level] = 1;
 		m_averageCellPopulation[level] = 1.0;
 		m_stdDevCellPopulation[level] = 0.0;
+		m_mostPopulatedCellCount[level] = 1;
+		m_cellPopulationSquareSum[level] = 1;
 		return;
 	}
 
@@ -507,6 +1758,8 @@ void DgmOctree::computeCellsStatistics(uchar level)
 		m_maxCellPopulation[level] = static_cast<unsigned>(m_thePointsAndTheirCellCodes.size());
 		m_averageCellPopulation[level] = static_cast<double>(m_thePointsAndTheirCellCodes.size());
 		m_stdDevCellPopulation[level] = 0.0;
+		m_mostPopulatedCellCount[level] = 1;
+		m_cellPopulationSquareSum[level] = static_cast<quint64>(m_maxCellPopulation[level]) * m_maxCellPopulation[level];
 		return;
 	}
 
@@ -514,14 +1767,16 @@ void DgmOctree::computeCellsStatistics(uchar level)
 	uchar bitDec = GET_BIT_SHIFT(level);
 
 	//iterator on octree elements
-	cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+	pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
 
 	//we init scan with first element
 	OctreeCellCodeType predCode = (p->theCode >> bitDec);
 	unsigned counter = 0;
 	unsigned cellCounter = 0;
 	unsigned maxCellPop = 0;
-	double sum = 0.0, sum2 = 0.0;
+	unsigned maxCellPopCount = 0;
+	double sum = 0.0;
+	quint64 sum2 = 0;
 
 	for (; p != m_thePointsAndTheirCellCodes.end(); ++p)
 	{
@@ -529,10 +1784,17 @@ void DgmOctree::computeCellsStatistics(uchar level)
 		if (predCode != currentCode)
 		{
 			sum += static_cast<double>(cellCounter);
-			sum2 += static_cast<double>(cellCounter) * static_cast<double>(cellCounter);
+			sum2 += static_cast<quint64>(cellCounter) * cellCounter;
 
-			if (maxCellPop<cellCounter)
+			if (maxCellPop < cellCounter)
+			{
 				maxCellPop = cellCounter;
+				maxCellPopCount = 1;
+			}
+			else if (maxCellPop == cellCounter)
+			{
+				++maxCellPopCount;
+			}
 
 			//new cell
 			predCode = currentCode;
@@ -544,16 +1806,140 @@ void DgmOctree::computeCellsStatistics(uchar level)
 
 	//don't forget last cell!
 	sum += static_cast<double>(cellCounter);
-	sum2 += static_cast<double>(cellCounter) * static_cast<double>(cellCounter);
+	sum2 += static_cast<quint64>(cellCounter) * cellCounter;
 	if (maxCellPop < cellCounter)
+	{
 		maxCellPop = cellCounter;
+		maxCellPopCount = 1;
+	}
+	else if (maxCellPop == cellCounter)
+	{
+		++maxCellPopCount;
+	}
 	++counter;
 
 	assert(counter > 0);
 	m_cellCount[level] = counter;
 	m_maxCellPopulation[level] = maxCellPop;
+	m_mostPopulatedCellCount[level] = maxCellPopCount;
+	m_cellPopulationSquareSum[level] = sum2;
 	m_averageCellPopulation[level] = sum/static_cast<double>(counter);
-	m_stdDevCellPopulation[level] = sqrt(sum2/static_cast<double>(counter) - m_averageCellPopulation[level]*m_averageCellPopulation[level]);
+	m_stdDevCellPopulation[level] = sqrt(static_cast<double>(sum2)/static_cast<double>(counter) - m_averageCellPopulation[level]*m_averageCellPopulation[level]);
+}
+
+void DgmOctree::updateCellsStatistics(const cellsContainer& codes, bool inserted, bool levelsToUpdate[])
+{
+	unsigned count = static_cast<unsigned>(codes.size());
+	unsigned previousCount = m_numberOfProjectedPoints;
+	assert(inserted || count <= previousCount);
+	unsigned newCount = (inserted ? previousCount + count : previousCount - count);
+
+	//range of the cell including each point in the current structure (for the current level)
+	std::vector<unsigned> cellFirst, cellLast;
+
+	//empty octree case (before or after the update): see computeCellsStatistics
+	bool fullUpdate = (previousCount == 0 || newCount == 0);
+	if (!fullUpdate)
+	{
+		try
+		{
+			cellFirst.resize(count,0);
+			cellLast.resize(count,previousCount);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			fullUpdate = true;
+		}
+	}
+	if (fullUpdate)
+	{
+		for (uchar level=0; level<=MAX_OCTREE_LEVEL; ++level)
+			levelsToUpdate[level] = true;
+		return;
+	}
+
+	//level '0' specific case
+	m_maxCellPopulation[0] = newCount;
+	m_averageCellPopulation[0] = static_cast<double>(newCount);
+	m_cellPopulationSquareSum[0] = static_cast<quint64>(newCount) * newCount;
+	levelsToUpdate[0] = false;
+
+	for (uchar level=1; level<=MAX_OCTREE_LEVEL; ++level)
+	{
+		//binary shift for cell code truncation
+		uchar bitDec = GET_BIT_SHIFT(level);
+
+		unsigned cellCount = m_cellCount[level];
+		unsigned maxCellPop = m_maxCellPopulation[level];
+		unsigned maxCellPopCount = m_mostPopulatedCellCount[level];
+		quint64 sum2 = m_cellPopulationSquareSum[level];
+
+		unsigned i = 0;
+		while (i < count)
+		{
+			//points falling in the same cell
+			OctreeCellCodeType truncatedCode = (codes[i].theCode >> bitDec);
+			unsigned j = i+1;
+			while (j < count && (codes[j].theCode >> bitDec) == truncatedCode)
+				++j;
+
+			//current range of this cell: we only look inside its parent cell range
+			//(beware, the code of the next cell overflows for the very last one)
+			unsigned first = m_thePointsAndTheirCellCodes.lowerBound(truncatedCode << bitDec,cellFirst[i],cellLast[i]);
+			unsigned last = cellLast[i];
+			quint64 nextTruncatedCode = static_cast<quint64>(truncatedCode) + 1;
+			if ((nextTruncatedCode >> (3*level)) == 0)
+				last = m_thePointsAndTheirCellCodes.lowerBound(static_cast<OctreeCellCodeType>(nextTruncatedCode << bitDec),first,last);
+			for (unsigned k=i; k<j; ++k)
+			{
+				cellFirst[k] = first;
+				cellLast[k] = last;
+			}
+
+			unsigned cellPop = last-first;
+			unsigned newCellPop = 0;
+			if (inserted)
+			{
+				newCellPop = cellPop + (j-i);
+				if (cellPop == 0)
+					++cellCount;
+				if (maxCellPop < newCellPop)
+				{
+					maxCellPop = newCellPop;
+					maxCellPopCount = 1;
+				}
+				else if (maxCellPop == newCellPop)
+				{
+					++maxCellPopCount;
+				}
+			}
+			else
+			{
+				assert(cellPop >= j-i);
+				newCellPop = cellPop - (j-i);
+				if (newCellPop == 0)
+					--cellCount;
+				if (cellPop == maxCellPop)
+					--maxCellPopCount;
+			}
+
+			sum2 += static_cast<quint64>(newCellPop) * newCellPop;
+			sum2 -= static_cast<quint64>(cellPop) * cellPop;
+
+			i = j;
+		}
+
+		//if all the most populated cells have shrunk, the new max can't be deduced
+		levelsToUpdate[level] = (maxCellPopCount == 0);
+
+		assert(cellCount > 0);
+		m_cellCount[level] = cellCount;
+		m_maxCellPopulation[level] = maxCellPop;
+		m_mostPopulatedCellCount[level] = maxCellPopCount;
+		m_cellPopulationSquareSum[level] = sum2;
+		m_averageCellPopulation[level] = static_cast<double>(newCount)/static_cast<double>(cellCount);
+		m_stdDevCellPopulation[level] = sqrt(static_cast<double>(sum2)/static_cast<double>(cellCount) - m_averageCellPopulation[level]*m_averageCellPopulation[level]);
+	}
 }
 
 //! Pre-computed cell codes for all potential cell positions (along a unique dimension)
@@ -699,6 +2085,17 @@ bool DgmOctree::getPointsInCell(OctreeCellCodeType cellCode,
 
 unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bitDec) const
 {
+	SearchStatistics* stats = ThreadSearchStatistics();
+	if (stats)
+		++stats->binarySearches;
+
+	//compact structure: we use its skip index
+	if (m_thePointsAndTheirCellCodes.isCompact())
+	{
+		unsigned i = m_thePointsAndTheirCellCodes.lowerBound(truncatedCellCode << bitDec,0,m_numberOfProjectedPoints);
+		return (i < m_numberOfProjectedPoints && (m_thePointsAndTheirCellCodes.getCode(i) >> bitDec) == truncatedCellCode ? i : m_numberOfProjectedPoints);
+	}
+
 	//inspired from the algorithm proposed by MATT PULVER (see http://eigenjoy.com/2011/01/21/worlds-fastest-binary-search/)
 	//DGM:	it's not faster, but the code is simpler ;)
 	unsigned i = 0;
@@ -708,7 +2105,7 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 		unsigned j = i | b;
 		if ( j < m_numberOfProjectedPoints)
 		{
-			OctreeCellCodeType middleCode = (m_thePointsAndTheirCellCodes[j].theCode >> bitDec);
+			OctreeCellCodeType middleCode = (m_thePointsAndTheirCellCodes.getCode(j) >> bitDec);
 			if (middleCode < truncatedCellCode )
 			{
 				//what we are looking for is on the right
@@ -717,7 +2114,7 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 			else if (middleCode == truncatedCellCode)
 			{
 				//we must check that it's the first element equal to input code
-				if (j == 0 || (m_thePointsAndTheirCellCodes[j-1].theCode >> bitDec) != truncatedCellCode)
+				if (j == 0 || (m_thePointsAndTheirCellCodes.getCode(j-1) >> bitDec) != truncatedCellCode)
 				{
 					//what we are looking for is right here
 					return j;
@@ -725,17 +2122,15 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 				//otheriwse what we are looking for is on the left!
 			}
 		}
+
+		if (stats)
+			++stats->binarySearchJumps;
 	}
 
-	return (m_thePointsAndTheirCellCodes[i].theCode >> bitDec) == truncatedCellCode ? i : m_numberOfProjectedPoints;
+	return (m_thePointsAndTheirCellCodes.getCode(i) >> bitDec) == truncatedCellCode ? i : m_numberOfProjectedPoints;
 }
 
 //optimized version with profiling
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-static double s_jumps = 0.0;
-static double s_binarySearchCount = 0.0;
-#endif
-
 #ifdef ADAPTATIVE_BINARY_SEARCH
 unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bitDec, unsigned begin, unsigned end) const
 {
@@ -743,20 +2138,20 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 	assert(end>=begin);
 	assert(end<m_numberOfProjectedPoints);
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-	s_binarySearchCount += 1;
-#endif
+	SearchStatistics* stats = ThreadSearchStatistics();
+	if (stats)
+		++stats->binarySearches;
 
 	//if query cell code is lower than or equal to the first octree cell code, then it's
 	//either the good one or there's no match
-	OctreeCellCodeType beginCode = (m_thePointsAndTheirCellCodes[begin].theCode >> bitDec);
+	OctreeCellCodeType beginCode = (m_thePointsAndTheirCellCodes.getCode(begin) >> bitDec);
 	if (truncatedCellCode < beginCode)
 		return m_numberOfProjectedPoints;
 	else if (truncatedCellCode == beginCode)
 		return begin;
 
 	//if query cell code is higher than the last octree cell code, then there's no match
-	OctreeCellCodeType endCode = (m_thePointsAndTheirCellCodes[end].theCode >> bitDec);
+	OctreeCellCodeType endCode = (m_thePointsAndTheirCellCodes.getCode(end) >> bitDec);
 	if (truncatedCellCode > endCode)
 		return m_numberOfProjectedPoints;
 
@@ -764,7 +2159,7 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 	{
 		float centralPoint = 0.5f + 0.75f*(static_cast<float>(truncatedCellCode-beginCode)/(-0.5f)); //0.75 = speed coef (empirical)
 		unsigned middle = begin + static_cast<unsigned>(centralPoint*float(end-begin));
-		OctreeCellCodeType middleCode = (m_thePointsAndTheirCellCodes[middle].theCode >> bitDec);
+		OctreeCellCodeType middleCode = (m_thePointsAndTheirCellCodes.getCode(middle) >> bitDec);
 
 		if (middleCode < truncatedCellCode)
 		{
@@ -787,15 +2182,14 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 		else
 		{
 			//if the previous point doesn't correspond, then we have just found the first good one!
-			if ((m_thePointsAndTheirCellCodes[middle-1].theCode >> bitDec) != truncatedCellCode)
+			if ((m_thePointsAndTheirCellCodes.getCode(middle-1) >> bitDec) != truncatedCellCode)
 				return middle;
 			end = middle;
 			endCode = middleCode;
 		}
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-		s_jumps += 1.0;
-#endif
+		if (stats)
+			++stats->binarySearchJumps;
 	}
 
 	//we shouldn't get there!
@@ -809,9 +2203,16 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 	assert(truncatedCellCode != INVALID_CELL_CODE);
 	assert(end >= begin && end < m_numberOfProjectedPoints);
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-	s_binarySearchCount += 1;
-#endif
+	SearchStatistics* stats = ThreadSearchStatistics();
+	if (stats)
+		++stats->binarySearches;
+
+	//compact structure: we use its skip index
+	if (m_thePointsAndTheirCellCodes.isCompact())
+	{
+		unsigned i = m_thePointsAndTheirCellCodes.lowerBound(truncatedCellCode << bitDec,begin,end+1);
+		return (i <= end && (m_thePointsAndTheirCellCodes.getCode(i) >> bitDec) == truncatedCellCode ? i : m_numberOfProjectedPoints);
+	}
 
 	//inspired from the algorithm proposed by MATT PULVER (see http://eigenjoy.com/2011/01/21/worlds-fastest-binary-search/)
 	//DGM:	it's not faster, but the code is simpler ;)
@@ -823,7 +2224,7 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 		unsigned j = i | b;
 		if ( j < count)
 		{
-			OctreeCellCodeType middleCode = (m_thePointsAndTheirCellCodes[begin+j].theCode >> bitDec);
+			OctreeCellCodeType middleCode = (m_thePointsAndTheirCellCodes.getCode(begin+j) >> bitDec);
 			if (middleCode < truncatedCellCode )
 			{
 				//what we are looking for is on the right
@@ -832,7 +2233,7 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 			else if (middleCode == truncatedCellCode)
 			{
 				//we must check that it's the first element equal to input code
-				if (j == 0 || (m_thePointsAndTheirCellCodes[begin+j-1].theCode >> bitDec) != truncatedCellCode)
+				if (j == 0 || (m_thePointsAndTheirCellCodes.getCode(begin+j-1) >> bitDec) != truncatedCellCode)
 				{
 					//what we are looking for is right here
 					return j + begin;
@@ -841,14 +2242,13 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 			}
 		}
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-		s_jumps += 1.0;
-#endif
+		if (stats)
+			++stats->binarySearchJumps;
 	}
 
 	i += begin;
 
-	return (m_thePointsAndTheirCellCodes[i].theCode >> bitDec) == truncatedCellCode ? i : m_numberOfProjectedPoints;
+	return (m_thePointsAndTheirCellCodes.getCode(i) >> bitDec) == truncatedCellCode ? i : m_numberOfProjectedPoints;
 }
 #endif
 
@@ -1032,6 +2432,15 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &n
 {
 	assert(neighbourhoodLength >= nNSS.alreadyVisitedNeighbourhoodSize);
 
+	SearchStatistics* stats = ThreadSearchStatistics();
+	QElapsedTimer timer;
+	size_t previousCount = 0;
+	if (stats)
+	{
+		timer.start();
+		previousCount = nNSS.pointsInNeighbourhood.size();
+	}
+
 	//get distance form cell to octree neighbourhood borders
 	int limits[6];
 	getCellDistanceFromBorders(nNSS.cellPos,nNSS.level,neighbourhoodLength,limits);
@@ -1076,7 +2485,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &n
 							//DGM TODO: Shall we stop? shall we try to go on, as we are not sure that we will actually need this much points?
 							assert(false);
 						}
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
 						{
 							if (!getOnlyPointsWithValidScalar || ScalarField::ValidValue(m_theAssociatedCloud->getPointScalarValue(p->theIndex)))
 							{
@@ -1107,7 +2516,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &n
 							//DGM TODO: Shall we stop? shall we try to go on, as we are not sure that we will actually need this much points?
 							assert(false);
 						}
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
 						{
 							if (!getOnlyPointsWithValidScalar || ScalarField::ValidValue(m_theAssociatedCloud->getPointScalarValue(p->theIndex)))
 							{
@@ -1135,7 +2544,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &n
 							//DGM TODO: Shall we stop? shall we try to go on, as we are not sure that we will actually need this much points?
 							assert(false);
 						}
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
 						{
 							if (!getOnlyPointsWithValidScalar || ScalarField::ValidValue(m_theAssociatedCloud->getPointScalarValue(p->theIndex)))
 							{
@@ -1148,6 +2557,41 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &n
 			}
 		}
 	}
+
+	if (stats)
+	{
+		stats->gatheredPoints += nNSS.pointsInNeighbourhood.size() - previousCount;
+		stats->neighbourhoodExtractionTime_ns += static_cast<quint64>(timer.nsecsElapsed());
+	}
+}
+
+void DgmOctree::extendBatchNeighbourhood(NearestNeighboursBatchSearchStruct &nNBSS, int neighbourhoodSize) const
+{
+	size_t previousCount = nNBSS.pointsInNeighbourhood.size();
+
+	//we get the points lying in the added area
+	while (nNBSS.alreadyVisitedNeighbourhoodSize < neighbourhoodSize)
+	{
+		getPointsInNeighbourCellsAround(nNBSS,nNBSS.alreadyVisitedNeighbourhoodSize);
+		++nNBSS.alreadyVisitedNeighbourhoodSize;
+	}
+
+	//and we copy their coordinates in the candidates arrays
+	size_t count = nNBSS.pointsInNeighbourhood.size();
+	if (count == previousCount)
+		return;
+
+	nNBSS.candidatesX.resize(count); //may throw std::bad_alloc
+	nNBSS.candidatesY.resize(count);
+	nNBSS.candidatesZ.resize(count);
+
+	for (size_t i=previousCount; i<count; ++i)
+	{
+		const CCVector3* P = nNBSS.pointsInNeighbourhood[i].point;
+		nNBSS.candidatesX[i] = P->x;
+		nNBSS.candidatesY[i] = P->y;
+		nNBSS.candidatesZ[i] = P->z;
+	}
 }
 
 #ifdef TEST_CELLS_FOR_SPHERICAL_NN
@@ -1173,7 +2617,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 			cellDesc.index = 0;
 			nNSS.cellsInNeighbourhood.push_back(cellDesc);
 
-			for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == truncatedCellCode); ++p)
+			for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == truncatedCellCode); ++p)
 			{
 				PointDescriptor newPoint(m_theAssociatedCloud->getPointPersistentPtr(p->theIndex),p->theIndex);
 				nNSS.pointsInSphericalNeighbourhood.push_back(newPoint);
@@ -1228,7 +2672,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 						cellDesc.index = nNSS.pointsInSphericalNeighbourhood.size();
 						nNSS.cellsInNeighbourhood.push_back(cellDesc);
 
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
                         {
 							PointDescriptor newPoint(m_theAssociatedCloud->getPointPersistentPtr(p->theIndex),p->theIndex);
                             nNSS.pointsInSphericalNeighbourhood.push_back(newPoint);
@@ -1268,7 +2712,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 						cellDesc.index = nNSS.pointsInSphericalNeighbourhood.size();
 						nNSS.cellsInNeighbourhood.push_back(cellDesc);
 
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
                         {
 							PointDescriptor newPoint(m_theAssociatedCloud->getPointPersistentPtr(p->theIndex),p->theIndex);
                             nNSS.pointsInSphericalNeighbourhood.push_back(newPoint);
@@ -1308,7 +2752,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 						cellDesc.index = nNSS.pointsInSphericalNeighbourhood.size();
 						nNSS.cellsInNeighbourhood.push_back(cellDesc);
 
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
                         {
 							PointDescriptor newPoint(m_theAssociatedCloud->getPointPersistentPtr(p->theIndex),p->theIndex);
                             nNSS.pointsInSphericalNeighbourhood.push_back(newPoint);
@@ -1348,7 +2792,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 						cellDesc.index = nNSS.pointsInSphericalNeighbourhood.size();
 						nNSS.cellsInNeighbourhood.push_back(cellDesc);
 
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c2); ++p)
                         {
 							PointDescriptor newPoint(m_theAssociatedCloud->getPointPersistentPtr(p->theIndex),p->theIndex);
                             nNSS.pointsInSphericalNeighbourhood.push_back(newPoint);
@@ -1387,7 +2831,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 						cellDesc.index = nNSS.pointsInSphericalNeighbourhood.size();
 						nNSS.cellsInNeighbourhood.push_back(cellDesc);
 
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c1); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c1); ++p)
 						{
 							PointDescriptor newPoint(m_theAssociatedCloud->getPointPersistentPtr(p->theIndex),p->theIndex);
 							nNSS.pointsInSphericalNeighbourhood.push_back(newPoint);
@@ -1426,7 +2870,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 						cellDesc.index = nNSS.pointsInSphericalNeighbourhood.size();
 						nNSS.cellsInNeighbourhood.push_back(cellDesc);
 
-						for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c1); ++p)
+						for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index; (p != m_thePointsAndTheirCellCodes.end()) && ((p->theCode >> bitDec) == c1); ++p)
 						{
 							PointDescriptor newPoint(m_theAssociatedCloud->getPointPersistentPtr(p->theIndex),p->theIndex);
 							nNSS.pointsInSphericalNeighbourhood.push_back(newPoint);
@@ -1445,6 +2889,10 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 
 double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearchStruct &nNSS) const
 {
+	SearchStatistics* stats = ThreadSearchStatistics();
+	if (stats)
+		++stats->searches;
+
 	//binary shift for cell code truncation
 	uchar bitDec = GET_BIT_SHIFT(nNSS.level);
 
@@ -1546,11 +2994,16 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 		}
 
 		//we get the (new) cells around the current neighbourhood
+		QElapsedTimer timer;
+		if (stats)
+			timer.start();
 		while (nNSS.alreadyVisitedNeighbourhoodSize < eligibleCellDistance) //DGM: warning, alreadyVisitedNeighbourhoodSize == 1 means that we have only visited the first cell (distance=0)
 		{
 			getNeighborCellsAround(nNSS.cellPos,nNSS.minimalCellsSetToVisit,nNSS.alreadyVisitedNeighbourhoodSize,nNSS.level);
 			++nNSS.alreadyVisitedNeighbourhoodSize;
 		}
+		if (stats)
+			stats->neighbourhoodExtractionTime_ns += static_cast<quint64>(timer.nsecsElapsed());
 
 		//we compute distances for the new points
 		DgmOctree::cellIndexesContainer::const_iterator q;
@@ -1560,7 +3013,7 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 			unsigned m = *q;
 
 			//we scan the whole cell to see if it contains a closer point
-			cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+m;
+			pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+m;
 			OctreeCellCodeType code = (p->theCode >> bitDec);
 			while (m < m_numberOfProjectedPoints && (p->theCode >> bitDec) == code)
 			{
@@ -1577,6 +3030,9 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 				++m;
 				++p;
 			}
+
+			if (stats)
+				stats->testedPoints += (m - *q);
 		}
 		alreadyProcessedCells = static_cast<unsigned>(nNSS.minimalCellsSetToVisit.size());
 
@@ -1615,6 +3071,10 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearchStruct &nNSS,
 															bool getOnlyPointsWithValidScalar/*=false*/) const
 {
+	SearchStatistics* stats = ThreadSearchStatistics();
+	if (stats)
+		++stats->searches;
+
 	//binary shift for cell code truncation
 	uchar bitDec = GET_BIT_SHIFT(nNSS.level);
 
@@ -1642,7 +3102,7 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 		if (index < m_numberOfProjectedPoints)
 		{
 			//we grab the points inside
-			cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index;
+			pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+index;
 			while (p!=m_thePointsAndTheirCellCodes.end() && (p->theCode >> bitDec) == truncatedCellCode)
 			{
 				if (!getOnlyPointsWithValidScalar || ScalarField::ValidValue(m_theAssociatedCloud->getPointScalarValue(p->theIndex)))
@@ -1698,84 +3158,393 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 		}
 	}
 
-	//for each dimension, we look for the min distance between the query point and the cell border.
-	//This distance (minDistToBorder) corresponds to the maximal radius of a sphere centered on the
-	//query point and totally included inside the cell
-	PointCoordinateType minDistToBorder = ComputeMinDistanceToCellBorder(&nNSS.queryPoint,cs,nNSS.cellCenter);
-
-	//eligible points found
-	unsigned eligiblePoints = 0;
+	//for each dimension, we look for the min distance between the query point and the cell border.
+	//This distance (minDistToBorder) corresponds to the maximal radius of a sphere centered on the
+	//query point and totally included inside the cell
+	PointCoordinateType minDistToBorder = ComputeMinDistanceToCellBorder(&nNSS.queryPoint,cs,nNSS.cellCenter);
+
+	//eligible points found
+	unsigned eligiblePoints = 0;
+
+	//points for which we have already computed the distance to the query point
+	unsigned alreadyProcessedPoints = 0;
+
+	//Min (squared) distance of non eligible points
+	double minSquareDist = -1.0;
+
+	//while we don't have enough 'nearest neighbours'
+	while (eligiblePoints<nNSS.minNumberOfNeighbors)
+	{
+		//if we do have found points but that were too far to be eligible
+		if (minSquareDist > 0)
+		{
+			//what would be the correct neighbourhood size to be sure of it?
+			int newEligibleCellDistance = static_cast<int>(ceil((static_cast<PointCoordinateType>(sqrt(minSquareDist))-minDistToBorder)/cs));
+			eligibleCellDistance = std::max(newEligibleCellDistance,eligibleCellDistance);
+		}
+
+		//we get the (new) points lying in the added area
+		while (visitedCellDistance < eligibleCellDistance) //DGM: warning, visitedCellDistance == 1 means that we have only visited the first cell (distance=0)
+		{
+			getPointsInNeighbourCellsAround(nNSS,visitedCellDistance,getOnlyPointsWithValidScalar);
+			++visitedCellDistance;
+		}
+
+		//we compute distances for the new points
+		NeighboursSet::iterator q;
+		for (q = nNSS.pointsInNeighbourhood.begin()+alreadyProcessedPoints; q != nNSS.pointsInNeighbourhood.end(); ++q)
+			q->squareDistd = (*q->point - nNSS.queryPoint).norm2d();
+		if (stats)
+			stats->testedPoints += nNSS.pointsInNeighbourhood.size() - alreadyProcessedPoints;
+		alreadyProcessedPoints = static_cast<unsigned>(nNSS.pointsInNeighbourhood.size());
+
+		//equivalent spherical neighbourhood radius (as we are actually looking to 'square' neighbourhoods,
+		//we must check that the nearest points inside such neighbourhoods are indeed near enough to fall
+		//inside the biggest included sphere). Otherwise we must look further.
+		double eligibleDist = static_cast<double>(eligibleCellDistance-1) * cs + minDistToBorder;
+		double squareEligibleDist = eligibleDist * eligibleDist;
+
+		//let's test all the previous 'not yet eligible' points and the new ones
+		unsigned j = eligiblePoints;
+		for (q = nNSS.pointsInNeighbourhood.begin()+eligiblePoints; q != nNSS.pointsInNeighbourhood.end(); ++q,++j)
+		{
+			//if the point is eligible
+			if (q->squareDistd <= squareEligibleDist)
+			{
+				if (eligiblePoints<j)
+					std::swap(nNSS.pointsInNeighbourhood[eligiblePoints],nNSS.pointsInNeighbourhood[j]);
+				++eligiblePoints;
+			}
+			//otherwise we track the nearest one
+			else if (q->squareDistd < minSquareDist || j == eligiblePoints)
+			{
+				minSquareDist = q->squareDistd;
+			}
+		}
+
+		//Maybe we are already too far?
+		if (nNSS.maxSearchSquareDistd >= 0 && squareEligibleDist > nNSS.maxSearchSquareDistd)
+			break;
+
+		//default strategy: increase neighbourhood size of +1 (for next step)
+		++eligibleCellDistance;
+	}
+
+	//update the neighbourhood size (for next call, if the query point lies in the same cell)
+	nNSS.alreadyVisitedNeighbourhoodSize = visitedCellDistance;
+
+	//we sort the eligible points
+	std::sort(nNSS.pointsInNeighbourhood.begin(),nNSS.pointsInNeighbourhood.begin()+eligiblePoints,PointDescriptor::distComp);
+
+	//we return the number of eligible points found
+	return eligiblePoints;
+}
+
+//! Computes the square distances between a query point and a set of points (structure of arrays)
+/** Uses AVX (8 points at a time) or SSE (4 points at a time) if available.
+	\warning assumes PointCoordinateType is 'float' (see CCTypes.h)
+**/
+static void ComputeSquareDistances(	const PointCoordinateType* x,
+									const PointCoordinateType* y,
+									const PointCoordinateType* z,
+									unsigned count,
+									const CCVector3& Q,
+									PointCoordinateType* squareDistances)
+{
+	unsigned i = 0;
+
+#if defined(OCTREE_NN_AVX)
+	const __m256 qx = _mm256_set1_ps(Q.x);
+	const __m256 qy = _mm256_set1_ps(Q.y);
+	const __m256 qz = _mm256_set1_ps(Q.z);
+	for (; i+8<=count; i+=8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x+i),qx);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y+i),qy);
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z+i),qz);
+		__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx,dx),_mm256_mul_ps(dy,dy)),_mm256_mul_ps(dz,dz));
+		_mm256_storeu_ps(squareDistances+i,d2);
+	}
+#elif defined(OCTREE_NN_SSE)
+	const __m128 qx = _mm_set1_ps(Q.x);
+	const __m128 qy = _mm_set1_ps(Q.y);
+	const __m128 qz = _mm_set1_ps(Q.z);
+	for (; i+4<=count; i+=4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(x+i),qx);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(y+i),qy);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(z+i),qz);
+		__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,dx),_mm_mul_ps(dy,dy)),_mm_mul_ps(dz,dz));
+		_mm_storeu_ps(squareDistances+i,d2);
+	}
+#endif
+
+	//remaining points
+	for (; i<count; ++i)
+	{
+		PointCoordinateType dx = x[i]-Q.x;
+		PointCoordinateType dy = y[i]-Q.y;
+		PointCoordinateType dz = z[i]-Q.z;
+		squareDistances[i] = dx*dx + dy*dy + dz*dz;
+	}
+}
+
+//! Compares two candidates of a batch NN search by their square distance (and their index, so that the order is deterministic)
+struct CandidatesDistanceComp
+{
+	const PointCoordinateType* squareDistances;
+
+	CandidatesDistanceComp(const PointCoordinateType* d2) : squareDistances(d2) {}
+
+	inline bool operator()(unsigned a, unsigned b) const
+	{
+		return squareDistances[a] < squareDistances[b] || (squareDistances[a] == squareDistances[b] && a < b);
+	}
+};
+
+//! Gathers the indexes of the candidates having a square distance below a given limit
+/** \return the number of selected candidates (stored at the beginning of 'selection')
+**/
+static unsigned SelectCandidates(	const std::vector<PointCoordinateType>& squareDistances,
+									unsigned candidateCount,
+									PointCoordinateType maxSquareDist,
+									std::vector<unsigned>& selection)
+{
+	if (selection.size() < candidateCount)
+		selection.resize(candidateCount); //may throw std::bad_alloc
+
+	//branchless compaction
+	unsigned count = 0;
+	for (unsigned i=0; i<candidateCount; ++i)
+	{
+		selection[count] = i;
+		count += (squareDistances[i] <= maxSquareDist ? 1 : 0);
+	}
+
+	return count;
+}
+
+//! Returns the size of the neighbourhood of a cell beyond which all the octree cells have been visited
+static int GetCompleteNeighbourhoodSize(const int* cellDistsFromBorders)
+{
+	int maxDist = 0;
+	for (unsigned i=0; i<6; ++i)
+		maxDist = std::max(maxDist,abs(cellDistsFromBorders[i]));
+
+	return maxDist+1;
+}
+
+unsigned DgmOctree::findNearestNeighborsForPointsInCell(NearestNeighboursBatchSearchStruct &nNBSS,
+														const GenericIndexedCloud* queryPoints,
+														unsigned firstQueryIndex,
+														unsigned queryCount,
+														unsigned k) const
+{
+	assert(queryPoints && firstQueryIndex+queryCount <= queryPoints->size());
+
+	SearchStatistics* stats = ThreadSearchStatistics();
+	if (stats)
+		stats->searches += queryCount;
+
+	nNBSS.neighbours.clear();
+	try
+	{
+		nNBSS.neighboursStart.assign(queryCount+1,0);
+		nNBSS.neighbours.reserve(static_cast<size_t>(queryCount)*k);
+
+		if (k == 0)
+			return 0;
+
+		//cell size at the current level of subdivision
+		const PointCoordinateType& cs = getCellSize(nNBSS.level);
+
+		//size of the neighbourhood beyond which there is no more point to gather
+		int cellDists[6];
+		getCellDistanceFromBorders(nNBSS.cellPos,nNBSS.level,cellDists);
+		const int completeNeighbourhoodSize = GetCompleteNeighbourhoodSize(cellDists);
+
+		const bool boundedSearch = (nNBSS.maxSearchSquareDistd >= 0);
+
+		CCVector3 Q;
+		for (unsigned q=0; q<queryCount; ++q)
+		{
+			queryPoints->getPoint(firstQueryIndex+q,Q);
+
+			//radius of the biggest sphere centered on the query point and totally included inside the cell
+			PointCoordinateType minDistToBorder = ComputeMinDistanceToCellBorder(&Q,cs,nNBSS.cellCenter);
+
+			//we look at least inside the cell including the query point
+			if (nNBSS.alreadyVisitedNeighbourhoodSize == 0)
+				extendBatchNeighbourhood(nNBSS,1);
+
+			unsigned processedCandidates = 0;
+			unsigned selectedCount = 0;
+			while (true)
+			{
+				//we compute the distances for the new candidates
+				unsigned candidateCount = static_cast<unsigned>(nNBSS.pointsInNeighbourhood.size());
+				if (candidateCount > processedCandidates)
+				{
+					nNBSS.squareDistances.resize(candidateCount);
+					ComputeSquareDistances(	&nNBSS.candidatesX[processedCandidates],
+											&nNBSS.candidatesY[processedCandidates],
+											&nNBSS.candidatesZ[processedCandidates],
+											candidateCount-processedCandidates,
+											Q,
+											&nNBSS.squareDistances[processedCandidates]);
+					if (stats)
+						stats->testedPoints += candidateCount-processedCandidates;
+					processedCandidates = candidateCount;
+				}
+				//radius of the biggest sphere centered on the query point and totally included inside the visited neighbourhood
+				double eligibleDist = std::max(0.0,static_cast<double>(nNBSS.alreadyVisitedNeighbourhoodSize-1) * cs + minDistToBorder);
+				double squareEligibleDist = eligibleDist * eligibleDist;
+
+				//no need to look further if all the octree cells (or all the cells inside the search limit) have been visited
+				bool complete = false;
+				if (nNBSS.alreadyVisitedNeighbourhoodSize >= completeNeighbourhoodSize)
+				{
+					squareEligibleDist = (boundedSearch ? nNBSS.maxSearchSquareDistd : FLT_MAX);
+					complete = true;
+				}
+				else if (boundedSearch && squareEligibleDist >= nNBSS.maxSearchSquareDistd)
+				{
+					squareEligibleDist = nNBSS.maxSearchSquareDistd;
+					complete = true;
+				}
+
+				//we only keep the eligible candidates (i.e. inside the above sphere)
+				unsigned eligibleCount = SelectCandidates(	nNBSS.squareDistances,
+															candidateCount,
+															static_cast<PointCoordinateType>(squareEligibleDist),
+															nNBSS.selection);
+				if (eligibleCount >= k || complete)
+				{
+					//we select the k nearest ones (partial selection)
+					selectedCount = std::min(k,eligibleCount);
+					if (selectedCount < eligibleCount)
+						std::nth_element(nNBSS.selection.begin(),nNBSS.selection.begin()+selectedCount,nNBSS.selection.begin()+eligibleCount,CandidatesDistanceComp(&nNBSS.squareDistances[0]));
+					break;
+				}
+
+				//otherwise we extend the neighbourhood
+				int neighbourhoodSize = nNBSS.alreadyVisitedNeighbourhoodSize+1;
+				if (candidateCount >= k)
+				{
+					//so as to include the sphere passing through the current k-th nearest candidate
+					SelectCandidates(nNBSS.squareDistances,candidateCount,FLT_MAX,nNBSS.selection);
+					std::vector<unsigned>::iterator kth = nNBSS.selection.begin()+(k-1);
+					std::nth_element(nNBSS.selection.begin(),kth,nNBSS.selection.begin()+candidateCount,CandidatesDistanceComp(&nNBSS.squareDistances[0]));
+					double kthDist = sqrt(static_cast<double>(nNBSS.squareDistances[*kth]));
+					neighbourhoodSize = std::max(neighbourhoodSize,static_cast<int>(ceil((kthDist-minDistToBorder)/cs)) + 1);
+				}
+				extendBatchNeighbourhood(nNBSS,std::min(neighbourhoodSize,completeNeighbourhoodSize));
+			}
+
+			//we only sort the k nearest neighbours
+			if (selectedCount > 1)
+				std::sort(nNBSS.selection.begin(),nNBSS.selection.begin()+selectedCount,CandidatesDistanceComp(&nNBSS.squareDistances[0]));
+			for (unsigned j=0; j<selectedCount; ++j)
+			{
+				const PointDescriptor& P = nNBSS.pointsInNeighbourhood[nNBSS.selection[j]];
+				nNBSS.neighbours.push_back(PointDescriptor(P.point,P.pointIndex,(*P.point - Q).norm2d()));
+			}
+			nNBSS.neighboursStart[q+1] = static_cast<unsigned>(nNBSS.neighbours.size());
+		}
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		nNBSS.neighbours.clear();
+		nNBSS.neighboursStart.clear();
+		return 0;
+	}
+
+	return static_cast<unsigned>(nNBSS.neighbours.size());
+}
 
-	//points for which we have already computed the distance to the query point
-	unsigned alreadyProcessedPoints = 0;
+unsigned DgmOctree::findNeighborsInASphereForPointsInCell(	NearestNeighboursBatchSearchStruct &nNBSS,
+															const GenericIndexedCloud* queryPoints,
+															unsigned firstQueryIndex,
+															unsigned queryCount,
+															PointCoordinateType radius,
+															bool sortValues/*=true*/) const
+{
+	assert(queryPoints && firstQueryIndex+queryCount <= queryPoints->size());
 
-	//Min (squared) distance of non eligible points
-	double minSquareDist = -1.0;
+	SearchStatistics* stats = ThreadSearchStatistics();
+	if (stats)
+		stats->searches += queryCount;
 
-	//while we don't have enough 'nearest neighbours'
-	while (eligiblePoints<nNSS.minNumberOfNeighbors)
+	nNBSS.neighbours.clear();
+	try
 	{
-		//if we do have found points but that were too far to be eligible
-		if (minSquareDist > 0)
-		{
-			//what would be the correct neighbourhood size to be sure of it?
-			int newEligibleCellDistance = static_cast<int>(ceil((static_cast<PointCoordinateType>(sqrt(minSquareDist))-minDistToBorder)/cs));
-			eligibleCellDistance = std::max(newEligibleCellDistance,eligibleCellDistance);
-		}
+		nNBSS.neighboursStart.assign(queryCount+1,0);
 
-		//we get the (new) points lying in the added area
-		while (visitedCellDistance < eligibleCellDistance) //DGM: warning, visitedCellDistance == 1 means that we have only visited the first cell (distance=0)
-		{
-			getPointsInNeighbourCellsAround(nNSS,visitedCellDistance,getOnlyPointsWithValidScalar);
-			++visitedCellDistance;
-		}
+		//cell size at the current level of subdivision
+		const PointCoordinateType& cs = getCellSize(nNBSS.level);
 
-		//we compute distances for the new points
-		NeighboursSet::iterator q;
-		for (q = nNSS.pointsInNeighbourhood.begin()+alreadyProcessedPoints; q != nNSS.pointsInNeighbourhood.end(); ++q)
-			q->squareDistd = (*q->point - nNSS.queryPoint).norm2d();
-		alreadyProcessedPoints = static_cast<unsigned>(nNSS.pointsInNeighbourhood.size());
+		//size of the neighbourhood beyond which there is no more point to gather
+		int cellDists[6];
+		getCellDistanceFromBorders(nNBSS.cellPos,nNBSS.level,cellDists);
+		const int completeNeighbourhoodSize = GetCompleteNeighbourhoodSize(cellDists);
 
-		//equivalent spherical neighbourhood radius (as we are actually looking to 'square' neighbourhoods,
-		//we must check that the nearest points inside such neighbourhoods are indeed near enough to fall
-		//inside the biggest included sphere). Otherwise we must look further.
-		double eligibleDist = static_cast<double>(eligibleCellDistance-1) * cs + minDistToBorder;
-		double squareEligibleDist = eligibleDist * eligibleDist;
+		const PointCoordinateType squareRadius = radius*radius;
 
-		//let's test all the previous 'not yet eligible' points and the new ones
-		unsigned j = eligiblePoints;
-		for (q = nNSS.pointsInNeighbourhood.begin()+eligiblePoints; q != nNSS.pointsInNeighbourhood.end(); ++q,++j)
+		CCVector3 Q;
+		for (unsigned q=0; q<queryCount; ++q)
 		{
-			//if the point is eligible
-			if (q->squareDistd <= squareEligibleDist)
+			queryPoints->getPoint(firstQueryIndex+q,Q);
+
+			//the sphere must be totally included inside the visited neighbourhood
+			PointCoordinateType minDistToBorder = ComputeMinDistanceToCellBorder(&Q,cs,nNBSS.cellCenter);
+			int neighbourhoodSize = static_cast<int>(ceil((radius-minDistToBorder)/cs)) + 1;
+			neighbourhoodSize = std::max(neighbourhoodSize,1);
+			neighbourhoodSize = std::min(neighbourhoodSize,completeNeighbourhoodSize);
+			if (nNBSS.alreadyVisitedNeighbourhoodSize < neighbourhoodSize)
+				extendBatchNeighbourhood(nNBSS,neighbourhoodSize);
+
+			//we compute the distances for all the candidates
+			unsigned candidateCount = static_cast<unsigned>(nNBSS.pointsInNeighbourhood.size());
+			if (candidateCount == 0)
 			{
-				if (eligiblePoints<j)
-					std::swap(nNSS.pointsInNeighbourhood[eligiblePoints],nNSS.pointsInNeighbourhood[j]);
-				++eligiblePoints;
+				nNBSS.neighboursStart[q+1] = static_cast<unsigned>(nNBSS.neighbours.size());
+				continue;
 			}
-			//otherwise we track the nearest one
-			else if (q->squareDistd < minSquareDist || j == eligiblePoints)
+			nNBSS.squareDistances.resize(candidateCount);
+			ComputeSquareDistances(	&nNBSS.candidatesX[0],
+									&nNBSS.candidatesY[0],
+									&nNBSS.candidatesZ[0],
+									candidateCount,
+									Q,
+									&nNBSS.squareDistances[0]);
+			if (stats)
+				stats->testedPoints += candidateCount;
+
+			//and we keep the ones inside the sphere
+			nNBSS.selection.clear();
+			for (unsigned i=0; i<candidateCount; ++i)
+				if (nNBSS.squareDistances[i] <= squareRadius)
+					nNBSS.selection.push_back(i);
+
+			if (sortValues)
+				std::sort(nNBSS.selection.begin(),nNBSS.selection.end(),CandidatesDistanceComp(&nNBSS.squareDistances[0]));
+
+			for (std::vector<unsigned>::const_iterator it = nNBSS.selection.begin(); it != nNBSS.selection.end(); ++it)
 			{
-				minSquareDist = q->squareDistd;
+				const PointDescriptor& P = nNBSS.pointsInNeighbourhood[*it];
+				nNBSS.neighbours.push_back(PointDescriptor(P.point,P.pointIndex,(*P.point - Q).norm2d()));
 			}
+			nNBSS.neighboursStart[q+1] = static_cast<unsigned>(nNBSS.neighbours.size());
 		}
-
-		//Maybe we are already too far?
-		if (nNSS.maxSearchSquareDistd >= 0 && squareEligibleDist > nNSS.maxSearchSquareDistd)
-			break;
-
-		//default strategy: increase neighbourhood size of +1 (for next step)
-		++eligibleCellDistance;
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		nNBSS.neighbours.clear();
+		nNBSS.neighboursStart.clear();
+		return 0;
 	}
 
-	//update the neighbourhood size (for next call, if the query point lies in the same cell)
-	nNSS.alreadyVisitedNeighbourhoodSize = visitedCellDistance;
-
-	//we sort the eligible points
-	std::sort(nNSS.pointsInNeighbourhood.begin(),nNSS.pointsInNeighbourhood.begin()+eligiblePoints,PointDescriptor::distComp);
-
-	//we return the number of eligible points found
-	return eligiblePoints;
+	return static_cast<unsigned>(nNBSS.neighbours.size());
 }
 
 int DgmOctree::getPointsInSphericalNeighbourhood(	const CCVector3& sphereCenter,
@@ -1841,7 +3610,7 @@ int DgmOctree::getPointsInSphericalNeighbourhood(	const CCVector3& sphereCenter,
 					if (cellIndex < m_numberOfProjectedPoints)
 					{
 						//we look for the first index in 'm_thePointsAndTheirCellCodes' corresponding to this cell
-						cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+cellIndex;
+						pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+cellIndex;
 						OctreeCellCodeType searchCode = (p->theCode >> bitDec);
 
 						//while the (partial) cell code matches this cell
@@ -1963,7 +3732,7 @@ size_t DgmOctree::getPointsInCylindricalNeighbourhood(CylindricalNeighbourhood&
 					if (cellIndex < m_numberOfProjectedPoints)
 					{
 						//we look for the first index in 'm_thePointsAndTheirCellCodes' corresponding to this cell
-						cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+cellIndex;
+						pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+cellIndex;
 						OctreeCellCodeType searchCode = (p->theCode >> bitDec);
 
 						//while the (partial) cell code matches this cell
@@ -2121,7 +3890,7 @@ size_t DgmOctree::getPointsInCylindricalNeighbourhoodProgressive(ProgressiveCyli
 						if (cellIndex < m_numberOfProjectedPoints)
 						{
 							//we look for the first index in 'm_thePointsAndTheirCellCodes' corresponding to this cell
-							cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+cellIndex;
+							pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+cellIndex;
 							OctreeCellCodeType searchCode = (p->theCode >> bitDec);
 
 							//while the (partial) cell code matches this cell
@@ -2458,7 +4227,7 @@ int DgmOctree::getPointsInSphericalNeighbourhood(const CCVector3& sphereCenter,
 		PointCoordinateType currentSquareDistanceToCellCenter = -1;
 		PointCoordinateType squareRadius = radius*radius;
 
-		for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+startIndex; p != m_thePointsAndTheirCellCodes.end() && (p->theCode >> bitDec) == englobCode; ++p) //we are looking to all points inside the main including cell!
+		for (pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+startIndex; p != m_thePointsAndTheirCellCodes.end() && (p->theCode >> bitDec) == englobCode; ++p) //we are looking to all points inside the main including cell!
 		{
 			//different cell?
 			if ((p->theCode >> currentBitDec) != currentTruncatedCode)
@@ -2592,15 +4361,14 @@ int DgmOctree::getPointsInSphericalNeighbourhood(const CCVector3& sphereCenter,
 
 #endif //THIS_CODE_IS_DEPREACTED
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-static double s_skippedPoints = 0.0;
-static double s_testedPoints = 0.0;
-#endif
-
 //search for all neighbors inside a sphere
 //warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors!
 int DgmOctree::findNeighborsInASphereStartingFromCell(NearestNeighboursSphericalSearchStruct &nNSS, double radius, bool sortValues) const
 {
+	SearchStatistics* stats = ThreadSearchStatistics();
+	if (stats)
+		++stats->searches;
+
 #ifdef OCTREE_TREE_TEST
 	assert(s_root);
 
@@ -2634,8 +4402,22 @@ int DgmOctree::findNeighborsInASphereStartingFromCell(NearestNeighboursSpherical
 			nNSS.pointsInSphericalNeighbourhood = nNSS.pointsInNeighbourhood;
 		}
 
+		QElapsedTimer timer;
+		size_t previousCount = 0;
+		if (stats)
+		{
+			timer.start();
+			previousCount = nNSS.pointsInSphericalNeighbourhood.size();
+		}
+
 		getPointsInNeighbourCellsAround(nNSS,nNSS.alreadyVisitedNeighbourhoodSize,minNeighbourhoodSize);
 
+		if (stats)
+		{
+			stats->gatheredPoints += nNSS.pointsInSphericalNeighbourhood.size() - previousCount;
+			stats->neighbourhoodExtractionTime_ns += static_cast<quint64>(timer.nsecsElapsed());
+		}
+
 		if (nNSS.pointsInNeighbourhood.size()<nNSS.pointsInSphericalNeighbourhood.size())
 			nNSS.pointsInNeighbourhood.resize(nNSS.pointsInSphericalNeighbourhood.size());
 
@@ -2700,18 +4482,16 @@ int DgmOctree::findNeighborsInASphereStartingFromCell(NearestNeighboursSpherical
 				//... we had them to the 'eligible points' part of the container
 				std::copy(p,p+count,nNSS.pointsInNeighbourhood.begin()+numberOfEligiblePoints);
 				numberOfEligiblePoints += count;
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-				s_skippedPoints += static_cast<double>(count);
-#endif
+				if (stats)
+					stats->skippedPoints += count;
 			}
 			else
 			{
+				if (stats)
+					stats->testedPoints += count;
 				for (unsigned j=0; j<count; ++j,++p)
 				{
 					p->squareDist = (*p->point - nNSS.queryPoint).norm2();
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-					s_testedPoints += 1.0;
-#endif
 					//if the distance is inferior to the sphere radius...
 					if (p->squareDistd <= squareRadius)
 					{
@@ -2721,12 +4501,10 @@ int DgmOctree::findNeighborsInASphereStartingFromCell(NearestNeighboursSpherical
 				}
 			}
 		}
-		//else cell is totally outside
+		else if (stats) //cell is totally outside
 		{
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
 			unsigned count = ((c+1) != nNSS.cellsInNeighbourhood.end() ? (c+1)->index : nNSS.pointsInSphericalNeighbourhood.size()) - c->index;
-			s_skippedPoints += static_cast<double>(count);
-#endif
+			stats->skippedPoints += count;
 		}
 	}
 
@@ -2735,6 +4513,8 @@ int DgmOctree::findNeighborsInASphereStartingFromCell(NearestNeighboursSpherical
 	//point by point scan
 	NeighboursSet::iterator p = nNSS.pointsInNeighbourhood.begin();
 	size_t k = nNSS.pointsInNeighbourhood.size();
+	if (stats)
+		stats->testedPoints += k;
 	for (size_t i=0; i<k; ++i,++p)
 	{
 		p->squareDistd = (*p->point - nNSS.queryPoint).norm2d();
@@ -2746,9 +4526,6 @@ int DgmOctree::findNeighborsInASphereStartingFromCell(NearestNeighboursSpherical
 				std::swap(nNSS.pointsInNeighbourhood[i],nNSS.pointsInNeighbourhood[numberOfEligiblePoints]);
 
 			++numberOfEligiblePoints;
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-			s_testedPoints += 1.0;
-#endif
 		}
 	}
 
@@ -2883,7 +4660,7 @@ bool DgmOctree::getCellCodesAndIndexes(uchar level, cellsContainer& vec, bool tr
 		//binary shift for cell code truncation
 		uchar bitDec = GET_BIT_SHIFT(level);
 
-		cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+		pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
 
 		OctreeCellCodeType predCode = (p->theCode >> bitDec)+1; //pred value must be different than the first element's
 
@@ -2912,7 +4689,7 @@ bool DgmOctree::getCellCodes(uchar level, cellCodesContainer& vec, bool truncate
 		//binary shift for cell code truncation
 		uchar bitDec = GET_BIT_SHIFT(level);
 
-		cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+		pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
 
 		OctreeCellCodeType predCode = (p->theCode >> bitDec)+1; //pred value must be different than the first element's
 
@@ -2949,7 +4726,7 @@ bool DgmOctree::getCellIndexes(uchar level, cellIndexesContainer& vec) const
 	//binary shift for cell code truncation
 	uchar bitDec = GET_BIT_SHIFT(level);
 
-	cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+	pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
 
 	OctreeCellCodeType predCode = (p->theCode >> bitDec)+1; //pred value must be different than the first element's
 
@@ -2977,7 +4754,7 @@ bool DgmOctree::getPointsInCellByCellIndex(	ReferenceCloud* cloud,
 	uchar bitDec = GET_BIT_SHIFT(level);
 
 	//we look for the first index in 'm_thePointsAndTheirCellCodes' corresponding to this cell
-	cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+cellIndex;
+	pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+cellIndex;
 	OctreeCellCodeType searchCode = (p->theCode >> bitDec);
 
 	if (clearOutputCloud)
@@ -3005,7 +4782,7 @@ ReferenceCloud* DgmOctree::getPointsInCellsWithSortedCellCodes(	cellCodesContain
     uchar bitDec1 = GET_BIT_SHIFT(level); //shift for this octree codes
     uchar bitDec2 = (areCodesTruncated ? 0 : bitDec1); //shift for the input codes
 
-    cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+    pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
     OctreeCellCodeType toExtractCode,currentCode = (p->theCode >> bitDec1); //pred value must be different than the first element's
 
     subset->clear(false);
@@ -3065,12 +4842,12 @@ void DgmOctree::diff(const cellCodesContainer& codesA, const cellCodesContainer&
         diffB.push_back(*pB++);
 }
 
-void DgmOctree::diff(uchar octreeLevel, const cellsContainer &codesA, const cellsContainer &codesB, int &diffA, int &diffB, int &cellsA, int &cellsB) const
+void DgmOctree::diff(uchar octreeLevel, const pointsAndCodesContainer &codesA, const pointsAndCodesContainer &codesB, int &diffA, int &diffB, int &cellsA, int &cellsB) const
 {
 	if (codesA.empty() && codesB.empty()) return;
 
-	cellsContainer::const_iterator pA = codesA.begin();
-	cellsContainer::const_iterator pB = codesB.begin();
+	pointsAndCodesContainer::const_iterator pA = codesA.begin();
+	pointsAndCodesContainer::const_iterator pB = codesB.begin();
 
 	//binary shift for cell code truncation
 	uchar bitDec = GET_BIT_SHIFT(octreeLevel);
@@ -3546,6 +5323,83 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, uchar level, bool
 
 /*** Octree-based cloud traversal mechanism ***/
 
+//! Spare containers of a thread (see DgmOctree::AcquireScratchBuffers)
+struct NeighbourhoodScratchBuffers
+{
+	std::vector<DgmOctree::cellIndexesContainer> cellIndexes;
+	std::vector<DgmOctree::NeighboursSet> points;
+};
+
+//! Max. number of spare containers (of each type) per thread
+static const size_t c_maxScratchBuffersPerThread = 8;
+
+static QThreadStorage<NeighbourhoodScratchBuffers*> s_scratchBuffers;
+
+static NeighbourhoodScratchBuffers* GetScratchBuffers()
+{
+	if (!s_scratchBuffers.hasLocalData())
+	{
+		NeighbourhoodScratchBuffers* buffers = 0;
+		try
+		{
+			buffers = new NeighbourhoodScratchBuffers;
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			return 0;
+		}
+		s_scratchBuffers.setLocalData(buffers);
+	}
+
+	return s_scratchBuffers.localData();
+}
+
+void DgmOctree::AcquireScratchBuffers(cellIndexesContainer& cellIndexes, NeighboursSet& points)
+{
+	NeighbourhoodScratchBuffers* buffers = GetScratchBuffers();
+	if (!buffers)
+		return;
+
+	//the spare containers are empty: swapping/popping them doesn't allocate nor free anything
+	if (!buffers->cellIndexes.empty())
+	{
+		cellIndexes.swap(buffers->cellIndexes.back());
+		buffers->cellIndexes.pop_back();
+	}
+	if (!buffers->points.empty())
+	{
+		points.swap(buffers->points.back());
+		buffers->points.pop_back();
+	}
+}
+
+void DgmOctree::ReleaseScratchBuffers(cellIndexesContainer& cellIndexes, NeighboursSet& points)
+{
+	NeighbourhoodScratchBuffers* buffers = GetScratchBuffers();
+	if (!buffers)
+		return;
+
+	try
+	{
+		if (cellIndexes.capacity() != 0 && buffers->cellIndexes.size() < c_maxScratchBuffersPerThread)
+		{
+			cellIndexes.clear();
+			buffers->cellIndexes.push_back(cellIndexesContainer());
+			buffers->cellIndexes.back().swap(cellIndexes);
+		}
+		if (points.capacity() != 0 && buffers->points.size() < c_maxScratchBuffersPerThread)
+		{
+			points.clear();
+			buffers->points.push_back(NeighboursSet());
+			buffers->points.back().swap(points);
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		//the containers will simply be released
+	}
+}
+
 DgmOctree::octreeCell::octreeCell(DgmOctree* _parentOctree)
 	: parentOctree(_parentOctree)
 	, level(0)
@@ -3586,7 +5440,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	uchar level,
 	uchar bitDec = GET_BIT_SHIFT(level);
 
 	//iterator on cell codes
-	cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+	pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
 
 	//init with first cell
 	cell.truncatedCode = (p->theCode >> bitDec);
@@ -3611,12 +5465,11 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	uchar level,
 
 	bool result = true;
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-	s_skippedPoints = 0;
-	s_testedPoints = 0;
-	s_jumps = 0.0;
-	s_binarySearchCount = 0.0;
-#endif
+	SearchStatisticsSession statsSession;
+	SearchStatistics* stats = ThreadSearchStatistics();
+	QElapsedTimer timer;
+	if (stats)
+		timer.start();
 
 	//for each point
 	for (; p!=m_thePointsAndTheirCellCodes.end(); ++p)
@@ -3625,9 +5478,21 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	uchar level,
 		OctreeCellCodeType nextCode = (p->theCode >> bitDec);
 		if (nextCode != cell.truncatedCode)
 		{
+			if (stats)
+			{
+				stats->addProcessedCell(cell.points->size());
+				stats->cellExtractionTime_ns += RestartTimer(timer);
+			}
+
 			//if not, we call the user function on the previous cell
 			result = (*func)(cell,additionalParameters,&nprogress);
 
+			if (stats)
+				stats->cellFunctionTime_ns += RestartTimer(timer);
+
+			//the points of this cell (and of its neighbours) are not used anymore
+			releaseCloudsPointers();
+
 			if (!result)
 				break;
 
@@ -3649,22 +5514,22 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	uchar level,
 
 	//don't forget last cell!
 	if (result)
+	{
+		if (stats)
+		{
+			stats->addProcessedCell(cell.points->size());
+			stats->cellExtractionTime_ns += RestartTimer(timer);
+		}
+
 		result = (*func)(cell,additionalParameters, &nprogress);
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-	FILE* fp=fopen("octree_log.txt","at");
-	if (fp)
-	{
-		fprintf(fp,"Function: %s\n",functionTitle ? functionTitle : "unknown");
-		fprintf(fp,"Tested:  %f (%3.1f %%)\n",s_testedPoints,100.0*s_testedPoints/std::max(1.0,s_testedPoints+s_skippedPoints));
-		fprintf(fp,"skipped: %f (%3.1f %%)\n",s_skippedPoints,100.0*s_skippedPoints/std::max(1.0,s_testedPoints+s_skippedPoints));
-		fprintf(fp,"Binary search count: %.0f\n",s_binarySearchCount);
-		if (s_binarySearchCount > 0.0)
-			fprintf(fp,"Mean jumps: %f\n",s_jumps/s_binarySearchCount);
-		fprintf(fp,"\n");
-		fclose(fp);
+		if (stats)
+			stats->cellFunctionTime_ns += RestartTimer(timer);
+
+		releaseCloudsPointers();
 	}
-#endif
+
+	statsSession.report(functionTitle);
 
 	//if something went wrong, we return 0
 	return (result ? cellCount : 0);
@@ -3723,10 +5588,16 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
 #endif
 
 	//pointer on the current octree element
-	cellsContainer::const_iterator startingElement = m_thePointsAndTheirCellCodes.begin();
+	pointsAndCodesContainer::const_iterator startingElement = m_thePointsAndTheirCellCodes.begin();
 
 	bool result = true;
 
+	SearchStatisticsSession statsSession;
+	SearchStatistics* stats = ThreadSearchStatistics();
+	QElapsedTimer timer;
+	if (stats)
+		timer.start();
+
 	//let's sweep through the octree
 	while (cell.index < m_numberOfProjectedPoints)
 	{
@@ -3759,7 +5630,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
 #endif
 
 		//let's test the following points
-		for (cellsContainer::const_iterator p = startingElement+1; p != m_thePointsAndTheirCellCodes.end(); ++p)
+		for (pointsAndCodesContainer::const_iterator p = startingElement+1; p != m_thePointsAndTheirCellCodes.end(); ++p)
 		{
 			//next point code (at current level of subdivision)
 			OctreeCellCodeType currentTruncatedCode = (p->theCode >> currentBitDec);
@@ -3888,6 +5759,12 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
 		for (unsigned i=0; i<elements; ++i)
 			cell.points->addPointIndex((startingElement++)->theIndex);
 
+		if (stats)
+		{
+			stats->addProcessedCell(elements);
+			stats->cellExtractionTime_ns += RestartTimer(timer);
+		}
+
 		//call user method on current cell
 		result = (*func)(cell,additionalParameters,
 #ifndef ENABLE_DOWN_TOP_TRAVERSAL
@@ -3897,6 +5774,12 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
 #endif
 			);
 
+		if (stats)
+			stats->cellFunctionTime_ns += RestartTimer(timer);
+
+		//the points of this cell (and of its neighbours) are not used anymore
+		releaseCloudsPointers();
+
 		if (!result)
 			break;
 
@@ -3920,75 +5803,302 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
 		progressCb->stop();
 	}
 
+	statsSession.report(functionTitle);
+
 	//if something went wrong, we return 0
 	return (result ? cellsNumber : 0);
 }
 
-#ifdef ENABLE_MT_OCTREE
+//! Max. number of threads used by the multi-threaded cell functions (0 = all cores)
+static int s_maxThreadCount = 0;
 
-#include <QtCore>
-#include <QApplication>
-#include <QtConcurrentMap>
+void DgmOctree::SetMaxThreadCount(int count)
+{
+	s_maxThreadCount = std::max(0, count);
+}
+
+int DgmOctree::GetMaxThreadCount()
+{
+	return s_maxThreadCount;
+}
+
+#ifdef ENABLE_MT_OCTREE
 
 /*** MULTI THREADING WRAPPER ***/
 
+//! Context of a multi-threaded cell function call
+/** One per call (shared by all its cells): several calls can run at the
+	same time (on different octrees or on the same one).
+**/
+struct octreeCellFuncContext
+{
+	DgmOctree* octree;
+	DgmOctree::octreeCellFunc func;
+	void** userParams;
+	GenericProgressCallback* progressCb;
+	NormalizedProgress* normProgressCb;
+	//! Search statistics of the call (if any)
+	SearchStatisticsSession* statsSession;
+	//! Set to false as soon as a cell fails (or the process is cancelled)
+	volatile bool success;
+
+	octreeCellFuncContext(DgmOctree* _octree, DgmOctree::octreeCellFunc _func, void** _userParams, GenericProgressCallback* _progressCb)
+		: octree(_octree)
+		, func(_func)
+		, userParams(_userParams)
+		, progressCb(_progressCb)
+		, normProgressCb(0)
+		, statsSession(0)
+		, success(true)
+	{}
+
+	~octreeCellFuncContext()
+	{
+		if (normProgressCb)
+			delete normProgressCb;
+		normProgressCb = 0;
+	}
+};
+
 struct octreeCellDesc
 {
 	DgmOctree::OctreeCellCodeType truncatedCode;
 	unsigned i1,i2;
 	uchar level;
+	octreeCellFuncContext* context;
 };
 
-static DgmOctree* s_octree_MT = 0;
-static DgmOctree::octreeCellFunc s_func_MT = 0;
-static void** s_userParams_MT = 0;
-static GenericProgressCallback* s_progressCb_MT = 0;
-static NormalizedProgress* s_normProgressCb_MT = 0;
-static bool s_cellFunc_MT_success = true;
-
-void LaunchOctreeCellFunc_MT(const octreeCellDesc& desc)
+//! Applies the cell function to a cell
+/** \param desc cell to process
+	\param cell cell descriptor (reused from one cell to the other by each thread)
+**/
+static void LaunchOctreeCellFunc_MT(const octreeCellDesc& desc, DgmOctree::octreeCell& cell)
 {
+	octreeCellFuncContext& context = *desc.context;
+
 	//skip cell if process is aborted/has failed
-	if (!s_cellFunc_MT_success)
+	if (!context.success)
 		return;
 
-	const DgmOctree::cellsContainer& pointsAndCodes = s_octree_MT->pointsAndTheirCellCodes();
+	const DgmOctree::pointsAndCodesContainer& pointsAndCodes = context.octree->pointsAndTheirCellCodes();
 
-    //cell descriptor
-    DgmOctree::octreeCell cell(s_octree_MT);
 	cell.level = desc.level;
 	cell.index = desc.i1;
 	cell.truncatedCode = desc.truncatedCode;
+	cell.points->clear(false);
 	if (cell.points->reserve(desc.i2-desc.i1+1))
 	{
+		DgmOctree::SearchStatistics* stats = ThreadSearchStatistics();
+		QElapsedTimer timer;
+		if (stats)
+			timer.start();
+
 		for (unsigned i=desc.i1; i<=desc.i2; ++i)
-			cell.points->addPointIndex(pointsAndCodes[i].theIndex);
+			cell.points->addPointIndex(pointsAndCodes.getIndex(i));
+
+		if (stats)
+		{
+			stats->addProcessedCell(desc.i2-desc.i1+1);
+			stats->cellExtractionTime_ns += RestartTimer(timer);
+		}
 
-		s_cellFunc_MT_success &= (*s_func_MT)(cell,s_userParams_MT,s_normProgressCb_MT);
+		if (!(*context.func)(cell,context.userParams,context.normProgressCb))
+			context.success = false;
+
+		if (stats)
+			stats->cellFunctionTime_ns += RestartTimer(timer);
 	}
 	else
 	{
-		s_cellFunc_MT_success = false;
+		context.success = false;
 	}
 
-	if (!s_cellFunc_MT_success)
+	if (!context.success)
 	{
 		//TODO: display a message to make clear that the cancel order has been understood!
-		if (s_progressCb_MT)
+		if (context.progressCb)
 		{
-			s_progressCb_MT->setInfo("Cancelling...");
+			context.progressCb->setInfo("Cancelling...");
 			QApplication::processEvents();
 		}
+	}
+}
+
+static void LaunchSingleOctreeCellFunc_MT(const octreeCellDesc& desc)
+{
+	SearchStatisticsWorkerScope statsScope(desc.context->statsSession);
+	DgmOctree::octreeCell cell(desc.context->octree);
+	LaunchOctreeCellFunc_MT(desc,cell);
+}
+
+//! Batch of contiguous cells (see ProcessCells_MT)
+struct octreeCellsBatch
+{
+	//! First cell and number of cells
+	size_t firstCell, cellCount;
+	//! Estimated cost (number of points)
+	unsigned long long weight;
+
+	static bool heavierThan(const octreeCellsBatch& a, const octreeCellsBatch& b)
+	{
+		return a.weight > b.weight;
+	}
+};
+
+//! Shared state of the threads processing the batches of a call
+struct octreeCellsScheduler
+{
+	DgmOctree* octree;
+	//! Search statistics of the call (if any)
+	SearchStatisticsSession* statsSession;
+	const std::vector<octreeCellDesc>* cells;
+	std::vector<octreeCellsBatch> batches;
+	//! Next batch to process
+	QAtomicInt nextBatch;
+};
+
+static void ProcessCellsBatches_MT(octreeCellsScheduler* const& scheduler)
+{
+	const std::vector<octreeCellDesc>& cells = *scheduler->cells;
+	const int batchCount = static_cast<int>(scheduler->batches.size());
+
+	//the same cell descriptor is used for all the cells processed by this thread
+	DgmOctree::octreeCell cell(scheduler->octree);
+	//and its searches are recorded for the call
+	SearchStatisticsWorkerScope statsScope(scheduler->statsSession);
+
+	//as long as there are remaining batches, we take the next one (i.e. the heaviest one)
+	for (int b = scheduler->nextBatch.fetchAndAddRelaxed(1); b < batchCount; b = scheduler->nextBatch.fetchAndAddRelaxed(1))
+	{
+		const octreeCellsBatch& batch = scheduler->batches[b];
+		for (size_t i=0; i<batch.cellCount; ++i)
+			LaunchOctreeCellFunc_MT(cells[batch.firstCell+i],cell);
+	}
+}
+
+//! Number of batches per thread (the more batches, the better the balance, but the higher the overhead)
+static const unsigned c_batchesPerThread = 16;
+
+//! Processes a range of cells with the multi-threaded scheduler
+/** Contiguous cells are grouped in batches of (roughly) the same weight
+	(number of points + 1 per cell). A single cell heavier than this target
+	has its own batch. Batches are sorted by decreasing weight, and each thread
+	takes the next one as soon as it's idle (so that the biggest cells don't
+	end up alone at the end of the process).
+	\param cells cells
+	\param firstCellIndex first cell to process
+	\param lastCellIndex last cell to process (excluded)
+	\param context call context
+**/
+static void ProcessCellsRange_MT(std::vector<octreeCellDesc>& cells, size_t firstCellIndex, size_t lastCellIndex, octreeCellFuncContext& context)
+{
+	if (firstCellIndex >= lastCellIndex)
+		return;
+
+	int threadCount = (s_maxThreadCount > 0 ? s_maxThreadCount : QThread::idealThreadCount());
+	if (threadCount < 1)
+		threadCount = 1;
+
+	unsigned long long totalWeight = 0;
+	for (size_t i=firstCellIndex; i<lastCellIndex; ++i)
+		totalWeight += static_cast<unsigned long long>(cells[i].i2-cells[i].i1+2);
+	unsigned long long targetWeight = std::max<unsigned long long>(1, totalWeight / (static_cast<unsigned long long>(threadCount) * c_batchesPerThread));
+
+	octreeCellsScheduler scheduler;
+	scheduler.octree = context.octree;
+	scheduler.statsSession = context.statsSession;
+	scheduler.cells = &cells;
+	scheduler.nextBatch = 0;
+	try
+	{
+		scheduler.batches.reserve(static_cast<size_t>(threadCount) * c_batchesPerThread * 2);
+
+		octreeCellsBatch batch;
+		batch.firstCell = firstCellIndex;
+		batch.cellCount = 0;
+		batch.weight = 0;
+		for (size_t i=firstCellIndex; i<lastCellIndex; ++i)
+		{
+			unsigned long long cellWeight = static_cast<unsigned long long>(cells[i].i2-cells[i].i1+2);
+
+			//a heavy cell gets its own batch
+			if (batch.cellCount != 0 && batch.weight + cellWeight > targetWeight && cellWeight >= targetWeight)
+			{
+				scheduler.batches.push_back(batch);
+				batch.firstCell = i;
+				batch.cellCount = 0;
+				batch.weight = 0;
+			}
+
+			++batch.cellCount;
+			batch.weight += cellWeight;
+
+			if (batch.weight >= targetWeight)
+			{
+				scheduler.batches.push_back(batch);
+				batch.firstCell = i+1;
+				batch.cellCount = 0;
+				batch.weight = 0;
+			}
+		}
+		if (batch.cellCount != 0)
+			scheduler.batches.push_back(batch);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		//we use the standard way (one task per cell)
+		QtConcurrent::blockingMap(cells.begin()+firstCellIndex, cells.begin()+lastCellIndex, LaunchSingleOctreeCellFunc_MT);
+		return;
+	}
+
+	//heaviest batches first
+	std::stable_sort(scheduler.batches.begin(), scheduler.batches.end(), octreeCellsBatch::heavierThan);
+
+	if (threadCount == 1)
+	{
+		ProcessCellsBatches_MT(&scheduler);
+	}
+	else
+	{
+		//one task per thread (they all share the same batches)
+		std::vector<octreeCellsScheduler*> tasks(static_cast<size_t>(threadCount), &scheduler);
+		QtConcurrent::blockingMap(tasks, ProcessCellsBatches_MT);
+	}
+}
+
+//! Processes cells with the multi-threaded scheduler
+/** If the cloud has a limited working set (see GenericIndexedCloudPersist::getWorkingSetSize),
+	the cells are processed by waves of contiguous cells with half as many points
+	(as the neighbouring cells are generally used as well). The cloud points are
+	released after each wave.
+**/
+static void ProcessCells_MT(std::vector<octreeCellDesc>& cells, octreeCellFuncContext& context)
+{
+	unsigned workingSetSize = context.octree->associatedCloud()->getWorkingSetSize();
+	if (workingSetSize == 0)
+	{
+		ProcessCellsRange_MT(cells, 0, cells.size(), context);
+		return;
+	}
+
+	const unsigned long long maxWaveWeight = std::max<unsigned>(workingSetSize/2, 1);
+	for (size_t firstCellIndex=0; firstCellIndex<cells.size() && context.success; )
+	{
+		size_t lastCellIndex = firstCellIndex;
+		unsigned long long waveWeight = 0;
+		while (lastCellIndex < cells.size())
+		{
+			unsigned long long cellWeight = static_cast<unsigned long long>(cells[lastCellIndex].i2-cells[lastCellIndex].i1+1);
+			if (lastCellIndex != firstCellIndex && waveWeight + cellWeight > maxWaveWeight)
+				break;
+			waveWeight += cellWeight;
+			++lastCellIndex;
+		}
+
+		ProcessCellsRange_MT(cells, firstCellIndex, lastCellIndex, context);
+		context.octree->releaseCloudsPointers();
 
-	//if (s_normProgressCb_MT)
-	//{
-	//	//QApplication::processEvents(); //let the application breath!
-	//	if (!s_normProgressCb_MT->oneStep())
-	//	{
-	//		s_cellFunc_MT_success = false;
-	//		return;
-	//	}
-	//}
+		firstCellIndex = lastCellIndex;
 	}
 }
 
@@ -4014,13 +6124,17 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
     uchar bitDec = GET_BIT_SHIFT(level);
 
     //iterator on cell codes
-    cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+    pointsAndCodesContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+
+	//context of this call
+	octreeCellFuncContext context(this,func,additionalParameters,progressCb);
 
     //cell descriptor (init. with first point/cell)
 	octreeCellDesc cellDesc;
 	cellDesc.i1 = 0;
 	cellDesc.i2 = 0;
 	cellDesc.level = level;
+	cellDesc.context = &context;
     cellDesc.truncatedCode = (p->theCode >> bitDec);
 	++p;
 
@@ -4041,18 +6155,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
     //don't forget the last cell!
 	cells.push_back(cellDesc);
 
-	//static wrap
-	s_octree_MT = this;
-	s_func_MT = func;
-	s_userParams_MT = additionalParameters;
-	s_cellFunc_MT_success = true;
-	s_progressCb_MT = progressCb;
-	if (s_normProgressCb_MT)
-	{
-		delete s_normProgressCb_MT;
-		s_normProgressCb_MT = 0;
-	}
-
     //progress notification
     if (progressCb)
     {
@@ -4062,49 +6164,22 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
         char buffer[512];
 		sprintf(buffer,"Octree level %i\nCells: %i\nAverage population: %3.2f (+/-%3.2f)\nMax population: %d",level,static_cast<int>(cells.size()),m_averageCellPopulation[level],m_stdDevCellPopulation[level],m_maxCellPopulation[level]);
         progressCb->setInfo(buffer);
-		s_normProgressCb_MT = new NormalizedProgress(progressCb,m_theAssociatedCloud->size());
+		context.normProgressCb = new NormalizedProgress(progressCb,m_theAssociatedCloud->size());
         progressCb->start();
     }
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-	s_skippedPoints = 0;
-	s_testedPoints = 0;
-	s_jumps = 0.0;
-	s_binarySearchCount = 0.0;
-#endif
-
-	QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+	SearchStatisticsSession statsSession;
+	context.statsSession = &statsSession;
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-	FILE* fp=fopen("octree_log.txt","at");
-	if (fp)
-	{
-		fprintf(fp,"Function: %s\n",functionTitle ? functionTitle : "unknown");
-		fprintf(fp,"Tested:  %f (%3.1f %%)\n",s_testedPoints,100.0*s_testedPoints/std::max(1.0,s_testedPoints+s_skippedPoints));
-		fprintf(fp,"skipped: %f (%3.1f %%)\n",s_skippedPoints,100.0*s_skippedPoints/std::max(1.0,s_testedPoints+s_skippedPoints));
-		fprintf(fp,"Binary search count: %.0f\n",s_binarySearchCount);
-		if (s_binarySearchCount > 0.0)
-			fprintf(fp,"Mean jumps: %f\n",s_jumps/s_binarySearchCount);
-		fprintf(fp,"\n");
-		fclose(fp);
-	}
-#endif
+	ProcessCells_MT(cells, context);
 
-	s_octree_MT = 0;
-	s_func_MT = 0;
-	s_userParams_MT = 0;
+	statsSession.report(functionTitle);
 
 	if (progressCb)
-	{
         progressCb->stop();
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT = 0;
-		s_progressCb_MT = 0;
-	}
 
 	//if something went wrong, we clear everything and return 0!
-	if (!s_cellFunc_MT_success)
+	if (!context.success)
 		cells.clear();
 
     return static_cast<unsigned>(cells.size());
@@ -4137,11 +6212,15 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 														progressCb,
 														functionTitle);
 
+	//context of this call
+	octreeCellFuncContext context(this,func,additionalParameters,progressCb);
+
     //cell descriptor (init. with first point/cell)
 	octreeCellDesc cellDesc;
 	cellDesc.i1 = 0;
 	cellDesc.i2 = 0;
 	cellDesc.level = startingLevel;
+	cellDesc.context = &context;
 
 	//binary shift for cell code truncation at current level
     uchar currentBitDec = GET_BIT_SHIFT(startingLevel);
@@ -4153,7 +6232,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 #endif
 
 	//pointer on the current octree element
-	cellsContainer::const_iterator startingElement = m_thePointsAndTheirCellCodes.begin();
+	pointsAndCodesContainer::const_iterator startingElement = m_thePointsAndTheirCellCodes.begin();
 
 	//we compute some statistics on the fly
 	unsigned long long popSum = 0;
@@ -4169,7 +6248,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 		unsigned elements = 1;
 
 		//let's test the following points
-		for (cellsContainer::const_iterator p = startingElement+1; p != m_thePointsAndTheirCellCodes.end(); ++p)
+		for (pointsAndCodesContainer::const_iterator p = startingElement+1; p != m_thePointsAndTheirCellCodes.end(); ++p)
         {
 			//next point code (at current level of subdivision)
             OctreeCellCodeType currentTruncatedCode = (p->theCode >> currentBitDec);
@@ -4314,15 +6393,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 	double mean = static_cast<double>(popSum)/static_cast<double>(cells.size());
 	double stddev = sqrt(static_cast<double>(popSum2-popSum*popSum))/static_cast<double>(cells.size());
 
-	//static wrap
-	s_octree_MT = this;
-	s_func_MT = func;
-	s_userParams_MT = additionalParameters;
-	s_cellFunc_MT_success = true;
-	if (s_normProgressCb_MT)
-		delete s_normProgressCb_MT;
-	s_normProgressCb_MT = 0;
-
     //progress notification
     if (progressCb)
     {
@@ -4332,50 +6402,22 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
         char buffer[1024];
 		sprintf(buffer,"Octree levels %i - %i\nCells: %i\nAverage population: %3.2f (+/-%3.2f)\nMax population: %llu",startingLevel,MAX_OCTREE_LEVEL,static_cast<int>(cells.size()),mean,stddev,maxPop);
         progressCb->setInfo(buffer);
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT = new NormalizedProgress(progressCb,static_cast<unsigned>(cells.size()));
+		context.normProgressCb = new NormalizedProgress(progressCb,static_cast<unsigned>(cells.size()));
         progressCb->start();
     }
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-	s_skippedPoints = 0;
-	s_testedPoints = 0;
-	s_jumps = 0.0;
-	s_binarySearchCount = 0.0;
-#endif
-
-	QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+	SearchStatisticsSession statsSession;
+	context.statsSession = &statsSession;
 
-#ifdef COMPUTE_NN_SEARCH_STATISTICS
-	FILE* fp=fopen("octree_log.txt","at");
-	if (fp)
-	{
-		fprintf(fp,"Function: %s\n",functionTitle ? functionTitle : "unknown");
-		fprintf(fp,"Tested:  %f (%3.1f %%)\n",s_testedPoints,100.0*s_testedPoints/std::max(1.0,s_testedPoints+s_skippedPoints));
-		fprintf(fp,"skipped: %f (%3.1f %%)\n",s_skippedPoints,100.0*s_skippedPoints/std::max(1.0,s_testedPoints+s_skippedPoints));
-		fprintf(fp,"Binary search count: %.0f\n",s_binarySearchCount);
-		if (s_binarySearchCount > 0.0)
-			fprintf(fp,"Mean jumps: %f\n",s_jumps/s_binarySearchCount);
-		fprintf(fp,"\n");
-		fclose(fp);
-	}
-#endif
+	ProcessCells_MT(cells, context);
 
-	s_octree_MT = 0;
-	s_func_MT = 0;
-	s_userParams_MT = 0;
+	statsSession.report(functionTitle);
 
 	if (progressCb)
-	{
         progressCb->stop();
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT = 0;
-	}
 
 	//if something went wrong, we clear everything and return 0!
-	if (!s_cellFunc_MT_success)
+	if (!context.success)
 		cells.clear();
 
     return static_cast<unsigned>(cells.size());
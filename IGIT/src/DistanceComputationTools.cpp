@@ -34,6 +34,7 @@
 #include "LocalModel.h"
 #include "SimpleTriangle.h"
 #include "ScalarField.h"
+#include "MeshBVH.h"
 
 //system
 #include <assert.h>
@@ -238,6 +239,9 @@ int DistanceComputationTools::computeHausdorffDistance(	GenericIndexedCloudPersi
 
 	int result = 0;
 
+	//the reference points are released along with the compared ones (see OutOfCoreCloud)
+	comparedOctree->setSecondaryCloud(referenceCloud);
+
 	bool success = false;
 #ifdef ENABLE_CLOUD2MESH_DIST_MT
 	if (params.multiThread)
@@ -258,6 +262,8 @@ int DistanceComputationTools::computeHausdorffDistance(	GenericIndexedCloudPersi
 																		"Cloud-Cloud Distance")!=0);
 	}
 
+	comparedOctree->setSecondaryCloud(0);
+
 	if (!success)
 	{
 		//something went wrong
@@ -1143,8 +1149,10 @@ int DistanceComputationTools::computePointCloud2MeshDistanceWithOctree(	OctreeAn
 			//no need to look farther than 'maxNeighbourhoodLength'
 			maxDist = std::min(maxDistToBoundaries,maxNeighbourhoodLength);
 
+			//the points farther than 'maxSearchDist' keep this value (warning: distances are squared if not signed)
+			ScalarType maxSearchDistValue = (signedDistances ? maxSearchDist : maxSearchDist*maxSearchDist);
 			for (unsigned j=0; j<remainingPoints; ++j)
-				Yk.setPointScalarValue(j,maxSearchDist);
+				Yk.setPointScalarValue(j,maxSearchDistValue);
 		}
 
 		//let's find the nearest triangles for each point in the neighborhood 'Yk'
@@ -1384,6 +1392,10 @@ static unsigned char s_octreeLevel_MT = 0;
 static OctreeAndMeshIntersection* s_theIntersection_MT = 0;
 static bool s_signedDistances_MT = true;
 static ScalarType s_normalSign_MT = 1.0f;
+//bounded search
+static bool s_boundedSearch_MT = false;
+static int s_maxNeighbourhoodLength_MT = 0;
+static ScalarType s_maxSearchDistValue_MT = 0;
 
 //'processTriangles' mechanism (based on bit mask)
 #include <QtCore/QBitArray>
@@ -1436,6 +1448,10 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 	}
 	int maxDist = maxDistToBoundaries;
 
+	//bounded search: no need to look farther than 'maxNeighbourhoodLength'
+	if (s_boundedSearch_MT)
+		maxDist = std::min(maxDistToBoundaries,s_maxNeighbourhoodLength_MT);
+
 	//on determine son centre
 	PointCoordinateType cellCenter[3];
 	s_octree_MT->computeCellCenter(startPos,s_octreeLevel_MT,cellCenter);
@@ -1487,6 +1503,13 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 		Yk.forwardIterator();
 	}
 
+	//bounded search: the points farther than 'maxSearchDist' keep this value
+	if (s_boundedSearch_MT)
+	{
+		for (unsigned j=0; j<remainingPoints; ++j)
+			Yk.setPointScalarValue(j,s_maxSearchDistValue_MT);
+	}
+
 	//initialisation de la recurrence
 	ScalarType maxRadius=0;
 	int dist=0;
@@ -1721,6 +1744,7 @@ int DistanceComputationTools::computePointCloud2MeshDistanceWithOctree_MT(Octree
 																		  uchar octreeLevel,
 																		  bool signedDistances,
 																		  bool flipTriangleNormals/*=false*/,
+																		  ScalarType maxSearchDist/*=-1.0*/,
 																		  GenericProgressCallback* progressCb/*=0*/)
 {
 	assert(theIntersection);
@@ -1753,6 +1777,17 @@ int DistanceComputationTools::computePointCloud2MeshDistanceWithOctree_MT(Octree
 	s_normalSign_MT = (flipTriangleNormals ? -1.0f : 1.0f);
 	s_octreeLevel_MT = octreeLevel;
 	s_theIntersection_MT = theIntersection;
+	//bounded search (same parameters as the single thread version)
+	s_boundedSearch_MT = (maxSearchDist >= 0);
+	s_maxNeighbourhoodLength_MT = 0;
+	s_maxSearchDistValue_MT = 0;
+	if (s_boundedSearch_MT)
+	{
+		const PointCoordinateType& cellLength = theOctree->getCellSize(octreeLevel);
+		s_maxNeighbourhoodLength_MT = static_cast<int>(ceil(maxSearchDist/cellLength + static_cast<ScalarType>((sqrt(2.0)-1.0)/2)));
+		//warning: distances are squared if not signed
+		s_maxSearchDistValue_MT = (signedDistances ? maxSearchDist : maxSearchDist*maxSearchDist);
+	}
 	//acceleration structure
 	s_useBitArrays_MT = true;
 
@@ -1782,6 +1817,175 @@ int DistanceComputationTools::computePointCloud2MeshDistanceWithOctree_MT(Octree
 
 #endif
 
+/*** BVH ENGINE ***/
+
+//! Context of a BVH-based cloud-to-mesh distances computation
+/** One per call (shared by all its cells): several computations can run at
+	the same time.
+**/
+struct cloudMeshDistContext_BVH
+{
+	DgmOctree* octree;
+	const MeshBVH* meshBVH;
+	NormalizedProgress* normProgressCb;
+	uchar octreeLevel;
+	bool signedDistances;
+	ScalarType normalSign;
+	//! Initial distance value (NaN or 'maxSearchDist' if the search is bounded)
+	ScalarType initialDistValue;
+	//! Set to false as soon as a cell fails (or the process is cancelled)
+	volatile bool success;
+
+	cloudMeshDistContext_BVH()
+		: octree(0)
+		, meshBVH(0)
+		, normProgressCb(0)
+		, octreeLevel(0)
+		, signedDistances(true)
+		, normalSign(1.0f)
+		, initialDistValue(0)
+		, success(true)
+	{}
+};
+
+struct cloudMeshDistCellDesc_BVH
+{
+	unsigned theIndex;
+	cloudMeshDistContext_BVH* context;
+};
+
+static void cloudMeshDistCellFunc_BVH(const cloudMeshDistCellDesc_BVH& desc)
+{
+	cloudMeshDistContext_BVH& context = *desc.context;
+
+	//skip cell if process is aborted/has failed
+	if (!context.success)
+		return;
+
+	if (context.normProgressCb && !context.normProgressCb->oneStep())
+	{
+		context.success = false;
+		return;
+	}
+
+	ReferenceCloud Yk(context.octree->associatedCloud());
+	if (!context.octree->getPointsInCellByCellIndex(&Yk,desc.theIndex,context.octreeLevel))
+	{
+		context.success = false;
+		return;
+	}
+
+	//the points of the cell are processed by packets
+	const CCVector3* points[MeshBVH::MAX_PACKET_SIZE];
+	ScalarType distances[MeshBVH::MAX_PACKET_SIZE];
+	unsigned triIndexes[MeshBVH::MAX_PACKET_SIZE];
+
+	unsigned count = Yk.size();
+	for (unsigned start=0; start<count; start+=MeshBVH::MAX_PACKET_SIZE)
+	{
+		unsigned packetSize = std::min(count-start,MeshBVH::MAX_PACKET_SIZE);
+		for (unsigned j=0; j<packetSize; ++j)
+		{
+			points[j] = Yk.getPointPersistentPtr(start+j);
+			distances[j] = context.initialDistValue;
+		}
+
+		context.meshBVH->findNearestTriangles(points,packetSize,context.signedDistances,distances,triIndexes);
+
+		for (unsigned j=0; j<packetSize; ++j)
+		{
+			//the default value (if no triangle is closer) is not affected by the normals orientation
+			if (context.signedDistances && triIndexes[j] != MeshBVH::INVALID_INDEX)
+				distances[j] *= context.normalSign;
+			Yk.setPointScalarValue(start+j,distances[j]);
+		}
+	}
+}
+
+int DistanceComputationTools::computePointCloud2MeshDistanceWithBVH(DgmOctree* theOctree,
+																	uchar octreeLevel,
+																	GenericIndexedMesh* theMesh,
+																	bool signedDistances,
+																	bool flipTriangleNormals/*=false*/,
+																	ScalarType maxSearchDist/*=-1.0*/,
+																	bool multiThread/*=true*/,
+																	GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(theOctree && theMesh);
+
+	MeshBVH bvh;
+	if (!bvh.build(theMesh,progressCb))
+		return -1;
+
+	//extraction des indexes et codes des cellules du niveau "octreeLevel"
+	DgmOctree::cellsContainer cellsCodes;
+	if (!theOctree->getCellCodesAndIndexes(octreeLevel,cellsCodes,true))
+		return -1;
+
+	unsigned numberOfCells = (unsigned)cellsCodes.size();
+
+	//the state of the computation is passed to each cell (no static variable)
+	cloudMeshDistContext_BVH context;
+	context.octree = theOctree;
+	context.meshBVH = &bvh;
+	context.octreeLevel = octreeLevel;
+	context.signedDistances = signedDistances;
+	context.normalSign = (flipTriangleNormals ? -1.0f : 1.0f);
+	//bounded search: the points farther than 'maxSearchDist' keep this value (warning: distances are squared if not signed)
+	context.initialDistValue = NAN_VALUE;
+	if (maxSearchDist >= 0)
+		context.initialDistValue = (signedDistances ? maxSearchDist : maxSearchDist*maxSearchDist);
+
+	std::vector<cloudMeshDistCellDesc_BVH> cellsDescs;
+	try
+	{
+		cellsDescs.resize(numberOfCells);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return -1;
+	}
+	{
+		unsigned i = 0;
+		for (DgmOctree::cellsContainer::const_iterator it = cellsCodes.begin(); it != cellsCodes.end(); ++it, ++i)
+		{
+			cellsDescs[i].theIndex = it->theIndex;
+			cellsDescs[i].context = &context;
+		}
+	}
+	cellsCodes.clear();
+
+	//Progress callback
+	if (progressCb)
+	{
+		context.normProgressCb = new NormalizedProgress(progressCb,numberOfCells);
+		char buffer[256];
+		sprintf(buffer,"Cells=%u\nTriangles=%u",numberOfCells,bvh.triangleCount());
+		progressCb->reset();
+		progressCb->setInfo(buffer);
+		progressCb->setMethodTitle(signedDistances ? "Compute signed distances (BVH)" : "Compute distances (BVH)");
+		progressCb->start();
+	}
+
+#ifdef ENABLE_CLOUD2MESH_DIST_MT
+	if (multiThread)
+	{
+		QtConcurrent::blockingMap(cellsDescs, cloudMeshDistCellFunc_BVH);
+	}
+	else
+#endif
+	{
+		for (unsigned i=0; i<numberOfCells; ++i)
+			cloudMeshDistCellFunc_BVH(cellsDescs[i]);
+	}
+
+	if (context.normProgressCb)
+		delete context.normProgressCb;
+	context.normProgressCb = 0;
+
+	return (context.success ? 0 : -2);
+}
+
 //convert all 'distances' (squared in fact) to their square root
 inline void applySqrtToPointDist(const CCVector3 &aPoint, ScalarType& aScalarValue)
 {
@@ -1798,7 +2002,8 @@ int DistanceComputationTools::computePointCloud2MeshDistance(	GenericIndexedClou
 																bool flipNormals/*=false*/,
 																bool multiThread/*=true*/,
 																GenericProgressCallback* progressCb/*=0*/,
-																DgmOctree* cloudOctree/*=0*/)
+																DgmOctree* cloudOctree/*=0*/,
+																CLOUD2MESH_ENGINE engine/*=C2M_GRID_ENGINE*/)
 {
 	assert(pointCloud && theMesh);
 
@@ -1864,6 +2069,25 @@ int DistanceComputationTools::computePointCloud2MeshDistance(	GenericIndexedClou
 		}
 	}
 
+	//the BVH engine doesn't need the grid structure
+	if (engine == C2M_BVH_ENGINE)
+	{
+		//raz des distances
+		pointCloud->enableScalarField();
+		pointCloud->forEach(ScalarFieldTools::SetScalarValueToNaN);
+
+		int result = computePointCloud2MeshDistanceWithBVH(theOctree,octreeLevel,theMesh,signedDistances,flipNormals,maxSearchDist,multiThread,progressCb);
+
+		//don't forget to pass the (squared) distances to the square root
+		if (result == 0 && !signedDistances)
+			pointCloud->forEach(applySqrtToPointDist);
+
+		if (!cloudOctree)
+			delete theOctree;
+
+		return (result < 0 ? -7 : 0);
+	}
+
 	OctreeAndMeshIntersection theIntersection;
 
 	//we deduce grid cell size very simply (as bbox has been "cubified")
@@ -1887,7 +2111,7 @@ int DistanceComputationTools::computePointCloud2MeshDistance(	GenericIndexedClou
 	theIntersection.sliceSize = tabSizes[1]*tabSizes[2];
 
 	bool boundedSearch = (maxSearchDist >= 0);
-	multiThread &= (!boundedSearch); //MT doesn't support boundedSearch yet!
+	multiThread &= (!useDistanceMap); //MT doesn't support the Chamfer distance transform
 	if (!useDistanceMap || boundedSearch)
 	{
 		//structure contenant pour chaque cellule de la grille 3D
@@ -1958,7 +2182,7 @@ int DistanceComputationTools::computePointCloud2MeshDistance(	GenericIndexedClou
 	//DGM: MT mode still under test!
 	if (multiThread)
 	{
-		result = computePointCloud2MeshDistanceWithOctree_MT(&theIntersection,octreeLevel,signedDistances,flipNormals,progressCb);
+		result = computePointCloud2MeshDistanceWithOctree_MT(&theIntersection,octreeLevel,signedDistances,flipNormals,maxSearchDist,progressCb);
 	}
 	else
 #endif
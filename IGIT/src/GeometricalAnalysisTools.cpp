@@ -339,22 +339,23 @@ bool GeometricalAnalysisTools::computeApproxPointsDensityInACellAtLevel(const Dg
 	//extract additional parameter(s)
 	Density densityType = *static_cast<Density*>(additionalParameters[0]);
 	
-	DgmOctree::NearestNeighboursSearchStruct nNSS;
-	nNSS.level								= cell.level;
-	nNSS.alreadyVisitedNeighbourhoodSize	= 0;
-	nNSS.minNumberOfNeighbors				= 2;
-	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
+	DgmOctree::NearestNeighboursBatchSearchStruct nNBSS;
+	nNBSS.level = cell.level;
+	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNBSS.cellPos,true);
+	cell.parentOctree->computeCellCenter(nNBSS.cellPos,cell.level,nNBSS.cellCenter);
 
+	//we look for the 2 nearest neighbours of all the points of the cell at once
 	unsigned n = cell.points->size();
+	cell.parentOctree->findNearestNeighborsForPointsInCell(nNBSS,cell.points,0,n,2);
+	if (nNBSS.neighboursStart.empty()) //not enough memory
+		return false;
+
 	for (unsigned i=0; i<n; ++i)
 	{
-		cell.points->getPoint(i,nNSS.queryPoint);
-
 		//the first point is always the point itself!
-		if (cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS) > 1)
+		if (nNBSS.getNeighbourCount(i) > 1)
 		{
-			double R2 = nNSS.pointsInNeighbourhood[1].squareDistd;
+			double R2 = nNBSS.getNeighbours(i)[1].squareDistd;
 
 			ScalarType density = NAN_VALUE;
 			if (R2 > ZERO_TOLERANCE)
@@ -0,0 +1,781 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "MeshBVH.h"
+
+//local
+#include "GenericIndexedMesh.h"
+#include "GenericProgressCallback.h"
+#include "DistanceComputationTools.h"
+#include "SimpleTriangle.h"
+#include "ScalarField.h"
+
+//system
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+//SIMD (for the packet distance kernels)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MESH_BVH_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MESH_BVH_SSE
+#endif
+
+using namespace CCLib;
+
+//! Number of bins for the SAH evaluation
+static const unsigned SAH_BIN_COUNT = 12;
+//! Cost of a node traversal (relatively to a triangle test) for the SAH evaluation
+static const float SAH_TRAVERSAL_COST = 1.0f;
+//! Relative margin applied to the (float) culling bounds
+/** The SIMD kernels work in single precision: a triangle (or a node) is only discarded
+	if its distance is above the current best distance by more than this margin. The
+	retained triangles are then evaluated with DistanceComputationTools::computePoint2TriangleDistance.
+**/
+static const double CULLING_RELATIVE_MARGIN = 1.0e-4;
+//! Size of the traversal stack allocated on the stack
+static const unsigned LOCAL_STACK_SIZE = 64;
+
+MeshBVH::MeshBVH()
+	: m_associatedMesh(0)
+	, m_absoluteMargin(0)
+	, m_maxDepth(0)
+{
+}
+
+MeshBVH::~MeshBVH()
+{
+	clear();
+}
+
+void MeshBVH::clear()
+{
+	m_nodes.clear();
+	m_triangles.clear();
+	m_associatedMesh = 0;
+	m_absoluteMargin = 0;
+	m_maxDepth = 0;
+}
+
+//! Triangle bounds (used during the build process only)
+struct TriangleBounds
+{
+	PointCoordinateType bbMin[3];
+	PointCoordinateType bbMax[3];
+	PointCoordinateType center[3];
+};
+
+//! Axis-aligned box (used during the build process only)
+struct BuildBox
+{
+	PointCoordinateType bbMin[3];
+	PointCoordinateType bbMax[3];
+
+	BuildBox() { reset(); }
+
+	inline void reset()
+	{
+		bbMin[0] = bbMin[1] = bbMin[2] = FLT_MAX;
+		bbMax[0] = bbMax[1] = bbMax[2] = -FLT_MAX;
+	}
+
+	inline void add(const PointCoordinateType* mins, const PointCoordinateType* maxs)
+	{
+		for (unsigned k=0; k<3; ++k)
+		{
+			bbMin[k] = std::min(bbMin[k],mins[k]);
+			bbMax[k] = std::max(bbMax[k],maxs[k]);
+		}
+	}
+
+	//! Returns half of the box surface (or 0 if the box is empty)
+	inline float halfArea() const
+	{
+		if (bbMin[0] > bbMax[0])
+			return 0;
+		float dx = bbMax[0]-bbMin[0];
+		float dy = bbMax[1]-bbMin[1];
+		float dz = bbMax[2]-bbMin[2];
+		return dx*dy + dy*dz + dz*dx;
+	}
+};
+
+//! Build task (see MeshBVH::build)
+struct BuildTask
+{
+	//! First triangle (in the 'order' array)
+	unsigned begin;
+	//! Last triangle + 1
+	unsigned end;
+	//! Index of the parent node if this is a right child (MeshBVH::INVALID_INDEX otherwise)
+	unsigned parent;
+	//! Depth of the node
+	unsigned depth;
+};
+
+//! Returns the SAH bin of a triangle
+static inline unsigned GetSAHBin(const TriangleBounds& tb, unsigned dim, PointCoordinateType minCenter, PointCoordinateType scale)
+{
+	unsigned bin = static_cast<unsigned>((tb.center[dim]-minCenter)*scale);
+	return std::min(bin,SAH_BIN_COUNT-1);
+}
+
+//! Predicate for std::partition (see MeshBVH::build)
+struct SAHBinPredicate
+{
+	const std::vector<TriangleBounds>& bounds;
+	unsigned dim;
+	PointCoordinateType minCenter;
+	PointCoordinateType scale;
+	unsigned lastLeftBin;
+
+	SAHBinPredicate(const std::vector<TriangleBounds>& _bounds, unsigned _dim, PointCoordinateType _minCenter, PointCoordinateType _scale, unsigned _lastLeftBin)
+		: bounds(_bounds), dim(_dim), minCenter(_minCenter), scale(_scale), lastLeftBin(_lastLeftBin) {}
+
+	inline bool operator()(unsigned triIndex) const
+	{
+		return GetSAHBin(bounds[triIndex],dim,minCenter,scale) <= lastLeftBin;
+	}
+};
+
+//! Computes the data used by the distance kernels
+static void PackTriangle(const CCVector3& A, const CCVector3& B, const CCVector3& C, unsigned index, MeshBVH::PackedTriangle& tri)
+{
+	tri.A = A;
+	tri.B = B;
+	tri.C = C;
+	tri.index = index;
+
+	tri.e0 = B-A;
+	tri.e1 = C-B;
+	tri.e2 = A-C;
+
+	double l0 = tri.e0.norm2d();
+	double l1 = tri.e1.norm2d();
+	double l2 = tri.e2.norm2d();
+	tri.invE0 = static_cast<PointCoordinateType>(l0 > 0 ? 1.0/l0 : 0);
+	tri.invE1 = static_cast<PointCoordinateType>(l1 > 0 ? 1.0/l1 : 0);
+	tri.invE2 = static_cast<PointCoordinateType>(l2 > 0 ? 1.0/l2 : 0);
+
+	//we compute the normal in double precision (sharp triangles)
+	CCVector3d AB(tri.e0.x,tri.e0.y,tri.e0.z);
+	CCVector3d AC(C.x-A.x,C.y-A.y,C.z-A.z);
+	CCVector3d N = AB.cross(AC);
+	//degenerate triangle: only the edges will be considered
+	tri.degenerate = !(N.norm2() > 0);
+	N.normalize();
+	tri.N = CCVector3(static_cast<PointCoordinateType>(N.x),static_cast<PointCoordinateType>(N.y),static_cast<PointCoordinateType>(N.z));
+
+	//inner normals of the edges (in the triangle plane)
+	CCVector3d edges[3] = {	AB,
+							CCVector3d(tri.e1.x,tri.e1.y,tri.e1.z),
+							CCVector3d(tri.e2.x,tri.e2.y,tri.e2.z) };
+	CCVector3* normals[3] = { &tri.n0, &tri.n1, &tri.n2 };
+	for (unsigned k=0; k<3; ++k)
+	{
+		CCVector3d n = N.cross(edges[k]);
+		n.normalize();
+		*normals[k] = CCVector3(static_cast<PointCoordinateType>(n.x),static_cast<PointCoordinateType>(n.y),static_cast<PointCoordinateType>(n.z));
+	}
+
+	tri.insideTol = static_cast<PointCoordinateType>(1.0e-4 * sqrt(std::max(l0,std::max(l1,l2))));
+}
+
+bool MeshBVH::build(GenericIndexedMesh* mesh, GenericProgressCallback* progressCb/*=0*/)
+{
+	clear();
+
+	if (!mesh)
+		return false;
+
+	unsigned triCount = mesh->size();
+	if (triCount == 0) //no triangle, no node!
+		return false;
+
+	std::vector<TriangleBounds> bounds;
+	std::vector<unsigned> order;
+	std::vector<BuildTask> tasks;
+	try
+	{
+		bounds.resize(triCount);
+		order.resize(triCount);
+		m_triangles.resize(triCount);
+		m_nodes.reserve(2*((triCount+MAX_LEAF_SIZE-1)/MAX_LEAF_SIZE));
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		clear();
+		return false;
+	}
+
+	NormalizedProgress* nProgress = 0;
+	if (progressCb)
+	{
+		//2 passes on the triangles (bounds + packing)
+		nProgress = new NormalizedProgress(progressCb,2*triCount);
+		char buffer[256];
+		sprintf(buffer,"Triangles=%u",triCount);
+		progressCb->reset();
+		progressCb->setMethodTitle("BVH computation");
+		progressCb->setInfo(buffer);
+		progressCb->start();
+	}
+
+	//triangle bounds
+	BuildBox meshBox;
+	for (unsigned i=0; i<triCount; ++i)
+	{
+		CCVector3 A,B,C;
+		mesh->getTriangleSummits(i,A,B,C);
+
+		TriangleBounds& tb = bounds[i];
+		for (unsigned k=0; k<3; ++k)
+		{
+			tb.bbMin[k] = std::min(A.u[k],std::min(B.u[k],C.u[k]));
+			tb.bbMax[k] = std::max(A.u[k],std::max(B.u[k],C.u[k]));
+			tb.center[k] = (tb.bbMin[k]+tb.bbMax[k])/2;
+		}
+		meshBox.add(tb.bbMin,tb.bbMax);
+		order[i] = i;
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			delete nProgress;
+			clear();
+			return false;
+		}
+	}
+
+	//iterative (depth-first) build: the left child of a node always follows its parent
+	BuildTask root;
+	root.begin = 0;
+	root.end = triCount;
+	root.parent = INVALID_INDEX;
+	root.depth = 0;
+	tasks.push_back(root);
+
+	try
+	{
+		while (!tasks.empty())
+		{
+			BuildTask task = tasks.back();
+			tasks.pop_back();
+
+			unsigned nodeIndex = static_cast<unsigned>(m_nodes.size());
+			m_nodes.push_back(Node());
+			if (task.parent != INVALID_INDEX)
+				m_nodes[task.parent].first = nodeIndex;
+			m_maxDepth = std::max(m_maxDepth,task.depth);
+
+			//node and centers bounding-boxes
+			BuildBox nodeBox,centerBox;
+			for (unsigned i=task.begin; i<task.end; ++i)
+			{
+				const TriangleBounds& tb = bounds[order[i]];
+				nodeBox.add(tb.bbMin,tb.bbMax);
+				centerBox.add(tb.center,tb.center);
+			}
+			{
+				Node& node = m_nodes.back();
+				for (unsigned k=0; k<3; ++k)
+				{
+					node.bbMin[k] = nodeBox.bbMin[k];
+					node.bbMax[k] = nodeBox.bbMax[k];
+				}
+			}
+
+			unsigned count = task.end-task.begin;
+			unsigned mid = task.begin; //no split by default
+
+			if (count > 1)
+			{
+				//we split along the largest dimension of the centers
+				unsigned dim = 0;
+				for (unsigned k=1; k<3; ++k)
+					if (centerBox.bbMax[k]-centerBox.bbMin[k] > centerBox.bbMax[dim]-centerBox.bbMin[dim])
+						dim = k;
+				PointCoordinateType extent = centerBox.bbMax[dim]-centerBox.bbMin[dim];
+
+				if (extent <= 0)
+				{
+					//all centers are the same: we can only split arbitrarily
+					if (count > MAX_LEAF_SIZE)
+						mid = task.begin + count/2;
+				}
+				else
+				{
+					//binned SAH
+					PointCoordinateType scale = static_cast<PointCoordinateType>(SAH_BIN_COUNT) / extent * (1.0f-FLT_EPSILON);
+					BuildBox binBoxes[SAH_BIN_COUNT];
+					unsigned binCounts[SAH_BIN_COUNT];
+					memset(binCounts,0,sizeof(unsigned)*SAH_BIN_COUNT);
+					for (unsigned i=task.begin; i<task.end; ++i)
+					{
+						const TriangleBounds& tb = bounds[order[i]];
+						unsigned bin = GetSAHBin(tb,dim,centerBox.bbMin[dim],scale);
+						binBoxes[bin].add(tb.bbMin,tb.bbMax);
+						++binCounts[bin];
+					}
+
+					//sweep from the right
+					float rightCosts[SAH_BIN_COUNT];
+					{
+						BuildBox box;
+						unsigned n = 0;
+						for (unsigned b=SAH_BIN_COUNT-1; b>0; --b)
+						{
+							box.add(binBoxes[b].bbMin,binBoxes[b].bbMax);
+							n += binCounts[b];
+							rightCosts[b-1] = box.halfArea() * n;
+						}
+					}
+
+					//sweep from the left
+					float bestCost = FLT_MAX;
+					unsigned bestBin = 0;
+					{
+						BuildBox box;
+						unsigned n = 0;
+						for (unsigned b=0; b+1<SAH_BIN_COUNT; ++b)
+						{
+							box.add(binBoxes[b].bbMin,binBoxes[b].bbMax);
+							n += binCounts[b];
+							if (n == 0 || n == count)
+								continue;
+							float cost = box.halfArea() * n + rightCosts[b];
+							if (cost < bestCost)
+							{
+								bestCost = cost;
+								bestBin = b;
+							}
+						}
+					}
+
+					float nodeArea = nodeBox.halfArea();
+					float leafCost = nodeArea * count;
+					float splitCost = SAH_TRAVERSAL_COST * nodeArea + bestCost;
+					if (count > MAX_LEAF_SIZE || splitCost < leafCost)
+					{
+						if (bestCost < FLT_MAX)
+						{
+							mid = static_cast<unsigned>(std::partition(	order.begin()+task.begin,
+																		order.begin()+task.end,
+																		SAHBinPredicate(bounds,dim,centerBox.bbMin[dim],scale,bestBin)) - order.begin());
+						}
+						else
+						{
+							mid = task.begin + count/2;
+						}
+					}
+				}
+			}
+
+			if (mid == task.begin)
+			{
+				//leaf
+				Node& node = m_nodes.back();
+				node.first = task.begin;
+				node.count = count;
+			}
+			else
+			{
+				//inner node ('first' will be updated with the right child index)
+				Node& node = m_nodes.back();
+				node.first = INVALID_INDEX;
+				node.count = 0;
+
+				BuildTask right;
+				right.begin = mid;
+				right.end = task.end;
+				right.parent = nodeIndex;
+				right.depth = task.depth+1;
+				tasks.push_back(right);
+
+				BuildTask left;
+				left.begin = task.begin;
+				left.end = mid;
+				left.parent = INVALID_INDEX;
+				left.depth = task.depth+1;
+				tasks.push_back(left);
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		if (nProgress)
+			delete nProgress;
+		clear();
+		return false;
+	}
+
+	//we pack the triangles in leaf order
+	for (unsigned i=0; i<triCount; ++i)
+	{
+		CCVector3 A,B,C;
+		mesh->getTriangleSummits(order[i],A,B,C);
+		PackTriangle(A,B,C,order[i],m_triangles[i]);
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			delete nProgress;
+			clear();
+			return false;
+		}
+	}
+
+	if (nProgress)
+		delete nProgress;
+
+	//absolute margin for the culling bounds (single precision rounding errors)
+	{
+		CCVector3 diag(meshBox.bbMax[0]-meshBox.bbMin[0],meshBox.bbMax[1]-meshBox.bbMin[1],meshBox.bbMax[2]-meshBox.bbMin[2]);
+		m_absoluteMargin = diag.normd() * 1.0e-6;
+	}
+
+	m_associatedMesh = mesh;
+
+	return true;
+}
+
+//! Computes the square distances between a packet of points and a box
+/** Uses AVX (8 points at a time) or SSE (4 points at a time) if available.
+	\warning 'count' should be a multiple of the SIMD width (the packets are padded)
+**/
+static void ComputeSquareDistancesToBox(const MeshBVH::Node& node,
+										const PointCoordinateType* x,
+										const PointCoordinateType* y,
+										const PointCoordinateType* z,
+										unsigned count,
+										PointCoordinateType* squareDistances)
+{
+	unsigned i = 0;
+
+#if defined(MESH_BVH_AVX)
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 minX = _mm256_set1_ps(node.bbMin[0]), maxX = _mm256_set1_ps(node.bbMax[0]);
+	const __m256 minY = _mm256_set1_ps(node.bbMin[1]), maxY = _mm256_set1_ps(node.bbMax[1]);
+	const __m256 minZ = _mm256_set1_ps(node.bbMin[2]), maxZ = _mm256_set1_ps(node.bbMax[2]);
+	for (; i+8<=count; i+=8)
+	{
+		__m256 px = _mm256_loadu_ps(x+i);
+		__m256 py = _mm256_loadu_ps(y+i);
+		__m256 pz = _mm256_loadu_ps(z+i);
+		__m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minX,px),_mm256_sub_ps(px,maxX)),zero);
+		__m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minY,py),_mm256_sub_ps(py,maxY)),zero);
+		__m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minZ,pz),_mm256_sub_ps(pz,maxZ)),zero);
+		__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx,dx),_mm256_mul_ps(dy,dy)),_mm256_mul_ps(dz,dz));
+		_mm256_storeu_ps(squareDistances+i,d2);
+	}
+#elif defined(MESH_BVH_SSE)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 minX = _mm_set1_ps(node.bbMin[0]), maxX = _mm_set1_ps(node.bbMax[0]);
+	const __m128 minY = _mm_set1_ps(node.bbMin[1]), maxY = _mm_set1_ps(node.bbMax[1]);
+	const __m128 minZ = _mm_set1_ps(node.bbMin[2]), maxZ = _mm_set1_ps(node.bbMax[2]);
+	for (; i+4<=count; i+=4)
+	{
+		__m128 px = _mm_loadu_ps(x+i);
+		__m128 py = _mm_loadu_ps(y+i);
+		__m128 pz = _mm_loadu_ps(z+i);
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX,px),_mm_sub_ps(px,maxX)),zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY,py),_mm_sub_ps(py,maxY)),zero);
+		__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ,pz),_mm_sub_ps(pz,maxZ)),zero);
+		__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,dx),_mm_mul_ps(dy,dy)),_mm_mul_ps(dz,dz));
+		_mm_storeu_ps(squareDistances+i,d2);
+	}
+#endif
+
+	//remaining points
+	for (; i<count; ++i)
+	{
+		PointCoordinateType dx = std::max(std::max(node.bbMin[0]-x[i],x[i]-node.bbMax[0]),0.0f);
+		PointCoordinateType dy = std::max(std::max(node.bbMin[1]-y[i],y[i]-node.bbMax[1]),0.0f);
+		PointCoordinateType dz = std::max(std::max(node.bbMin[2]-z[i],z[i]-node.bbMax[2]),0.0f);
+		squareDistances[i] = dx*dx + dy*dy + dz*dz;
+	}
+}
+
+#if defined(MESH_BVH_AVX) || defined(MESH_BVH_SSE)
+
+//SIMD wrappers (so that the triangle kernel is only written once)
+#if defined(MESH_BVH_AVX)
+typedef __m256 PackedFloat;
+static const unsigned PACKED_FLOAT_SIZE = 8;
+static inline PackedFloat PF_Set1(float v) { return _mm256_set1_ps(v); }
+static inline PackedFloat PF_Load(const float* p) { return _mm256_loadu_ps(p); }
+static inline void PF_Store(float* p, PackedFloat a) { _mm256_storeu_ps(p,a); }
+static inline PackedFloat PF_Add(PackedFloat a, PackedFloat b) { return _mm256_add_ps(a,b); }
+static inline PackedFloat PF_Sub(PackedFloat a, PackedFloat b) { return _mm256_sub_ps(a,b); }
+static inline PackedFloat PF_Mul(PackedFloat a, PackedFloat b) { return _mm256_mul_ps(a,b); }
+static inline PackedFloat PF_Min(PackedFloat a, PackedFloat b) { return _mm256_min_ps(a,b); }
+static inline PackedFloat PF_Max(PackedFloat a, PackedFloat b) { return _mm256_max_ps(a,b); }
+static inline PackedFloat PF_And(PackedFloat a, PackedFloat b) { return _mm256_and_ps(a,b); }
+static inline PackedFloat PF_AndNot(PackedFloat a, PackedFloat b) { return _mm256_andnot_ps(a,b); }
+static inline PackedFloat PF_Or(PackedFloat a, PackedFloat b) { return _mm256_or_ps(a,b); }
+static inline PackedFloat PF_CmpGE(PackedFloat a, PackedFloat b) { return _mm256_cmp_ps(a,b,_CMP_GE_OQ); }
+#else
+typedef __m128 PackedFloat;
+static const unsigned PACKED_FLOAT_SIZE = 4;
+static inline PackedFloat PF_Set1(float v) { return _mm_set1_ps(v); }
+static inline PackedFloat PF_Load(const float* p) { return _mm_loadu_ps(p); }
+static inline void PF_Store(float* p, PackedFloat a) { _mm_storeu_ps(p,a); }
+static inline PackedFloat PF_Add(PackedFloat a, PackedFloat b) { return _mm_add_ps(a,b); }
+static inline PackedFloat PF_Sub(PackedFloat a, PackedFloat b) { return _mm_sub_ps(a,b); }
+static inline PackedFloat PF_Mul(PackedFloat a, PackedFloat b) { return _mm_mul_ps(a,b); }
+static inline PackedFloat PF_Min(PackedFloat a, PackedFloat b) { return _mm_min_ps(a,b); }
+static inline PackedFloat PF_Max(PackedFloat a, PackedFloat b) { return _mm_max_ps(a,b); }
+static inline PackedFloat PF_And(PackedFloat a, PackedFloat b) { return _mm_and_ps(a,b); }
+static inline PackedFloat PF_AndNot(PackedFloat a, PackedFloat b) { return _mm_andnot_ps(a,b); }
+static inline PackedFloat PF_Or(PackedFloat a, PackedFloat b) { return _mm_or_ps(a,b); }
+static inline PackedFloat PF_CmpGE(PackedFloat a, PackedFloat b) { return _mm_cmpge_ps(a,b); }
+#endif
+
+static inline PackedFloat PF_Dot(PackedFloat x, PackedFloat y, PackedFloat z, const CCVector3& v)
+{
+	return PF_Add(PF_Add(PF_Mul(x,PF_Set1(v.x)),PF_Mul(y,PF_Set1(v.y))),PF_Mul(z,PF_Set1(v.z)));
+}
+
+//! Square distance between a packet of points and a segment [S,S+e] (the points are expressed relatively to S)
+static inline PackedFloat PF_SquareDistToSegment(PackedFloat x, PackedFloat y, PackedFloat z, const CCVector3& e, PointCoordinateType invE)
+{
+	PackedFloat t = PF_Mul(PF_Dot(x,y,z,e),PF_Set1(invE));
+	t = PF_Min(PF_Max(t,PF_Set1(0)),PF_Set1(1.0f));
+	PackedFloat dx = PF_Sub(x,PF_Mul(t,PF_Set1(e.x)));
+	PackedFloat dy = PF_Sub(y,PF_Mul(t,PF_Set1(e.y)));
+	PackedFloat dz = PF_Sub(z,PF_Mul(t,PF_Set1(e.z)));
+	return PF_Add(PF_Add(PF_Mul(dx,dx),PF_Mul(dy,dy)),PF_Mul(dz,dz));
+}
+
+#endif
+
+//! Computes the (approximate) square distances between a packet of points and a triangle
+/** Single precision version of DistanceComputationTools::computePoint2TriangleDistance:
+	distance to the triangle plane if the point projects inside the triangle, distance
+	to the nearest edge otherwise. Uses AVX (8 points at a time) or SSE (4 points at a time)
+	if available.
+	\warning 'count' should be a multiple of the SIMD width (the packets are padded)
+**/
+static void ComputeSquareDistancesToTriangle(	const MeshBVH::PackedTriangle& tri,
+												const PointCoordinateType* x,
+												const PointCoordinateType* y,
+												const PointCoordinateType* z,
+												unsigned count,
+												PointCoordinateType* squareDistances)
+{
+	unsigned i = 0;
+
+#if defined(MESH_BVH_AVX) || defined(MESH_BVH_SSE)
+	const PackedFloat minusTol = PF_Set1(-tri.insideTol);
+	for (; i+PACKED_FLOAT_SIZE<=count; i+=PACKED_FLOAT_SIZE)
+	{
+		PackedFloat px = PF_Load(x+i);
+		PackedFloat py = PF_Load(y+i);
+		PackedFloat pz = PF_Load(z+i);
+
+		PackedFloat apx = PF_Sub(px,PF_Set1(tri.A.x)), apy = PF_Sub(py,PF_Set1(tri.A.y)), apz = PF_Sub(pz,PF_Set1(tri.A.z));
+		PackedFloat bpx = PF_Sub(px,PF_Set1(tri.B.x)), bpy = PF_Sub(py,PF_Set1(tri.B.y)), bpz = PF_Sub(pz,PF_Set1(tri.B.z));
+		PackedFloat cpx = PF_Sub(px,PF_Set1(tri.C.x)), cpy = PF_Sub(py,PF_Set1(tri.C.y)), cpz = PF_Sub(pz,PF_Set1(tri.C.z));
+
+		//distance to the edges
+		PackedFloat dEdges = PF_SquareDistToSegment(apx,apy,apz,tri.e0,tri.invE0);
+		dEdges = PF_Min(dEdges,PF_SquareDistToSegment(bpx,bpy,bpz,tri.e1,tri.invE1));
+		dEdges = PF_Min(dEdges,PF_SquareDistToSegment(cpx,cpy,cpz,tri.e2,tri.invE2));
+		if (tri.degenerate)
+		{
+			PF_Store(squareDistances+i,dEdges);
+			continue;
+		}
+
+		//does the point project inside the triangle?
+		PackedFloat inside = PF_CmpGE(PF_Dot(apx,apy,apz,tri.n0),minusTol);
+		inside = PF_And(inside,PF_CmpGE(PF_Dot(bpx,bpy,bpz,tri.n1),minusTol));
+		inside = PF_And(inside,PF_CmpGE(PF_Dot(cpx,cpy,cpz,tri.n2),minusTol));
+
+		//distance to the plane
+		PackedFloat h = PF_Dot(apx,apy,apz,tri.N);
+		PackedFloat dPlane = PF_Mul(h,h);
+
+		PF_Store(squareDistances+i,PF_Or(PF_And(inside,dPlane),PF_AndNot(inside,dEdges)));
+	}
+#endif
+
+	//remaining points
+	for (; i<count; ++i)
+	{
+		CCVector3 P(x[i],y[i],z[i]);
+		CCVector3 AP = P-tri.A;
+		CCVector3 BP = P-tri.B;
+		CCVector3 CP = P-tri.C;
+
+		if (	!tri.degenerate
+			&&	AP.dot(tri.n0) >= -tri.insideTol
+			&&	BP.dot(tri.n1) >= -tri.insideTol
+			&&	CP.dot(tri.n2) >= -tri.insideTol )
+		{
+			PointCoordinateType h = AP.dot(tri.N);
+			squareDistances[i] = h*h;
+		}
+		else
+		{
+			const CCVector3* SP[3] = { &AP, &BP, &CP };
+			const CCVector3* e[3] = { &tri.e0, &tri.e1, &tri.e2 };
+			const PointCoordinateType invE[3] = { tri.invE0, tri.invE1, tri.invE2 };
+			PointCoordinateType d2 = FLT_MAX;
+			for (unsigned k=0; k<3; ++k)
+			{
+				PointCoordinateType t = std::min(std::max(SP[k]->dot(*e[k])*invE[k],0.0f),1.0f);
+				d2 = std::min(d2,(*SP[k] - *e[k]*t).norm2());
+			}
+			squareDistances[i] = d2;
+		}
+	}
+}
+
+//! Returns the (float) square distance above which a triangle or a node can be safely discarded
+static inline PointCoordinateType GetCullingBound(ScalarType distance, bool signedDistances, double absoluteMargin)
+{
+	if (!ScalarField::ValidValue(distance))
+		return FLT_MAX;
+
+	double d = (signedDistances ? fabs(static_cast<double>(distance)) : sqrt(static_cast<double>(distance)));
+	d = d * (1.0 + CULLING_RELATIVE_MARGIN) + absoluteMargin;
+	return static_cast<PointCoordinateType>(std::min(d*d,static_cast<double>(FLT_MAX)));
+}
+
+void MeshBVH::findNearestTriangles(	const CCVector3* const* points,
+									unsigned count,
+									bool signedDistances,
+									ScalarType* distances,
+									unsigned* triangleIndexes) const
+{
+	assert(count <= MAX_PACKET_SIZE);
+	if (count > MAX_PACKET_SIZE)
+		count = MAX_PACKET_SIZE;
+
+	for (unsigned i=0; i<count; ++i)
+		triangleIndexes[i] = INVALID_INDEX;
+
+	if (m_nodes.empty() || count == 0)
+		return;
+
+	//packet (structure of arrays) padded to a multiple of 8 (see the SIMD kernels)
+	PointCoordinateType x[MAX_PACKET_SIZE], y[MAX_PACKET_SIZE], z[MAX_PACKET_SIZE];
+	PointCoordinateType bounds[MAX_PACKET_SIZE];
+	PointCoordinateType squareDistances[MAX_PACKET_SIZE];
+	unsigned paddedCount = std::min((count+7) & ~7u, MAX_PACKET_SIZE);
+	CCVector3 center(0,0,0);
+	for (unsigned i=0; i<paddedCount; ++i)
+	{
+		if (i < count)
+		{
+			x[i] = points[i]->x;
+			y[i] = points[i]->y;
+			z[i] = points[i]->z;
+			bounds[i] = GetCullingBound(distances[i],signedDistances,m_absoluteMargin);
+			center += *points[i];
+		}
+		else
+		{
+			//padding: the bound is negative so that these points never trigger anything
+			x[i] = x[0];
+			y[i] = y[0];
+			z[i] = z[0];
+			bounds[i] = -1.0f;
+		}
+	}
+	center /= static_cast<PointCoordinateType>(count);
+
+	//traversal stack
+	unsigned localStack[LOCAL_STACK_SIZE];
+	std::vector<unsigned> heapStack;
+	unsigned* stack = localStack;
+	if (m_maxDepth+2 > LOCAL_STACK_SIZE)
+	{
+		heapStack.resize(m_maxDepth+2);
+		stack = &heapStack[0];
+	}
+	unsigned stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize != 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+
+		//is the node close enough to at least one point?
+		ComputeSquareDistancesToBox(node,x,y,z,paddedCount,squareDistances);
+		bool visit = false;
+		for (unsigned i=0; i<count; ++i)
+			visit |= (squareDistances[i] <= bounds[i]);
+		if (!visit)
+			continue;
+
+		if (node.isLeaf())
+		{
+			for (unsigned t=node.first; t<node.first+node.count; ++t)
+			{
+				const PackedTriangle& tri = m_triangles[t];
+				ComputeSquareDistancesToTriangle(tri,x,y,z,paddedCount,squareDistances);
+
+				for (unsigned i=0; i<count; ++i)
+				{
+					if (squareDistances[i] > bounds[i])
+						continue;
+
+					//accurate distance (same computation as the other C2M engines)
+					SimpleTriangle exactTri(tri.A,tri.B,tri.C);
+					ScalarType d = DistanceComputationTools::computePoint2TriangleDistance(points[i],&exactTri,signedDistances);
+					ScalarType& minD = distances[i];
+					bool closer = !ScalarField::ValidValue(minD);
+					if (!closer)
+						closer = (signedDistances ? minD*minD > d*d : d < minD);
+					if (closer)
+					{
+						minD = d;
+						triangleIndexes[i] = tri.index;
+						bounds[i] = GetCullingBound(d,signedDistances,m_absoluteMargin);
+					}
+				}
+			}
+		}
+		else
+		{
+			//we visit the nearest child first (relatively to the packet center)
+			unsigned left = static_cast<unsigned>(&node - &m_nodes[0]) + 1;
+			unsigned right = node.first;
+			PointCoordinateType dLeft, dRight;
+			ComputeSquareDistancesToBox(m_nodes[left],&center.x,&center.y,&center.z,1,&dLeft);
+			ComputeSquareDistancesToBox(m_nodes[right],&center.x,&center.y,&center.z,1,&dRight);
+			if (dLeft <= dRight)
+			{
+				stack[stackSize++] = right;
+				stack[stackSize++] = left;
+			}
+			else
+			{
+				stack[stackSize++] = left;
+				stack[stackSize++] = right;
+			}
+		}
+	}
+}
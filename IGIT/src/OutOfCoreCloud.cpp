@@ -0,0 +1,889 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "OutOfCoreCloud.h"
+
+//local
+#include "DgmOctree.h"
+#include "CCMiscTools.h"
+#include "GenericProgressCallback.h"
+
+//system
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+
+using namespace CCLib;
+
+//! File header signature
+static const char c_fileSignature[4] = { 'C', 'C', 'O', 'C' };
+//! File format version
+static const quint32 c_fileVersion = 1;
+//! File header size (the pages start right after)
+static const qint64 c_headerSize = 128;
+
+//! Header flags
+enum OutOfCoreCloudFlags { OOC_SORTED = 1, OOC_SCALAR_FIELD = 2 };
+
+//! Size of a page (in memory and in the file)
+static const size_t c_pageSize = OutOfCoreCloud::POINTS_PER_PAGE * (sizeof(CCVector3) + sizeof(ScalarType));
+
+//! Returns the position of a page in the file
+static inline qint64 GetPageOffset(unsigned pageIndex)
+{
+	return c_headerSize + static_cast<qint64>(pageIndex) * static_cast<qint64>(c_pageSize);
+}
+
+//! Reads the epoch of a page (acquire semantics)
+/** If it matches the current epoch, the page content is visible to the calling thread.
+**/
+static inline unsigned LoadEpoch(const QAtomicInt& epoch)
+{
+#if QT_VERSION >= 0x050000
+	return static_cast<unsigned>(epoch.loadAcquire());
+#else
+	//Qt4 has no 'loadAcquire'
+	return static_cast<unsigned>(const_cast<QAtomicInt&>(epoch).fetchAndAddAcquire(0));
+#endif
+}
+
+//! Sets the epoch of a page (release semantics)
+/** The page content written before is visible to the threads reading the epoch with LoadEpoch.
+**/
+static inline void StoreEpoch(QAtomicInt& epoch, unsigned value)
+{
+#if QT_VERSION >= 0x050000
+	epoch.storeRelease(static_cast<int>(value));
+#else
+	//Qt4 has no 'storeRelease'
+	epoch.fetchAndStoreRelease(static_cast<int>(value));
+#endif
+}
+
+//! Writes contiguous points directly in the file (see OutOfCoreCloud::sortPoints)
+/** \param file cloud file
+	\param firstIndex index of the first point
+	\param points points
+	\param count number of points
+	\return success
+**/
+static bool WritePoints(QFile& file, unsigned firstIndex, const CCVector3* points, unsigned count)
+{
+	while (count)
+	{
+		//the points are written page by page
+		unsigned pageIndex = firstIndex / OutOfCoreCloud::POINTS_PER_PAGE;
+		unsigned pos = firstIndex % OutOfCoreCloud::POINTS_PER_PAGE;
+		unsigned pageCount = std::min(count, OutOfCoreCloud::POINTS_PER_PAGE - pos);
+		qint64 byteCount = static_cast<qint64>(pageCount * sizeof(CCVector3));
+
+		if (	!file.seek(GetPageOffset(pageIndex) + static_cast<qint64>(pos * sizeof(CCVector3)))
+			||	file.write(reinterpret_cast<const char*>(points), byteCount) != byteCount)
+		{
+			return false;
+		}
+
+		firstIndex += pageCount;
+		points += pageCount;
+		count -= pageCount;
+	}
+
+	return true;
+}
+
+//! Point and its octree cell code (see OutOfCoreCloud::sortPoints)
+struct PointAndCode
+{
+	quint64 code;
+	CCVector3 P;
+
+	static bool codeComp(const PointAndCode& a, const PointAndCode& b)
+	{
+		return a.code < b.code;
+	}
+};
+
+//! Spreads the (21) first bits of a value so that there are 2 zero bits between each of them
+static inline quint64 SpreadBits(quint64 x)
+{
+	x &= 0x00000000001FFFFFULL;
+	x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+	x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+	x = (x | (x <<  8)) & 0x100F00F00F00F00FULL;
+	x = (x | (x <<  4)) & 0x10C30C30C30C30C3ULL;
+	x = (x | (x <<  2)) & 0x1249249249249249ULL;
+	return x;
+}
+
+//! Computes the octree cell code of a point (at MAX_OCTREE_LEVEL)
+/** Same code as DgmOctree::generateTruncatedCellCode (for the cell computed
+	by DgmOctree::getTheCellPosWhichIncludesThePoint).
+	\param P point
+	\param dimMin octree bounding-box min corner
+	\param cellSize octree cell size at MAX_OCTREE_LEVEL
+**/
+static quint64 ComputeCellCode(const CCVector3& P, const CCVector3& dimMin, PointCoordinateType cellSize)
+{
+	quint64 code = 0;
+	for (int dim=0; dim<3; ++dim)
+	{
+		int pos = (cellSize > 0 ? static_cast<int>((P.u[dim] - dimMin.u[dim])/cellSize) : 0);
+		if (pos < 0)
+			pos = 0;
+		else if (pos > DgmOctree::MAX_OCTREE_LENGTH)
+			pos = DgmOctree::MAX_OCTREE_LENGTH;
+
+		code |= (SpreadBits(static_cast<quint64>(pos)) << dim);
+	}
+	return code;
+}
+
+OutOfCoreCloud::OutOfCoreCloud(size_t maxResidentSize/*=DEFAULT_MAX_RESIDENT_SIZE*/)
+	: m_importCount(0)
+	, m_pointCount(0)
+	, m_bbMin(0,0,0)
+	, m_bbMax(0,0,0)
+	, m_sorted(false)
+	, m_scalarFieldEnabled(false)
+	, m_maxResidentSize(std::max(maxResidentSize, c_pageSize))
+	, m_useCounter(0)
+	, m_epoch(1)
+	, m_ioError(false)
+	, m_globalIterator(0)
+	, m_iteratorPoint(0,0,0)
+{
+}
+
+OutOfCoreCloud::~OutOfCoreCloud()
+{
+	close();
+}
+
+void OutOfCoreCloud::clear()
+{
+	for (size_t i=0; i<m_loadedPages.size(); ++i)
+	{
+		Page& page = m_pages[m_loadedPages[i]];
+		delete[] page.points;
+		delete[] page.values;
+	}
+	m_loadedPages.clear();
+	m_pages.clear();
+
+	std::vector<CCVector3>().swap(m_importBuffer);
+	m_importCount = 0;
+
+	m_pointCount = 0;
+	m_bbMin = m_bbMax = CCVector3(0,0,0);
+	m_sorted = false;
+	m_scalarFieldEnabled = false;
+	m_useCounter = 0;
+	m_epoch = 1;
+	m_ioError = false;
+	m_globalIterator = 0;
+}
+
+bool OutOfCoreCloud::create(const char* filename)
+{
+	close();
+
+	m_file.setFileName(filename);
+	if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+		return false;
+
+	m_importFile.setFileName(QString(filename) + ".import");
+	if (!m_importFile.open(QIODevice::ReadWrite | QIODevice::Truncate))
+	{
+		m_file.close();
+		return false;
+	}
+
+	try
+	{
+		m_importBuffer.reserve(POINTS_PER_PAGE);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		close();
+		return false;
+	}
+
+	return writeHeader();
+}
+
+bool OutOfCoreCloud::addPoint(const CCVector3& P)
+{
+	if (!m_importFile.isOpen() || m_importCount == static_cast<unsigned>(-1))
+		return false;
+
+	if (m_importCount)
+	{
+		for (int dim=0; dim<3; ++dim)
+		{
+			if (P.u[dim] < m_bbMin.u[dim])
+				m_bbMin.u[dim] = P.u[dim];
+			else if (P.u[dim] > m_bbMax.u[dim])
+				m_bbMax.u[dim] = P.u[dim];
+		}
+	}
+	else
+	{
+		m_bbMin = m_bbMax = P;
+	}
+
+	m_importBuffer.push_back(P);
+	++m_importCount;
+
+	if (m_importBuffer.size() == POINTS_PER_PAGE)
+		return flushImportBuffer();
+
+	return true;
+}
+
+bool OutOfCoreCloud::flushImportBuffer()
+{
+	if (m_importBuffer.empty())
+		return true;
+
+	qint64 byteCount = static_cast<qint64>(m_importBuffer.size() * sizeof(CCVector3));
+	bool success = (m_importFile.write(reinterpret_cast<const char*>(&m_importBuffer[0]), byteCount) == byteCount);
+	m_importBuffer.clear();
+
+	return success;
+}
+
+bool OutOfCoreCloud::sortPoints(GenericProgressCallback* progressCb/*=0*/)
+{
+	if (!m_importFile.isOpen() || !flushImportBuffer())
+		return false;
+
+	const unsigned pointCount = m_importCount;
+	const unsigned pageCount = (pointCount + POINTS_PER_PAGE - 1) / POINTS_PER_PAGE;
+
+	//octree bounding-box and cell size (see DgmOctree::updateMinAndMaxTables and DgmOctree::updateCellSizeTable)
+	CCVector3 dimMin = m_bbMin;
+	CCVector3 dimMax = m_bbMax;
+	CCMiscTools::MakeMinAndMaxCubical(dimMin,dimMax);
+	PointCoordinateType cellSize = dimMax.x - dimMin.x;
+	for (int k=1; k<=DgmOctree::MAX_OCTREE_LEVEL; ++k)
+		cellSize /= 2;
+
+	//points are first dispatched in groups of contiguous cells (at this level)
+	const int dispatchLevel = std::min(7, DgmOctree::MAX_OCTREE_LEVEL);
+	const int dispatchShift = 3 * (DgmOctree::MAX_OCTREE_LEVEL - dispatchLevel);
+
+	//the sort buffer and the cache share the memory
+	const size_t maxResidentSize = m_maxResidentSize;
+	const unsigned maxGroupSize = static_cast<unsigned>(std::min<size_t>(std::max<size_t>(maxResidentSize / (2 * sizeof(PointAndCode)), POINTS_PER_PAGE), static_cast<unsigned>(-1)));
+
+	std::vector<unsigned> cellGroups;
+	std::vector<unsigned> groupPos;
+	std::vector<CCVector3> buffer;
+	try
+	{
+		m_pages.resize(pageCount);
+		cellGroups.resize(static_cast<size_t>(1) << (3*dispatchLevel), 0);
+		buffer.resize(POINTS_PER_PAGE);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		m_pages.clear();
+		return false;
+	}
+	m_pointCount = pointCount;
+	m_sorted = false;
+
+	if (progressCb)
+	{
+		progressCb->reset();
+		progressCb->setMethodTitle("Sort points");
+		char infosBuffer[256];
+		sprintf(infosBuffer,"Points: %u\nPages: %u",pointCount,pageCount);
+		progressCb->setInfo(infosBuffer);
+		progressCb->start();
+	}
+	NormalizedProgress nprogress(progressCb,3*pageCount);
+
+	bool success = true;
+
+	//first pass: number of points per cell
+	m_importFile.seek(0);
+	for (unsigned p=0; p<pageCount && success; ++p)
+	{
+		unsigned count = getPagePointCount(p);
+		qint64 byteCount = static_cast<qint64>(count * sizeof(CCVector3));
+		success = (m_importFile.read(reinterpret_cast<char*>(&buffer[0]), byteCount) == byteCount);
+
+		for (unsigned i=0; i<count && success; ++i)
+			++cellGroups[ComputeCellCode(buffer[i],dimMin,cellSize) >> dispatchShift];
+
+		if (success && !nprogress.oneStep())
+			success = false;
+	}
+
+	//groups of contiguous cells (each group should fit in the sort buffer)
+	if (success)
+	{
+		groupPos.push_back(0);
+		unsigned groupSize = 0;
+		for (size_t c=0; c<cellGroups.size(); ++c)
+		{
+			unsigned cellPopulation = cellGroups[c];
+			if (groupSize != 0 && groupSize + cellPopulation > maxGroupSize)
+			{
+				groupPos.push_back(groupPos.back() + groupSize);
+				groupSize = 0;
+			}
+			groupSize += cellPopulation;
+			cellGroups[c] = static_cast<unsigned>(groupPos.size()-1);
+		}
+	}
+	const size_t groupCount = groupPos.size();
+	//groupPos[g] is the current writing position of group g
+	std::vector<unsigned> groupStart(groupPos);
+	groupStart.push_back(pointCount);
+
+	//second pass: points are dispatched in their group (with a small buffer per group)
+	//and directly written in the file (the scalar values are implicitly set to 0)
+	std::vector< std::vector<CCVector3> > groupBuffers;
+	const unsigned groupBufferSize = std::max(1024u, static_cast<unsigned>(std::min<size_t>(maxResidentSize / (2 * sizeof(CCVector3) * std::max<size_t>(groupCount,1)), POINTS_PER_PAGE)));
+	try
+	{
+		groupBuffers.resize(groupCount);
+		for (size_t g=0; g<groupCount; ++g)
+			groupBuffers[g].reserve(groupBufferSize);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		success = false;
+	}
+
+	m_importFile.seek(0);
+	for (unsigned p=0; p<pageCount && success; ++p)
+	{
+		unsigned count = getPagePointCount(p);
+		qint64 byteCount = static_cast<qint64>(count * sizeof(CCVector3));
+		success = (m_importFile.read(reinterpret_cast<char*>(&buffer[0]), byteCount) == byteCount);
+
+		for (unsigned i=0; i<count && success; ++i)
+		{
+			unsigned g = cellGroups[ComputeCellCode(buffer[i],dimMin,cellSize) >> dispatchShift];
+			std::vector<CCVector3>& groupBuffer = groupBuffers[g];
+			groupBuffer.push_back(buffer[i]);
+			if (groupBuffer.size() == groupBufferSize)
+			{
+				success = WritePoints(m_file, groupPos[g], &groupBuffer[0], groupBufferSize);
+				groupPos[g] += groupBufferSize;
+				groupBuffer.clear();
+			}
+		}
+
+		if (success && !nprogress.oneStep())
+			success = false;
+	}
+
+	for (size_t g=0; g<groupCount && success; ++g)
+	{
+		if (!groupBuffers[g].empty())
+			success = WritePoints(m_file, groupPos[g], &groupBuffers[g][0], static_cast<unsigned>(groupBuffers[g].size()));
+	}
+	std::vector< std::vector<CCVector3> >().swap(groupBuffers);
+
+	//we don't need the import file anymore
+	m_importFile.close();
+	m_importFile.remove();
+	std::vector<CCVector3>().swap(m_importBuffer);
+	m_importCount = 0;
+	std::vector<unsigned>().swap(cellGroups);
+	std::vector<CCVector3>().swap(buffer);
+
+	//third pass: each group is sorted in memory
+	m_maxResidentSize = std::max(maxResidentSize/2, c_pageSize);
+	{
+		std::vector<PointAndCode> sortBuffer;
+		for (size_t g=0; g<groupCount && success; ++g)
+		{
+			unsigned first = groupStart[g];
+			unsigned count = groupStart[g+1] - first;
+			if (count == 0)
+				continue;
+
+			try
+			{
+				sortBuffer.resize(count);
+			}
+			catch (.../*const std::bad_alloc&*/) //out of memory
+			{
+				success = false;
+				break;
+			}
+
+			QMutexLocker locker(&m_cacheMutex);
+			for (unsigned i=0; i<count && success; ++i)
+			{
+				unsigned pos = first + i;
+				const Page* page = usePage(pos / POINTS_PER_PAGE, false);
+				if (page)
+				{
+					sortBuffer[i].P = page->points[pos % POINTS_PER_PAGE];
+					sortBuffer[i].code = ComputeCellCode(sortBuffer[i].P,dimMin,cellSize);
+				}
+				else
+				{
+					success = false;
+				}
+			}
+
+			std::sort(sortBuffer.begin(),sortBuffer.begin()+count,PointAndCode::codeComp);
+
+			for (unsigned i=0; i<count && success; ++i)
+			{
+				unsigned pos = first + i;
+				Page* page = usePage(pos / POINTS_PER_PAGE, false);
+				if (page)
+				{
+					page->points[pos % POINTS_PER_PAGE] = sortBuffer[i].P;
+					page->modified = true;
+				}
+				else
+				{
+					success = false;
+				}
+			}
+			locker.unlock();
+
+			if (success && !nprogress.steps((count + POINTS_PER_PAGE - 1) / POINTS_PER_PAGE))
+				success = false;
+		}
+	}
+	m_maxResidentSize = maxResidentSize;
+
+	if (success)
+	{
+		m_sorted = true;
+		success = unloadAllPages() && writeHeader();
+	}
+	else
+	{
+		//the cloud is not usable
+		close();
+	}
+
+	if (progressCb)
+		progressCb->stop();
+
+	return success;
+}
+
+bool OutOfCoreCloud::open(const char* filename)
+{
+	close();
+
+	m_file.setFileName(filename);
+	if (!m_file.open(QIODevice::ReadWrite))
+		return false;
+
+	char signature[4];
+	quint32 values[6]; //version, coordinate size, scalar size, points per page, point count, flags
+	bool success =		m_file.read(signature,4) == 4
+					&&	memcmp(signature,c_fileSignature,4) == 0
+					&&	m_file.read(reinterpret_cast<char*>(values),sizeof(quint32)*6) == static_cast<qint64>(sizeof(quint32)*6)
+					&&	values[0] == c_fileVersion
+					&&	values[1] == sizeof(PointCoordinateType)
+					&&	values[2] == sizeof(ScalarType)
+					&&	values[3] == POINTS_PER_PAGE
+					&&	m_file.read(reinterpret_cast<char*>(m_bbMin.u),sizeof(CCVector3)) == static_cast<qint64>(sizeof(CCVector3))
+					&&	m_file.read(reinterpret_cast<char*>(m_bbMax.u),sizeof(CCVector3)) == static_cast<qint64>(sizeof(CCVector3));
+
+	if (success)
+	{
+		m_pointCount = values[4];
+		m_sorted = ((values[5] & OOC_SORTED) != 0);
+		m_scalarFieldEnabled = ((values[5] & OOC_SCALAR_FIELD) != 0);
+		try
+		{
+			m_pages.resize((m_pointCount + POINTS_PER_PAGE - 1) / POINTS_PER_PAGE);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			success = false;
+		}
+	}
+
+	if (!success)
+	{
+		m_file.close();
+		clear();
+	}
+
+	return success;
+}
+
+bool OutOfCoreCloud::close()
+{
+	bool success = true;
+
+	if (m_importFile.isOpen())
+	{
+		//unfinished import
+		m_importFile.close();
+		m_importFile.remove();
+	}
+
+	if (m_file.isOpen())
+	{
+		success = unloadAllPages() && writeHeader();
+		m_file.close();
+	}
+
+	clear();
+
+	return success;
+}
+
+bool OutOfCoreCloud::writeHeader()
+{
+	quint32 values[6] = {	c_fileVersion,
+							sizeof(PointCoordinateType),
+							sizeof(ScalarType),
+							POINTS_PER_PAGE,
+							m_pointCount,
+							static_cast<quint32>((m_sorted ? OOC_SORTED : 0) | (m_scalarFieldEnabled ? OOC_SCALAR_FIELD : 0)) };
+
+	char header[c_headerSize];
+	memset(header,0,c_headerSize);
+	char* ptr = header;
+	memcpy(ptr,c_fileSignature,4);
+	ptr += 4;
+	memcpy(ptr,values,sizeof(quint32)*6);
+	ptr += sizeof(quint32)*6;
+	memcpy(ptr,m_bbMin.u,sizeof(CCVector3));
+	ptr += sizeof(CCVector3);
+	memcpy(ptr,m_bbMax.u,sizeof(CCVector3));
+	assert(ptr + sizeof(CCVector3) <= header + c_headerSize);
+
+	return m_file.seek(0) && m_file.write(header,c_headerSize) == c_headerSize;
+}
+
+OutOfCoreCloud::Page* OutOfCoreCloud::usePage(unsigned pageIndex, bool pin) const
+{
+	assert(pageIndex < m_pages.size());
+	Page& page = m_pages[pageIndex];
+
+	page.lastUse = ++m_useCounter;
+
+	if (!page.points)
+	{
+		if (!loadPage(pageIndex))
+			return 0;
+	}
+
+	//warning: must be set once the page is loaded (see getPointPersistentPtr)
+	if (pin)
+		StoreEpoch(page.epoch, m_epoch);
+
+	return &page;
+}
+
+bool OutOfCoreCloud::loadPage(unsigned pageIndex) const
+{
+	Page& page = m_pages[pageIndex];
+	assert(!page.points);
+
+	if (!makeRoomForOnePage())
+		return false;
+
+	try
+	{
+		page.points = new CCVector3[POINTS_PER_PAGE];
+		page.values = new ScalarType[POINTS_PER_PAGE];
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		delete[] page.points;
+		page.points = 0;
+		return false;
+	}
+	page.modified = false;
+
+	//the page may not have been written yet (new cloud): the missing data is set to 0
+	unsigned count = getPagePointCount(pageIndex);
+	qint64 offset = GetPageOffset(pageIndex);
+	qint64 readBytes = (m_file.seek(offset) ? m_file.read(reinterpret_cast<char*>(page.points), static_cast<qint64>(count * sizeof(CCVector3))) : 0);
+	if (readBytes < static_cast<qint64>(count * sizeof(CCVector3)))
+		memset(reinterpret_cast<char*>(page.points) + std::max<qint64>(readBytes,0), 0, count * sizeof(CCVector3) - static_cast<size_t>(std::max<qint64>(readBytes,0)));
+
+	offset += static_cast<qint64>(POINTS_PER_PAGE * sizeof(CCVector3));
+	readBytes = (m_file.seek(offset) ? m_file.read(reinterpret_cast<char*>(page.values), static_cast<qint64>(count * sizeof(ScalarType))) : 0);
+	if (readBytes < static_cast<qint64>(count * sizeof(ScalarType)))
+		memset(reinterpret_cast<char*>(page.values) + std::max<qint64>(readBytes,0), 0, count * sizeof(ScalarType) - static_cast<size_t>(std::max<qint64>(readBytes,0)));
+
+	m_loadedPages.push_back(pageIndex);
+
+	return true;
+}
+
+bool OutOfCoreCloud::makeRoomForOnePage() const
+{
+	while ((m_loadedPages.size() + 1) * c_pageSize > m_maxResidentSize)
+	{
+		//least recently used page (except the pinned ones)
+		size_t lruPos = m_loadedPages.size();
+		for (size_t i=0; i<m_loadedPages.size(); ++i)
+		{
+			const Page& page = m_pages[m_loadedPages[i]];
+			if (LoadEpoch(page.epoch) != m_epoch && (lruPos == m_loadedPages.size() || page.lastUse < m_pages[m_loadedPages[lruPos]].lastUse))
+				lruPos = i;
+		}
+
+		//all the loaded pages are pinned (soft limit)
+		if (lruPos == m_loadedPages.size())
+			break;
+
+		unsigned pageIndex = m_loadedPages[lruPos];
+		if (!writePage(pageIndex))
+			return false;
+
+		Page& page = m_pages[pageIndex];
+		delete[] page.points;
+		delete[] page.values;
+		page.points = 0;
+		page.values = 0;
+		StoreEpoch(page.epoch, 0);
+
+		m_loadedPages[lruPos] = m_loadedPages.back();
+		m_loadedPages.pop_back();
+	}
+
+	return true;
+}
+
+bool OutOfCoreCloud::writePage(unsigned pageIndex) const
+{
+	Page& page = m_pages[pageIndex];
+	if (!page.modified)
+		return true;
+
+	unsigned count = getPagePointCount(pageIndex);
+	qint64 offset = GetPageOffset(pageIndex);
+	qint64 pointsBytes = static_cast<qint64>(count * sizeof(CCVector3));
+	qint64 valuesBytes = static_cast<qint64>(count * sizeof(ScalarType));
+
+	if (	!m_file.seek(offset)
+		||	m_file.write(reinterpret_cast<const char*>(page.points), pointsBytes) != pointsBytes
+		||	!m_file.seek(offset + static_cast<qint64>(POINTS_PER_PAGE * sizeof(CCVector3)))
+		||	m_file.write(reinterpret_cast<const char*>(page.values), valuesBytes) != valuesBytes )
+	{
+		m_ioError = true;
+		return false;
+	}
+
+	page.modified = false;
+	return true;
+}
+
+bool OutOfCoreCloud::unloadAllPages()
+{
+	QMutexLocker locker(&m_cacheMutex);
+
+	bool success = !m_ioError;
+	for (size_t i=0; i<m_loadedPages.size(); ++i)
+	{
+		unsigned pageIndex = m_loadedPages[i];
+		if (!writePage(pageIndex))
+			success = false;
+
+		Page& page = m_pages[pageIndex];
+		delete[] page.points;
+		delete[] page.values;
+		page.points = 0;
+		page.values = 0;
+		StoreEpoch(page.epoch, 0);
+	}
+	m_loadedPages.clear();
+
+	return success;
+}
+
+size_t OutOfCoreCloud::getResidentSize() const
+{
+	QMutexLocker locker(&m_cacheMutex);
+	return m_loadedPages.size() * c_pageSize;
+}
+
+unsigned OutOfCoreCloud::getWorkingSetSize() const
+{
+	size_t pageCount = std::max<size_t>(m_maxResidentSize / c_pageSize, 1);
+	return static_cast<unsigned>(std::min<size_t>(pageCount * POINTS_PER_PAGE, static_cast<unsigned>(-1)));
+}
+
+void OutOfCoreCloud::releasePointsPointers()
+{
+	QMutexLocker locker(&m_cacheMutex);
+	++m_epoch;
+	if (m_epoch == 0) //0 is the epoch of the pages that have never been pinned
+		m_epoch = 1;
+}
+
+const CCVector3* OutOfCoreCloud::getPointPersistentPtr(unsigned index)
+{
+	assert(index < m_pointCount);
+
+	//fast path (without lock): the page has already been pinned during the current epoch,
+	//so it can't be unloaded before the next call to releasePointsPointers
+	const Page& pinnedPage = m_pages[index / POINTS_PER_PAGE];
+	if (LoadEpoch(pinnedPage.epoch) == m_epoch)
+		return pinnedPage.points + (index % POINTS_PER_PAGE);
+
+	QMutexLocker locker(&m_cacheMutex);
+	const Page* page = usePage(index / POINTS_PER_PAGE, true);
+
+	return (page ? page->points + (index % POINTS_PER_PAGE) : 0);
+}
+
+void OutOfCoreCloud::getPoint(unsigned index, CCVector3& P) const
+{
+	assert(index < m_pointCount);
+
+	//fast path (see getPointPersistentPtr)
+	const Page& pinnedPage = m_pages[index / POINTS_PER_PAGE];
+	if (LoadEpoch(pinnedPage.epoch) == m_epoch)
+	{
+		P = pinnedPage.points[index % POINTS_PER_PAGE];
+		return;
+	}
+
+	QMutexLocker locker(&m_cacheMutex);
+	const Page* page = usePage(index / POINTS_PER_PAGE, false);
+
+	P = (page ? page->points[index % POINTS_PER_PAGE] : CCVector3(0,0,0));
+}
+
+void OutOfCoreCloud::setPointScalarValue(unsigned pointIndex, ScalarType value)
+{
+	assert(pointIndex < m_pointCount);
+
+	//fast path (see getPointPersistentPtr)
+	Page& pinnedPage = m_pages[pointIndex / POINTS_PER_PAGE];
+	if (LoadEpoch(pinnedPage.epoch) == m_epoch)
+	{
+		pinnedPage.values[pointIndex % POINTS_PER_PAGE] = value;
+		pinnedPage.modified = true;
+		return;
+	}
+
+	QMutexLocker locker(&m_cacheMutex);
+	Page* page = usePage(pointIndex / POINTS_PER_PAGE, false);
+	if (page)
+	{
+		page->values[pointIndex % POINTS_PER_PAGE] = value;
+		page->modified = true;
+	}
+}
+
+ScalarType OutOfCoreCloud::getPointScalarValue(unsigned pointIndex) const
+{
+	assert(pointIndex < m_pointCount);
+
+	//fast path (see getPointPersistentPtr)
+	const Page& pinnedPage = m_pages[pointIndex / POINTS_PER_PAGE];
+	if (LoadEpoch(pinnedPage.epoch) == m_epoch)
+		return pinnedPage.values[pointIndex % POINTS_PER_PAGE];
+
+	QMutexLocker locker(&m_cacheMutex);
+	const Page* page = usePage(pointIndex / POINTS_PER_PAGE, false);
+
+	return (page ? page->values[pointIndex % POINTS_PER_PAGE] : 0);
+}
+
+bool OutOfCoreCloud::enableScalarField()
+{
+	//scalar values are always stored with the points
+	m_scalarFieldEnabled = true;
+	return m_file.isOpen();
+}
+
+void OutOfCoreCloud::forEach(genericPointAction& anAction)
+{
+	//the action is applied to a copy of each page (so that the cache can be used in the meantime)
+	std::vector<CCVector3> points;
+	std::vector<ScalarType> values;
+	try
+	{
+		points.resize(POINTS_PER_PAGE);
+		values.resize(POINTS_PER_PAGE);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return;
+	}
+
+	const unsigned pageCount = static_cast<unsigned>(m_pages.size());
+	for (unsigned p=0; p<pageCount; ++p)
+	{
+		unsigned count = getPagePointCount(p);
+		{
+			QMutexLocker locker(&m_cacheMutex);
+			const Page* page = usePage(p, false);
+			if (!page)
+				return;
+			std::copy(page->points, page->points + count, points.begin());
+			memcpy(&values[0], page->values, count * sizeof(ScalarType));
+		}
+
+		bool modified = false;
+		for (unsigned i=0; i<count; ++i)
+		{
+			//the scalar value can be modified by the action
+			ScalarType value = values[i];
+			anAction(points[i],values[i]);
+			if (memcmp(&value,&values[i],sizeof(ScalarType)) != 0)
+				modified = true;
+		}
+
+		if (modified)
+		{
+			QMutexLocker locker(&m_cacheMutex);
+			Page* page = usePage(p, false);
+			if (!page)
+				return;
+			memcpy(page->values, &values[0], count * sizeof(ScalarType));
+			page->modified = true;
+		}
+	}
+}
+
+void OutOfCoreCloud::getBoundingBox(PointCoordinateType bbMin[], PointCoordinateType bbMax[])
+{
+	memcpy(bbMin, m_bbMin.u, sizeof(PointCoordinateType)*3);
+	memcpy(bbMax, m_bbMax.u, sizeof(PointCoordinateType)*3);
+}
+
+void OutOfCoreCloud::placeIteratorAtBegining()
+{
+	m_globalIterator = 0;
+}
+
+const CCVector3* OutOfCoreCloud::getNextPoint()
+{
+	if (m_globalIterator >= m_pointCount)
+		return 0;
+
+	//the returned point is a copy (valid until the next call)
+	getPoint(m_globalIterator++, m_iteratorPoint);
+	return &m_iteratorPoint;
+}
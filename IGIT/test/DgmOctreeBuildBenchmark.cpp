@@ -0,0 +1,222 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//! Times DgmOctree::build on large clouds and checks its result
+/** Usage: DgmOctreeBuildBenchmark [-nocheck] [point counts in millions...]
+	For each point count (10 and 100 millions by default), a random cloud is
+	generated (with ~20% of duplicated points, i.e. equal cell codes) and its
+	octree is built in standard then in compact mode (see DgmOctree::
+	SetCompactStorageByDefault). Both results are compared to a reference
+	structure obtained the 'classic' way (sequential projection + comparison
+	sort by code then index), which is timed too. Returns 0 if all octrees
+	match their reference. Sizes that don't fit in memory are skipped.
+	Build: DgmOctreeBuildBenchmark.vcxproj (or, with gcc, compile this file with
+	all the CCLib sources of ../src and ../triangle/triangle.cpp:
+	g++ -O2 -DNDEBUG -DTRILIBRARY -DNO_TIMER -I../include -I../triangle
+	-I$QTDIR/include -I$QTDIR/include/QtCore -I$QTDIR/include/QtGui
+	[sources] -lQtCore -lQtGui)
+**/
+
+#include "DgmOctree.h"
+#include "SimpleCloud.h"
+
+//Qt
+#include <QElapsedTimer>
+
+//system
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+using namespace CCLib;
+
+//! Deterministic pseudo-random generator (same sequence on all platforms)
+static unsigned s_randomSeed = 1;
+static unsigned RandomInt()
+{
+	s_randomSeed = s_randomSeed * 1103515245 + 12345;
+	return (s_randomSeed >> 8);
+}
+static PointCoordinateType RandomCoord(PointCoordinateType maxValue)
+{
+	return static_cast<PointCoordinateType>(RandomInt() & 0xFFFFF) * maxValue / static_cast<PointCoordinateType>(0xFFFFF);
+}
+
+//! Generates a random cloud (~20% of the points are duplicates of previous ones)
+static bool GenerateCloud(SimpleCloud& cloud, unsigned count)
+{
+	if (!cloud.reserve(count))
+		return false;
+
+	s_randomSeed = 42;
+	for (unsigned i=0; i<count; ++i)
+	{
+		if (i > 10 && (RandomInt() % 5) == 0)
+		{
+			CCVector3 P;
+			cloud.getPoint(RandomInt() % i,P);
+			cloud.addPoint(P);
+		}
+		else
+		{
+			cloud.addPoint(CCVector3(RandomCoord(100),RandomCoord(50),RandomCoord(25)));
+		}
+	}
+
+	return true;
+}
+
+//! Builds the reference structure (sequential projection + comparison sort)
+static void BuildReference(const DgmOctree& octree, SimpleCloud& cloud, DgmOctree::cellsContainer& reference)
+{
+	unsigned count = cloud.size();
+	reference.resize(count);
+	for (unsigned i=0; i<count; ++i)
+	{
+		int pos[3];
+		octree.getTheCellPosWhichIncludesThePoint(cloud.getPoint(i),pos);
+		for (int d=0; d<3; ++d)
+		{
+			if (pos[d] < 0)
+				pos[d] = 0;
+			else if (pos[d] > DgmOctree::MAX_OCTREE_LENGTH)
+				pos[d] = DgmOctree::MAX_OCTREE_LENGTH;
+		}
+		reference[i].theIndex = i;
+		reference[i].theCode = octree.generateTruncatedCellCode(pos,DgmOctree::MAX_OCTREE_LEVEL);
+	}
+
+	std::sort(reference.begin(),reference.end(),DgmOctree::IndexAndCode::codeAndIndexComp);
+}
+
+//! Compares an octree structure with the reference one
+static bool SameStructure(const DgmOctree::pointsAndCodesContainer& codes, const DgmOctree::cellsContainer& reference)
+{
+	if (codes.size() != reference.size())
+		return false;
+
+	for (unsigned i=0; i<codes.size(); ++i)
+		if (codes.getIndex(i) != reference[i].theIndex || codes.getCode(i) != reference[i].theCode)
+			return false;
+
+	return true;
+}
+
+//! Builds the octree of a cloud and returns the elapsed time (in seconds) or -1 on error
+static double TimeBuild(DgmOctree& octree)
+{
+	QElapsedTimer timer;
+	timer.start();
+	if (octree.build() <= 0)
+		return -1.0;
+	return static_cast<double>(timer.nsecsElapsed()) / 1.0e9;
+}
+
+//! Runs the benchmark for a given number of points
+/** \return false if the octrees don't match the reference (true if they match or if the test is skipped)
+**/
+static bool RunBenchmark(unsigned count, bool check)
+{
+	printf("[%u points]\n",count);
+
+	SimpleCloud cloud;
+	try
+	{
+		if (!GenerateCloud(cloud,count))
+		{
+			printf("\tskipped: not enough memory to generate the cloud\n");
+			return true;
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		printf("\tskipped: not enough memory to generate the cloud\n");
+		return true;
+	}
+
+	bool ok = true;
+	try
+	{
+		DgmOctree::cellsContainer reference;
+		for (int compact=0; compact<2 && ok; ++compact)
+		{
+			DgmOctree::SetCompactStorageByDefault(compact != 0);
+			DgmOctree octree(&cloud);
+			double buildTime = TimeBuild(octree);
+			if (buildTime < 0)
+			{
+				printf("\t%s build: failed\n",compact ? "compact" : "standard");
+				ok = false;
+				break;
+			}
+			printf("\t%s build: %.3f s\n",compact ? "compact" : "standard",buildTime);
+
+			if (!check)
+				continue;
+
+			if (reference.empty())
+			{
+				QElapsedTimer timer;
+				timer.start();
+				BuildReference(octree,cloud,reference);
+				printf("\treference (sequential projection + std::sort): %.3f s\n",static_cast<double>(timer.nsecsElapsed()) / 1.0e9);
+			}
+
+			if (!SameStructure(octree.pointsAndTheirCellCodes(),reference))
+			{
+				printf("\t%s build: structure differs from the reference!\n",compact ? "compact" : "standard");
+				ok = false;
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		printf("\tskipped: not enough memory\n");
+	}
+	DgmOctree::SetCompactStorageByDefault(false);
+
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	bool check = true;
+	std::vector<unsigned> counts;
+	for (int i=1; i<argc; ++i)
+	{
+		if (strcmp(argv[i],"-nocheck") == 0)
+			check = false;
+		else if (atoi(argv[i]) > 0)
+			counts.push_back(static_cast<unsigned>(atoi(argv[i])) * 1000000);
+	}
+	if (counts.empty())
+	{
+		counts.push_back(10000000);
+		counts.push_back(100000000);
+	}
+
+	bool ok = true;
+	for (size_t i=0; i<counts.size(); ++i)
+		if (!RunBenchmark(counts[i],check))
+			ok = false;
+
+	printf(ok ? "all octrees match their reference\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
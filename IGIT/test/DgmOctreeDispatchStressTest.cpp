@@ -0,0 +1,221 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//! Stress test of the concurrent multi-threaded octree cell dispatch
+/** Usage: DgmOctreeDispatchStressTest [rounds]
+	Several octrees are processed at the same time (one thread each) with
+	DgmOctree::executeFunctionForAllCellsAtLevel_MT and executeFunctionForAll
+	CellsAtStartingLevel_MT, one of the cell functions starting a nested
+	multi-threaded dispatch on another octree. At each round (20 by default),
+	every point of every cloud must have been seen exactly once by the cell
+	function of its own job. Returns 0 if all rounds succeed.
+	Build: DgmOctreeDispatchStressTest.vcxproj (or, with gcc, compile this file
+	with all the CCLib sources of ../src and ../triangle/triangle.cpp:
+	g++ -O2 -DNDEBUG -DTRILIBRARY -DNO_TIMER -I../include -I../triangle
+	-I$QTDIR/include -I$QTDIR/include/QtCore -I$QTDIR/include/QtGui
+	[sources] -lQtCore -lQtGui)
+**/
+
+#include "DgmOctree.h"
+#include "ReferenceCloud.h"
+#include "SimpleCloud.h"
+
+//Qt
+#include <QAtomicInt>
+#include <QThread>
+
+//system
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CCLib;
+
+//! Number of octrees processed concurrently
+static const int c_jobCount = 6;
+
+//! Octree processing job
+struct DispatchJob
+{
+	//! Cloud
+	SimpleCloud cloud;
+	//! Cloud octree
+	DgmOctree* octree;
+	//! Number of points seen by the cell function
+	QAtomicInt points;
+	//! Number of cells seen by the cell function
+	QAtomicInt cells;
+
+	DispatchJob() : octree(0), points(0), cells(0) {}
+	~DispatchJob() { delete octree; }
+
+	//! Resets the counters
+	void reset()
+	{
+		points.fetchAndStoreOrdered(0);
+		cells.fetchAndStoreOrdered(0);
+	}
+	//! Returns the number of points seen by the cell function
+	unsigned pointCount()
+	{
+		return static_cast<unsigned>(points.fetchAndAddOrdered(0));
+	}
+};
+
+//! Cell function: counts the points of a cell
+/** Additional parameters: (DispatchJob*) job
+**/
+static bool CountPoints(const DgmOctree::octreeCell& cell, void** additionalParameters, NormalizedProgress* nProgress)
+{
+	DispatchJob* job = static_cast<DispatchJob*>(additionalParameters[0]);
+
+	//a cell of another octree means that the dispatcher mixed up two calls
+	if (cell.parentOctree != job->octree)
+		return false;
+
+	job->points.fetchAndAddOrdered(static_cast<int>(cell.points->size()));
+	job->cells.fetchAndAddOrdered(1);
+
+	return true;
+}
+
+//! Cell function: counts the points of a cell and starts a nested dispatch for the first one
+/** Additional parameters: (DispatchJob*) job, (DispatchJob*) nested job
+**/
+static bool CountPointsWithNestedCall(const DgmOctree::octreeCell& cell, void** additionalParameters, NormalizedProgress* nProgress)
+{
+	if (!CountPoints(cell,additionalParameters,nProgress))
+		return false;
+
+	if (cell.index == 0)
+	{
+		DispatchJob* nestedJob = static_cast<DispatchJob*>(additionalParameters[1]);
+		void* nestedParameters[1] = { nestedJob };
+		if (nestedJob->octree->executeFunctionForAllCellsAtLevel_MT(4,CountPoints,nestedParameters) == 0)
+			return false;
+	}
+
+	return true;
+}
+
+//! Thread processing one job
+class DispatchThread : public QThread
+{
+public:
+
+	DispatchThread(DispatchJob* job, DispatchJob* nestedJob, int mode)
+		: m_job(job)
+		, m_nestedJob(nestedJob)
+		, m_mode(mode)
+	{
+	}
+
+protected:
+
+	virtual void run()
+	{
+		void* additionalParameters[2] = { m_job, m_nestedJob };
+		switch (m_mode)
+		{
+		case 0:
+			m_job->octree->executeFunctionForAllCellsAtStartingLevel_MT(5,CountPoints,additionalParameters,50,500);
+			break;
+		case 1:
+			m_job->octree->executeFunctionForAllCellsAtLevel_MT(6,CountPoints,additionalParameters);
+			break;
+		default:
+			m_job->octree->executeFunctionForAllCellsAtLevel_MT(7,CountPointsWithNestedCall,additionalParameters);
+			break;
+		}
+	}
+
+	DispatchJob* m_job;
+	DispatchJob* m_nestedJob;
+	int m_mode;
+};
+
+int main(int argc, char* argv[])
+{
+	int rounds = (argc > 1 ? atoi(argv[1]) : 20);
+
+	//generate the clouds and their octrees
+	DispatchJob jobs[c_jobCount];
+	srand(1);
+	for (int j=0; j<c_jobCount; ++j)
+	{
+		unsigned count = 200000 + j*50000;
+		if (!jobs[j].cloud.reserve(count))
+		{
+			printf("not enough memory\n");
+			return 1;
+		}
+		for (unsigned i=0; i<count; ++i)
+		{
+			jobs[j].cloud.addPoint(CCVector3(	static_cast<PointCoordinateType>(rand() % 1000) / 10,
+												static_cast<PointCoordinateType>(rand() % 1000) / 10,
+												static_cast<PointCoordinateType>(rand() % 1000) / 10 ));
+		}
+		jobs[j].octree = new DgmOctree(&jobs[j].cloud);
+		if (jobs[j].octree->build() <= 0)
+		{
+			printf("failed to build octree #%i\n",j);
+			return 1;
+		}
+	}
+
+	bool ok = true;
+	for (int r=0; r<rounds && ok; ++r)
+	{
+		//the nested dispatch runs on the first octree (processed concurrently by its own job)
+		DispatchJob& nestedJob = jobs[0];
+		DispatchJob nestedCounter;
+		nestedCounter.octree = nestedJob.octree;
+
+		for (int j=0; j<c_jobCount; ++j)
+			jobs[j].reset();
+
+		DispatchThread* threads[c_jobCount];
+		for (int j=0; j<c_jobCount; ++j)
+		{
+			int mode = (j == 1 ? 2 : j % 2);
+			threads[j] = new DispatchThread(jobs+j,&nestedCounter,mode);
+			threads[j]->start();
+		}
+		for (int j=0; j<c_jobCount; ++j)
+		{
+			threads[j]->wait();
+			delete threads[j];
+		}
+
+		for (int j=0; j<c_jobCount; ++j)
+		{
+			if (jobs[j].pointCount() != jobs[j].cloud.size())
+			{
+				printf("round %i, job %i: %u points processed (%u expected)\n",r,j,jobs[j].pointCount(),jobs[j].cloud.size());
+				ok = false;
+			}
+		}
+		if (nestedCounter.pointCount() != nestedJob.cloud.size())
+		{
+			printf("round %i, nested job: %u points processed (%u expected)\n",r,nestedCounter.pointCount(),nestedJob.cloud.size());
+			ok = false;
+		}
+		nestedCounter.octree = 0; //not owned
+	}
+
+	printf(ok ? "all rounds succeeded\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -2,6 +2,8 @@
 
 //CCLib
 #include <CloudSamplingTools.h>
+#include <DistanceComputationTools.h>
+#include <OutOfCoreCloud.h>
 #include <WeibullDistribution.h>
 #include <NormalDistribution.h>
 #include <StatisticalTestingTools.h>
@@ -11,6 +13,7 @@
 #include <ccProgressDialog.h>
 #include <ccOctree.h>
 #include <ccPlane.h>
+#include <ccGenericPrimitive.h>
 #include <ccNormalVectors.h>
 #include <ccPolyline.h>
 #include <ccScalarField.h>
@@ -21,6 +24,7 @@
 #include <FBXFilter.h>
 #include <BinFilter.h>
 #include <PlyFilter.h>
+#include <PDMS/PDMSFilter.h>
 
 //qCC
 #include "ccCommon.h"
@@ -64,6 +68,7 @@ static const char COMMAND_BUNDLER_UNDISTORT[]				= "UNDISTORT";
 static const char COMMAND_BUNDLER_COLOR_DTM[]				= "COLOR_DTM";
 static const char COMMAND_C2M_DIST[]						= "C2M_DIST";
 static const char COMMAND_C2M_DIST_FLIP_NORMALS[]			= "FLIP_NORMS";
+static const char COMMAND_C2M_DIST_BVH[]					= "BVH";
 static const char COMMAND_C2C_DIST[]						= "C2C_DIST";
 static const char COMMAND_C2C_SPLIT_XYZ[]					= "SPLIT_XYZ";
 static const char COMMAND_C2C_LOCAL_MODEL[]					= "MODEL";
@@ -93,6 +98,12 @@ static const char COMMAND_ASCII_EXPORT_PRECISION[]			= "PREC";
 static const char COMMAND_ASCII_EXPORT_SEPARATOR[]			= "SEP";
 static const char COMMAND_PLY_EXPORT_FORMAT[]				= "PLY_EXPORT_FMT";
 static const char COMMAND_FBX_EXPORT_FORMAT[]				= "FBX_EXPORT_FMT";
+static const char COMMAND_PDMS_INSTANCING[]					= "PDMS_INSTANCING";
+static const char COMMAND_PDMS_MERGE_GROUPS[]				= "PDMS_MERGE_GROUPS";
+static const char COMMAND_LAZY_TESSELLATION[]				= "LAZY_TESSELLATION";
+static const char COMMAND_PDMS_CONVERT[]					= "PDMS_CONVERT";	//+ PDMS macro (or directory)
+static const char COMMAND_PDMS_CONVERT_BATCH_SIZE[]			= "BATCH_SIZE";		//+ max number of triangles per batch
+static const char COMMAND_PDMS_CONVERT_UPDATE_CACHE[]		= "UPDATE_CACHE";
 static const char COMMAND_MESH_EXPORT_FORMAT[]				= "M_EXPORT_FMT";
 static const char COMMAND_EXPORT_EXTENSION[]				= "EXT";
 static const char COMMAND_NO_TIMESTAMP[]					= "NO_TIMESTAMP";
@@ -112,6 +123,15 @@ static const char COMMAND_DELAUNAY_AA[]						= "AA";
 static const char COMMAND_DELAUNAY_BF[]						= "BEST_FIT";
 static const char COMMAND_DELAUNAY_MAX_EDGE_LENGTH[]		= "MAX_EDGE_LENGTH";
 static const char COMMAND_CROSS_SECTION[]					= "CROSS_SECTION";
+static const char COMMAND_OCTREE_REORDER[]					= "OCTREE_REORDER";
+static const char COMMAND_OCTREE_STATS[]					= "OCTREE_STATS";
+static const char COMMAND_MAX_THREADS[]						= "MAX_THREADS";	//+ max. number of threads (0 = all cores)
+static const char COMMAND_OOC_OPEN[]						= "OOC_OPEN";		//+ ASCII file name
+static const char COMMAND_OOC_MAX_MEMORY[]					= "MAX_MEMORY";		//+ max. memory used by the loaded points (in MB)
+static const char COMMAND_OOC_SUBSAMPLE[]					= "OOC_SS";			//+ method (SPATIAL/OCTREE) + parameter (resp. spatial step / octree level)
+static const char COMMAND_OOC_NORMALS[]						= "OOC_NORMALS";	//+ neighbourhood radius
+static const char COMMAND_OOC_C2C_DIST[]					= "OOC_C2C_DIST";
+static const char COMMAND_OOC_SAVE[]						= "OOC_SAVE";
 static const char COMMAND_LOG_FILE[]						= "LOG_FILE";
 
 static const char OPTION_ALL_AT_ONCE[]						= "ALL_AT_ONCE";
@@ -225,6 +245,7 @@ ccCommandLineParser::~ccCommandLineParser()
 {
 	removeClouds();
 	removeMeshes();
+	removeOutOfCoreCloud();
 }
 
 static void Print(const QString& message)
@@ -271,6 +292,44 @@ void ccCommandLineParser::removeMeshes()
 	}
 }
 
+void ccCommandLineParser::removeOutOfCoreCloud()
+{
+	if (m_oocCloud.cloud)
+	{
+		delete m_oocCloud.cloud; //closes the file
+		QFile::remove(m_oocCloud.filename);
+	}
+	if (m_oocCloud.normals)
+	{
+		m_oocCloud.normals->release();
+	}
+	m_oocCloud = OutOfCoreCloudDesc();
+}
+
+QString ccCommandLineParser::exportOutOfCoreCloud(ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[SAVING]");
+	assert(m_oocCloud.cloud);
+
+	//only the ASCII format can be written without loading the whole cloud
+	QString outputFilename = m_oocCloud.basename;
+	if (s_addTimestamp)
+		outputFilename += QString("_%1").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd_hh'h'mm_ss"));
+	outputFilename += QString(".asc");
+	if (!m_oocCloud.path.isEmpty())
+		outputFilename.prepend(QString("%1/").arg(m_oocCloud.path));
+
+	CC_FILE_ERROR result = AsciiFilter::SaveOutOfCoreCloud(outputFilename, *m_oocCloud.cloud, m_oocCloud.shift, m_oocCloud.normals, m_oocCloud.sfName, pDlg);
+	if (result != CC_FERR_NO_ERROR)
+	{
+		FileIOFilter::DisplayErrorMessage(result, "saving", outputFilename);
+		return QString("Failed to save out-of-core cloud in file '%1'").arg(outputFilename);
+	}
+
+	Print(QString("Out-of-core cloud saved to: %1").arg(outputFilename));
+	return QString();
+}
+
 bool ccCommandLineParser::saveClouds(QString suffix/*=QString()*/, bool allAtOnce/*=false*/)
 {
 	//all-at-once: all clouds in a single file
@@ -2133,6 +2192,371 @@ bool ccCommandLineParser::commandCrop2D(QStringList& arguments)
 	return true;
 }
 
+bool ccCommandLineParser::commandOctreeReorder(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[OCTREE REORDER]");
+	if (m_clouds.empty())
+		return Error(QString("No point cloud to reorder! (be sure to open one with \"-%1 [cloud filename]\" before \"-%2\")").arg(COMMAND_OPEN).arg(COMMAND_OCTREE_REORDER));
+
+	for (size_t i=0; i<m_clouds.size(); ++i)
+	{
+		ccPointCloud* cloud = m_clouds[i].pc;
+		if (!cloud->reorderInOctreeOrder(pDlg))
+			return Error(QString("Failed to reorder cloud '%1'!").arg(cloud->getName()));
+		Print(QString("\tCloud '%1': %2 points reordered").arg(cloud->getName()).arg(cloud->size()));
+	}
+
+	//save output
+	if (s_autoSaveMode && !saveClouds("REORDERED"))
+		return false;
+
+	return true;
+}
+
+bool ccCommandLineParser::commandOctreeStats(QStringList& arguments)
+{
+	if (arguments.empty())
+		return Error(QString("Missing parameter: option after '%1' (%2/%3)").arg(COMMAND_OCTREE_STATS).arg(OPTION_ON).arg(OPTION_OFF));
+
+	QString option = arguments.takeFirst().toUpper();
+	if (option == OPTION_ON)
+	{
+		Print("Octree search statistics are enabled");
+		ccOctree::EnableSearchStatisticsLog(true);
+	}
+	else if (option == OPTION_OFF)
+	{
+		Print("Octree search statistics are disabled");
+		ccOctree::EnableSearchStatisticsLog(false);
+	}
+	else
+	{
+		return Error(QString("Unrecognized option afer '%1' (%2 or %3 expected)").arg(COMMAND_OCTREE_STATS).arg(OPTION_ON).arg(OPTION_OFF));
+	}
+
+	return true;
+}
+
+bool ccCommandLineParser::commandMaxThreadCount(QStringList& arguments)
+{
+	if (arguments.empty())
+		return Error(QString("Missing parameter: number of threads after '%1'").arg(COMMAND_MAX_THREADS));
+
+	bool ok;
+	int count = arguments.takeFirst().toInt(&ok);
+	if (!ok || count < 0)
+		return Error(QString("Invalid number of threads after '%1'").arg(COMMAND_MAX_THREADS));
+
+	//overrides the persistent setting (for this session only)
+	CCLib::DgmOctree::SetMaxThreadCount(count);
+	if (count == 0)
+		Print("Octree-based processes will use all the cores");
+	else
+		Print(QString("Octree-based processes will use at most %1 thread(s)").arg(count));
+
+	return true;
+}
+
+bool ccCommandLineParser::commandOutOfCoreOpen(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[OUT-OF-CORE OPEN]");
+	if (arguments.empty())
+		return Error(QString("Missing parameter: ASCII filename after \"-%1\"").arg(COMMAND_OOC_OPEN));
+
+	QString filename = arguments.takeFirst();
+	size_t maxMemory = CCLib::OutOfCoreCloud::DEFAULT_MAX_RESIDENT_SIZE;
+	unsigned skipLines = 0;
+
+	//look for additional parameters
+	while (!arguments.empty())
+	{
+		QString argument = arguments.front();
+
+		if (IsCommand(argument,COMMAND_OOC_MAX_MEMORY))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: memory size (in MB) after '%1'").arg(COMMAND_OOC_MAX_MEMORY));
+
+			bool ok;
+			unsigned megaBytes = arguments.takeFirst().toUInt(&ok);
+			if (!ok || megaBytes == 0)
+				return Error(QString("Invalid memory size after '%1'").arg(COMMAND_OOC_MAX_MEMORY));
+			maxMemory = static_cast<size_t>(megaBytes) << 20;
+		}
+		else if (IsCommand(argument,COMMAND_OPEN_SKIP_LINES))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: number of lines after '%1'").arg(COMMAND_OPEN_SKIP_LINES));
+
+			bool ok;
+			skipLines = arguments.takeFirst().toUInt(&ok);
+			if (!ok)
+				return Error(QString("Invalid parameter: number of lines after '%1'").arg(COMMAND_OPEN_SKIP_LINES));
+		}
+		else
+		{
+			break; //as soon as we encounter an unrecognized argument, we break the local loop to go back on the main one!
+		}
+	}
+
+	//only one out-of-core cloud at a time
+	removeOutOfCoreCloud();
+
+	//the points are stored in a file next to the input one
+	QFileInfo fileInfo(filename);
+	QString cloudFilename = QString("%1/%2.ccoc").arg(fileInfo.absolutePath()).arg(fileInfo.completeBaseName());
+	Print(QString("\tImporting '%1' (max. memory: %2 MB, points file: '%3')").arg(fileInfo.fileName()).arg(maxMemory >> 20).arg(cloudFilename));
+
+	CCLib::OutOfCoreCloud* cloud = new CCLib::OutOfCoreCloud(maxMemory);
+	CCVector3d shift(0,0,0);
+	CC_FILE_ERROR result = AsciiFilter::LoadOutOfCoreCloud(filename, cloudFilename, *cloud, shift, s_loadParameters, skipLines, pDlg);
+	if (result != CC_FERR_NO_ERROR)
+	{
+		delete cloud;
+		FileIOFilter::DisplayErrorMessage(result, "loading", filename);
+		return Error(QString("Failed to import '%1'").arg(filename));
+	}
+
+	m_oocCloud.cloud = cloud;
+	m_oocCloud.filename = cloudFilename;
+	m_oocCloud.basename = fileInfo.baseName();
+	m_oocCloud.path = fileInfo.path();
+	m_oocCloud.shift = shift;
+	Print(QString("\tResult: %1 points").arg(cloud->size()));
+
+	return true;
+}
+
+bool ccCommandLineParser::commandOutOfCoreSubsample(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[OUT-OF-CORE SUBSAMPLING]");
+	if (!m_oocCloud.cloud)
+		return Error(QString("No out-of-core cloud to subsample! (be sure to open one with \"-%1 [ASCII filename]\" before \"-%2\")").arg(COMMAND_OOC_OPEN).arg(COMMAND_OOC_SUBSAMPLE));
+	if (arguments.size() < 2)
+		return Error(QString("Missing parameter(s) after \"-%1\" (SPATIAL step or OCTREE level)").arg(COMMAND_OOC_SUBSAMPLE));
+
+	QString method = arguments.takeFirst().toUpper();
+	CCLib::ReferenceCloud* refCloud = 0;
+	if (method == "SPATIAL")
+	{
+		bool ok;
+		double step = arguments.takeFirst().toDouble(&ok);
+		if (!ok || step <= 0)
+			return Error("Invalid step value for spatial resampling!");
+		Print(QString("\tSpatial step: %1").arg(step));
+
+		CCLib::CloudSamplingTools::SFModulationParams modParams(false);
+		refCloud = CCLib::CloudSamplingTools::resampleCloudSpatially(m_oocCloud.cloud,static_cast<PointCoordinateType>(step),modParams,0,pDlg);
+	}
+	else if (method == "OCTREE")
+	{
+		bool ok = false;
+		int octreeLevel = arguments.takeFirst().toInt(&ok);
+		if (!ok || octreeLevel < 1 || octreeLevel > CCLib::DgmOctree::MAX_OCTREE_LEVEL)
+			return Error("Invalid octree level!");
+		Print(QString("\tOctree level: %1").arg(octreeLevel));
+
+		refCloud = CCLib::CloudSamplingTools::subsampleCloudWithOctreeAtLevel(m_oocCloud.cloud,static_cast<uchar>(octreeLevel),CCLib::CloudSamplingTools::NEAREST_POINT_TO_CELL_CENTER,pDlg);
+	}
+	else
+	{
+		return Error(QString("Unknown method after \"-%1\" (SPATIAL or OCTREE expected)").arg(COMMAND_OOC_SUBSAMPLE));
+	}
+
+	if (!refCloud)
+		return Error("Subsampling process failed!");
+
+	//the subsampled cloud is loaded in memory
+	ccPointCloud* result = new ccPointCloud(m_oocCloud.basename + QString(".subsampled"));
+	if (!result->reserve(refCloud->size()))
+	{
+		delete refCloud;
+		delete result;
+		return Error("Not enough memory!");
+	}
+	for (unsigned i=0; i<refCloud->size(); ++i)
+	{
+		CCVector3 P;
+		m_oocCloud.cloud->getPoint(refCloud->getPointGlobalIndex(i),P);
+		result->addPoint(P);
+	}
+	delete refCloud;
+	refCloud = 0;
+
+	result->setGlobalShift(m_oocCloud.shift);
+	Print(QString("\tResult: %1 points").arg(result->size()));
+
+	CloudDesc cloudDesc(result,m_oocCloud.basename,m_oocCloud.path);
+	if (s_autoSaveMode)
+	{
+		QString errorStr = Export(cloudDesc,"SUBSAMPLED");
+		if (!errorStr.isEmpty())
+		{
+			delete result;
+			return Error(errorStr);
+		}
+	}
+	cloudDesc.basename += QString("_SUBSAMPLED");
+	m_clouds.push_back(cloudDesc);
+
+	return true;
+}
+
+bool ccCommandLineParser::commandOutOfCoreNormals(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[OUT-OF-CORE NORMALS]");
+	if (!m_oocCloud.cloud)
+		return Error(QString("No out-of-core cloud available! (be sure to open one with \"-%1 [ASCII filename]\" before \"-%2\")").arg(COMMAND_OOC_OPEN).arg(COMMAND_OOC_NORMALS));
+	if (arguments.empty())
+		return Error(QString("Missing parameter: neighbourhood radius after \"-%1\"").arg(COMMAND_OOC_NORMALS));
+
+	bool ok;
+	double radius = arguments.takeFirst().toDouble(&ok);
+	if (!ok || radius <= 0)
+		return Error(QString("Invalid neighbourhood radius after \"-%1\"").arg(COMMAND_OOC_NORMALS));
+
+	CC_LOCAL_MODEL_TYPES model = LS;
+	if (!arguments.empty() && IsCommand(arguments.front(),COMMAND_C2C_LOCAL_MODEL))
+	{
+		//local option confirmed, we can move on
+		arguments.pop_front();
+
+		if (arguments.empty())
+			return Error(QString("Missing parameter: model type after \"-%1\" (LS/TRI/HF)").arg(COMMAND_C2C_LOCAL_MODEL));
+		QString modelType = arguments.takeFirst().toUpper();
+		if (modelType == "LS")
+			model = LS;
+		else if (modelType == "TRI")
+			model = TRI;
+		else if (modelType == "HF")
+			model = HF;
+		else
+			return Error(QString("Invalid parameter: unknown model type \"%1\"").arg(modelType));
+	}
+	Print(QString("\tRadius: %1").arg(radius));
+
+	//the normals are stored in compressed form (the only per-point data kept in memory)
+	NormsIndexesTableType* normals = m_oocCloud.normals;
+	if (!normals)
+	{
+		normals = new NormsIndexesTableType();
+		normals->link();
+	}
+	if (!ccNormalVectors::ComputeCloudNormals(m_oocCloud.cloud, *normals, model, static_cast<PointCoordinateType>(radius), -1, pDlg))
+	{
+		normals->release();
+		m_oocCloud.normals = 0;
+		return Error("Failed to compute normals! (not enough memory?)");
+	}
+	m_oocCloud.normals = normals;
+	m_oocCloud.basename += QString("_NORMALS");
+
+	if (s_autoSaveMode)
+	{
+		QString errorStr = exportOutOfCoreCloud(pDlg);
+		if (!errorStr.isEmpty())
+			return Error(errorStr);
+	}
+
+	return true;
+}
+
+bool ccCommandLineParser::commandOutOfCoreC2CDist(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[OUT-OF-CORE C2C DISTANCE]");
+	if (!m_oocCloud.cloud)
+		return Error(QString("No out-of-core cloud available! (be sure to open one with \"-%1 [ASCII filename]\" before \"-%2\")").arg(COMMAND_OOC_OPEN).arg(COMMAND_OOC_C2C_DIST));
+
+	//reference cloud (in memory)
+	if (m_clouds.empty())
+		return Error(QString("No reference cloud available. Be sure to open one (with \"-%1\") before \"-%2\"").arg(COMMAND_OPEN).arg(COMMAND_OOC_C2C_DIST));
+	else if (m_clouds.size() != 1)
+		ccConsole::Warning("Multiple point clouds loaded! We take the first one as reference by default");
+	ccPointCloud* refCloud = m_clouds.front().pc;
+
+	//both clouds must be expressed in the same coordinate system
+	if ((refCloud->getGlobalShift() - m_oocCloud.shift).norm() > ZERO_TOLERANCE || refCloud->getGlobalScale() != 1.0)
+		return Error(QString("The reference cloud and the out-of-core cloud have different global shifts! (use \"-%1\" with the same values when loading them)").arg(COMMAND_OPEN_SHIFT_ON_LOAD));
+
+	CCLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams params;
+	params.multiThread = true;
+
+	//look for additional parameters
+	double maxDist = 0.0;
+	while (!arguments.empty())
+	{
+		QString argument = arguments.front();
+		if (IsCommand(argument,COMMAND_MAX_DISTANCE))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: value after \"-%1\"").arg(COMMAND_MAX_DISTANCE));
+			bool conversionOk = false;
+			maxDist = arguments.takeFirst().toDouble(&conversionOk);
+			if (!conversionOk || maxDist <= 0)
+				return Error(QString("Invalid parameter: value after \"-%1\"").arg(COMMAND_MAX_DISTANCE));
+			params.maxSearchDist = static_cast<ScalarType>(maxDist);
+		}
+		else if (IsCommand(argument,COMMAND_OCTREE_LEVEL))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: value after \"-%1\"").arg(COMMAND_OCTREE_LEVEL));
+			bool conversionOk = false;
+			unsigned octreeLevel = arguments.takeFirst().toUInt(&conversionOk);
+			if (!conversionOk || octreeLevel > CCLib::DgmOctree::MAX_OCTREE_LEVEL)
+				return Error(QString("Invalid parameter: value after \"-%1\"").arg(COMMAND_OCTREE_LEVEL));
+			params.octreeLevel = static_cast<uchar>(octreeLevel);
+		}
+		else
+		{
+			break; //as soon as we encounter an unrecognized argument, we break the local loop to go back on the main one!
+		}
+	}
+
+	//the distances are stored in the scalar field of the out-of-core cloud
+	int result = CCLib::DistanceComputationTools::computeHausdorffDistance(m_oocCloud.cloud, refCloud, params, pDlg);
+	if (result < 0)
+		return Error("An error occured during distances computation!");
+
+	m_oocCloud.sfName = CC_CLOUD2CLOUD_DISTANCES_DEFAULT_SF_NAME;
+	m_oocCloud.basename += QString("_C2C_DIST");
+	if (maxDist > 0)
+		m_oocCloud.basename += QString("_MAX_DIST_%1").arg(maxDist);
+
+	if (s_autoSaveMode)
+	{
+		QString errorStr = exportOutOfCoreCloud(pDlg);
+		if (!errorStr.isEmpty())
+			return Error(errorStr);
+	}
+
+	return true;
+}
+
+bool ccCommandLineParser::commandOutOfCoreSave(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[OUT-OF-CORE SAVE]");
+	if (!m_oocCloud.cloud)
+		return Error(QString("No out-of-core cloud to save! (be sure to open one with \"-%1 [ASCII filename]\" before \"-%2\")").arg(COMMAND_OOC_OPEN).arg(COMMAND_OOC_SAVE));
+
+	QString errorStr = exportOutOfCoreCloud(pDlg);
+	if (!errorStr.isEmpty())
+		return Error(errorStr);
+
+	return true;
+}
+
 bool ccCommandLineParser::commandColorBanding(QStringList& arguments)
 {
 	Print("[COLOR BANDING]");
@@ -2322,6 +2746,7 @@ bool ccCommandLineParser::commandDist(QStringList& arguments, bool cloud2meshDis
 
 	//inner loop for Distance computation options
 	bool flipNormals = false;
+	bool useBVH = false;
 	double maxDist = 0.0;
 	unsigned octreeLevel = 0;
 
@@ -2343,6 +2768,16 @@ bool ccCommandLineParser::commandDist(QStringList& arguments, bool cloud2meshDis
 			if (!cloud2meshDist)
 				ccConsole::Warning("Parameter \"-%1\" ignored: only for C2M distance!");
 		}
+		else if (IsCommand(argument,COMMAND_C2M_DIST_BVH))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			useBVH = true;
+
+			if (!cloud2meshDist)
+				ccConsole::Warning(QString("Parameter \"-%1\" ignored: only for C2M distance!").arg(COMMAND_C2M_DIST_BVH));
+		}
 		else if (IsCommand(argument,COMMAND_MAX_DISTANCE))
 		{
 			//local option confirmed, we can move on
@@ -2460,6 +2895,8 @@ bool ccCommandLineParser::commandDist(QStringList& arguments, bool cloud2meshDis
 	{
 		if (flipNormals)
 			compDlg.flipNormalsCheckBox->setChecked(true);
+		if (useBVH)
+			compDlg.bvhCheckBox->setChecked(true);
 	}
 	//C2C-only parameters
 	else
@@ -3123,6 +3560,127 @@ bool ccCommandLineParser::commandChangeFBXOutputFormat(QStringList& arguments)
 	return true;
 }
 
+bool ccCommandLineParser::commandEnablePDMSInstancing(QStringList& arguments)
+{
+#ifdef CC_PDMS_SUPPORT
+	//simply change the default filter behavior
+	PDMSFilter::SetInstancing(true);
+	ccConsole::Print("PDMS primitives instancing enabled");
+#else
+	ccConsole::Warning(QString("PDMS support not available ('%1' ignored)").arg(COMMAND_PDMS_INSTANCING));
+#endif
+
+	return true;
+}
+
+bool ccCommandLineParser::commandEnablePDMSGroupMerging(QStringList& arguments)
+{
+#ifdef CC_PDMS_SUPPORT
+	//simply change the default filter behavior
+	PDMSFilter::SetGroupMerging(true);
+	ccConsole::Print("PDMS groups merging enabled");
+#else
+	ccConsole::Warning(QString("PDMS support not available ('%1' ignored)").arg(COMMAND_PDMS_MERGE_GROUPS));
+#endif
+
+	return true;
+}
+
+bool ccCommandLineParser::commandEnableLazyTessellation(QStringList& arguments)
+{
+	//primitives will only be tessellated when actually needed
+	ccGenericPrimitive::SetLazyTessellation(true);
+	ccConsole::Print("Lazy tessellation of primitives enabled");
+
+	return true;
+}
+
+bool ccCommandLineParser::commandPDMSConvert(QStringList& arguments)
+{
+	if (arguments.empty())
+		return Error(QString("Missing parameter: PDMS macro (or directory) after '%1'").arg(COMMAND_PDMS_CONVERT));
+
+	QString inputPath = arguments.takeFirst();
+	unsigned batchSize = 1000000;
+	bool updateCache = false;
+
+	//look for additional parameters
+	while (!arguments.empty())
+	{
+		QString argument = arguments.front();
+
+		if (IsCommand(argument,COMMAND_PDMS_CONVERT_BATCH_SIZE))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: number of triangles after '%1'").arg(COMMAND_PDMS_CONVERT_BATCH_SIZE));
+
+			bool ok;
+			batchSize = arguments.takeFirst().toUInt(&ok);
+			if (!ok || batchSize == 0)
+				return Error(QString("Invalid number of triangles after '%1'").arg(COMMAND_PDMS_CONVERT_BATCH_SIZE));
+		}
+		else if (IsCommand(argument,COMMAND_PDMS_CONVERT_UPDATE_CACHE))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			updateCache = true;
+		}
+		else
+		{
+			break; //as soon as we encounter an unrecognized argument, we break the local loop to go back on the main one!
+		}
+	}
+
+#ifdef CC_PDMS_SUPPORT
+	//primitives are streamed to the current mesh export format (BIN or PLY only)
+	PDMSFilter::ConversionFormat format = PDMSFilter::CONVERT_TO_BIN;
+	if (s_MeshExportFormat == PlyFilter::GetFileFilter())
+		format = PDMSFilter::CONVERT_TO_PLY;
+	else if (s_MeshExportFormat != BinFilter::GetFileFilter())
+		return Error(QString("'%1' only supports BIN and PLY output formats (see '%2')").arg(COMMAND_PDMS_CONVERT).arg(COMMAND_MESH_EXPORT_FORMAT));
+
+	QStringList filenames;
+	QFileInfo inputInfo(inputPath);
+	if (inputInfo.isDir())
+	{
+		QDir dir(inputPath);
+		QStringList nameFilters;
+		nameFilters << "*.mac" << "*.pdms" << "*.pdmsmac";
+		QStringList entries = dir.entryList(nameFilters, QDir::Files | QDir::Readable, QDir::Name);
+		for (int i=0; i<entries.size(); ++i)
+			filenames << dir.absoluteFilePath(entries[i]);
+		if (filenames.empty())
+			return Error(QString("No PDMS macro in directory '%1'").arg(inputPath));
+	}
+	else
+	{
+		filenames << inputPath;
+	}
+
+	for (int i=0; i<filenames.size(); ++i)
+	{
+		QFileInfo fileInfo(filenames[i]);
+		QString outputFilename = QString("%1/%2.%3").arg(fileInfo.absolutePath()).arg(fileInfo.completeBaseName()).arg(s_MeshExportExt);
+		Print(QString("Converting '%1' to '%2'").arg(fileInfo.fileName()).arg(outputFilename));
+
+		CC_FILE_ERROR result = PDMSFilter::ConvertFile(filenames[i], outputFilename, format, batchSize, updateCache);
+		if (result != CC_FERR_NO_ERROR)
+		{
+			FileIOFilter::DisplayErrorMessage(result, "converting", filenames[i]);
+			return Error(QString("Failed to convert '%1'").arg(filenames[i]));
+		}
+	}
+#else
+	ccConsole::Warning(QString("PDMS support not available ('%1' ignored)").arg(COMMAND_PDMS_CONVERT));
+#endif
+
+	return true;
+}
+
 bool ccCommandLineParser::commandChangePLYExportFormat(QStringList& arguments)
 {
 	if (arguments.empty())
@@ -3363,6 +3921,46 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		{
 			success = commandCrossSection(arguments);
 		}
+		//Reorder points in octree order
+		else if (IsCommand(argument,COMMAND_OCTREE_REORDER))
+		{
+			success = commandOctreeReorder(arguments,&progressDlg);
+		}
+		//Octree search statistics
+		else if (IsCommand(argument,COMMAND_OCTREE_STATS))
+		{
+			success = commandOctreeStats(arguments);
+		}
+		//Max. number of threads of the octree-based processes
+		else if (IsCommand(argument,COMMAND_MAX_THREADS))
+		{
+			success = commandMaxThreadCount(arguments);
+		}
+		//Import a cloud bigger than the available memory
+		else if (IsCommand(argument,COMMAND_OOC_OPEN))
+		{
+			success = commandOutOfCoreOpen(arguments,&progressDlg);
+		}
+		//Subsample the out-of-core cloud
+		else if (IsCommand(argument,COMMAND_OOC_SUBSAMPLE))
+		{
+			success = commandOutOfCoreSubsample(arguments,&progressDlg);
+		}
+		//Compute the normals of the out-of-core cloud
+		else if (IsCommand(argument,COMMAND_OOC_NORMALS))
+		{
+			success = commandOutOfCoreNormals(arguments,&progressDlg);
+		}
+		//Compute the distances between the out-of-core cloud and a (loaded) reference cloud
+		else if (IsCommand(argument,COMMAND_OOC_C2C_DIST))
+		{
+			success = commandOutOfCoreC2CDist(arguments,&progressDlg);
+		}
+		//Save the out-of-core cloud
+		else if (IsCommand(argument,COMMAND_OOC_SAVE))
+		{
+			success = commandOutOfCoreSave(arguments,&progressDlg);
+		}
 		//Color banding
 		else if (IsCommand(argument,COMMAND_COLOR_BANDING))
 		{
@@ -3387,6 +3985,26 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		{
 			success = commandChangeFBXOutputFormat(arguments);
 		}
+		//Share the geometry of identical PDMS primitives
+		else if (IsCommand(argument,COMMAND_PDMS_INSTANCING))
+		{
+			success = commandEnablePDMSInstancing(arguments);
+		}
+		//Merge the primitives of each PDMS group
+		else if (IsCommand(argument,COMMAND_PDMS_MERGE_GROUPS))
+		{
+			success = commandEnablePDMSGroupMerging(arguments);
+		}
+		//Tessellate primitives on demand
+		else if (IsCommand(argument,COMMAND_LAZY_TESSELLATION))
+		{
+			success = commandEnableLazyTessellation(arguments);
+		}
+		//Stream PDMS macros to mesh files
+		else if (IsCommand(argument,COMMAND_PDMS_CONVERT))
+		{
+			success = commandPDMSConvert(arguments);
+		}
 		//Force normal computation when importing gridded clouds
 		else if (IsCommand(argument,COMMAND_COMPUTE_GRIDDED_NORMALS))
 		{
@@ -3432,6 +4050,7 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		{
 			removeClouds();
 			removeMeshes();
+			removeOutOfCoreCloud();
 		}
 		//no timestamp for output filenames
 		else if (IsCommand(argument,COMMAND_NO_TIMESTAMP))
@@ -19,6 +19,12 @@
 class ccProgressDialog;
 class QDialog;
 
+namespace CCLib
+{
+	class OutOfCoreCloud;
+}
+class NormsIndexesTableType;
+
 //! Command line parser
 class ccCommandLineParser
 {
@@ -45,6 +51,14 @@ protected:
 	bool commandCrop2D						(QStringList& arguments);
 	bool commandCrossSection				(QStringList& arguments, QDialog* parent = 0);
 	bool commandColorBanding				(QStringList& arguments);
+	bool commandOctreeReorder				(QStringList& arguments, ccProgressDialog* pDlg = 0);
+	bool commandOctreeStats					(QStringList& arguments);
+	bool commandMaxThreadCount				(QStringList& arguments);
+	bool commandOutOfCoreOpen				(QStringList& arguments, ccProgressDialog* pDlg = 0);
+	bool commandOutOfCoreSubsample			(QStringList& arguments, ccProgressDialog* pDlg = 0);
+	bool commandOutOfCoreNormals			(QStringList& arguments, ccProgressDialog* pDlg = 0);
+	bool commandOutOfCoreC2CDist			(QStringList& arguments, ccProgressDialog* pDlg = 0);
+	bool commandOutOfCoreSave				(QStringList& arguments, ccProgressDialog* pDlg = 0);
 	bool matchBBCenters						(QStringList& arguments);
 	bool commandICP							(QStringList& arguments, QDialog* parent = 0);
 	bool commandDelaunay					(QStringList& arguments, QDialog* parent = 0);
@@ -52,6 +66,10 @@ protected:
 	bool commandChangeMeshOutputFormat		(QStringList& arguments);
 	bool commandChangePLYExportFormat		(QStringList& arguments);
 	bool commandChangeFBXOutputFormat		(QStringList& arguments);
+	bool commandEnablePDMSInstancing		(QStringList& arguments);
+	bool commandEnablePDMSGroupMerging		(QStringList& arguments);
+	bool commandEnableLazyTessellation		(QStringList& arguments);
+	bool commandPDMSConvert					(QStringList& arguments);
 	bool commandForceNormalsComputation		(QStringList& arguments);
 	bool commandSaveClouds					(QStringList& arguments);
 	bool commandSaveMeshes					(QStringList& arguments);
@@ -185,6 +203,14 @@ protected:
 	//! Removes all meshes
 	void removeMeshes();
 
+	//! Releases the out-of-core cloud (and removes its file)
+	void removeOutOfCoreCloud();
+
+	//! Streams the out-of-core cloud (and its normals and distances) to an ASCII file
+	/** \return error string (if any)
+	**/
+	QString exportOutOfCoreCloud(ccProgressDialog* pDlg = 0);
+
 	//! Currently opened point clouds and their filename
 	std::vector< CloudDesc > m_clouds;
 
@@ -196,6 +222,34 @@ protected:
 
 	//! Mesh filename
 	QString m_meshFilename;
+
+	//! Out-of-core cloud description
+	struct OutOfCoreCloudDesc
+	{
+		//! Cloud
+		CCLib::OutOfCoreCloud* cloud;
+		//! Cloud file (removed with the cloud)
+		QString filename;
+		//! Source file base name
+		QString basename;
+		//! Source file path
+		QString path;
+		//! Global shift applied to the points
+		CCVector3d shift;
+		//! Compressed normals (if computed, see commandOutOfCoreNormals)
+		NormsIndexesTableType* normals;
+		//! Name of the scalar field (if enabled, see commandOutOfCoreC2CDist)
+		QString sfName;
+
+		OutOfCoreCloudDesc()
+			: cloud(0)
+			, shift(0,0,0)
+			, normals(0)
+		{}
+	};
+
+	//! Currently opened out-of-core cloud (for clouds bigger than the available memory)
+	OutOfCoreCloudDesc m_oocCloud;
 };
 
 #endif
@@ -85,6 +85,7 @@ ccComparisonDlg::ccComparisonDlg(	ccHObject* compEntity,
 	signedDistCheckBox->setChecked(false);
 	split3DCheckBox->setEnabled(false);
 	signedDistFrame->setEnabled(false);
+	bvhCheckBox->setEnabled(false);
 	okButton->setEnabled(false);
 
 	connect(cancelButton,			SIGNAL(clicked()),					this,	SLOT(cancelAndExit()));
@@ -117,6 +118,7 @@ ccComparisonDlg::ccComparisonDlg(	ccHObject* compEntity,
 		localModelingTab->setEnabled(false);
 		signedDistFrame->setEnabled(true);
 		signedDistCheckBox->setChecked(true);
+		bvhCheckBox->setEnabled(true);
 	}
 	else
 	{
@@ -549,8 +551,8 @@ int ccComparisonDlg::determineBestOctreeLevel(double maxSearchDist)
 		CCLib::DgmOctree::OctreeCellCodeType tempCode = 0xFFFFFFFF;
 
 		//scan the octree structure
-		const CCLib::DgmOctree::cellsContainer& compCodes = m_compOctree->pointsAndTheirCellCodes();
-		for (CCLib::DgmOctree::cellsContainer::const_iterator c=compCodes.begin(); c!=compCodes.end(); ++c)
+		const CCLib::DgmOctree::pointsAndCodesContainer& compCodes = m_compOctree->pointsAndTheirCellCodes();
+		for (CCLib::DgmOctree::pointsAndCodesContainer::const_iterator c=compCodes.begin(); c!=compCodes.end(); ++c)
 		{
 			CCLib::DgmOctree::OctreeCellCodeType truncatedCode = (c->theCode >> bitDec);
 
@@ -690,6 +692,10 @@ bool ccComparisonDlg::compute()
 	ScalarType maxSearchDist = static_cast<ScalarType>(maxSearchDistSpinBox->isEnabled() ? maxSearchDistSpinBox->value() : -1.0);
 	//multi-thread
 	bool multiThread = multiThreadedCheckBox->isChecked();
+	//cloud-to-mesh distance engine
+	CCLib::DistanceComputationTools::CLOUD2MESH_ENGINE c2mEngine = CCLib::DistanceComputationTools::C2M_GRID_ENGINE;
+	if (bvhCheckBox->isEnabled() && bvhCheckBox->isChecked())
+		c2mEngine = CCLib::DistanceComputationTools::C2M_BVH_ENGINE;
 
 	int result = -1;
 	ccProgressDialog progressDlg(true,this);
@@ -735,9 +741,6 @@ bool ccComparisonDlg::compute()
 
 	case CLOUDMESH_DIST: //cloud-mesh
 
-		if (multiThread && maxSearchDistSpinBox->isEnabled())
-			ccLog::Warning("[Cloud/Mesh comparison] Max search distance is not supported in multi-thread mode! Switching to single thread mode...");
-		
 		result = CCLib::DistanceComputationTools::computePointCloud2MeshDistance(	m_compCloud,
 																					m_refMesh,
 																					static_cast<uchar>(bestOctreeLevel),
@@ -747,7 +750,8 @@ bool ccComparisonDlg::compute()
 																					flipNormals,
 																					multiThread,
 																					&progressDlg,
-																					m_compOctree);
+																					m_compOctree,
+																					c2mEngine);
 		break;
 	}
 	qint64 elapsedTime_ms = eTimer.elapsed();
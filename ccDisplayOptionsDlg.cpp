@@ -61,6 +61,7 @@ ccDisplayOptionsDlg::ccDisplayOptionsDlg(QWidget* parent) : QDialog(parent), Ui:
 	connect(zoomSpeedDoubleSpinBox,          SIGNAL(valueChanged(double)), this, SLOT(changeZoomSpeed(double)));
 	connect(maxCloudSizeDoubleSpinBox,       SIGNAL(valueChanged(double)), this, SLOT(changeMaxCloudSize(double)));
 	connect(maxMeshSizeDoubleSpinBox,        SIGNAL(valueChanged(double)), this, SLOT(changeMaxMeshSize(double)));
+	connect(primitiveErrorDoubleSpinBox,     SIGNAL(valueChanged(double)), this, SLOT(changePrimitiveMaxScreenError(double)));
 
 	connect(okButton,                        SIGNAL(clicked()),         this, SLOT(doAccept()));
 	connect(applyButton,                     SIGNAL(clicked()),         this, SLOT(apply()));
@@ -129,6 +130,7 @@ void ccDisplayOptionsDlg::refresh()
 	maxMeshSizeDoubleSpinBox->setValue(static_cast<double>(parameters.minLoDMeshSize)/1000000.0);
 	decimateCloudBox->setChecked(parameters.decimateCloudOnMove);
 	maxCloudSizeDoubleSpinBox->setValue(static_cast<double>(parameters.minLoDCloudSize)/1000000.0);
+	primitiveErrorDoubleSpinBox->setValue(parameters.primitiveMaxScreenError);
 	useVBOCheckBox->setChecked(parameters.useVBOs);
 	showCrossCheckBox->setChecked(parameters.displayCross);
 	openGLPickingCheckBox->setChecked(parameters.useOpenGLPointPicking);
@@ -373,6 +375,11 @@ void ccDisplayOptionsDlg::changeMaxCloudSize(double val)
 	parameters.minLoDCloudSize = static_cast<unsigned>(val * 1000000);
 }
 
+void ccDisplayOptionsDlg::changePrimitiveMaxScreenError(double val)
+{
+	parameters.primitiveMaxScreenError = static_cast<float>(val);
+}
+
 void ccDisplayOptionsDlg::changeVBOUsage()
 {
 	parameters.useVBOs = useVBOCheckBox->isChecked();
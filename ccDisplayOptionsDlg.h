@@ -80,6 +80,7 @@ signals:
 		void changeMaxMeshSize(double);
 		void changeCloudDecimation();
 		void changeMaxCloudSize(double);
+		void changePrimitiveMaxScreenError(double);
 		void changeVBOUsage();
 		void changeCrossDisplayed();
 		void changeOpenGLPicking();
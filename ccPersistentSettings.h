@@ -39,6 +39,12 @@ public:
 	static inline const QString DuplicatePointsGroup        () { return "duplicatePoints"; }
 	static inline const QString DuplicatePointsMinDist      () { return "minDist"; }
 	static inline const QString HeightGridGeneration        () { return "HeightGridGeneration"; }
+	static inline const QString MaxThreadCount              () { return "maxThreadCount"; }
+	static inline const QString LazyTessellation            () { return "lazyTessellation"; }
+	static inline const QString CompactOctrees              () { return "compactOctrees"; }
+	static inline const QString SaveOctrees                 () { return "saveOctrees"; }
+	static inline const QString PdmsInstancing              () { return "pdmsInstancing"; }
+	static inline const QString PdmsGroupMerging            () { return "pdmsGroupMerging"; }
 };
 
 #endif //CC_PERSISTENT_SETTINGS_HEADER
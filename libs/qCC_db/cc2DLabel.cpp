@@ -22,6 +22,7 @@
 #include "ccBasicTypes.h"
 #include "ccGenericPointCloud.h"
 #include "ccPointCloud.h"
+#include "ccMesh.h"
 #include "ccSphere.h"
 #include "ccGenericGLDisplay.h"
 #include "ccScalarField.h"
@@ -533,6 +534,14 @@ QStringList cc2DLabel::getLabelContent(int precision)
 				QString sfStr = QString("%1 = %2").arg(info.sfName).arg(info.sfValue,0,'f',precision);
 				body << sfStr;
 			}
+			//source entity (merged meshes)
+			ccHObject* parent = info.cloud->getParent();
+			if (parent && parent->isA(CC_TYPES::MESH))
+			{
+				QString sourceName = static_cast<ccMesh*>(parent)->getSourceName(info.pointIndex);
+				if (!sourceName.isEmpty())
+					body << QString("Source: %1").arg(sourceName);
+			}
 		}
 		break;
 
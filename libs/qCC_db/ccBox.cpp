@@ -58,6 +58,14 @@ bool ccBox::buildUp()
 	return (vertices() && vertices()->size() == 24 && vertices()->hasNormals() && this->size() == 12);
 }
 
+bool ccBox::getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const
+{
+	maxCorner = m_dims/2;
+	minCorner = -maxCorner;
+
+	return true;
+}
+
 ccBox::ccBox(QString name/*=QString("Box")*/)
 	: ccGenericPrimitive(name)
 	, m_dims(0,0,0)
@@ -69,6 +77,11 @@ ccGenericPrimitive* ccBox::clone() const
 	return finishCloneJob(new ccBox(m_dims,&m_transformation,getName()));
 }
 
+ccGenericPrimitive* ccBox::createBuildCopy() const
+{
+	return new ccBox(m_dims);
+}
+
 bool ccBox::toFile_MeOnly(QFile& out) const
 {
 	if (!ccGenericPrimitive::toFile_MeOnly(out))
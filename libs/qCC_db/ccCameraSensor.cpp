@@ -2283,8 +2283,8 @@ bool ccOctreeFrustrumIntersector::build(CCLib::DgmOctree* octree)
 	for (int i=0; i<CCLib::DgmOctree::MAX_OCTREE_LEVEL+1 ; i++)
 		m_cellsBuilt[i].clear();
 
-	const CCLib::DgmOctree::cellsContainer& thePointsAndTheirCellCodes = octree->pointsAndTheirCellCodes();
-	CCLib::DgmOctree::cellsContainer::const_iterator it = thePointsAndTheirCellCodes.begin();
+	const CCLib::DgmOctree::pointsAndCodesContainer& thePointsAndTheirCellCodes = octree->pointsAndTheirCellCodes();
+	CCLib::DgmOctree::pointsAndCodesContainer::const_iterator it = thePointsAndTheirCellCodes.begin();
 
 	try
 	{
@@ -54,6 +54,11 @@ ccGenericPrimitive* ccCone::clone() const
 	return finishCloneJob(new ccCone(m_bottomRadius,m_topRadius,m_height,m_xOff,m_yOff,&m_transformation,getName(),m_drawPrecision));
 }
 
+ccGenericPrimitive* ccCone::createBuildCopy() const
+{
+	return new ccCone(m_bottomRadius,m_topRadius,m_height,m_xOff,m_yOff,0,QString(),m_drawPrecision);
+}
+
 bool ccCone::buildUp()
 {
 	if (m_drawPrecision < MIN_DRAWING_PRECISION)
@@ -218,6 +223,17 @@ bool ccCone::buildUp()
 	return true;
 }
 
+bool ccCone::getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const
+{
+	PointCoordinateType r = std::max(m_bottomRadius,m_topRadius);
+	PointCoordinateType dx = fabs(m_xOff)/2 + r;
+	PointCoordinateType dy = fabs(m_yOff)/2 + r;
+	minCorner = CCVector3(-dx,-dy,-m_height/2);
+	maxCorner = CCVector3( dx, dy, m_height/2);
+
+	return true;
+}
+
 void ccCone::setHeight(PointCoordinateType height)
 {
 	if (m_height == height)
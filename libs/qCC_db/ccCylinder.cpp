@@ -36,6 +36,11 @@ ccGenericPrimitive* ccCylinder::clone() const
 	return finishCloneJob(new ccCylinder(m_bottomRadius,m_height,&m_transformation,getName(),m_drawPrecision));
 }
 
+ccGenericPrimitive* ccCylinder::createBuildCopy() const
+{
+	return new ccCylinder(m_bottomRadius,m_height,0,QString(),m_drawPrecision);
+}
+
 void ccCylinder::setBottomRadius(PointCoordinateType radius)
 {
 	//we set the top radius as well!
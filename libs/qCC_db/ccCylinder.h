@@ -63,6 +63,11 @@ public:
 	virtual void setBottomRadius(PointCoordinateType radius);
 	inline virtual void setTopRadius(PointCoordinateType radius) { return setBottomRadius(radius); }
 
+protected:
+
+	//inherited from ccGenericPrimitive
+	virtual ccGenericPrimitive* createBuildCopy() const;
+
 };
 
 #endif //CC_CYLINDER_PRIMITIVE_HEADER
@@ -50,6 +50,11 @@ ccGenericPrimitive* ccDish::clone() const
 	return finishCloneJob(new ccDish(m_baseRadius,m_height,m_secondRadius,&m_transformation,getName(),m_drawPrecision));
 }
 
+ccGenericPrimitive* ccDish::createBuildCopy() const
+{
+	return new ccDish(m_baseRadius,m_height,m_secondRadius,0,QString(),m_drawPrecision);
+}
+
 bool ccDish::buildUp()
 {
 	if (m_drawPrecision < MIN_DRAWING_PRECISION)
@@ -164,6 +169,16 @@ bool ccDish::buildUp()
 	return true;
 }
 
+bool ccDish::getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const
+{
+	//half-ellipsoid mode: the second radius is along Y
+	PointCoordinateType ry = (m_secondRadius > 0 ? m_secondRadius : m_baseRadius);
+	minCorner = CCVector3(-m_baseRadius,-ry,0);
+	maxCorner = CCVector3( m_baseRadius, ry,m_height);
+
+	return true;
+}
+
 bool ccDish::toFile_MeOnly(QFile& out) const
 {
 	if (!ccGenericPrimitive::toFile_MeOnly(out))
@@ -70,6 +70,8 @@ protected:
 	virtual bool toFile_MeOnly(QFile& out) const;
 	virtual bool fromFile_MeOnly(QFile& in, short dataVersion, int flags);
 	virtual bool buildUp();
+	virtual ccGenericPrimitive* createBuildCopy() const;
+	virtual bool getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const;
 
 	//! Base radius
 	PointCoordinateType m_baseRadius;
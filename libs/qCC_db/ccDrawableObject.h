@@ -110,6 +110,22 @@ struct glDrawContext //
 	//! Minimum number of triangles for activating LOD display
 	unsigned minLODTriangleCount;
 
+	//! Max. screen-space error for primitives LOD display (in pixels - 0 = disabled)
+	/** See ccMeshLOD::getLevelIndex.
+	**/
+	float primitiveMaxScreenError;
+
+	//! Pixel size (in 'current unit'/pixel) for primitives LOD display
+	/** Valid everywhere in ortho. mode or at a unit distance from the camera in perspective mode.
+	**/
+	double lodPixelSize;
+
+	//! Perspective view state (for primitives LOD display)
+	bool lodPerspective;
+
+	//! Camera center (for primitives LOD display in perspective mode)
+	CCVector3d lodCameraCenter;
+
 	//! Currently displayed color scale (the corresponding scalar field in fact)
 	ccScalarField* sfColorScaleToDisplay;
 	
@@ -164,6 +180,10 @@ struct glDrawContext //
 		, higherLODLevelsAvailable(false)
 		, decimateMeshOnMove(true)
 		, minLODTriangleCount(2500000)
+		, primitiveMaxScreenError(0)
+		, lodPixelSize(0)
+		, lodPerspective(false)
+		, lodCameraCenter(0,0,0)
 		, sfColorScaleToDisplay(0)
 		, colorRampShader(0)
 		, customRenderingShader(0)
@@ -51,6 +51,11 @@ ccGenericPrimitive* ccExtru::clone() const
 	return finishCloneJob(new ccExtru(m_profile,m_height,&m_transformation,getName()));
 }
 
+ccGenericPrimitive* ccExtru::createBuildCopy() const
+{
+	return new ccExtru(m_profile,m_height);
+}
+
 bool ccExtru::buildUp()
 {
 	unsigned count = static_cast<unsigned>(m_profile.size());
@@ -141,6 +146,29 @@ bool ccExtru::buildUp()
 	return true;
 }
 
+bool ccExtru::getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const
+{
+	if (m_profile.empty())
+		return false;
+
+	minCorner = maxCorner = CCVector3(m_profile[0].x,m_profile[0].y,0);
+	for (size_t i=1; i<m_profile.size(); ++i)
+	{
+		const CCVector2& P = m_profile[i];
+		if (P.x < minCorner.x)
+			minCorner.x = P.x;
+		else if (P.x > maxCorner.x)
+			maxCorner.x = P.x;
+		if (P.y < minCorner.y)
+			minCorner.y = P.y;
+		else if (P.y > maxCorner.y)
+			maxCorner.y = P.y;
+	}
+	maxCorner.z = m_height;
+
+	return true;
+}
+
 bool ccExtru::toFile_MeOnly(QFile& out) const
 {
 	if (!ccGenericPrimitive::toFile_MeOnly(out))
@@ -20,10 +20,274 @@
 
 #include "ccGenericPrimitive.h"
 #include "ccPointCloud.h"
+#include "ccMeshLOD.h"
+
+//Qt
+#include <QMutex>
+#include <QThread>
+#include <QFuture>
+#include <QtConcurrentRun>
+
+//System
+#include <set>
+#include <algorithm>
+
+//! Whether primitives are tessellated on demand (see ccGenericPrimitive::SetLazyTessellation)
+static bool s_lazyTessellation = false;
+
+//! Background tessellation mutex
+/** Protects the background tessellation queue, the set of primitives handled
+	by the background thread and their state. It is never held while the
+	geometry is being built.
+**/
+static QMutex s_tessellationMutex;
+
+//! Background tessellation queue (the next primitive is at the back)
+/** Protected by s_tessellationMutex.
+**/
+static std::vector<ccGenericPrimitive*> s_backgroundQueue;
+
+//! Primitives handled by the background tessellation (queued, being built or ready)
+/** Protected by s_tessellationMutex. Deleted (or modified) primitives remove
+	themselves from this set, so that the background thread never uses a
+	dangling pointer (nor an obsolete copy).
+**/
+static std::set<const ccGenericPrimitive*> s_backgroundPrimitives;
+
+//! Background tessellation task
+static QFuture<void> s_backgroundTessellation;
+
+//! Atomic load with acquire semantics
+static int LoadAcquire(const QAtomicInt& value)
+{
+#if QT_VERSION >= 0x050000
+	return value.loadAcquire();
+#else
+	//Qt4 has no 'loadAcquire'
+	return const_cast<QAtomicInt&>(value).fetchAndAddAcquire(0);
+#endif
+}
+
+//! Atomic store with release semantics
+static void StoreRelease(QAtomicInt& value, int newValue)
+{
+#if QT_VERSION >= 0x050000
+	value.storeRelease(newValue);
+#else
+	//Qt4 has no 'storeRelease'
+	value.fetchAndStoreRelease(newValue);
+#endif
+}
+
+void ccGenericPrimitive::BackgroundTessellation_MT()
+{
+	while (true)
+	{
+		ccGenericPrimitive* primitive = 0;
+		ccGenericPrimitive* copy = 0;
+		{
+			QMutexLocker locker(&s_tessellationMutex);
+			if (s_backgroundQueue.empty())
+				break;
+
+			primitive = s_backgroundQueue.back();
+			s_backgroundQueue.pop_back();
+
+			//primitives deleted (or tessellated) in the meantime are not handled anymore
+			if (s_backgroundPrimitives.find(primitive) == s_backgroundPrimitives.end()
+				|| primitive->backgroundState() != BG_QUEUED)
+				continue;
+
+			//we claim the primitive and make a private copy of its parameters
+			//(the primitive itself is never modified by this thread)
+			copy = primitive->createBuildCopy();
+			if (!copy)
+			{
+				//it will be tessellated on demand
+				primitive->setBackgroundState(BG_NONE);
+				s_backgroundPrimitives.erase(primitive);
+				continue;
+			}
+			primitive->setBackgroundState(BG_BUILDING);
+		}
+
+		//pure geometry generation, without holding the lock
+		bool success = true;
+		if (!copy->isTessellated())
+		{
+			copy->m_tessellationThread = QThread::currentThread();
+			success = copy->buildUp();
+			copy->m_tessellationThread = 0;
+			copy->setTessellated(true);
+		}
+
+		{
+			QMutexLocker locker(&s_tessellationMutex);
+			//the primitive may have been deleted, modified or tessellated by its owner in the meantime
+			if (s_backgroundPrimitives.find(primitive) != s_backgroundPrimitives.end()
+				&& primitive->backgroundState() == BG_BUILDING)
+			{
+				if (success)
+				{
+					primitive->m_backgroundCopy = copy;
+					copy = 0;
+					primitive->setBackgroundState(BG_READY);
+				}
+				else
+				{
+					//it will be tessellated on demand (and fail again...)
+					primitive->setBackgroundState(BG_NONE);
+					s_backgroundPrimitives.erase(primitive);
+				}
+			}
+		}
+
+		delete copy;
+	}
+}
+
+void ccGenericPrimitive::SetLazyTessellation(bool state)
+{
+	s_lazyTessellation = state;
+}
+
+bool ccGenericPrimitive::LazyTessellationEnabled()
+{
+	return s_lazyTessellation;
+}
+
+void ccGenericPrimitive::StartBackgroundTessellation(const std::vector<ccGenericPrimitive*>& primitives, const CCVector3& viewCenter)
+{
+	StopBackgroundTessellation();
+
+	//sort primitives by decreasing distance to the view center
+	std::vector< std::pair<PointCoordinateType, ccGenericPrimitive*> > sortedPrimitives;
+	try
+	{
+		sortedPrimitives.reserve(primitives.size());
+		for (size_t i=0; i<primitives.size(); ++i)
+		{
+			ccGenericPrimitive* primitive = primitives[i];
+			//(the ones already built in the background are simply waiting to be displayed)
+			if (primitive && !primitive->isTessellated() && primitive->backgroundState() == BG_NONE)
+			{
+				CCVector3 C = CCVector3::fromArray(primitive->getTransformation().getTranslation());
+				sortedPrimitives.push_back(std::pair<PointCoordinateType, ccGenericPrimitive*>(-(C-viewCenter).norm2(),primitive));
+			}
+		}
+	}
+	catch(std::bad_alloc)
+	{
+		//not a problem: primitives will be tessellated on demand
+		return;
+	}
+
+	if (sortedPrimitives.empty())
+		return;
+
+	std::sort(sortedPrimitives.begin(),sortedPrimitives.end());
+
+	{
+		QMutexLocker locker(&s_tessellationMutex);
+		try
+		{
+			s_backgroundQueue.reserve(sortedPrimitives.size());
+			for (size_t i=0; i<sortedPrimitives.size(); ++i)
+			{
+				ccGenericPrimitive* primitive = sortedPrimitives[i].second;
+				s_backgroundPrimitives.insert(primitive);
+				primitive->setBackgroundState(BG_QUEUED);
+				s_backgroundQueue.push_back(primitive);
+			}
+		}
+		catch(std::bad_alloc)
+		{
+			//not a problem: primitives will be tessellated on demand
+			for (size_t i=0; i<s_backgroundQueue.size(); ++i)
+			{
+				s_backgroundQueue[i]->setBackgroundState(BG_NONE);
+				s_backgroundPrimitives.erase(s_backgroundQueue[i]);
+			}
+			s_backgroundQueue.clear();
+			return;
+		}
+	}
+
+	s_backgroundTessellation = QtConcurrent::run(BackgroundTessellation_MT);
+}
+
+void ccGenericPrimitive::StopBackgroundTessellation()
+{
+	{
+		QMutexLocker locker(&s_tessellationMutex);
+		//the primitives still in the queue will be tessellated on demand
+		//(the ones already built or being built are kept)
+		for (size_t i=0; i<s_backgroundQueue.size(); ++i)
+		{
+			ccGenericPrimitive* primitive = s_backgroundQueue[i];
+			if (s_backgroundPrimitives.find(primitive) != s_backgroundPrimitives.end()
+				&& primitive->backgroundState() == BG_QUEUED)
+			{
+				primitive->setBackgroundState(BG_NONE);
+				s_backgroundPrimitives.erase(primitive);
+			}
+		}
+		s_backgroundQueue.clear();
+	}
+
+	s_backgroundTessellation.waitForFinished();
+}
+
+bool ccGenericPrimitive::IsBackgroundTessellationRunning()
+{
+	return s_backgroundTessellation.isRunning();
+}
+
+bool ccGenericPrimitive::isTessellated() const
+{
+	return LoadAcquire(m_tessellated) != 0;
+}
+
+void ccGenericPrimitive::setTessellated(bool state)
+{
+	StoreRelease(m_tessellated, state ? 1 : 0);
+}
+
+int ccGenericPrimitive::backgroundState() const
+{
+	return LoadAcquire(m_backgroundState);
+}
+
+void ccGenericPrimitive::setBackgroundState(int state)
+{
+	StoreRelease(m_backgroundState, state);
+}
+
+ccGenericPrimitive* ccGenericPrimitive::takeBackgroundCopy()
+{
+	//only the owner thread may take a primitive out of the background tessellation
+	//(so if it's not handled by the background thread, it won't be in the meantime)
+	if (backgroundState() == BG_NONE)
+		return 0;
+
+	QMutexLocker locker(&s_tessellationMutex);
+
+	//if the primitive is being built, the background thread will discard its copy
+	ccGenericPrimitive* copy = m_backgroundCopy;
+	m_backgroundCopy = 0;
+	setBackgroundState(BG_NONE);
+	s_backgroundPrimitives.erase(this);
+
+	return copy;
+}
 
 ccGenericPrimitive::ccGenericPrimitive(QString name/*=QString()*/, const ccGLMatrix* transMat /*= 0*/)
 	: ccMesh(new ccPointCloud("vertices"))
 	, m_drawPrecision(0)
+	, m_tessellated(1)
+	, m_tessellationThread(0)
+	, m_backgroundState(BG_NONE)
+	, m_backgroundCopy(0)
 {
 	setName(name);
 	showNormals(true);
@@ -37,8 +301,18 @@ ccGenericPrimitive::ccGenericPrimitive(QString name/*=QString()*/, const ccGLMat
 		m_transformation = *transMat;
 }
 
+ccGenericPrimitive::~ccGenericPrimitive()
+{
+	//the background tessellation thread must forget this primitive
+	delete takeBackgroundCopy();
+}
+
 void ccGenericPrimitive::setColor(const ccColor::Rgb& col)
 {
+	//colors are set on the vertices (they must exist!)
+	tessellate();
+	clearLOD();
+
 	if (m_associatedCloud)
 		static_cast<ccPointCloud*>(m_associatedCloud)->setRGBColor(col.rgb);
 }
@@ -125,6 +399,9 @@ const ccGenericPrimitive& ccGenericPrimitive::operator += (const ccGenericPrimit
 
 bool ccGenericPrimitive::toFile_MeOnly(QFile& out) const
 {
+	//vertices and triangles are saved as well
+	const_cast<ccGenericPrimitive*>(this)->tessellate();
+
 	if (!ccMesh::toFile_MeOnly(out))
 		return false;
 
@@ -158,6 +435,9 @@ bool ccGenericPrimitive::fromFile_MeOnly(QFile& in, short dataVersion, int flags
 	if (in.read((char*)&m_drawPrecision,sizeof(unsigned)) < 0)
 		return ReadError();
 
+	//vertices and triangles are loaded as well
+	setTessellated(true);
+
 	return true;
 }
 
@@ -175,17 +455,208 @@ bool ccGenericPrimitive::setDrawingPrecision(unsigned steps)
 
 bool ccGenericPrimitive::updateRepresentation()
 {
+	clearLOD();
+
+	//any copy built in the background (with the previous parameters) is obsolete
+	delete takeBackgroundCopy();
+
+	if (s_lazyTessellation)
+	{
+		//the per-triangle normals table is attached right away, so that
+		//the hierarchy doesn't change when the primitive is tessellated
+		//(potentially by another thread)
+		if (!m_triNormals)
+			setTriNormsTable(new NormsIndexesTableType());
+
+		setTessellated(false);
+		return true;
+	}
+
+	setTessellated(false);
+	return build();
+}
+
+bool ccGenericPrimitive::build()
+{
+	m_tessellationThread = QThread::currentThread();
 	bool success = buildUp();
 	if (success)
 	{
 		applyTransformationToVertices();
 	}
+	m_tessellationThread = 0;
+
+	//even if it failed (there's no need to try again with the same parameters)
+	setTessellated(true);
+
+	return success;
+}
+
+bool ccGenericPrimitive::buildFrom(const ccGenericPrimitive& copy)
+{
+	m_tessellationThread = QThread::currentThread();
+
+	//same structures as the ones 'buildUp' would have initialized
+	const ccGenericPointCloud* copyVertices = copy.m_associatedCloud;
+	bool success = (copyVertices
+					&& init(copyVertices->size(), copyVertices->hasNormals(), copy.ccMesh::size(), copy.m_triNormals ? copy.m_triNormals->currentSize() : 0));
+	if (success)
+	{
+		*this += copy;
+		success = (ccMesh::size() == copy.ccMesh::size());
+		if (success)
+		{
+			applyTransformationToVertices();
+		}
+	}
+	m_tessellationThread = 0;
+
+	//even if it failed (there's no need to try again with the same parameters)
+	setTessellated(true);
+
+	return success;
+}
+
+bool ccGenericPrimitive::tessellate()
+{
+	if (isTessellated())
+		return true;
+
+	//the primitive is currently being built by this thread (recursive call)
+	if (m_tessellationThread == QThread::currentThread())
+		return true;
+
+	//no need to tessellate it in the background anymore
+	ccGenericPrimitive* copy = takeBackgroundCopy();
+	if (!copy)
+		return build();
+
+	//it has already been built in the background
+	bool success = buildFrom(*copy);
+	delete copy;
 
 	return success;
 }
 
+ccBBox ccGenericPrimitive::getOwnBB(bool withGLFeatures/*=false*/)
+{
+	if (!isTessellated())
+	{
+		//no need to tessellate the primitive yet
+		CCVector3 minCorner, maxCorner;
+		if (getLocalBoundingBox(minCorner,maxCorner))
+			return ccBBox(minCorner,maxCorner) * m_transformation;
+
+		tessellate();
+	}
+
+	return ccMesh::getOwnBB(withGLFeatures);
+}
+
+ccGenericPointCloud* ccGenericPrimitive::getAssociatedCloud() const
+{
+	const_cast<ccGenericPrimitive*>(this)->tessellate();
+
+	return ccMesh::getAssociatedCloud();
+}
+
+unsigned ccGenericPrimitive::size() const
+{
+	const_cast<ccGenericPrimitive*>(this)->tessellate();
+
+	return ccMesh::size();
+}
+
+void ccGenericPrimitive::drawMeOnly(CC_DRAW_CONTEXT& context)
+{
+	if (!isTessellated() && MACRO_Draw3D(context))
+	{
+		//primitives waiting for the background tessellation are skipped, without
+		//blocking (the display will be refreshed as soon as they are ready)
+		int state = backgroundState();
+		if (state == BG_QUEUED || state == BG_BUILDING)
+			return;
+
+		//the geometry built in the background (if any) is transferred here
+		tessellate();
+	}
+
+	ccMesh::drawMeOnly(context);
+}
+
+ccMeshLOD* ccGenericPrimitive::getLOD()
+{
+	if (m_lod || !hasDrawingPrecision() || m_drawPrecision <= MIN_DRAWING_PRECISION)
+		return m_lod;
+
+	//the precision applies to the circular sections (in the local XY plane)
+	CCVector3 minCorner, maxCorner;
+	if (!getLocalBoundingBox(minCorner,maxCorner))
+		return 0;
+	double radius = std::max(maxCorner.x-minCorner.x, maxCorner.y-minCorner.y) / 2;
+	if (radius <= 0)
+		return 0;
+
+	//the levels have the same (uniform) color as this primitive (see setColor)
+	tessellate();
+	const colorType* color = (vertices()->hasColors() && vertices()->size() != 0 ? vertices()->getPointColor(0) : 0);
+
+	//even if it fails (there's no need to try again with the same parameters)
+	m_lod = new ccMeshLOD();
+	m_lod->link();
+
+	unsigned precision = m_drawPrecision;
+	while (precision > MIN_DRAWING_PRECISION)
+	{
+		precision = std::max<unsigned>(precision/2, MIN_DRAWING_PRECISION);
+
+		//temporary copy with the level precision
+		ccGenericPrimitive* copy = clone();
+		bool success = (copy && copy->setDrawingPrecision(precision) && copy->tessellate());
+		if (success)
+		{
+			try
+			{
+				m_lod->levels.push_back(ccMeshLOD::Level());
+				ccMeshLOD::Level& level = m_lod->levels.back();
+				success = ccMeshLOD::AppendMesh(level,*copy,0,copy->size());
+				if (success && color)
+				{
+					level.colors.resize(level.vertices.size()*3);
+					for (size_t i=0; i<level.colors.size(); i+=3)
+					{
+						level.colors[i  ] = color[0];
+						level.colors[i+1] = color[1];
+						level.colors[i+2] = color[2];
+					}
+				}
+
+				//the (max) chord error of a circle of radius r discretized with n steps is r.(1-cos(pi/n))
+				level.maxError = static_cast<PointCoordinateType>(radius * (1.0 - cos(M_PI/precision)));
+			}
+			catch (const std::bad_alloc&)
+			{
+				success = false;
+			}
+		}
+		delete copy;
+
+		if (!success)
+		{
+			m_lod->levels.clear();
+			break;
+		}
+	}
+
+	return m_lod;
+}
+
 void ccGenericPrimitive::applyGLTransformation(const ccGLMatrix& trans)
 {
+	//the vertices must exist before being transformed
+	tessellate();
+	clearLOD();
+
 	//transparent call
 	ccMesh::applyGLTransformation(trans);
 
@@ -285,6 +756,9 @@ ccGenericPrimitive* ccGenericPrimitive::finishCloneJob(ccGenericPrimitive* primi
 {
 	if (primitive)
 	{
+		const_cast<ccGenericPrimitive*>(this)->tessellate();
+		primitive->tessellate();
+
 		//'clone' vertices (everything but the points that are already here)
 		if (primitive->m_associatedCloud && m_associatedCloud && m_associatedCloud->size() == primitive->m_associatedCloud->size())
 		{
@@ -22,7 +22,14 @@
 #include "qCC_db.h"
 #include "ccMesh.h"
 
+//Qt
+#include <QAtomicInt>
+
+//System
+#include <vector>
+
 class ccPointCloud;
+class QThread;
 
 //! Generic primitive interface
 class QCC_DB_LIB_API ccGenericPrimitive : public ccMesh
@@ -37,6 +44,9 @@ public:
 	**/
 	ccGenericPrimitive(QString name = QString(), const ccGLMatrix* transMat = 0);
 
+	//! Destructor
+	virtual ~ccGenericPrimitive();
+
 	//! Returns type name (sphere, cylinder, etc.)
 	virtual QString getTypeName() const = 0;
 
@@ -81,8 +91,72 @@ public:
 	//! Returns the transformation that is currently applied to the vertices (const version)
 	virtual const ccGLMatrix& getTransformation() const { return m_transformation; }
 
+	//! Enables or disables lazy tessellation (disabled by default)
+	/** In lazy mode, the primitives created (or modified) afterwards only keep
+		their parameters and transformation: their vertices and triangles are
+		built the first time they are actually needed (display, access to the
+		vertices or triangles, saving, etc. - see ccGenericPrimitive::tessellate).
+		Hidden primitives therefore cost (almost) nothing.
+	**/
+	static void SetLazyTessellation(bool state);
+
+	//! Returns whether lazy tessellation is enabled
+	static bool LazyTessellationEnabled();
+
+	//! Builds the primitive vertices and triangles if they are not up to date
+	/** Only useful in lazy mode (called automatically when necessary). Must be
+		called by the thread owning the primitive: if the primitive has already been
+		built in the background, its geometry is simply transferred (and transformed).
+		\return success
+	**/
+	bool tessellate();
+
+	//! Returns whether the primitive vertices and triangles are up to date
+	bool isTessellated() const;
+
+	//! Tessellates (lazy) primitives in a background thread
+	/** Primitives are processed by increasing distance between their center
+		and 'viewCenter', so that the ones in the current view are ready first.
+		The background thread only generates the geometry of private copies (see
+		ccGenericPrimitive::createBuildCopy): the primitives themselves are updated
+		(and transformed) by the calling thread, the next time they are displayed
+		or tessellated. Primitives waiting to be tessellated are not displayed (the
+		display should be refreshed until ccGenericPrimitive::IsBackgroundTessellationRunning
+		returns false). Any previous background tessellation is stopped first.
+		\param primitives primitives to tessellate (the ones already tessellated are ignored)
+		\param viewCenter current view center
+	**/
+	static void StartBackgroundTessellation(const std::vector<ccGenericPrimitive*>& primitives, const CCVector3& viewCenter);
+
+	//! Stops the background tessellation (if any)
+	/** Remaining primitives will be tessellated on demand.
+	**/
+	static void StopBackgroundTessellation();
+
+	//! Returns whether primitives are currently tessellated in the background
+	static bool IsBackgroundTessellationRunning();
+
+	//inherited from ccHObject
+	virtual ccBBox getOwnBB(bool withGLFeatures = false);
+
+	//inherited from ccGenericMesh
+	virtual ccGenericPointCloud* getAssociatedCloud() const;
+
+	//inherited from ccMesh
+	/** For primitives with a drawing precision, coarser versions (half the
+		precision each time, down to MIN_DRAWING_PRECISION) are built on demand.
+		Their error is the max. chord error of the circular sections.
+	**/
+	virtual ccMeshLOD* getLOD();
+
+	//inherited from GenericIndexedMesh
+	virtual unsigned size() const;
+
 protected:
 
+	//inherited from ccHObject
+	virtual void drawMeOnly(CC_DRAW_CONTEXT& context);
+
 	//! Inherited from ccGenericMesh
 	virtual void applyGLTransformation(const ccGLMatrix& trans);
 
@@ -96,12 +170,38 @@ protected:
 	**/
 	virtual bool buildUp() = 0;
 
+	//! Returns the bounding-box of the primitive (before transformation)
+	/** Computed from the primitive parameters (so that it is available before
+		the primitive is tessellated in lazy mode).
+		\param minCorner bounding-box min corner
+		\param maxCorner bounding-box max corner
+		\return false if not supported by this primitive
+	**/
+	virtual bool getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const { return false; }
+
+	//! Creates a primitive with the same parameters (but no transformation, name, etc.)
+	/** Used by the background tessellation thread to build the geometry without
+		modifying this primitive. The copy is not tessellated in lazy mode.
+		\return copy (or 0 if not supported: the primitive is then tessellated on demand)
+	**/
+	virtual ccGenericPrimitive* createBuildCopy() const { return 0; }
+
 	//! Updates internal representation (as a mesh)
-	/** Calls buildUp then applyTransformationToVertices.
+	/** Calls buildUp then applyTransformationToVertices (deferred in lazy mode).
 		\return success of buildUp
 	**/
 	virtual bool updateRepresentation();
 
+	//! Builds the primitive (buildUp + applyTransformationToVertices)
+	bool build();
+
+	//! Builds the primitive from the geometry of a copy built in the background
+	/** The geometry of 'copy' (in the primitive local coordinate system) is
+		transferred, then the transformation is applied as in build.
+		\return success
+	**/
+	bool buildFrom(const ccGenericPrimitive& copy);
+
 	//! Inits internal structures
 	/** Warning: resets all!
 	**/
@@ -128,6 +228,48 @@ protected:
 
 	//! Drawing precision (for primitives that support this feature)
 	unsigned m_drawPrecision;
+
+	//! Sets whether vertices and triangles are up to date (release semantics)
+	void setTessellated(bool state);
+
+	//! Whether vertices and triangles are up to date (see lazy tessellation)
+	/** Read with acquire semantics (see isTessellated) as it is set by the
+		background tessellation thread.
+	**/
+	QAtomicInt m_tessellated;
+
+	//! Thread currently building the primitive (if any)
+	QThread* m_tessellationThread;
+
+	//! Background tessellation states (see m_backgroundState)
+	enum BackgroundState {	BG_NONE = 0,		/**< not handled by the background thread **/
+							BG_QUEUED = 1,		/**< waiting in the queue **/
+							BG_BUILDING = 2,	/**< claimed by the background thread (a copy is being built) **/
+							BG_READY = 3			/**< copy built (see m_backgroundCopy) **/
+	};
+
+	//! Background tessellation state (see BackgroundState)
+	/** Only changed with s_tessellationMutex locked, but read without it by
+		drawMeOnly (primitives waiting for the background thread are skipped).
+	**/
+	QAtomicInt m_backgroundState;
+
+	//! Copy built by the background thread (protected by the tessellation mutex)
+	ccGenericPrimitive* m_backgroundCopy;
+
+	//! Returns the background tessellation state (acquire semantics)
+	int backgroundState() const;
+
+	//! Sets the background tessellation state (release semantics)
+	void setBackgroundState(int state);
+
+	//! Removes this primitive from the background tessellation
+	/** \return the copy built in the background (if any) - to be deleted by the caller
+	**/
+	ccGenericPrimitive* takeBackgroundCopy();
+
+	//! Background tessellation loop (see StartBackgroundTessellation)
+	static void BackgroundTessellation_MT();
 };
 
 #endif //CC_GENERIC_PRIMITIVE_HEADER
@@ -30,6 +30,7 @@
 #include "ccScalarField.h"
 #include "ccColorScalesManager.h"
 #include "ccGenericGLDisplay.h"
+#include "ccMeshLOD.h"
 
 //CCLib
 #include <ManualSegmentationTools.h>
@@ -59,6 +60,8 @@ ccMesh::ccMesh(ccGenericPointCloud* vertices)
 	, m_triMtlIndexes(0)
 	, m_texCoordIndexes(0)
 	, m_triNormalIndexes(0)
+	, m_prototype(0)
+	, m_lod(0)
 {
 	setAssociatedCloud(vertices);
 
@@ -77,6 +80,8 @@ ccMesh::ccMesh(CCLib::GenericIndexedMesh* giMesh, ccGenericPointCloud* giVertice
 	, m_triMtlIndexes(0)
 	, m_texCoordIndexes(0)
 	, m_triNormalIndexes(0)
+	, m_prototype(0)
+	, m_lod(0)
 {
 	setAssociatedCloud(giVertices);
 
@@ -110,6 +115,7 @@ ccMesh::~ccMesh()
 	clearTriNormals();
 	setMaterialSet(0);
 	setTexCoordinatesTable(0);
+	clearLOD();
 
 	if (m_triVertIndexes)
 		m_triVertIndexes->release();
@@ -147,6 +153,22 @@ void ccMesh::onDeletionOf(const ccHObject* obj)
 	if (obj == m_associatedCloud)
 		setAssociatedCloud(0);
 
+	//an instance can't use the prototype geometry anymore (see ccMesh::createInstance)
+	if (obj == m_prototype)
+	{
+		m_prototype = 0;
+
+		setAssociatedCloud(0);
+		setTriNormsTable(0);
+		removePerTriangleNormalIndexes();
+
+		m_triVertIndexes->release();
+		m_triVertIndexes = new triangleIndexesContainer();
+		m_triVertIndexes->link();
+
+		m_bBox.setValidity(false);
+	}
+
 	ccGenericMesh::onDeletionOf(obj);
 }
 
@@ -478,8 +500,13 @@ void ccMesh::applyGLTransformation(const ccGLMatrix& trans)
 
 	//vertices should be handled another way!
 
+	//but the display L.O.D. levels must follow
+	if (m_lod)
+		m_lod->applyTransformation(trans);
+
     //we must take care of the triangle normals!
-	if (m_triNormals && (!getParent() || !getParent()->isKindOf(CC_TYPES::MESH)))
+	//(but not of the ones shared with a mesh instance, see ccMesh::createInstance)
+	if (m_triNormals && getChildIndex(m_triNormals) >= 0 && (!getParent() || !getParent()->isKindOf(CC_TYPES::MESH)))
     {
         bool recoded = false;
 
@@ -656,6 +683,78 @@ bool ccMesh::laplacianSmooth(	unsigned nbIteration,
 	return true;
 }
 
+QString ccMesh::getSourceName(unsigned vertIndex) const
+{
+	QVariant names = getMetaData(MetaKeySourceNames());
+	if (!names.isValid() || !m_associatedCloud || !m_associatedCloud->isA(CC_TYPES::POINT_CLOUD))
+		return QString();
+
+	ccPointCloud* vertices = static_cast<ccPointCloud*>(m_associatedCloud);
+	int sfIdx = vertices->getScalarFieldIndexByName(qPrintable(SourceIndexSFName()));
+	if (sfIdx < 0 || vertIndex >= vertices->size())
+		return QString();
+
+	ScalarType index = vertices->getScalarField(sfIdx)->getValue(vertIndex);
+	QStringList sourceNames = names.toStringList();
+	if (!ccScalarField::ValidValue(index) || index < 0 || static_cast<int>(index) >= sourceNames.size())
+		return QString();
+
+	return sourceNames[static_cast<int>(index)];
+}
+
+ccMeshLOD* ccMesh::getLOD()
+{
+	//instances use the levels of their prototype
+	return (m_prototype ? m_prototype->getLOD() : m_lod);
+}
+
+void ccMesh::clearLOD()
+{
+	if (m_lod)
+	{
+		m_lod->release();
+		m_lod = 0;
+	}
+}
+
+ccMesh* ccMesh::createInstance(const ccGLMatrix& trans)
+{
+	//virtual call: lazily tessellated primitives are built first
+	ccGenericPointCloud* vertices = getAssociatedCloud();
+	assert(vertices && m_triVertIndexes);
+
+	ccMesh* instance = new ccMesh(vertices);
+
+	//share the triangles (instead of the default empty set)
+	instance->m_triVertIndexes->release();
+	instance->m_triVertIndexes = m_triVertIndexes;
+	m_triVertIndexes->link();
+
+	//share the per-triangle normals
+	//(the table stays a child of this mesh: see ccMesh::applyGLTransformation)
+	if (m_triNormals && m_triNormalIndexes)
+	{
+		instance->m_triNormals = m_triNormals;
+		m_triNormals->link();
+		instance->m_triNormalIndexes = m_triNormalIndexes;
+		m_triNormalIndexes->link();
+	}
+
+	instance->showNormals(normalsShown());
+	instance->showTriNorms(triNormsShown());
+	instance->showColors(colorsShown());
+	instance->showSF(sfShown());
+	instance->setVisible(isVisible());
+	instance->setGLTransformation(trans);
+
+	//each one must be notified of the deletion of the other
+	instance->m_prototype = this;
+	addDependency(instance,DP_NOTIFY_OTHER_ON_DELETE);
+	instance->addDependency(this,DP_NOTIFY_OTHER_ON_DELETE);
+
+	return instance;
+}
+
 ccMesh* ccMesh::cloneMesh(	ccGenericPointCloud* vertices/*=0*/,
 							ccMaterialSet* clonedMaterials/*=0*/,
 							NormsIndexesTableType* clonedNormsTable/*=0*/,
@@ -954,7 +1053,7 @@ ccMesh* ccMesh::Triangulate(ccGenericPointCloud* cloud,
 	return mesh;
 }
 
-bool ccMesh::merge(const ccMesh* mesh)
+bool ccMesh::merge(const ccMesh* mesh, bool withLOD/*=true*/)
 {
 	if (!mesh)
 	{
@@ -1231,6 +1330,24 @@ bool ccMesh::merge(const ccMesh* mesh)
 		static_cast<ccPointCloud*>(m_associatedCloud)->resize(vertNumBefore);
 		resize(triNumBefore);
 	}
+	else if (!withLOD)
+	{
+		clearLOD();
+	}
+	else
+	{
+		//display L.O.D. levels (a mesh that already had triangles without levels won't have any)
+		if (triNumBefore == 0 && !m_lod)
+		{
+			m_lod = new ccMeshLOD();
+			m_lod->link();
+		}
+		if (m_lod && !m_lod->merge(*this,triNumBefore,*mesh,const_cast<ccMesh*>(mesh)->getLOD()))
+		{
+			ccLog::Warning("[ccMesh::merge] Not enough memory to merge the display L.O.D. levels!");
+			clearLOD();
+		}
+	}
 
 	return success;
 }
@@ -1467,6 +1584,30 @@ void ccMesh::drawMeOnly(CC_DRAW_CONTEXT& context)
 		bool applyMaterials = (hasMaterials() && materialsShown());
 		bool showTextures = (hasTextures() && materialsShown() && !lodEnabled);
 
+		//display L.O.D. levels (not while picking, nor with features they don't have)
+		if (!MACRO_DrawNames(context) && !lodEnabled && !visFiltering && !glParams.showSF && !applyMaterials && !showTextures)
+		{
+			ccMeshLOD* lod = getLOD();
+			if (lod && !lod->levels.empty())
+			{
+				ccBBox box = getOwnBB();
+				if (box.isValid())
+				{
+					//bounding sphere (in the display coordinate system)
+					CCVector3 C = box.getCenter();
+					if (isGLTransEnabled())
+						m_glTrans.apply(C);
+
+					int levelIndex = lod->getLevelIndex(context,C,box.getDiagNorm()/2);
+					if (levelIndex >= 0)
+					{
+						drawLODLevel(context,*lod,static_cast<unsigned>(levelIndex),glParams);
+						return;
+					}
+				}
+			}
+		}
+
 		//GL name pushing
 		bool pushName = MACRO_DrawEntityNames(context);
 		//special case: triangle names pushing (for picking)
@@ -2014,6 +2155,91 @@ void ccMesh::drawMeOnly(CC_DRAW_CONTEXT& context)
 	}
 }
 
+void ccMesh::drawLODLevel(CC_DRAW_CONTEXT& context, const ccMeshLOD& lod, unsigned levelIndex, const glDrawParams& glParams)
+{
+	assert(levelIndex < lod.levels.size());
+	const ccMeshLOD::Level& level = lod.levels[levelIndex];
+	if (level.indexes.empty())
+		return;
+
+	//materials or color?
+	bool showColors = glParams.showColors;
+	if (glParams.showColors)
+	{
+		glColorMaterial(GL_FRONT_AND_BACK, GL_DIFFUSE);
+		glEnable(GL_COLOR_MATERIAL);
+
+		if (isColorOverriden() || level.colors.empty())
+		{
+			ccGL::Color3v(isColorOverriden() ? m_tempColor.rgb : ccColor::white.rgba);
+			showColors = false;
+		}
+	}
+	else
+	{
+		glColor3fv(context.defaultMat->getDiffuseFront().rgba);
+	}
+
+	if (glParams.showNorms)
+	{
+		//DGM: Strangely, when Qt::renderPixmap is called, the OpenGL version can fall to 1.0!
+		glEnable((QGLFormat::openGLVersionFlags() & QGLFormat::OpenGL_Version_1_2 ? GL_RESCALE_NORMAL : GL_NORMALIZE));
+		glEnable(GL_LIGHTING);
+		context.defaultMat->applyGL(true,glParams.showColors);
+	}
+
+	//stipple mask
+	if (m_stippling)
+		EnableGLStippleMask(true);
+
+	//wireframe
+	if (isShownAsWire())
+	{
+		glPushAttrib(GL_POLYGON_BIT);
+		glPolygonMode(GL_FRONT_AND_BACK,GL_LINE);
+	}
+
+	//the GL type depends on the PointCoordinateType 'size' (float or double)
+	GLenum GL_COORD_TYPE = sizeof(PointCoordinateType) == 4 ? GL_FLOAT : GL_DOUBLE;
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3,GL_COORD_TYPE,0,level.vertices[0].u);
+	if (glParams.showNorms)
+	{
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_COORD_TYPE,0,level.normals[0].u);
+	}
+	if (showColors)
+	{
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(3,GL_UNSIGNED_BYTE,0,&(level.colors[0]));
+	}
+
+	glDrawElements(GL_TRIANGLES,static_cast<GLsizei>(level.indexes.size()),GL_UNSIGNED_INT,&(level.indexes[0]));
+
+	//disable arrays
+	glDisableClientState(GL_VERTEX_ARRAY);
+	if (glParams.showNorms)
+		glDisableClientState(GL_NORMAL_ARRAY);
+	if (showColors)
+		glDisableClientState(GL_COLOR_ARRAY);
+
+	if (isShownAsWire())
+		glPopAttrib(); //GL_POLYGON_BIT
+
+	if (m_stippling)
+		EnableGLStippleMask(false);
+
+	if (glParams.showColors)
+		glDisable(GL_COLOR_MATERIAL);
+
+	if (glParams.showNorms)
+	{
+		glDisable(GL_LIGHTING);
+		glDisable((QGLFormat::openGLVersionFlags() & QGLFormat::OpenGL_Version_1_2 ? GL_RESCALE_NORMAL : GL_NORMALIZE));
+	}
+}
+
 ccMesh* ccMesh::createNewMeshFromSelection(bool removeSelectedFaces)
 {
 	if (!m_associatedCloud)
@@ -27,6 +27,8 @@
 #include "ccGenericMesh.h"
 #include "ccMaterial.h"
 
+class ccMeshLOD;
+
 //! Triangular mesh
 class QCC_DB_LIB_API ccMesh : public ccGenericMesh
 {
@@ -66,6 +68,39 @@ public:
 								NormsIndexesTableType* clonedNormsTable = 0,
 								TextureCoordsContainer* cloneTexCoords = 0);
 
+	//! Creates an instance of this mesh
+	/** The instance shares the vertices, the triangles and the per-triangle
+		normals of this mesh (nothing is duplicated) and is only placed by its
+		own display transformation (see ccDrawableObject::setGLTransformation).
+		If this mesh is deleted, its instances lose their geometry (they become
+		empty but stay valid).
+		Warnings:
+		- this mesh geometry shouldn't be modified as long as instances exist
+		- the instance transformation is meant to stay a display one (i.e. it
+		shouldn't be 'applied' with ccHObject::applyGLTransformation_recursive)
+		\param trans instance (display) transformation
+		\return instance
+	**/
+	ccMesh* createInstance(const ccGLMatrix& trans);
+
+	//! Returns the mesh this one is an instance of (if any)
+	/** See ccMesh::createInstance.
+	**/
+	inline ccMesh* getPrototype() const { return m_prototype; }
+
+	//! Returns the display L.O.D. levels of this mesh (if any)
+	/** Instances use the levels of their prototype (see ccMesh::createInstance)
+		and merged meshes the ones of the merged meshes (see ccMesh::merge).
+		\return levels (or 0 if none)
+	**/
+	virtual ccMeshLOD* getLOD();
+
+	//! Releases the display L.O.D. levels of this mesh
+	/** Should be called whenever the mesh geometry is modified (automatically
+		done when it's transformed).
+	**/
+	void clearLOD();
+
 	//! Creates a Delaunay 2.5D mesh from a point cloud
 	/** See CCLib::PointProjectionTools::computeTriangulation.
 	**/
@@ -77,8 +112,26 @@ public:
 
 	//! Merges another mesh into this one
 	/** \param mesh mesh to be merged in this one
+		\param withLOD whether the display L.O.D. levels should be merged as well (see getLOD)
+	**/
+	bool merge(const ccMesh* mesh, bool withLOD = true);
+
+	//! Meta-data key: names of the entities baked in a (merged) mesh
+	/** Stored as a QStringList. The index of the source entity of each vertex
+		is stored in a dedicated scalar field (see ccMesh::SourceIndexSFName).
+		As source entities don't share vertices, it's also the source of each
+		triangle.
+	**/
+	static QString MetaKeySourceNames()		{ return "merged.source.names"; }
+	//! Name of the vertices scalar field storing the index of their source entity
+	static QString SourceIndexSFName()		{ return "Source index"; }
+
+	//! Returns the name of the source entity of a given vertex (merged meshes only)
+	/** See ccMesh::MetaKeySourceNames.
+		\param vertIndex vertex index
+		\return source entity name (or an empty string if not available)
 	**/
-	bool merge(const ccMesh* mesh);
+	QString getSourceName(unsigned vertIndex) const;
 
 	//inherited methods (ccHObject)
 	virtual unsigned getUniqueIDForDisplay() const;
@@ -373,6 +426,9 @@ protected:
 	//! Same as other 'interpolateColors' method with a set of 3 vertices indexes
 	bool interpolateColors(unsigned i1, unsigned i2, unsigned i3, const CCVector3& P, ccColor::Rgb& C);
 
+	//! Draws a display L.O.D. level (see getLOD)
+	void drawLODLevel(CC_DRAW_CONTEXT& context, const ccMeshLOD& lod, unsigned levelIndex, const glDrawParams& glParams);
+
 	//! Used internally by 'subdivide'
 	bool pushSubdivide(/*PointCoordinateType maxArea, */unsigned indexA, unsigned indexB, unsigned indexC);
 
@@ -440,6 +496,12 @@ protected:
 	typedef GenericChunkedArray<3,int> triangleNormalsIndexesSet;
 	//! Mesh normals indexes (per-triangle)
 	triangleNormalsIndexesSet* m_triNormalIndexes;
+
+	//! Mesh this one is an instance of (see ccMesh::createInstance)
+	ccMesh* m_prototype;
+
+	//! Display L.O.D. levels (see getLOD)
+	ccMeshLOD* m_lod;
 };
 
 #endif //CC_MESH_HEADER
@@ -0,0 +1,244 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccMeshLOD.h"
+
+//Local
+#include "ccMesh.h"
+#include "ccGenericPointCloud.h"
+#include "ccNormalVectors.h"
+
+//System
+#include <map>
+#include <algorithm>
+#include <assert.h>
+
+ccMeshLOD::ccMeshLOD()
+	: CCShareable()
+{
+}
+
+bool ccMeshLOD::Level::append(const Level& level)
+{
+	assert(&level != this);
+
+	try
+	{
+		//both levels must have colors (or none)
+		bool withColors = (!colors.empty() || !level.colors.empty());
+		if (withColors)
+			colors.resize(vertices.size()*3,ccColor::MAX);
+
+		unsigned indexShift = static_cast<unsigned>(vertices.size());
+		vertices.insert(vertices.end(),level.vertices.begin(),level.vertices.end());
+		normals.insert(normals.end(),level.normals.begin(),level.normals.end());
+		if (withColors)
+		{
+			if (level.colors.empty())
+				colors.resize(vertices.size()*3,ccColor::MAX);
+			else
+				colors.insert(colors.end(),level.colors.begin(),level.colors.end());
+		}
+
+		indexes.reserve(indexes.size() + level.indexes.size());
+		for (size_t i=0; i<level.indexes.size(); ++i)
+			indexes.push_back(level.indexes[i] + indexShift);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	maxError = std::max(maxError,level.maxError);
+
+	return true;
+}
+
+bool ccMeshLOD::AppendMesh(Level& level, const ccMesh& mesh, unsigned firstTriangle, unsigned lastTriangle)
+{
+	ccGenericPointCloud* vertices = mesh.getAssociatedCloud();
+	if (!vertices)
+		return false;
+
+	assert(firstTriangle <= lastTriangle && lastTriangle <= mesh.size());
+
+	NormsIndexesTableType* triNormals = (mesh.hasTriNormals() ? mesh.getTriNormsTable() : 0);
+	bool vertNormals = vertices->hasNormals();
+	bool vertColors = vertices->hasColors();
+	bool withColors = (vertColors || !level.colors.empty());
+
+	try
+	{
+		//the previous vertices get a default color if necessary
+		if (withColors)
+			level.colors.resize(level.vertices.size()*3,ccColor::MAX);
+
+		//a vertex is shared by the triangles that use the same normal for it
+		std::map< std::pair<unsigned,int>, unsigned > newIndexes;
+
+		for (unsigned t=firstTriangle; t<lastTriangle; ++t)
+		{
+			const CCLib::TriangleSummitsIndexes* tsi = mesh.getTriangleIndexes(t);
+			const unsigned vertIndexes[3] = { tsi->i1, tsi->i2, tsi->i3 };
+
+			int normIndexes[3] = { -1, -1, -1 };
+			if (triNormals)
+				mesh.getTriangleNormalIndexes(t,normIndexes[0],normIndexes[1],normIndexes[2]);
+
+			for (unsigned j=0; j<3; ++j)
+			{
+				//without any normal, the vertex gets the triangle normal (and can't be shared)
+				bool shared = (normIndexes[j] >= 0 || vertNormals);
+				std::pair<unsigned,int> key(vertIndexes[j],normIndexes[j]);
+				if (shared)
+				{
+					std::map< std::pair<unsigned,int>, unsigned >::const_iterator it = newIndexes.find(key);
+					if (it != newIndexes.end())
+					{
+						level.indexes.push_back(it->second);
+						continue;
+					}
+				}
+
+				unsigned newIndex = static_cast<unsigned>(level.vertices.size());
+				level.vertices.push_back(*vertices->getPoint(vertIndexes[j]));
+
+				if (normIndexes[j] >= 0)
+				{
+					level.normals.push_back(ccNormalVectors::GetNormal(triNormals->getValue(normIndexes[j])));
+				}
+				else if (vertNormals)
+				{
+					level.normals.push_back(vertices->getPointNormal(vertIndexes[j]));
+				}
+				else
+				{
+					const CCVector3* A = vertices->getPoint(vertIndexes[0]);
+					const CCVector3* B = vertices->getPoint(vertIndexes[1]);
+					const CCVector3* C = vertices->getPoint(vertIndexes[2]);
+					CCVector3 N = (*B-*A).cross(*C-*A);
+					N.normalize();
+					level.normals.push_back(N);
+				}
+
+				if (withColors)
+				{
+					const colorType* col = (vertColors ? vertices->getPointColor(vertIndexes[j]) : ccColor::white.rgba);
+					level.colors.insert(level.colors.end(),col,col+3);
+				}
+
+				level.indexes.push_back(newIndex);
+				if (shared)
+					newIndexes[key] = newIndex;
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool ccMeshLOD::merge(const ccMesh& mesh, unsigned triCount, const ccMesh& merged, const ccMeshLOD* mergedLOD)
+{
+	if (mergedLOD && mergedLOD->levels.empty())
+		mergedLOD = 0;
+
+	//new levels start with the content of the current coarsest one
+	//(or with the full resolution mesh if there's none)
+	size_t levelCount = std::max(levels.size(), mergedLOD ? mergedLOD->levels.size() : 0);
+	try
+	{
+		levels.reserve(levelCount);
+		while (levels.size() < levelCount)
+		{
+			if (levels.empty())
+			{
+				levels.push_back(Level());
+				if (!AppendMesh(levels.back(),mesh,0,triCount))
+					return false;
+			}
+			else
+			{
+				levels.push_back(levels.back());
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	for (size_t i=0; i<levels.size(); ++i)
+	{
+		if (mergedLOD)
+		{
+			//the merged mesh may have less levels
+			const Level& mergedLevel = mergedLOD->levels[std::min(i,mergedLOD->levels.size()-1)];
+			if (!levels[i].append(mergedLevel))
+				return false;
+		}
+		else if (!AppendMesh(levels[i],merged,0,merged.size()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ccMeshLOD::applyTransformation(const ccGLMatrix& trans)
+{
+	for (size_t i=0; i<levels.size(); ++i)
+	{
+		Level& level = levels[i];
+		for (size_t j=0; j<level.vertices.size(); ++j)
+			trans.apply(level.vertices[j]);
+		for (size_t j=0; j<level.normals.size(); ++j)
+			trans.applyRotation(level.normals[j]);
+	}
+}
+
+int ccMeshLOD::getLevelIndex(const CC_DRAW_CONTEXT& context, const CCVector3& center, PointCoordinateType radius) const
+{
+	if (	levels.empty()
+		||	context.primitiveMaxScreenError <= 0
+		||	context.lodPixelSize <= 0)
+	{
+		return -1;
+	}
+
+	//pixel size at the mesh position
+	double pixelSize = context.lodPixelSize;
+	if (context.lodPerspective)
+	{
+		double dist = (CCVector3d(center.x,center.y,center.z) - context.lodCameraCenter).norm() - radius;
+		if (dist <= 0)
+			return -1;
+		pixelSize *= dist;
+	}
+
+	//coarsest level that is precise enough (the error increases with the level)
+	double maxError = context.primitiveMaxScreenError * pixelSize;
+	int levelIndex = -1;
+	for (size_t i=0; i<levels.size() && levels[i].maxError <= maxError; ++i)
+		levelIndex = static_cast<int>(i);
+
+	return levelIndex;
+}
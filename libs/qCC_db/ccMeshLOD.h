@@ -0,0 +1,115 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_MESH_LOD_HEADER
+#define CC_MESH_LOD_HEADER
+
+//CCLib
+#include <CCShareable.h>
+#include <CCGeom.h>
+
+//Local
+#include "qCC_db.h"
+#include "ccColorTypes.h"
+#include "ccDrawableObject.h"
+
+//System
+#include <vector>
+
+class ccMesh;
+
+//! Display L.O.D. levels of a mesh
+/** Each level is a coarser version of the mesh stored as plain vertex, normal,
+	color and index buffers (in the same coordinate system as the mesh vertices)
+	along with its max. geometric error. The levels of a mesh are shared by its
+	instances (see ccMesh::createInstance) and the ones of merged meshes are
+	concatenated (see ccMesh::merge). It's only a display cache: it's transformed
+	along with the mesh but it should be released if the mesh geometry is modified
+	in any other way (see ccMesh::clearLOD).
+**/
+class QCC_DB_LIB_API ccMeshLOD : public CCShareable
+{
+public:
+
+	//! L.O.D. level
+	struct Level
+	{
+		//! Vertices
+		std::vector<CCVector3> vertices;
+		//! Per-vertex normals
+		std::vector<CCVector3> normals;
+		//! Per-vertex colors (RGB - empty if the mesh has no colors)
+		std::vector<colorType> colors;
+		//! Triangles (3 vertex indexes per triangle)
+		std::vector<unsigned> indexes;
+		//! Max. geometric error (distance to the full resolution mesh)
+		PointCoordinateType maxError;
+
+		//! Default constructor
+		Level() : maxError(0) {}
+
+		//! Appends another level
+		/** \return success (false if not enough memory)
+		**/
+		bool append(const Level& level);
+	};
+
+	//! Default constructor
+	ccMeshLOD();
+
+	//! Levels (from the finest to the coarsest)
+	std::vector<Level> levels;
+
+	//! Appends triangles of a mesh to a level
+	/** Vertices with different (per-triangle) normals are duplicated.
+		\param level level
+		\param mesh mesh
+		\param firstTriangle index of the first triangle to append
+		\param lastTriangle index of the last triangle to append (excluded)
+		\return success (false if not enough memory)
+	**/
+	static bool AppendMesh(Level& level, const ccMesh& mesh, unsigned firstTriangle, unsigned lastTriangle);
+
+	//! Appends the levels of a mesh merged in the one these levels belong to
+	/** Each level is extended with the corresponding level of the merged mesh
+		(or with its coarsest one, or with the mesh itself if it has none).
+		\param mesh mesh these levels belong to
+		\param triCount number of triangles of 'mesh' before merging
+		\param merged merged mesh
+		\param mergedLOD levels of the merged mesh (may be 0)
+		\return success (false if not enough memory)
+	**/
+	bool merge(const ccMesh& mesh, unsigned triCount, const ccMesh& merged, const ccMeshLOD* mergedLOD);
+
+	//! Applies a (rigid) transformation to all levels
+	void applyTransformation(const ccGLMatrix& trans);
+
+	//! Returns the coarsest level for which the screen-space error stays below glDrawContext::primitiveMaxScreenError
+	/** \param context display context
+		\param center center of the mesh bounding sphere (in the display coordinate system)
+		\param radius radius of the mesh bounding sphere
+		\return level index (or -1 if the full resolution mesh should be displayed)
+	**/
+	int getLevelIndex(const CC_DRAW_CONTEXT& context, const CCVector3& center, PointCoordinateType radius) const;
+
+protected:
+
+	//! Destructor (see CCShareable)
+	virtual ~ccMeshLOD() {}
+};
+
+#endif //CC_MESH_LOD_HEADER
@@ -134,7 +134,7 @@ void ccNormalVectors::InvertNormal(normsType &code)
 	code += ((code & mask) ? -mask : mask);
 }
 
-bool ccNormalVectors::UpdateNormalOrientations(	ccGenericPointCloud* theCloud,
+bool ccNormalVectors::UpdateNormalOrientations(	CCLib::GenericIndexedCloudPersist* theCloud,
 												NormsIndexesTableType& theNormsCodes,
 												int preferedOrientation)
 {
@@ -178,13 +178,15 @@ bool ccNormalVectors::UpdateNormalOrientations(	ccGenericPointCloud* theCloud,
 		//we check sign
 		if (useBarycenter)
 		{
+			CCVector3 P;
+			theCloud->getPoint(i,P);
 			if (positiveSign)
 			{
-				orientation = *(theCloud->getPoint(i)) - barycenter;
+				orientation = P - barycenter;
 			}
 			else
 			{
-				orientation = barycenter - *(theCloud->getPoint(i));
+				orientation = barycenter - P;
 			}
 		}
 
@@ -199,7 +201,7 @@ bool ccNormalVectors::UpdateNormalOrientations(	ccGenericPointCloud* theCloud,
 	return true;
 }
 
-bool ccNormalVectors::ComputeCloudNormals(	ccGenericPointCloud* theCloud,
+bool ccNormalVectors::ComputeCloudNormals(	CCLib::GenericIndexedCloudPersist* theCloud,
 											NormsIndexesTableType& theNormsCodes,
 											CC_LOCAL_MODEL_TYPES method,
 											PointCoordinateType radius,
@@ -233,19 +235,11 @@ bool ccNormalVectors::ComputeCloudNormals(	ccGenericPointCloud* theCloud,
 			return false;
 		}
 
-	//we instantiate 'n' 3D normal vectors
-	NormsTableType* theNorms = new NormsTableType;
+	//the normals are directly stored in compressed form (the points without normal keep the 'blank' one)
 	CCVector3 blankN(0.0,0.0,0.0);
-	if (!theNorms->resize(n,true,blankN.u))
-	{
-		theNormsCodes.clear();
-		if (!inputOctree)
-			delete theOctree;
-		return false;
-	}
-	//theNorms->fill(0);
+	theNormsCodes.fill(GetNormIndex(blankN));
 
-	void* additionalParameters[2] = { (void*)theNorms, (void*)&radius };
+	void* additionalParameters[2] = { (void*)&theNormsCodes, (void*)&radius };
 
 	unsigned processedCells = 0;
 	switch(method)
@@ -303,23 +297,11 @@ bool ccNormalVectors::ComputeCloudNormals(	ccGenericPointCloud* theCloud,
 	if (processedCells == 0 || (progressCb && progressCb->isCancelRequested()))
 	{
 		theNormsCodes.clear();
+		if (!inputOctree)
+			delete theOctree;
 		return false;
 	}
 
-	//we 'compress' each normal (and we check its orientation if necessary)
-	theNormsCodes.fill(0);
-	theNorms->placeIteratorAtBegining();
-	for (unsigned i=0; i<n; i++)
-	{
-		const PointCoordinateType* N = theNorms->getCurrentValue();
-		normsType nCode = GetNormIndex(N);
-		theNormsCodes.setValue(i,nCode);
-		theNorms->forwardIterator();
-	}
-
-	theNorms->release();
-	theNorms = 0;
-
 	//prefered orientation
 	if (preferedOrientation >= 0)
 		UpdateNormalOrientations(theCloud,theNormsCodes,preferedOrientation);
@@ -338,7 +320,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithHF(const CCLib::DgmOctree::octreeCe
 												CCLib::NormalizedProgress* nProgress/*=0*/)
 {
 	//additional parameters
-	NormsTableType* theNorms	= static_cast<NormsTableType*>(additionalParameters[0]);
+	NormsIndexesTableType* theNormsCodes	= static_cast<NormsIndexesTableType*>(additionalParameters[0]);
 	PointCoordinateType radius	= *static_cast<PointCoordinateType*>(additionalParameters[1]);
 
 	CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
@@ -391,7 +373,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithHF(const CCLib::DgmOctree::octreeCe
 				//on normalise
 				CCVector3::vnormalize(N);
 
-				theNorms->setValue(cell.points->getPointGlobalIndex(i),N);
+				theNormsCodes->setValue(cell.points->getPointGlobalIndex(i),GetNormIndex(N));
 			}
 		}
 
@@ -407,7 +389,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCLib::DgmOctree::octreeCe
 												CCLib::NormalizedProgress* nProgress/*=0*/)
 {
 	//additional parameters
-	NormsTableType* theNorms	= static_cast<NormsTableType*>(additionalParameters[0]);
+	NormsIndexesTableType* theNormsCodes	= static_cast<NormsIndexesTableType*>(additionalParameters[0]);
 	PointCoordinateType radius	= *static_cast<PointCoordinateType*>(additionalParameters[1]);
 
 	CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
@@ -444,7 +426,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCLib::DgmOctree::octreeCe
 			const CCVector3* lsqPlaneNormal = Z.getLSQPlaneNormal();
 			if (lsqPlaneNormal) //should already be unit!
 			{
-				theNorms->setValue(cell.points->getPointGlobalIndex(i),lsqPlaneNormal->u);
+				theNormsCodes->setValue(cell.points->getPointGlobalIndex(i),GetNormIndex(lsqPlaneNormal->u));
 			}
 		}
 
@@ -460,7 +442,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(	const CCLib::DgmOctree::octree
 													CCLib::NormalizedProgress* nProgress/*=0*/)
 {
 	//additional parameters
-	NormsTableType* theNorms = static_cast<NormsTableType*>(additionalParameters[0]);
+	NormsIndexesTableType* theNormsCodes = static_cast<NormsIndexesTableType*>(additionalParameters[0]);
 
 	CCLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
 	nNSS.level												= cell.level;
@@ -526,7 +508,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(	const CCLib::DgmOctree::octree
 
 				//normalize the 'mean' vector
 				N.normalize();
-				theNorms->setValue(cell.points->getPointGlobalIndex(i),N.u);
+				theNormsCodes->setValue(cell.points->getPointGlobalIndex(i),GetNormIndex(N.u));
 			}
 		}
 
@@ -83,7 +83,7 @@ public:
 		\param inputOctree octree associated with theCloud.
 		\return success
 	**/
-	static bool ComputeCloudNormals(ccGenericPointCloud* theCloud,
+	static bool ComputeCloudNormals(CCLib::GenericIndexedCloudPersist* theCloud,
 									NormsIndexesTableType& theNormsCodes,
 									CC_LOCAL_MODEL_TYPES method,
 									PointCoordinateType radius,
@@ -97,7 +97,7 @@ public:
 		\param preferedOrientation specifies a preferred orientation for normals (0:+X, 1:-X, 2:+Y, 3:-Y, 4:+Z, 5:-Z, 6:+Barycenter, 7:-Barycenter, 8:+Zero, 9:-Zero)
 		\return success
 	**/
-	static bool UpdateNormalOrientations(	ccGenericPointCloud* theCloud,
+	static bool UpdateNormalOrientations(	CCLib::GenericIndexedCloudPersist* theCloud,
 											NormsIndexesTableType& theNormsCodes,
 											int preferedOrientation);
 
@@ -52,8 +52,9 @@
 	v3.7 - 08/24/2014 - Textures are stored and saved as a single DB with only references to them in each material (key = absolute filename)
 	v3.8 - 09/14/2014 - GBL and camera sensors structures have evolved
 	v3.9 - 01/30/2015 - Shift & scale information are now saved for polylines (+ separate interface)
+	v4.0 - 03/02/2015 - The octree structure of point clouds is now saved (optional)
 **/
-const unsigned c_currentDBVersion = 39; //3.9
+const unsigned c_currentDBVersion = 40; //4.0
 
 //! Default unique ID generator (using the system persistent settings as we did previously proved to be not reliable)
 static ccUniqueIDGenerator::Shared s_uniqueIDGenerator(new ccUniqueIDGenerator);
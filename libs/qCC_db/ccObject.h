@@ -26,6 +26,7 @@
 #include <QString>
 #include <QVariant>
 #include <QSharedPointer>
+#include <QAtomicInt>
 
 //System
 #include <stdint.h>
@@ -160,17 +161,25 @@ public:
 	ccUniqueIDGenerator() : m_lastUniqueID(0) {}
 
 	//! Resets the unique ID
-	void reset() { m_lastUniqueID = 0; }
+	void reset() { m_lastUniqueID.fetchAndStoreOrdered(0); }
 	//! Returns a (new) unique ID
-	unsigned fetchOne() { return ++m_lastUniqueID; }
+	/** Thread-safe (entities may be created by other threads, e.g. see
+		ccGenericPrimitive::StartBackgroundTessellation).
+	**/
+	unsigned fetchOne() { return static_cast<unsigned>(m_lastUniqueID.fetchAndAddOrdered(1)) + 1; }
 
 	//! Returns the value of the last generated unique ID
-	unsigned getLast() const { return m_lastUniqueID; }
+	unsigned getLast() const { return static_cast<unsigned>(const_cast<QAtomicInt&>(m_lastUniqueID).fetchAndAddOrdered(0)); }
 	//! Updates the value of the last generated unique ID with the current one
-	void update(unsigned ID) { if (ID > m_lastUniqueID) m_lastUniqueID = ID; }
+	void update(unsigned ID)
+	{
+		int last = static_cast<int>(getLast());
+		while (ID > static_cast<unsigned>(last) && !m_lastUniqueID.testAndSetOrdered(last,static_cast<int>(ID)))
+			last = static_cast<int>(getLast());
+	}
 
 protected:
-	unsigned m_lastUniqueID;
+	QAtomicInt m_lastUniqueID;
 };
 
 //==================================================CLASS CCOBJECT==========================================================//
@@ -31,6 +31,11 @@
 #include <Neighbourhood.h>
 #include <CCMiscTools.h>
 
+//System
+#include <stdint.h>
+#include <assert.h>
+#include <algorithm>
+
 ccOctreeSpinBox::ccOctreeSpinBox(QWidget* parent/*=0*/)
 	: QSpinBox(parent)
 	, m_octreeBoxWidth(0)
@@ -142,6 +147,95 @@ void ccOctree::clear()
 	DgmOctree::clear();
 }
 
+bool ccOctree::addPoints(unsigned firstIndex)
+{
+	if (!DgmOctree::addPoints(firstIndex))
+		return false;
+
+	notifyStructureUpdate();
+	return true;
+}
+
+bool ccOctree::removePoints(const std::vector<bool>& removedPoints)
+{
+	if (!DgmOctree::removePoints(removedPoints))
+		return false;
+
+	notifyStructureUpdate();
+	return true;
+}
+
+void ccOctree::reindexInOctreeOrder()
+{
+	DgmOctree::reindexInOctreeOrder();
+
+	notifyStructureUpdate();
+}
+
+//! Sends the search statistics of a cells traversal to the console
+static void LogSearchStatistics(const char* functionTitle, const CCLib::DgmOctree::SearchStatistics& stats)
+{
+	const double toMs = 1.0e-6;
+
+	ccLog::Print(QString("[Octree statistics] %1: %2 cells processed in %3 ms (cells extraction: %4 ms, cell functions: %5 ms, including neighbourhoods extraction: %6 ms)")
+					.arg(functionTitle ? functionTitle : "Process")
+					.arg(stats.processedCells)
+					.arg(static_cast<double>(stats.elapsedTime_ns)*toMs,0,'f',1)
+					.arg(static_cast<double>(stats.cellExtractionTime_ns)*toMs,0,'f',1)
+					.arg(static_cast<double>(stats.cellFunctionTime_ns)*toMs,0,'f',1)
+					.arg(static_cast<double>(stats.neighbourhoodExtractionTime_ns)*toMs,0,'f',1));
+
+	if (stats.searches != 0)
+	{
+		ccLog::Print(QString("[Octree statistics] Searches: %1 - tested points: %2 (%3 per search) - skipped points: %4 - gathered points: %5")
+						.arg(stats.searches)
+						.arg(stats.testedPoints)
+						.arg(static_cast<double>(stats.testedPoints)/static_cast<double>(stats.searches),0,'f',1)
+						.arg(stats.skippedPoints)
+						.arg(stats.gatheredPoints));
+	}
+
+	if (stats.binarySearches != 0)
+	{
+		ccLog::Print(QString("[Octree statistics] Binary searches: %1 (mean jumps: %2)")
+						.arg(stats.binarySearches)
+						.arg(static_cast<double>(stats.binarySearchJumps)/static_cast<double>(stats.binarySearches),0,'f',2));
+	}
+
+	QString histogram;
+	for (unsigned i=0; i<CCLib::DgmOctree::POPULATION_HISTOGRAM_SIZE; ++i)
+	{
+		if (stats.cellPopulationHistogram[i] == 0)
+			continue;
+		if (!histogram.isEmpty())
+			histogram += " - ";
+		if (i+1 < CCLib::DgmOctree::POPULATION_HISTOGRAM_SIZE)
+			histogram += QString("[%1-%2]: %3").arg(1u << i).arg((2u << i)-1).arg(stats.cellPopulationHistogram[i]);
+		else
+			histogram += QString("[%1+]: %2").arg(1u << i).arg(stats.cellPopulationHistogram[i]);
+	}
+	if (!histogram.isEmpty())
+		ccLog::Print(QString("[Octree statistics] Cells population: %1").arg(histogram));
+}
+
+void ccOctree::EnableSearchStatisticsLog(bool state)
+{
+	CCLib::DgmOctree::SetSearchStatisticsReporter(state ? LogSearchStatistics : 0);
+	CCLib::DgmOctree::EnableSearchStatistics(state);
+}
+
+void ccOctree::notifyStructureUpdate()
+{
+	m_shouldBeRefreshed = true;
+
+	//will be rebuilt on demand
+	if (m_frustrumIntersector)
+	{
+		delete m_frustrumIntersector;
+		m_frustrumIntersector = 0;
+	}
+}
+
 ccBBox ccOctree::getOwnBB(bool withGLFeatures/*=false*/)
 {
 	if (withGLFeatures)
@@ -154,6 +248,266 @@ ccBBox ccOctree::getOwnBB(bool withGLFeatures/*=false*/)
 	}
 }
 
+//! Number of elements written/read at once when (de)serializing the octree structure
+static const unsigned c_structureIOBlockSize = 65536;
+
+bool ccOctree::structureToFile(QFile& out) const
+{
+	assert(out.isOpen() && (out.openMode() & QIODevice::WriteOnly));
+
+	//max octree level (dataVersion>=40)
+	::uint8_t maxLevel = static_cast< ::uint8_t >(MAX_OCTREE_LEVEL);
+	if (out.write((const char*)&maxLevel,1) < 0)
+		return WriteError();
+
+	//associated cloud size and bounding-box, for validation (dataVersion>=40)
+	{
+		::uint32_t cloudSize = static_cast< ::uint32_t >(m_theAssociatedCloud->size());
+		if (out.write((const char*)&cloudSize,4) < 0)
+			return WriteError();
+
+		CCVector3 bbMin, bbMax;
+		m_theAssociatedCloud->getBoundingBox(bbMin.u,bbMax.u);
+		double bb[6] = { bbMin.x, bbMin.y, bbMin.z, bbMax.x, bbMax.y, bbMax.z };
+		if (out.write((const char*)bb,sizeof(double)*6) < 0)
+			return WriteError();
+	}
+
+	//octree box and 'accepted points' box (dataVersion>=40)
+	{
+		double limits[12] = {	m_dimMin.x,    m_dimMin.y,    m_dimMin.z,
+								m_dimMax.x,    m_dimMax.y,    m_dimMax.z,
+								m_pointsMin.x, m_pointsMin.y, m_pointsMin.z,
+								m_pointsMax.x, m_pointsMax.y, m_pointsMax.z };
+		if (out.write((const char*)limits,sizeof(double)*12) < 0)
+			return WriteError();
+	}
+
+	//compact storage (dataVersion>=40)
+	if (out.write((const char*)&m_compactStorage,sizeof(bool)) < 0)
+		return WriteError();
+
+	//sorted points indexes and cell codes (dataVersion>=40)
+	//--> we write them as blocks of indexes and blocks of codes (faster)
+	{
+		::uint32_t elementCount = static_cast< ::uint32_t >(m_numberOfProjectedPoints);
+		if (out.write((const char*)&elementCount,4) < 0)
+			return WriteError();
+
+		std::vector< ::uint32_t > indexes;
+		std::vector< ::int64_t > codes;
+		try
+		{
+			indexes.resize(std::min(elementCount,c_structureIOBlockSize));
+			codes.resize(indexes.size());
+		}
+		catch (const std::bad_alloc&)
+		{
+			return MemoryError();
+		}
+
+		for (unsigned first=0; first<elementCount; first+=c_structureIOBlockSize)
+		{
+			unsigned count = std::min(elementCount-first,c_structureIOBlockSize);
+			for (unsigned i=0; i<count; ++i)
+			{
+				IndexAndCode element = m_thePointsAndTheirCellCodes[first+i];
+				indexes[i] = static_cast< ::uint32_t >(element.theIndex);
+				codes[i] = static_cast< ::int64_t >(element.theCode);
+			}
+			if (	out.write((const char*)&(indexes[0]),sizeof(::uint32_t)*count) < 0
+				||	out.write((const char*)&(codes[0]),sizeof(::int64_t)*count) < 0 )
+				return WriteError();
+		}
+	}
+
+	//fill indexes (dataVersion>=40)
+	{
+		::int32_t fillIndexes[(MAX_OCTREE_LEVEL+1)*6];
+		for (int i=0; i<(MAX_OCTREE_LEVEL+1)*6; ++i)
+			fillIndexes[i] = static_cast< ::int32_t >(m_fillIndexes[i]);
+		if (out.write((const char*)fillIndexes,sizeof(::int32_t)*(MAX_OCTREE_LEVEL+1)*6) < 0)
+			return WriteError();
+	}
+
+	//cells statistics for each level (dataVersion>=40)
+	for (int level=0; level<=MAX_OCTREE_LEVEL; ++level)
+	{
+		::uint32_t counts[3] = {	static_cast< ::uint32_t >(m_cellCount[level]),
+									static_cast< ::uint32_t >(m_maxCellPopulation[level]),
+									static_cast< ::uint32_t >(m_mostPopulatedCellCount[level]) };
+		double population[2] = { m_averageCellPopulation[level], m_stdDevCellPopulation[level] };
+		::uint64_t squareSum = static_cast< ::uint64_t >(m_cellPopulationSquareSum[level]);
+		if (	out.write((const char*)counts,sizeof(::uint32_t)*3) < 0
+			||	out.write((const char*)population,sizeof(double)*2) < 0
+			||	out.write((const char*)&squareSum,8) < 0 )
+			return WriteError();
+	}
+
+	return true;
+}
+
+bool ccOctree::structureFromFile(QFile& in, short dataVersion, bool& restored)
+{
+	assert(in.isOpen() && (in.openMode() & QIODevice::ReadOnly));
+
+	restored = false;
+	clear();
+
+	if (dataVersion < 40)
+		return CorruptError();
+
+	//max octree level (dataVersion>=40)
+	::uint8_t maxLevel = 0;
+	if (in.read((char*)&maxLevel,1) < 0)
+		return ReadError();
+	//the structure is only valid if the cells codes have the same depth
+	bool valid = (maxLevel == static_cast< ::uint8_t >(MAX_OCTREE_LEVEL));
+
+	//associated cloud size and bounding-box (dataVersion>=40)
+	{
+		::uint32_t cloudSize = 0;
+		double bb[6];
+		if (	in.read((char*)&cloudSize,4) < 0
+			||	in.read((char*)bb,sizeof(double)*6) < 0 )
+			return ReadError();
+
+		if (cloudSize != m_theAssociatedCloud->size())
+		{
+			valid = false;
+		}
+		else if (cloudSize != 0)
+		{
+			CCVector3 bbMin, bbMax;
+			m_theAssociatedCloud->getBoundingBox(bbMin.u,bbMax.u);
+			for (int dim=0; dim<3; ++dim)
+				if (	bbMin.u[dim] != static_cast<PointCoordinateType>(bb[dim])
+					||	bbMax.u[dim] != static_cast<PointCoordinateType>(bb[dim+3]) )
+					valid = false;
+		}
+	}
+
+	//octree box and 'accepted points' box (dataVersion>=40)
+	{
+		double limits[12];
+		if (in.read((char*)limits,sizeof(double)*12) < 0)
+			return ReadError();
+		for (int dim=0; dim<3; ++dim)
+		{
+			m_dimMin.u[dim]    = static_cast<PointCoordinateType>(limits[dim]);
+			m_dimMax.u[dim]    = static_cast<PointCoordinateType>(limits[dim+3]);
+			m_pointsMin.u[dim] = static_cast<PointCoordinateType>(limits[dim+6]);
+			m_pointsMax.u[dim] = static_cast<PointCoordinateType>(limits[dim+9]);
+		}
+	}
+
+	//compact storage (dataVersion>=40)
+	bool compactStorage = false;
+	if (in.read((char*)&compactStorage,sizeof(bool)) < 0)
+		return ReadError();
+
+	//sorted points indexes and cell codes (dataVersion>=40)
+	::uint32_t elementCount = 0;
+	if (in.read((char*)&elementCount,4) < 0)
+		return ReadError();
+	if (elementCount > m_theAssociatedCloud->size())
+		valid = false;
+
+	cellsContainer elements;
+	{
+		std::vector< ::uint32_t > indexes;
+		std::vector< ::int64_t > codes;
+		try
+		{
+			indexes.resize(std::min(elementCount,c_structureIOBlockSize));
+			codes.resize(indexes.size());
+			//we still have to read the data if the structure is not valid
+			if (valid)
+				elements.resize(elementCount);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return MemoryError();
+		}
+
+		//max code value (MAX_OCTREE_LEVEL*3 bits)
+		const ::int64_t maxCode = static_cast< ::int64_t >((static_cast<quint64>(1) << (3*MAX_OCTREE_LEVEL)) - 1);
+
+		for (unsigned first=0; first<elementCount; first+=c_structureIOBlockSize)
+		{
+			unsigned count = std::min(elementCount-first,c_structureIOBlockSize);
+			if (	in.read((char*)&(indexes[0]),sizeof(::uint32_t)*count) < 0
+				||	in.read((char*)&(codes[0]),sizeof(::int64_t)*count) < 0 )
+				return ReadError();
+
+			for (unsigned i=0; i<count && valid; ++i)
+			{
+				IndexAndCode& element = elements[first+i];
+				element.theIndex = static_cast<unsigned>(indexes[i]);
+				element.theCode = static_cast<OctreeCellCodeType>(codes[i]);
+
+				//the elements must be valid and sorted (by code, then by index)
+				valid = (	codes[i] >= 0 && codes[i] <= maxCode
+						&&	indexes[i] < m_theAssociatedCloud->size()
+						&&	(first+i == 0 || IndexAndCode::codeAndIndexComp(elements[first+i-1],element)) );
+			}
+		}
+	}
+
+	//fill indexes (dataVersion>=40)
+	{
+		::int32_t fillIndexes[(MAX_OCTREE_LEVEL+1)*6];
+		if (valid)
+		{
+			if (in.read((char*)fillIndexes,sizeof(::int32_t)*(MAX_OCTREE_LEVEL+1)*6) < 0)
+				return ReadError();
+			for (int i=0; i<(MAX_OCTREE_LEVEL+1)*6; ++i)
+				m_fillIndexes[i] = static_cast<int>(fillIndexes[i]);
+		}
+		else if (!in.seek(in.pos() + sizeof(::int32_t)*6*(static_cast<qint64>(maxLevel)+1)))
+		{
+			return ReadError();
+		}
+	}
+
+	//cells statistics for each level (dataVersion>=40)
+	for (int level=0; level<=static_cast<int>(maxLevel); ++level)
+	{
+		::uint32_t counts[3];
+		double population[2];
+		::uint64_t squareSum = 0;
+		if (	in.read((char*)counts,sizeof(::uint32_t)*3) < 0
+			||	in.read((char*)population,sizeof(double)*2) < 0
+			||	in.read((char*)&squareSum,8) < 0 )
+			return ReadError();
+
+		if (valid)
+		{
+			m_cellCount[level] = static_cast<unsigned>(counts[0]);
+			m_maxCellPopulation[level] = static_cast<unsigned>(counts[1]);
+			m_mostPopulatedCellCount[level] = static_cast<unsigned>(counts[2]);
+			m_averageCellPopulation[level] = population[0];
+			m_stdDevCellPopulation[level] = population[1];
+			m_cellPopulationSquareSum[level] = static_cast<quint64>(squareSum);
+		}
+	}
+
+	if (!valid || elementCount == 0)
+	{
+		clear();
+		return true;
+	}
+
+	//we restore the structure (in compact form if required and if possible)
+	m_compactStorage = compactStorage;
+	m_thePointsAndTheirCellCodes.assign(elements,m_compactStorage);
+	m_numberOfProjectedPoints = elementCount;
+	updateCellSizeTable();
+
+	restored = true;
+	return true;
+}
+
 void ccOctree::multiplyBoundingBox(const PointCoordinateType multFactor)
 {
 	m_dimMin *= multFactor;
@@ -119,10 +119,41 @@ public: //GENERAL METHODS
 
 	//inherited from DgmOctree
 	virtual void clear();
+	virtual bool addPoints(unsigned firstIndex);
+	virtual bool removePoints(const std::vector<bool>& removedPoints);
+	virtual void reindexInOctreeOrder();
 
 	//Inherited from ccHObject
 	virtual ccBBox getOwnBB(bool withGLFeatures = false);
 
+	//! Enables or disables the search statistics log
+	/** When enabled, the octree search statistics (see CCLib::DgmOctree::SearchStatistics)
+		of each cells traversal (distances computation, curvature, etc.) are sent to the
+		console once the process is finished.
+	**/
+	static void EnableSearchStatisticsLog(bool state);
+
+public: //SERIALIZATION (see ccPointCloud::toFile_MeOnly)
+
+	//! Saves the octree structure to a file
+	/** The sorted cell codes, the fill indexes and the per-level cells statistics
+		are saved, so that the octree can be restored without being rebuilt.
+		\param out output file (already opened)
+		\return success
+	**/
+	bool structureToFile(QFile& out) const;
+
+	//! Restores the octree structure from a file (see structureToFile)
+	/** The associated cloud must be loaded already: the structure is only
+		restored if the cloud number of points and bounding-box are the same
+		as the ones saved with it (otherwise the octree is left empty).
+		\param in input file (already opened)
+		\param dataVersion file version
+		\param[out] restored whether the structure has been restored (i.e. is valid) or not
+		\return false if the file couldn't be read (the octree is then left empty)
+	**/
+	bool structureFromFile(QFile& in, short dataVersion, bool& restored);
+
 public: //RENDERING METHODS
 
 	static void RenderOctreeAs(	CC_OCTREE_DISPLAY_TYPE octreeDisplayType,
@@ -148,6 +179,9 @@ protected:
 	//Inherited from ccHObject
 	void drawMeOnly(CC_DRAW_CONTEXT& context);
 
+	//! Deprecates the structures depending on the octree contents (display, frustrum intersector)
+	void notifyStructureUpdate();
+
 	/*** RENDERING METHODS ***/
 
 	static bool DrawCellAsABox(	const CCLib::DgmOctree::octreeCell& cell,
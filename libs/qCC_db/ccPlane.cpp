@@ -69,11 +69,24 @@ bool ccPlane::buildUp()
 	return true;
 }
 
+bool ccPlane::getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const
+{
+	minCorner = CCVector3(-m_xWidth/2,-m_yWidth/2,0);
+	maxCorner = CCVector3( m_xWidth/2, m_yWidth/2,0);
+
+	return true;
+}
+
 ccGenericPrimitive* ccPlane::clone() const
 {
 	return finishCloneJob(new ccPlane(m_xWidth,m_yWidth,&m_transformation,getName()));
 }
 
+ccGenericPrimitive* ccPlane::createBuildCopy() const
+{
+	return new ccPlane(m_xWidth,m_yWidth);
+}
+
 ccPlane* ccPlane::Fit(CCLib::GenericIndexedCloudPersist *cloud, double* rms/*=0*/)
 {
 	//number of points
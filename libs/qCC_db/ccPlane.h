@@ -89,6 +89,8 @@ protected:
 	virtual bool toFile_MeOnly(QFile& out) const;
 	virtual bool fromFile_MeOnly(QFile& in, short dataVersion, int flags);
 	virtual bool buildUp();
+	virtual ccGenericPrimitive* createBuildCopy() const;
+	virtual bool getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const;
 
 	//! Width along 'X' dimension
 	PointCoordinateType m_xWidth;
@@ -58,6 +58,19 @@ ccPointCloud::ccPointCloud(QString name) throw()
 	showSF(false);
 }
 
+//! Whether the clouds octree is saved along with them (see ccPointCloud::SetOctreeSaving)
+static bool s_octreeSaving = false;
+
+void ccPointCloud::SetOctreeSaving(bool state)
+{
+	s_octreeSaving = state;
+}
+
+bool ccPointCloud::OctreeSavingEnabled()
+{
+	return s_octreeSaving;
+}
+
 ccPointCloud* ccPointCloud::From(CCLib::GenericCloud* cloud, const ccGenericPointCloud* sourceCloud/*=0*/)
 {
 	ccPointCloud* pc = new ccPointCloud("Cloud");
@@ -382,11 +395,15 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 	if (size() == pointCountBefore) //in some cases points have already been copied! (ok it's tricky)
 	{
 		//we remove structures that are not compatible with fusion process
-		deleteOctree();
 		unallocateVisibilityArray();
 
 		for (unsigned i=0; i<addedPoints; i++)
 			addPoint(*addedCloud->getPoint(i));
+
+		//the octree is updated rather than rebuilt (if the new points fall inside its limits)
+		ccOctree* octree = getOctree();
+		if (octree && !octree->addPoints(pointCountBefore))
+			deleteOctree();
 	}
 
 	//deprecate internal structures
@@ -1431,6 +1448,144 @@ void ccPointCloud::scale(PointCoordinateType fx, PointCoordinateType fy, PointCo
 	notifyGeometryUpdate(); //calls releaseVBOs()
 }
 
+bool ccPointCloud::reorderInOctreeOrder(CCLib::GenericProgressCallback* progressCb/*=0*/)
+{
+	if (isLocked())
+	{
+		ccLog::Error("[ccPointCloud::reorderInOctreeOrder] Cloud is locked");
+		return false;
+	}
+
+	unsigned count = size();
+	if (count < 2)
+		return true;
+
+	//the meshes and the labels reference the points by index
+	{
+		bool referenced = false;
+
+		ccHObject* parent = getParent();
+		if (parent && parent->isKindOf(CC_TYPES::MESH) && static_cast<ccGenericMesh*>(parent)->getAssociatedCloud() == this)
+			referenced = true;
+
+		ccHObject::Container meshes;
+		filterChildren(meshes, true, CC_TYPES::MESH);
+		for (size_t i=0; i<meshes.size() && !referenced; ++i)
+			if (static_cast<ccGenericMesh*>(meshes[i])->getAssociatedCloud() == this)
+				referenced = true;
+
+		ccHObject::Container labels;
+		filterChildren(labels, true, CC_TYPES::LABEL_2D);
+		if (!labels.empty())
+			referenced = true;
+
+		if (referenced)
+		{
+			ccLog::Warning(QString("[ccPointCloud::reorderInOctreeOrder] The points of cloud '%1' are referenced by a mesh or a label: they can't be reordered").arg(getName()));
+			return false;
+		}
+	}
+
+	ccOctree* octree = getOctree();
+	if (!octree)
+	{
+		octree = computeOctree(progressCb);
+		if (!octree)
+		{
+			ccLog::Error("[ccPointCloud::reorderInOctreeOrder] Failed to compute the octree!");
+			return false;
+		}
+	}
+
+	//index (before reordering) of the point at each position
+	std::vector<unsigned> order;
+	{
+		const CCLib::DgmOctree::pointsAndCodesContainer& codes = octree->pointsAndTheirCellCodes();
+		unsigned projectedCount = codes.size();
+		assert(projectedCount <= count);
+
+		try
+		{
+			order.resize(count);
+			for (unsigned i=0; i<projectedCount; ++i)
+				order[i] = codes.getIndex(i);
+
+			//the points that are not projected in the octree are put at the end (in the same order)
+			if (projectedCount < count)
+			{
+				std::vector<bool> projected(count,false);
+				for (unsigned i=0; i<projectedCount; ++i)
+					projected[order[i]] = true;
+				unsigned pos = projectedCount;
+				for (unsigned i=0; i<count; ++i)
+					if (!projected[i])
+						order[pos++] = i;
+				assert(pos == count);
+			}
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			ccLog::Error("[ccPointCloud::reorderInOctreeOrder] Not enough memory!");
+			return false;
+		}
+	}
+
+	CCLib::NormalizedProgress* nprogress = 0;
+	if (progressCb)
+	{
+		progressCb->reset();
+		nprogress = new CCLib::NormalizedProgress(progressCb,count);
+		progressCb->setMethodTitle("Reorder points (octree)");
+		progressCb->setInfo(qPrintable(QString("Number of points = %1").arg(count)));
+		progressCb->start();
+	}
+
+	bool hasVisibilityTable = isVisibilityTableInstantiated();
+
+	//we apply the permutation cycle by cycle (the already placed points are
+	//marked in 'order' itself, so that no additional memory is required)
+	for (unsigned i=0; i<count; ++i)
+	{
+		unsigned current = i;
+		while (order[current] != current)
+		{
+			unsigned next = order[current];
+			order[current] = current;
+			if (nprogress)
+				nprogress->oneStep();
+			if (next == i)
+				break;
+
+			swapPoints(current,next);
+			if (hasVisibilityTable)
+				m_pointsVisibility->swap(current,next);
+			current = next;
+		}
+	}
+
+	if (nprogress)
+	{
+		progressCb->stop();
+		delete nprogress;
+		nprogress = 0;
+	}
+
+	//the octree codes are unchanged
+	octree->reindexInOctreeOrder();
+
+	//we can't keep the kd-trees
+	{
+		ccHObject::Container kdtrees;
+		filterChildren(kdtrees, false, CC_TYPES::POINT_KDTREE);
+		for (size_t i=0; i<kdtrees.size(); ++i)
+			removeChild(kdtrees[i]);
+	}
+
+	notifyGeometryUpdate(); //calls releaseVBOs()
+
+	return true;
+}
+
 void ccPointCloud::invertNormals()
 {
 	if (!hasNormals())
@@ -2596,12 +2751,30 @@ ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(bool re
 	//shall the visible points be erased from this cloud?
 	if (removeSelectedPoints && !isLocked())
 	{
-		//we drop the octree before modifying this cloud's contents
-		deleteOctree();
+		unsigned count = size();
 
-		//we remove all visible points
+		//the octree is updated rather than rebuilt
+		ccOctree* octree = getOctree();
+		if (octree)
+		{
+			std::vector<bool> removedPoints;
+			try
+			{
+				removedPoints.resize(count);
+				for (unsigned i=0; i<count; ++i)
+					removedPoints[i] = (m_pointsVisibility->getValue(i) == POINT_VISIBLE);
+			}
+			catch (.../*const std::bad_alloc&*/) //out of memory
+			{
+				removedPoints.clear();
+			}
+
+			if (removedPoints.empty() || !octree->removePoints(removedPoints) || octree->getNumberOfProjectedPoints() == 0)
+				deleteOctree();
+		}
+
+		//we remove all visible points (the others keep their relative order)
 		unsigned lastPoint = 0;
-		unsigned count = size();
 		for (unsigned i=0; i<count; ++i)
 		{
 			if (m_pointsVisibility->getValue(i) != POINT_VISIBLE)
@@ -3073,6 +3246,19 @@ bool ccPointCloud::toFile_MeOnly(QFile& out) const
 			return WriteError();
 	}
 
+	//octree structure (optional, dataVersion>=40)
+	{
+		ccOctree* octree = (s_octreeSaving ? const_cast<ccPointCloud*>(this)->getOctree() : 0);
+		bool hasOctree = (octree && octree->getNumberOfProjectedPoints() != 0);
+		if (out.write((const char*)&hasOctree,sizeof(bool)) < 0)
+			return WriteError();
+		if (hasOctree)
+		{
+			if (!octree->structureToFile(out))
+				return false;
+		}
+	}
+
 	return true;
 }
 
@@ -3219,6 +3405,37 @@ bool ccPointCloud::fromFile_MeOnly(QFile& in, short dataVersion, int flags)
 			setCurrentDisplayedScalarField(displayedScalarFieldIndex);
 	}
 
+	//octree structure (optional, dataVersion>=40)
+	if (dataVersion >= 40)
+	{
+		bool hasOctree = false;
+		if (in.read((char*)&hasOctree,sizeof(bool)) < 0)
+			return ReadError();
+		if (hasOctree)
+		{
+			ccOctree* octree = new ccOctree(this);
+			bool restored = false;
+			if (!octree->structureFromFile(in, dataVersion, restored))
+			{
+				delete octree;
+				return false;
+			}
+
+			if (restored)
+			{
+				//same state as with ccGenericPointCloud::computeOctree
+				octree->setVisible(true);
+				octree->setEnabled(false);
+				addChild(octree);
+			}
+			else
+			{
+				ccLog::Warning(QString("[BIN] Saved octree of cloud '%1' doesn't match the cloud (it will be recomputed when needed)").arg(getName()));
+				delete octree;
+			}
+		}
+	}
+
 	//notifyGeometryUpdate(); //FIXME: we can't call it now as the dependent 'pointers' are not valid yet!
 
 	//We should update the VBOs (just in case)
@@ -3811,8 +4028,8 @@ bool ccPointCloud::initLOD(CCLib::GenericProgressCallback* progressCallback/*=0*
 		CCLib::DgmOctree::OctreeCellCodeType currentTruncatedCellCode = 0xFFFFFFFF;
 
 		//scan the octree structure
-		const CCLib::DgmOctree::cellsContainer& thePointsAndTheirCellCodes = octree->pointsAndTheirCellCodes();
-		for (CCLib::DgmOctree::cellsContainer::const_iterator c=thePointsAndTheirCellCodes.begin(); c!=thePointsAndTheirCellCodes.end(); ++c)
+		const CCLib::DgmOctree::pointsAndCodesContainer& thePointsAndTheirCellCodes = octree->pointsAndTheirCellCodes();
+		for (CCLib::DgmOctree::pointsAndCodesContainer::const_iterator c=thePointsAndTheirCellCodes.begin(); c!=thePointsAndTheirCellCodes.end(); ++c)
 		{
 			CCLib::DgmOctree::OctreeCellCodeType truncatedCode = (c->theCode >> bitDec);
 
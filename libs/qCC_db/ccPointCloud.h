@@ -112,6 +112,16 @@ public:
 	**/
 	static ccPointCloud* From(CCLib::GenericCloud* cloud, const ccGenericPointCloud* sourceCloud = 0);
 
+	//! Sets whether the clouds octree is saved along with them (BIN files)
+	/** Disabled by default: the octree structure takes roughly 16 bytes per point
+		(with 64 bits codes) but it doesn't have to be recomputed after loading.
+		Files are loaded the same way in both cases.
+	**/
+	static void SetOctreeSaving(bool state);
+
+	//! Returns whether the clouds octree is saved along with them (see SetOctreeSaving)
+	static bool OctreeSavingEnabled();
+
 	//! Warnings for the partialClone method (bit flags)
 	enum CLONE_WARNINGS {	WRN_OUT_OF_MEM_FOR_COLORS		= 1,
 							WRN_OUT_OF_MEM_FOR_NORMALS		= 2,
@@ -441,6 +451,18 @@ public:
     **/
     void hidePointsByScalarValue(ScalarType minVal, ScalarType maxVal);
 
+	//! Reorders the points in the octree order (Morton order)
+	/** Points, colors, normals, scalar fields and visibility values are permuted
+		in place so that the points of each octree cell are contiguous in memory.
+		The octree is computed if necessary, and updated afterwards (the cells then
+		correspond to ranges of point indexes, see DgmOctree::reindexInOctreeOrder).
+		The Kd-trees are deleted. Warning: the process fails if the points are
+		referenced by a mesh or a label. It can't be cancelled.
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism
+		\return success
+	**/
+	bool reorderInOctreeOrder(CCLib::GenericProgressCallback* progressCb = 0);
+
 	//! Unrolls the cloud and its normals on a cylinder
 	/** This method is redundant with the "developCloudOnCylinder" method of CCLib,
 		appart that it can also handle the cloud normals.
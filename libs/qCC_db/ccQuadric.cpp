@@ -145,6 +145,11 @@ ccGenericPrimitive* ccQuadric::clone() const
 	return finishCloneJob(new ccQuadric(m_minCorner,m_maxCorner,m_eq,m_hfDims,&m_transformation,getName(),m_drawPrecision));
 }
 
+ccGenericPrimitive* ccQuadric::createBuildCopy() const
+{
+	return new ccQuadric(m_minCorner,m_maxCorner,m_eq,m_hfDims,0,QString(),m_drawPrecision);
+}
+
 ccQuadric* ccQuadric::Fit(CCLib::GenericIndexedCloudPersist *cloud, double* rms/*=0*/)
 {
 	//number of points
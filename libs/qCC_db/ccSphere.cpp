@@ -43,6 +43,11 @@ ccGenericPrimitive* ccSphere::clone() const
 	return finishCloneJob(new ccSphere(m_radius,&m_transformation,getName(),m_drawPrecision));
 }
 
+ccGenericPrimitive* ccSphere::createBuildCopy() const
+{
+	return new ccSphere(m_radius,0,QString(),m_drawPrecision);
+}
+
 bool ccSphere::buildUp()
 {
 	if (m_drawPrecision < MIN_DRAWING_PRECISION)
@@ -152,6 +157,14 @@ bool ccSphere::buildUp()
 	return true;
 }
 
+bool ccSphere::getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const
+{
+	minCorner = CCVector3(-m_radius,-m_radius,-m_radius);
+	maxCorner = CCVector3( m_radius, m_radius, m_radius);
+
+	return true;
+}
+
 void ccSphere::setRadius(PointCoordinateType radius)
 {
 	if (m_radius == radius)
@@ -54,6 +54,11 @@ ccGenericPrimitive* ccTorus::clone() const
 	return finishCloneJob(new ccTorus(m_insideRadius,m_outsideRadius,m_angle_rad,m_rectSection,m_rectSectionHeight,&m_transformation,getName(),m_drawPrecision));
 }
 
+ccGenericPrimitive* ccTorus::createBuildCopy() const
+{
+	return new ccTorus(m_insideRadius,m_outsideRadius,m_angle_rad,m_rectSection,m_rectSectionHeight,0,QString(),m_drawPrecision);
+}
+
 bool ccTorus::buildUp()
 {
 	if (m_drawPrecision < MIN_DRAWING_PRECISION)
@@ -253,6 +258,16 @@ bool ccTorus::buildUp()
 	return true;
 }
 
+bool ccTorus::getLocalBoundingBox(CCVector3& minCorner, CCVector3& maxCorner) const
+{
+	//conservative for partial tori
+	PointCoordinateType dz = (m_rectSection ? m_rectSectionHeight : m_outsideRadius-m_insideRadius)/2;
+	minCorner = CCVector3(-m_outsideRadius,-m_outsideRadius,-dz);
+	maxCorner = CCVector3( m_outsideRadius, m_outsideRadius, dz);
+
+	return true;
+}
+
 bool ccTorus::toFile_MeOnly(QFile& out) const
 {
 	if (!ccGenericPrimitive::toFile_MeOnly(out))
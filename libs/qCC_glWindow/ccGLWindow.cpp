@@ -2201,6 +2201,21 @@ void ccGLWindow::getContext(CC_DRAW_CONTEXT& context)
 	context.labelMarkerSize = static_cast<float>(guiParams.labelMarkerSize * pixSize);
 	context.labelMarkerTextShift = static_cast<float>(5 * pixSize); //5 pixels shift
 
+	//primitives L.O.D.
+	context.primitiveMaxScreenError = guiParams.primitiveMaxScreenError;
+	context.lodPerspective = m_viewportParams.perspectiveView;
+	context.lodCameraCenter = m_viewportParams.cameraCenter;
+	if (m_viewportParams.perspectiveView)
+	{
+		//pixel size at a unit distance from the camera (see computeActualPixelSize)
+		int minScreenDim = std::min(m_glWidth,m_glHeight);
+		context.lodPixelSize = (minScreenDim > 0 ? tan(getFov() * CC_DEG_TO_RAD) / minScreenDim : 0);
+	}
+	else
+	{
+		context.lodPixelSize = pixSize;
+	}
+
 	//text display
 	context.dispNumberPrecision = guiParams.displayedNumPrecision;
 	//label opacity
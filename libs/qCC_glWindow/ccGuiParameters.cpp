@@ -82,6 +82,7 @@ void ccGui::ParamStruct::reset()
 	minLoDMeshSize				= 2500000;
 	decimateCloudOnMove			= true;
 	minLoDCloudSize				= 10000000;
+	primitiveMaxScreenError		= 1.0f;
 	useVBOs						= true;
 	useOpenGLPointPicking		= false;
 	displayCross				= true;
@@ -126,6 +127,7 @@ void ccGui::ParamStruct::fromPersistentSettings()
 	minLoDMeshSize				=                                  settings.value("minLoDMeshSize",       2500000 ).toUInt();
 	decimateCloudOnMove			=                                  settings.value("cloudDecimation",         true ).toBool();
 	minLoDCloudSize				=                                  settings.value("minLoDCloudSize",     10000000 ).toUInt();
+	primitiveMaxScreenError		=                                  settings.value("primitiveMaxScreenError", 1.0  ).toFloat();
 	useVBOs						=                                  settings.value("useVBOs",                 true ).toBool();
 	useOpenGLPointPicking		=                                  settings.value("useOpenGLPointPicking",   false).toBool();
 	displayCross				=                                  settings.value("crossDisplayed",          true ).toBool();
@@ -165,6 +167,7 @@ void ccGui::ParamStruct::toPersistentSettings() const
 	settings.setValue("minLoDMeshSize",	          minLoDMeshSize);
 	settings.setValue("cloudDecimation",          decimateCloudOnMove);
 	settings.setValue("minLoDCloudSize",	      minLoDCloudSize);
+	settings.setValue("primitiveMaxScreenError",  primitiveMaxScreenError);
 	settings.setValue("useVBOs",                  useVBOs);
 	settings.setValue("useOpenGLPointPicking",    useOpenGLPointPicking);
 	settings.setValue("crossDisplayed",           displayCross);
@@ -76,6 +76,8 @@ public:
 		bool decimateCloudOnMove;
 		//! Min cloud size for decimation
 		unsigned minLoDCloudSize;
+		//! Max. screen-space error for primitives L.O.D. (in pixels - 0 = disabled)
+		float primitiveMaxScreenError;
 		//! Display cross in the middle of the screen
 		bool displayCross;
 		//! Whether to use VBOs for faster display
@@ -22,9 +22,11 @@
 #include <QFileInfo>
 #include <QTextStream>
 #include <QSharedPointer>
+#include <QRegExp>
 
 //CClib
 #include <ScalarField.h>
+#include <OutOfCoreCloud.h>
 
 //qCC_db
 #include <ccPointCloud.h>
@@ -32,6 +34,7 @@
 #include <ccProgressDialog.h>
 #include <ccLog.h>
 #include <ccScalarField.h>
+#include <ccNormalVectors.h>
 
 //System
 #include <string.h>
@@ -343,6 +346,222 @@ CC_FILE_ERROR AsciiFilter::saveToFile(ccHObject* entity, QString filename, SaveP
 	return CC_FERR_NO_ERROR;
 }
 
+CC_FILE_ERROR AsciiFilter::LoadOutOfCoreCloud(	const QString& filename,
+												const QString& cloudFilename,
+												CCLib::OutOfCoreCloud& cloud,
+												CCVector3d& Pshift,
+												LoadParameters& parameters,
+												unsigned skipLines/*=0*/,
+												CCLib::GenericProgressCallback* progressCb/*=0*/)
+{
+	QFile file(filename);
+	if (!file.open(QFile::ReadOnly))
+		return CC_FERR_READING;
+	qint64 fileSize = std::max<qint64>(file.size(),1);
+
+	if (!cloud.create(qPrintable(cloudFilename)))
+		return CC_FERR_WRITING;
+
+	QTextStream stream(&file);
+
+	//we skip lines as defined on input
+	for (unsigned i=0; i<skipLines; ++i)
+		stream.readLine();
+
+	if (progressCb)
+	{
+		progressCb->reset();
+		progressCb->setMethodTitle("Import out-of-core cloud");
+		progressCb->setInfo(qPrintable(QString("File: %1").arg(QFileInfo(filename).fileName())));
+		progressCb->start();
+	}
+
+	QRegExp separators("[\\s,;]+");
+	Pshift = CCVector3d(0,0,0);
+	unsigned linesRead = 0;
+	unsigned pointsRead = 0;
+	unsigned ignoredLines = 0;
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+
+	for (QString currentLine = stream.readLine(); !currentLine.isNull(); currentLine = stream.readLine())
+	{
+		++linesRead;
+
+		//progress (the file position is only approximate because of the stream buffer)
+		if (progressCb && (linesRead & 0xFFFF) == 0)
+		{
+			progressCb->update(static_cast<float>(100.0 * static_cast<double>(file.pos()) / static_cast<double>(fileSize)));
+			if (progressCb->isCancelRequested())
+			{
+				result = CC_FERR_CANCELED_BY_USER;
+				break;
+			}
+		}
+
+		//comment
+		if (currentLine.startsWith("//"))
+			continue;
+
+		QStringList parts = currentLine.split(separators,QString::SkipEmptyParts);
+		bool ok = (parts.size() >= 3);
+		CCVector3d P(0,0,0);
+		for (int k=0; k<3 && ok; ++k)
+			P.u[k] = parts[k].toDouble(&ok);
+		if (!ok)
+		{
+			++ignoredLines;
+			continue;
+		}
+
+		//first point: check for 'big' coordinates
+		if (pointsRead == 0 && HandleGlobalShift(P,Pshift,parameters))
+			ccLog::Warning("[AsciiFilter::LoadOutOfCoreCloud] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",Pshift.x,Pshift.y,Pshift.z);
+
+		if (!cloud.addPoint(CCVector3::fromArray((P+Pshift).u)))
+		{
+			result = CC_FERR_WRITING;
+			break;
+		}
+		++pointsRead;
+	}
+
+	if (progressCb)
+		progressCb->stop();
+
+	if (ignoredLines != 0)
+		ccLog::Warning(QString("[AsciiFilter::LoadOutOfCoreCloud] %1 line(s) ignored (not starting with 3 numbers)").arg(ignoredLines));
+
+	if (result == CC_FERR_NO_ERROR && pointsRead == 0)
+		result = CC_FERR_NO_LOAD;
+
+	//the points must be sorted before the cloud can be used
+	if (result == CC_FERR_NO_ERROR && !cloud.sortPoints(progressCb))
+		result = CC_FERR_WRITING;
+
+	if (result != CC_FERR_NO_ERROR)
+	{
+		cloud.close();
+		QFile::remove(cloudFilename);
+	}
+
+	return result;
+}
+
+CC_FILE_ERROR AsciiFilter::SaveOutOfCoreCloud(	const QString& filename,
+												CCLib::OutOfCoreCloud& cloud,
+												const CCVector3d& Pshift,
+												NormsIndexesTableType* normals/*=0*/,
+												QString sfName/*=QString()*/,
+												CCLib::GenericProgressCallback* progressCb/*=0*/)
+{
+	unsigned numberOfPoints = cloud.size();
+	bool writeSF = cloud.isScalarFieldEnabled();
+	bool writeNorms = (normals && normals->currentSize() == numberOfPoints);
+
+	QFile file(filename);
+	if (!file.open(QFile::WriteOnly | QFile::Truncate))
+		return CC_FERR_WRITING;
+	QTextStream stream(&file);
+
+	//output precision
+	QSharedPointer<AsciiSaveDlg> saveDialog = GetSaveDialog();
+	const int s_coordPrecision = saveDialog->coordsPrecision();
+	const int s_sfPrecision = saveDialog->sfPrecision(); 
+	const int s_nPrecision = 2+sizeof(PointCoordinateType);
+	QChar separator(saveDialog->getSeparator());
+
+	if (saveDialog->saveColumnsNamesHeader())
+	{
+		QString header("//");
+		header.append(AsciiHeaderColumns::X());
+		header.append(separator);
+		header.append(AsciiHeaderColumns::Y());
+		header.append(separator);
+		header.append(AsciiHeaderColumns::Z());
+		if (writeSF)
+		{
+			if (sfName.isEmpty())
+				sfName = "Scalar field";
+			sfName.replace(separator,'_');
+			header.append(separator);
+			header.append(sfName);
+		}
+		if (writeNorms)
+		{
+			header.append(separator);
+			header.append(AsciiHeaderColumns::Nx());
+			header.append(separator);
+			header.append(AsciiHeaderColumns::Ny());
+			header.append(separator);
+			header.append(AsciiHeaderColumns::Nz());
+		}
+		stream << header << "\n";
+	}
+
+	if (saveDialog->savePointCountHeader())
+	{
+		stream << QString::number(numberOfPoints) << "\n";
+	}
+
+	if (progressCb)
+	{
+		progressCb->reset();
+		progressCb->setMethodTitle("Save out-of-core cloud");
+		progressCb->setInfo(qPrintable(QString("Number of points: %1").arg(numberOfPoints)));
+		progressCb->start();
+	}
+	CCLib::NormalizedProgress nprogress(progressCb,numberOfPoints);
+
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+	for (unsigned i=0; i<numberOfPoints; ++i)
+	{
+		//points are read in file order (i.e. page by page)
+		CCVector3 P;
+		cloud.getPoint(i,P);
+		CCVector3d Pglobal = CCVector3d::fromArray(P.u) - Pshift;
+
+		QString line;
+		line.append(QString::number(Pglobal.x,'f',s_coordPrecision));
+		line.append(separator);
+		line.append(QString::number(Pglobal.y,'f',s_coordPrecision));
+		line.append(separator);
+		line.append(QString::number(Pglobal.z,'f',s_coordPrecision));
+
+		if (writeSF)
+		{
+			line.append(separator);
+			line.append(QString::number(cloud.getPointScalarValue(i),'f',s_sfPrecision));
+		}
+
+		if (writeNorms)
+		{
+			const CCVector3& N = ccNormalVectors::GetNormal(normals->getValue(i));
+			line.append(separator);
+			line.append(QString::number(N.x,'f',s_nPrecision));
+			line.append(separator);
+			line.append(QString::number(N.y,'f',s_nPrecision));
+			line.append(separator);
+			line.append(QString::number(N.z,'f',s_nPrecision));
+		}
+
+		stream << line << "\n";
+
+		if (progressCb && !nprogress.oneStep())
+		{
+			result = CC_FERR_CANCELED_BY_USER;
+			break;
+		}
+	}
+
+	if (progressCb)
+		progressCb->stop();
+
+	if (result == CC_FERR_NO_ERROR && stream.status() != QTextStream::Ok)
+		result = CC_FERR_WRITING;
+
+	return result;
+}
+
 // load File
 CC_FILE_ERROR AsciiFilter::loadFile(QString filename,
 									ccHObject& container,
@@ -27,6 +27,13 @@
 //Qt
 #include <QSharedPointer>
 
+namespace CCLib
+{
+	class OutOfCoreCloud;
+	class GenericProgressCallback;
+}
+class NormsIndexesTableType;
+
 //! ASCII point cloud I/O filter
 class QCC_IO_LIB_API AsciiFilter : public FileIOFilter
 {
@@ -58,6 +65,43 @@ public:
 													unsigned skipLines,
 													LoadParameters& parameters);
 
+	//! Streams an ASCII file in a new out-of-core cloud (see CCLib::OutOfCoreCloud)
+	/** Only the coordinates are imported: the first 3 values of each line (separated
+		by spaces, tabs, commas or semicolons). Comments ('//') and lines that don't
+		start with 3 numbers are ignored. Only a small buffer of points is kept in memory.
+		\param filename ASCII file
+		\param cloudFilename out-of-core cloud file (created or overwritten)
+		\param cloud output cloud (points are sorted once imported, see OutOfCoreCloud::sortPoints)
+		\param Pshift global shift applied to the points (see FileIOFilter::HandleGlobalShift)
+		\param parameters loading parameters (big coordinates handling)
+		\param skipLines number of lines to skip at the beginning of the file
+		\param progressCb progress callback
+	**/
+	static CC_FILE_ERROR LoadOutOfCoreCloud(const QString& filename,
+											const QString& cloudFilename,
+											CCLib::OutOfCoreCloud& cloud,
+											CCVector3d& Pshift,
+											LoadParameters& parameters,
+											unsigned skipLines = 0,
+											CCLib::GenericProgressCallback* progressCb = 0);
+
+	//! Streams an out-of-core cloud to an ASCII file (see CCLib::OutOfCoreCloud)
+	/** Writes X Y Z [distance] [Nx Ny Nz] lines, with the precision and the separator
+		of the save dialog (see GetSaveDialog). The points are read page by page.
+		\param filename ASCII file
+		\param cloud out-of-core cloud
+		\param Pshift global shift applied to the points (see LoadOutOfCoreCloud)
+		\param normals compressed normals of the cloud points (optional)
+		\param sfName name of the scalar field column (only written if the cloud scalar field is enabled)
+		\param progressCb progress callback
+	**/
+	static CC_FILE_ERROR SaveOutOfCoreCloud(const QString& filename,
+											CCLib::OutOfCoreCloud& cloud,
+											const CCVector3d& Pshift,
+											NormsIndexesTableType* normals = 0,
+											QString sfName = QString(),
+											CCLib::GenericProgressCallback* progressCb = 0);
+
 	//! Returns associated dialog (creates it if necessary)
 	static QSharedPointer<AsciiOpenDlg> GetOpenDialog();
 	//! Returns associated dialog (creates it if necessary)
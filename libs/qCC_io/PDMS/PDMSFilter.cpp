@@ -17,11 +17,16 @@
 
 #include "PDMSFilter.h"
 #include "PdmsParser.h"
+#include "PdmsCache.h"
+#include "../BinFilter.h"
+#include "../PlyFilter.h"
 
 //qCC_db
 #include <ccLog.h>
 #include <ccMesh.h>
+#include <ccGenericPrimitive.h>
 #include <ccPointCloud.h>
+#include <ccScalarField.h>
 #include <ccCylinder.h>
 #include <ccTorus.h>
 #include <ccBox.h>
@@ -29,7 +34,16 @@
 #include <ccDish.h>
 #include <ccExtru.h>
 
+//Qt
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTemporaryFile>
+#include <QtConcurrentMap>
+
+//System
 #include <assert.h>
+#include <map>
 
 using namespace CCLib;
 
@@ -46,157 +60,814 @@ bool PDMSFilter::canSave(CC_CLASS_ENUM type, bool& multiple, bool& exclusive) co
 	return false;
 }
 
-typedef std::pair<PdmsTools::PdmsObjects::GenericItem*,ccHObject*> PdmsAndCCPair;
+//! Cached group or element (see PdmsCache) and the corresponding CC entity
+struct CachedItemAndCCPair
+{
+	bool isGroup;
+	size_t index;
+	ccHObject* entity;
 
-CC_FILE_ERROR PDMSFilter::loadFile(QString filename, ccHObject& container, LoadParameters& parameters)
+	CachedItemAndCCPair(bool g, size_t i, ccHObject* e) : isGroup(g), index(i), entity(e) {}
+};
+
+//! Whether identical primitives should share the same geometry
+static bool s_instancing = false;
+
+void PDMSFilter::SetInstancing(bool state)
+{
+	s_instancing = state;
+}
+
+bool PDMSFilter::IsInstancingEnabled()
+{
+	return s_instancing;
+}
+
+//! Whether the primitives of each group should be merged in a single mesh
+static bool s_groupMerging = false;
+
+void PDMSFilter::SetGroupMerging(bool state)
+{
+	s_groupMerging = state;
+}
+
+bool PDMSFilter::IsGroupMergingEnabled()
+{
+	return s_groupMerging;
+}
+
+//! Whether parsed macros should be cached (see PdmsCache)
+static bool s_caching = true;
+
+void PDMSFilter::SetCaching(bool state)
+{
+	s_caching = state;
+}
+
+bool PDMSFilter::IsCachingEnabled()
+{
+	return s_caching;
+}
+
+//! Primitives of a group merged in a single mesh
+struct MergedGroup
+{
+	ccMesh* mesh;
+	//! Source elements names
+	QStringList names;
+	//! Index of the first vertex of each source element
+	std::vector<unsigned> firstVertex;
+
+	MergedGroup() : mesh(0) {}
+};
+
+//! Creates an (empty) merged group mesh
+static ccMesh* CreateMergedMesh(const QString& name)
+{
+	ccPointCloud* vertices = new ccPointCloud("vertices");
+	ccMesh* mesh = new ccMesh(vertices);
+	mesh->setName(name);
+	mesh->addChild(vertices);
+	vertices->setEnabled(false);
+
+	return mesh;
+}
+
+//! Finishes a merged group mesh (source index scalar field and names)
+/** See ccMesh::MetaKeySourceNames.
+**/
+static bool FinishMergedGroup(MergedGroup& merged)
 {
-	PdmsParser parser;
-	PdmsFileSession session(qPrintable(filename)); //DGM: warning, toStdString doesn't preserve "local" characters
+	assert(merged.mesh && merged.names.size() == static_cast<int>(merged.firstVertex.size()));
 
-	parser.linkWithSession(&session);
-	if (parser.parseSessionContent())
+	ccPointCloud* vertices = static_cast<ccPointCloud*>(merged.mesh->getAssociatedCloud());
+	unsigned vertCount = vertices->size();
+
+	ccScalarField* sf = new ccScalarField(qPrintable(ccMesh::SourceIndexSFName()));
+	if (!sf->resize(vertCount))
 	{
-		PdmsTools::PdmsObjects::GenericItem* pdmsmodel = parser.getLoadedObject(true);
-		assert(pdmsmodel);
+		sf->release();
+		return false;
+	}
 
-		std::vector< PdmsAndCCPair > treeSync;
-		treeSync.push_back(PdmsAndCCPair(pdmsmodel,&container));
+	for (size_t i=0; i<merged.firstVertex.size(); ++i)
+	{
+		unsigned lastVertex = (i+1 < merged.firstVertex.size() ? merged.firstVertex[i+1] : vertCount);
+		for (unsigned j=merged.firstVertex[i]; j<lastVertex; ++j)
+			sf->setValue(j,static_cast<ScalarType>(i));
+	}
+	sf->computeMinAndMax();
+	vertices->addScalarField(sf);
 
-		while (!treeSync.empty())
+	merged.mesh->setMetaData(ccMesh::MetaKeySourceNames(),QVariant(merged.names));
+
+	return true;
+}
+
+//! Primitive type and parameters
+/** Two PDMS elements with the same key are converted to the same primitive
+	(up to their transformation).
+**/
+struct PrimitiveKey
+{
+	Token type;
+	std::vector<PointCoordinateType> params;
+
+	PrimitiveKey() : type(PDMS_INVALID_TOKEN) {}
+
+	bool operator < (const PrimitiveKey& key) const
+	{
+		if (type != key.type)
+			return type < key.type;
+		return params < key.params;
+	}
+};
+
+//! Returns the name of an unsupported PDMS primitive (see PdmsCache::GetPrimitiveParameters)
+static QString GetUnsupportedPrimitiveName(Token type)
+{
+	switch (type)
+	{
+	case PDMS_PYRAMID:
+		return "Pyramid";
+	case PDMS_NBOX:
+		return "NBox";
+	case PDMS_NEXTRU:
+		return "NExtru";
+	case PDMS_LOOP:
+		return "Loop";
+	case PDMS_VERTEX:
+		return "Vertex";
+	default:
+		break;
+	}
+
+	return "unknown";
+}
+
+//! Creates the primitive corresponding to a key
+static ccGenericPrimitive* CreatePrimitive(const PrimitiveKey& key, const ccGLMatrix* transMat, QString name)
+{
+	const std::vector<PointCoordinateType>& p = key.params;
+
+	switch (key.type)
+	{
+	case PDMS_SCYLINDER:
+		return new ccCylinder(p[0],p[1],transMat,name);
+	case PDMS_CTORUS:
+		return new ccTorus(p[0],p[1],p[2],false,0,transMat,name);
+	case PDMS_RTORUS:
+		return new ccTorus(p[0],p[1],p[2],false,p[3],transMat,name);
+	case PDMS_DISH:
+		return new ccDish(p[0],p[1],p[2],transMat,name);
+	case PDMS_CONE:
+		return new ccCone(p[0],p[1],p[2],0,0,transMat,name);
+	case PDMS_SNOUT:
+		return new ccCone(p[0],p[1],p[2],p[3],p[4],transMat,name);
+	case PDMS_BOX:
+		return new ccBox(CCVector3(p[0],p[1],p[2]),transMat,name);
+	case PDMS_EXTRU:
 		{
-			PdmsAndCCPair currentPair = treeSync.back();
-			treeSync.pop_back();
+			std::vector<CCVector2> profile;
+			profile.reserve((p.size()-1)/2);
+			for (size_t i=1; i+1<p.size(); i+=2)
+				profile.push_back(CCVector2(p[i],p[i+1]));
 
-			if (currentPair.first->isGroupElement())
+			return new ccExtru(profile,p[0],transMat,name);
+		}
+	default:
+		assert(false);
+		break;
+	}
+
+	return 0;
+}
+
+//! Chunk parsing job
+struct PdmsChunkJob
+{
+	PdmsChunkedParser* parser;
+	size_t index;
+};
+
+static void ParseChunk_MT(const PdmsChunkJob& job)
+{
+	//failures are not critical (the chunk will be parsed sequentially)
+	job.parser->parseChunk(job.index);
+}
+
+//! Parses a PDMS macro
+/** \param filename PDMS macro filename
+	\param cache output (see PdmsCache::build)
+	\param sourceSize file size
+	\param sourceTime file last modification time (ms since epoch)
+**/
+static CC_FILE_ERROR ParseFile(const QString& filename, PdmsCache& cache, int64_t sourceSize, int64_t sourceTime)
+{
+	PdmsChunkedParser parser(qPrintable(filename)); //DGM: warning, toStdString doesn't preserve "local" characters
+
+	//big files are split at their top-level blocks, parsed concurrently
+	if (QFileInfo(filename).size() >= static_cast<qint64>(2*PdmsChunkedParser::c_default_min_chunk_size))
+	{
+		size_t chunkCount = parser.prepare();
+		if (chunkCount > 1)
+		{
+			std::vector<PdmsChunkJob> jobs(chunkCount);
+			for (size_t i=0; i<chunkCount; ++i)
 			{
-				PdmsTools::PdmsObjects::GroupElement* group = static_cast<PdmsTools::PdmsObjects::GroupElement*>(currentPair.first);
+				jobs[i].parser = &parser;
+				jobs[i].index = i;
+			}
+			QtConcurrent::blockingMap(jobs, ParseChunk_MT);
+		}
+	}
 
-				//primitives
-				{
-					for (std::list<PdmsTools::PdmsObjects::DesignElement*>::const_iterator it = group->elements.begin(); it != group->elements.end(); ++it)
-						treeSync.push_back(PdmsAndCCPair(*it,currentPair.second));
-				}
+	if (!parser.parseFileContent())
+		return CC_FERR_MALFORMED_FILE;
+
+	PdmsTools::PdmsObjects::GenericItem* pdmsmodel = parser.getLoadedObject(true);
+	assert(pdmsmodel);
+
+	if (!cache.build(pdmsmodel, sourceSize, sourceTime))
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+
+	return CC_FERR_NO_ERROR;
+}
+
+//! Loads the cache of a PDMS macro (or parses it and updates the cache)
+/** The parsed content is cached next to the macro (see PdmsCache): as long as
+	the macro size and modification time don't change, the cache is simply mapped
+	instead of parsing the macro again.
+	\param filename PDMS macro filename
+	\param cache output
+	\param warnings output warnings
+	\param updateCache whether the cache file should be (re)written if it's missing or outdated
+**/
+static CC_FILE_ERROR LoadCache(const QString& filename, PdmsCache& cache, QStringList& warnings, bool updateCache = true)
+{
+	QFileInfo fileInfo(filename);
+	int64_t sourceSize = static_cast<int64_t>(fileInfo.size());
+	int64_t sourceTime = static_cast<int64_t>(fileInfo.lastModified().toMSecsSinceEpoch());
+	QString cacheFilename = PdmsCache::GetFilename(filename);
+
+	if (!s_caching || !cache.load(cacheFilename, sourceSize, sourceTime))
+	{
+		CC_FILE_ERROR result = ParseFile(filename, cache, sourceSize, sourceTime);
+		if (result != CC_FERR_NO_ERROR)
+			return result;
+
+		if (s_caching && updateCache && !cache.save(cacheFilename))
+			warnings << QString("[PDMSFilter] Failed to write cache file '%1'").arg(cacheFilename);
+	}
 
-				//sub-groups
+	return CC_FERR_NO_ERROR;
+}
+
+//! Returns the transformation of a cached element
+static ccGLMatrix GetTransformation(const PdmsCache::Element& item)
+{
+	ccGLMatrix trans;
+	trans.setTranslation(CCVector3::fromArray(item.position));
+	for (unsigned c=0; c<3; ++c)
+		for (unsigned l=0; l<3; ++l)
+			trans.getColumn(c)[l] = static_cast<float>(item.orientation[3*c+l]);
+
+	return trans;
+}
+
+//! Converts the content of a parsed PDMS macro (as children of 'container')
+/** Warnings are returned in 'warnings'.
+**/
+static CC_FILE_ERROR ConvertCache(const PdmsCache& cache, ccHObject& container, QStringList& warnings)
+{
+	//group merging mode: all the primitives of a group are baked in a single mesh
+	bool groupMerging = s_groupMerging;
+	std::map<ccHObject*, MergedGroup> mergedGroups;
+
+	//instancing mode: prototypes are tessellated once (and hidden in their own group)
+	//(useless if primitives are merged)
+	bool instancing = s_instancing && !groupMerging;
+	std::map<PrimitiveKey, ccGenericPrimitive*> prototypes;
+	ccHObject* prototypesGroup = (instancing ? new ccHObject("Prototypes") : 0);
+
+	std::vector< CachedItemAndCCPair > treeSync;
+	treeSync.push_back(CachedItemAndCCPair(true,0,&container));
+
+	while (!treeSync.empty())
+	{
+		CachedItemAndCCPair currentPair = treeSync.back();
+		treeSync.pop_back();
+
+		if (currentPair.isGroup)
+		{
+			const PdmsCache::Group& group = cache.group(currentPair.index);
+
+			//primitives
+			{
+				for (uint32_t i=0; i<group.elementCount; ++i)
+					treeSync.push_back(CachedItemAndCCPair(false,group.firstElement+i,currentPair.entity));
+			}
+
+			//sub-groups
+			{
+				for (uint32_t i=0; i<group.subGroupCount; ++i)
 				{
-					for (std::list<PdmsTools::PdmsObjects::GroupElement*>::const_iterator it = group->subhierarchy.begin(); it != group->subhierarchy.end(); ++it)
-					{
-						ccHObject* subGroup = new ccHObject((*it)->name);
-						currentPair.second->addChild(subGroup);
+					ccHObject* subGroup = new ccHObject(cache.string(cache.group(group.firstSubGroup+i).name));
+					currentPair.entity->addChild(subGroup);
 
-						treeSync.push_back(PdmsAndCCPair(*it,subGroup));
-					}
+					treeSync.push_back(CachedItemAndCCPair(true,group.firstSubGroup+i,subGroup));
 				}
 			}
-			else
+		}
+		else
+		{
+			const PdmsCache::Element& item = cache.element(currentPair.index);
+			QString itemName = cache.string(item.name);
+
+			//Convert PDMS element to the corresponding ccHObject
+			PrimitiveKey key;
+			key.type = static_cast<Token>(item.type);
+			if (item.flags & PdmsCache::UNSUPPORTED)
 			{
-				//Convert PDMS GenericItem to the corresponding ccHObject
-				ccMesh* primitive = 0;
-				QString unsupportedPrimitiveStr("unknown");
-				switch (currentPair.first->getType())
+				warnings << QString("[PDMSFilter] Primitive '%1' not supported yet!").arg(GetUnsupportedPrimitiveName(key.type));
+				continue;
+			}
+			const PointCoordinateType* params = cache.params(item);
+			key.params.assign(params, params+item.paramCount);
+
+			//transformation
+			ccGLMatrix trans = GetTransformation(item);
+
+			ccMesh* primitive = 0;
+			if (instancing)
+			{
+				//identical primitives share the same (tessellated) prototype
+				ccGenericPrimitive*& prototype = prototypes[key];
+				if (!prototype)
 				{
-				case PDMS_SCYLINDER:
-					{
-						PdmsTools::PdmsObjects::SCylinder* pdmsCyl = static_cast<PdmsTools::PdmsObjects::SCylinder*>(currentPair.first);
-						primitive = new ccCylinder(pdmsCyl->diameter/2,pdmsCyl->height,0,pdmsCyl->name);
-					}
-					break;
-				case PDMS_CTORUS:
-					{
-						PdmsTools::PdmsObjects::CTorus* pdmsCTor = static_cast<PdmsTools::PdmsObjects::CTorus*>(currentPair.first);
-						primitive = new ccTorus(pdmsCTor->inside_radius,pdmsCTor->outside_radius,pdmsCTor->angle/**M_PI/180.0*/,false,0,0,pdmsCTor->name);
-					}
-					break;
-				case PDMS_RTORUS:
-					{
-						PdmsTools::PdmsObjects::RTorus* pdmsRTor = static_cast<PdmsTools::PdmsObjects::RTorus*>(currentPair.first);
-						primitive = new ccTorus(pdmsRTor->inside_radius,pdmsRTor->outside_radius,pdmsRTor->angle/**M_PI/180.0*/,false,pdmsRTor->height,0,pdmsRTor->name);
-					}
-					break;
-				case PDMS_DISH:
-					{
-						PdmsTools::PdmsObjects::Dish* pdmsDish = static_cast<PdmsTools::PdmsObjects::Dish*>(currentPair.first);
-						primitive = new ccDish(pdmsDish->diameter/2,pdmsDish->height,pdmsDish->radius,0,pdmsDish->name);
-					}
-					break;
-				case PDMS_CONE:
-					{
-						PdmsTools::PdmsObjects::Cone* pdmsCone = static_cast<PdmsTools::PdmsObjects::Cone*>(currentPair.first);
-						primitive = new ccCone(pdmsCone->dbottom/2,pdmsCone->dtop/2,pdmsCone->height,0,0,0,pdmsCone->name);
-					}
-					break;
-				case PDMS_PYRAMID:
-					unsupportedPrimitiveStr = "Pyramid";
-					break;
-				case PDMS_SNOUT:
+					prototype = CreatePrimitive(key, 0, itemName);
+					if (!prototype)
 					{
-						PdmsTools::PdmsObjects::Snout* pdmsSnout = static_cast<PdmsTools::PdmsObjects::Snout*>(currentPair.first);
-						primitive = new ccCone(pdmsSnout->dbottom/2,pdmsSnout->dtop/2,pdmsSnout->height,pdmsSnout->xoff,pdmsSnout->yoff,0,pdmsSnout->name);
+						prototypes.erase(key);
+						continue;
 					}
-					break;
-				case PDMS_BOX:
-					{
-						PdmsTools::PdmsObjects::Box* pdmsBox = static_cast<PdmsTools::PdmsObjects::Box*>(currentPair.first);
-						primitive = new ccBox(pdmsBox->lengths,0,pdmsBox->name);
-					}
-					break;
-				case PDMS_NBOX:
-					unsupportedPrimitiveStr = "NBox";
-					break;
-				case PDMS_EXTRU:
-					{
-						PdmsTools::PdmsObjects::Extrusion* pdmsExtru = static_cast<PdmsTools::PdmsObjects::Extrusion*>(currentPair.first);
-						size_t count = pdmsExtru->loop->loop.size();
-						if (count)
-						{
-							std::vector<CCVector2> profile;
-							profile.reserve(count);
-							for (std::list<PdmsTools::PdmsObjects::Vertex*>::const_iterator it=pdmsExtru->loop->loop.begin();it!=pdmsExtru->loop->loop.end();++it)
-								profile.push_back((*it)->v);
-
-							primitive = new ccExtru(profile,pdmsExtru->height,0,pdmsExtru->name);
-						}
-					}
-					break;
-				case PDMS_NEXTRU:
-					unsupportedPrimitiveStr = "NExtru";
-					break;
-				case PDMS_LOOP:
-					unsupportedPrimitiveStr = "Loop";
-					break;
-				case PDMS_VERTEX:
-					unsupportedPrimitiveStr = "Vertex";
-					break;
+					prototype->setName(QString("%1 #%2").arg(prototype->getTypeName()).arg(prototypes.size()));
+					prototype->setEnabled(false);
+					prototypesGroup->addChild(prototype);
 				}
+				primitive = prototype->createInstance(trans);
+				primitive->setName(itemName);
+			}
+			else
+			{
+				primitive = CreatePrimitive(key, &trans, itemName);
+				if (!primitive)
+					continue;
+			}
 
-				if (primitive)
+			if (groupMerging)
+			{
+				MergedGroup& merged = mergedGroups[currentPair.entity];
+				if (!merged.mesh)
+					merged.mesh = CreateMergedMesh(QString("%1 (merged)").arg(currentPair.entity->getName()));
+
+				unsigned firstVertex = merged.mesh->getAssociatedCloud()->size();
+				if (merged.mesh->merge(primitive))
 				{
-					//transformation
-					ccGLMatrix trans;
-					assert(currentPair.first->isCoordinateSystemUpToDate);
-					trans.setTranslation(currentPair.first->position);
-					for (unsigned c=0; c<3; ++c)
-						for (unsigned l=0; l<3; ++l)
-							trans.getColumn(c)[l] = static_cast<float>(currentPair.first->orientation[c].u[l]);
-
-					primitive->setGLTransformation(trans);
-					primitive->setVisible(true);
-					currentPair.second->addChild(primitive);
+					merged.names << itemName;
+					merged.firstVertex.push_back(firstVertex);
 				}
 				else
 				{
-					ccLog::Warning(QString("[PDMSFilter] Primitive '%1' not supported yet!").arg(unsupportedPrimitiveStr));
+					warnings << QString("[PDMSFilter] Failed to merge element '%1' (not enough memory)").arg(itemName);
 				}
+				delete primitive;
+				continue;
+			}
+
+			primitive->setVisible(true);
+			currentPair.entity->addChild(primitive);
+		}
+
+	}
+
+	for (std::map<ccHObject*, MergedGroup>::iterator it = mergedGroups.begin(); it != mergedGroups.end(); ++it)
+	{
+		MergedGroup& merged = it->second;
+		if (merged.names.empty())
+		{
+			delete merged.mesh;
+			continue;
+		}
+
+		if (!FinishMergedGroup(merged))
+			warnings << QString("[PDMSFilter] Not enough memory to store the source elements of group '%1'").arg(it->first->getName());
+
+		merged.mesh->setVisible(true);
+		it->first->addChild(merged.mesh);
+		merged.mesh = 0;
+	}
+
+	if (prototypesGroup)
+	{
+		if (prototypesGroup->getChildrenNumber() != 0)
+		{
+			//instances depend on them: they must be kept in the DB tree
+			container.addChild(prototypesGroup);
+		}
+		else
+		{
+			delete prototypesGroup;
+		}
+		prototypesGroup = 0;
+	}
+
+	return CC_FERR_NO_ERROR;
+}
+
+//! Parses a PDMS macro (or loads its cache) and converts its content (as children of 'container')
+static CC_FILE_ERROR ImportFile(const QString& filename, ccHObject& container, QStringList& warnings)
+{
+	PdmsCache cache;
+	{
+		CC_FILE_ERROR result = LoadCache(filename, cache, warnings);
+		if (result != CC_FERR_NO_ERROR)
+			return result;
+	}
+
+	return ConvertCache(cache, container, warnings);
+}
+
+//! Batch import job (one per file)
+struct PdmsImportJob
+{
+	QString filename;
+	PdmsCache* cache;
+	QStringList warnings;
+	CC_FILE_ERROR result;
+};
+
+//! Parses a PDMS macro (or loads its cache)
+/** Only relies on its own parser (and context), so that several files can
+	be parsed concurrently. Warnings are returned in the job (ccLog is not
+	meant to be called from several threads at once). Entities are created
+	afterwards, by the calling thread (see ConvertCache).
+**/
+static void LoadCache_MT(PdmsImportJob& job)
+{
+	try
+	{
+		job.result = LoadCache(job.filename, *job.cache, job.warnings);
+	}
+	catch(...)
+	{
+		job.result = CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+}
+
+CC_FILE_ERROR PDMSFilter::LoadFiles(const QStringList& filenames, ccHObject& container)
+{
+	if (filenames.empty())
+		return CC_FERR_NO_LOAD;
+
+	//one job (and one group) per file
+	std::vector<PdmsImportJob> jobs;
+	try
+	{
+		jobs.resize(filenames.size());
+	}
+	catch(std::bad_alloc)
+	{
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+	for (int i=0; i<filenames.size(); ++i)
+	{
+		jobs[i].filename = filenames[i];
+		jobs[i].cache = new PdmsCache;
+		jobs[i].result = CC_FERR_NO_ERROR;
+	}
+
+	//each file is parsed by its own thread
+	QtConcurrent::blockingMap(jobs, LoadCache_MT);
+
+	//the entities are created by this thread (in the input order)
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+	unsigned loadedCount = 0;
+	for (size_t i=0; i<jobs.size(); ++i)
+	{
+		ccHObject* fileGroup = 0;
+		if (jobs[i].result == CC_FERR_NO_ERROR)
+		{
+			fileGroup = new ccHObject(QFileInfo(jobs[i].filename).fileName());
+			try
+			{
+				jobs[i].result = ConvertCache(*jobs[i].cache, *fileGroup, jobs[i].warnings);
+			}
+			catch(...)
+			{
+				jobs[i].result = CC_FERR_NOT_ENOUGH_MEMORY;
 			}
+		}
+		delete jobs[i].cache;
+		jobs[i].cache = 0;
+
+		for (int j=0; j<jobs[i].warnings.size(); ++j)
+			ccLog::Warning(jobs[i].warnings[j]);
 
+		if (jobs[i].result == CC_FERR_NO_ERROR)
+		{
+			container.addChild(fileGroup);
+			++loadedCount;
+		}
+		else
+		{
+			ccLog::Warning(QString("[PDMSFilter] Failed to load file '%1'").arg(jobs[i].filename));
+			delete fileGroup;
+			if (result == CC_FERR_NO_ERROR)
+				result = jobs[i].result;
 		}
 	}
+
+	if (loadedCount == 0)
+		return result;
+
+	return CC_FERR_NO_ERROR;
+}
+
+CC_FILE_ERROR PDMSFilter::LoadDirectory(QString dirname, ccHObject& container)
+{
+	QDir dir(dirname);
+	QStringList nameFilters;
+	nameFilters << "*.mac" << "*.pdms" << "*.pdmsmac";
+	QStringList entries = dir.entryList(nameFilters, QDir::Files | QDir::Readable, QDir::Name);
+
+	QStringList filenames;
+	for (int i=0; i<entries.size(); ++i)
+		filenames << dir.absoluteFilePath(entries[i]);
+
+	if (filenames.empty())
+	{
+		ccLog::Warning(QString("[PDMSFilter] No PDMS macro in directory '%1'").arg(dirname));
+		return CC_FERR_NO_LOAD;
+	}
+
+	return LoadFiles(filenames, container);
+}
+
+//! Output of PDMSFilter::ConvertFile (written batch by batch)
+struct ConversionOutput
+{
+	QString filename;
+	PDMSFilter::ConversionFormat format;
+	//! Number of batches written so far
+	unsigned batchCount;
+	//! Number of vertices and triangles written so far
+	unsigned vertexCount, triangleCount;
+	//! PLY format: vertices and triangles (until the final file can be written)
+	QTemporaryFile vertexFile, triangleFile;
+
+	ConversionOutput(const QString& outputFilename, PDMSFilter::ConversionFormat outputFormat)
+		: filename(outputFilename)
+		, format(outputFormat)
+		, batchCount(0)
+		, vertexCount(0)
+		, triangleCount(0)
+		, vertexFile(outputFilename + ".vertices.XXXXXX")
+		, triangleFile(outputFilename + ".triangles.XXXXXX")
+	{}
+};
+
+//! Writes a batch of merged primitives (see PDMSFilter::ConvertFile)
+/** \param output conversion output
+	\param batch merged primitives
+	\param last whether this is the last batch
+**/
+static CC_FILE_ERROR WriteBatch(ConversionOutput& output, MergedGroup& batch, bool last)
+{
+	assert(batch.mesh);
+	ccGenericPointCloud* vertices = batch.mesh->getAssociatedCloud();
+	unsigned vertCount = vertices->size();
+	unsigned triCount = batch.mesh->size();
+
+	if (output.format == PDMSFilter::CONVERT_TO_BIN)
+	{
+		//each batch has its own file (unless there's only one)
+		QString filename = output.filename;
+		if (!last || output.batchCount != 0)
+		{
+			QFileInfo fileInfo(output.filename);
+			filename = QString("%1/%2_part%3.%4").arg(fileInfo.absolutePath()).arg(fileInfo.completeBaseName()).arg(output.batchCount+1).arg(BinFilter::GetDefaultExtension());
+			batch.mesh->setName(QString("%1 (part %2)").arg(fileInfo.completeBaseName()).arg(output.batchCount+1));
+		}
+
+		if (!FinishMergedGroup(batch))
+			ccLog::Warning(QString("[PDMSFilter] Not enough memory to store the source elements of '%1'").arg(batch.mesh->getName()));
+
+		FileIOFilter::SaveParameters parameters;
+		parameters.alwaysDisplaySaveDialog = false;
+		CC_FILE_ERROR result = FileIOFilter::SaveToFile(batch.mesh, filename, parameters, BinFilter::GetFileFilter());
+		if (result != CC_FERR_NO_ERROR)
+			return result;
+	}
 	else
 	{
-		return CC_FERR_MALFORMED_FILE;
+		for (unsigned i=0; i<vertCount; ++i)
+		{
+			const CCVector3* P = vertices->getPoint(i);
+			if (output.vertexFile.write(reinterpret_cast<const char*>(P->u), sizeof(PointCoordinateType)*3) < 0)
+				return CC_FERR_WRITING;
+		}
+
+		for (unsigned i=0; i<triCount; ++i)
+		{
+			const CCLib::TriangleSummitsIndexes* tsi = batch.mesh->getTriangleIndexes(i);
+			int32_t indexes[3] = {	static_cast<int32_t>(output.vertexCount + tsi->i1),
+									static_cast<int32_t>(output.vertexCount + tsi->i2),
+									static_cast<int32_t>(output.vertexCount + tsi->i3) };
+			if (output.triangleFile.write(reinterpret_cast<const char*>(indexes), sizeof(int32_t)*3) < 0)
+				return CC_FERR_WRITING;
+		}
 	}
 
-	container.applyGLTransformation_recursive();
+	output.vertexCount += vertCount;
+	output.triangleCount += triCount;
+	++output.batchCount;
 
 	return CC_FERR_NO_ERROR;
 }
+
+//! Writes the content of a temporary file (see WriteBatch) with rply
+/** \param ply output
+	\param file temporary file (triplets of values)
+	\param lists whether triplets should be written as lists (triangles)
+**/
+template<typename T> static bool WriteTriplets(p_ply ply, QFile& file, bool lists)
+{
+	if (!file.seek(0))
+		return false;
+
+	std::vector<T> buffer(3*4096);
+	while (true)
+	{
+		qint64 readBytes = file.read(reinterpret_cast<char*>(&buffer[0]), static_cast<qint64>(buffer.size()*sizeof(T)));
+		if (readBytes < 0)
+			return false;
+		if (readBytes == 0)
+			break;
+
+		size_t count = static_cast<size_t>(readBytes) / sizeof(T);
+		for (size_t i=0; i<count; ++i)
+		{
+			if (lists && (i % 3) == 0 && !ply_write(ply, 3.0))
+				return false;
+			if (!ply_write(ply, static_cast<double>(buffer[i])))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//! Writes the final PLY file (see PDMSFilter::ConvertFile)
+static CC_FILE_ERROR WritePlyFile(ConversionOutput& output)
+{
+	p_ply ply = ply_create(qPrintable(output.filename), PlyFilter::GetDefaultOutputFormat(), NULL, 0, NULL);
+	if (!ply)
+		return CC_FERR_WRITING;
+
+	e_ply_type coordType = (sizeof(PointCoordinateType) > 4 ? PLY_DOUBLE : PLY_FLOAT);
+
+	bool success =	ply_add_element(ply, "vertex", output.vertexCount)
+				&&	ply_add_scalar_property(ply, "x", coordType)
+				&&	ply_add_scalar_property(ply, "y", coordType)
+				&&	ply_add_scalar_property(ply, "z", coordType)
+				&&	ply_add_element(ply, "face", output.triangleCount)
+				&&	ply_add_list_property(ply, "vertex_indices", PLY_UCHAR, PLY_INT)
+				&&	ply_add_comment(ply, "Author: CloudCompare (TELECOM PARISTECH/EDF R&D)")
+				&&	ply_write_header(ply);
+
+	success = success
+			&&	WriteTriplets<PointCoordinateType>(ply, output.vertexFile, false)
+			&&	WriteTriplets<int32_t>(ply, output.triangleFile, true);
+
+	ply_close(ply);
+
+	return success ? CC_FERR_NO_ERROR : CC_FERR_WRITING;
+}
+
+CC_FILE_ERROR PDMSFilter::ConvertFile(QString filename, QString outputFilename, ConversionFormat format, unsigned maxBatchTriangles/*=1000000*/, bool updateCache/*=false*/)
+{
+	QStringList warnings;
+	PdmsCache cache;
+	CC_FILE_ERROR result = LoadCache(filename, cache, warnings, updateCache);
+
+	ConversionOutput output(outputFilename, format);
+	if (result == CC_FERR_NO_ERROR && format == CONVERT_TO_PLY)
+	{
+		if (!output.vertexFile.open() || !output.triangleFile.open())
+			result = CC_FERR_WRITING;
+	}
+
+	//primitives are tessellated one at a time and merged in the current batch
+	MergedGroup batch;
+	unsigned primitiveCount = 0;
+	//unsupported primitives (count per type)
+	std::map<Token, unsigned> unsupported;
+
+	size_t elementCount = (result == CC_FERR_NO_ERROR ? static_cast<size_t>(cache.header().elementCount) : 0);
+	for (size_t i=0; i<elementCount && result == CC_FERR_NO_ERROR; ++i)
+	{
+		const PdmsCache::Element& item = cache.element(i);
+
+		PrimitiveKey key;
+		key.type = static_cast<Token>(item.type);
+		if (item.flags & PdmsCache::UNSUPPORTED)
+		{
+			++unsupported[key.type];
+			continue;
+		}
+		const PointCoordinateType* params = cache.params(item);
+		key.params.assign(params, params+item.paramCount);
+
+		ccGLMatrix trans = GetTransformation(item);
+		QString itemName = cache.string(item.name);
+		ccGenericPrimitive* primitive = CreatePrimitive(key, &trans, itemName);
+		if (!primitive)
+			continue;
+		if (!primitive->tessellate())
+		{
+			warnings << QString("[PDMSFilter] Failed to tessellate element '%1' (not enough memory)").arg(itemName);
+			delete primitive;
+			continue;
+		}
+
+		//flush the current batch if it's full
+		if (batch.mesh && batch.mesh->size() != 0 && batch.mesh->size() + primitive->size() > maxBatchTriangles)
+		{
+			result = WriteBatch(output, batch, false);
+			delete batch.mesh;
+			batch = MergedGroup();
+			if (result != CC_FERR_NO_ERROR)
+			{
+				delete primitive;
+				break;
+			}
+		}
+
+		if (!batch.mesh)
+			batch.mesh = CreateMergedMesh(QFileInfo(outputFilename).completeBaseName());
+
+		unsigned firstVertex = batch.mesh->getAssociatedCloud()->size();
+		if (batch.mesh->merge(primitive,false)) //no need for display L.O.D. levels
+		{
+			batch.names << itemName;
+			batch.firstVertex.push_back(firstVertex);
+			++primitiveCount;
+		}
+		else
+		{
+			warnings << QString("[PDMSFilter] Failed to merge element '%1' (not enough memory)").arg(itemName);
+		}
+		delete primitive;
+	}
+
+	if (result == CC_FERR_NO_ERROR)
+	{
+		if (batch.mesh && !batch.names.empty())
+			result = WriteBatch(output, batch, true);
+
+		if (result == CC_FERR_NO_ERROR)
+		{
+			if (output.batchCount == 0)
+				result = CC_FERR_NO_SAVE;
+			else if (format == CONVERT_TO_PLY)
+				result = WritePlyFile(output);
+		}
+	}
+	delete batch.mesh;
+	batch.mesh = 0;
+
+	for (std::map<Token, unsigned>::const_iterator it = unsupported.begin(); it != unsupported.end(); ++it)
+		warnings << QString("[PDMSFilter] Primitive '%1' not supported yet! (%2 element(s) ignored)").arg(GetUnsupportedPrimitiveName(it->first)).arg(it->second);
+	for (int i=0; i<warnings.size(); ++i)
+		ccLog::Warning(warnings[i]);
+
+	if (result == CC_FERR_NO_ERROR)
+		ccLog::Print(QString("[PDMSFilter] '%1' converted: %2 primitive(s), %3 vertices, %4 triangles (%5 batch(es))").arg(QFileInfo(filename).fileName()).arg(primitiveCount).arg(output.vertexCount).arg(output.triangleCount).arg(output.batchCount));
+
+	return result;
+}
+
+CC_FILE_ERROR PDMSFilter::loadFile(QString filename, ccHObject& container, LoadParameters& parameters)
+{
+	//a whole directory of macros can be loaded at once
+	if (QFileInfo(filename).isDir())
+		return LoadDirectory(filename, container);
+
+	QStringList warnings;
+	CC_FILE_ERROR result = ImportFile(filename, container, warnings);
+	for (int i=0; i<warnings.size(); ++i)
+		ccLog::Warning(warnings[i]);
+
+	return result;
+}
@@ -31,6 +31,71 @@ public:
 	static inline QString GetFileFilter() { return "PDMS primitives (*.pdms *.pdmsmac *.mac)"; }
 	static inline QString GetDefaultExtension() { return "pdms"; }
 
+	//! Sets whether identical primitives should be instanced (disabled by default)
+	/** In instancing mode, all the PDMS primitives with the same parameters
+		share a single tessellated prototype (see ccMesh::createInstance). Each
+		element only keeps its own transformation (as a display transformation).
+		Prototypes are stored (disabled) in a 'Prototypes' group.
+	**/
+	static void SetInstancing(bool state);
+	//! Returns whether identical primitives are instanced
+	static bool IsInstancingEnabled();
+
+	//! Sets whether the primitives of each group should be merged (disabled by default)
+	/** In this mode, all the primitives of a given PDMS group (zone, equipment, etc.)
+		are baked in a single mesh (to reduce the number of entities to display).
+		The name of the source element of each vertex/triangle can still be
+		retrieved with ccMesh::getSourceName. Takes precedence over instancing.
+	**/
+	static void SetGroupMerging(bool state);
+	//! Returns whether the primitives of each group are merged
+	static bool IsGroupMergingEnabled();
+
+	//! Sets whether parsed macros should be cached (enabled by default)
+	/** The parsed content of each macro is saved next to it (see PdmsCache).
+		As long as the macro size and modification time don't change, the cache
+		is loaded (mapped) instead of parsing the macro again.
+	**/
+	static void SetCaching(bool state);
+	//! Returns whether parsed macros are cached
+	static bool IsCachingEnabled();
+
+	//! Loads several PDMS macros at once
+	/** Files are parsed in parallel (one thread per file). Entities are then
+		created by the calling thread (as this is not thread-safe). Each file gets
+		its own group in 'container' (in the same order as 'filenames').
+		Files that can't be loaded are skipped (with a warning).
+		\return CC_FERR_NO_ERROR if at least one file was loaded
+	**/
+	static CC_FILE_ERROR LoadFiles(const QStringList& filenames, ccHObject& container);
+
+	//! Loads all the PDMS macros (*.mac, *.pdms, *.pdmsmac) of a directory
+	/** See PDMSFilter::LoadFiles. Also called by loadFile if 'filename' is a directory.
+	**/
+	static CC_FILE_ERROR LoadDirectory(QString dirname, ccHObject& container);
+
+	//! Output format of PDMSFilter::ConvertFile
+	enum ConversionFormat { CONVERT_TO_BIN, CONVERT_TO_PLY };
+
+	//! Converts a PDMS macro to a mesh file (without creating any entity tree)
+	/** This is not a streaming conversion: the macro is parsed as a whole
+		first, as 'WRT /NAME' references may point to any other element of the
+		hierarchy (see PdmsChunkedParser). The peak memory is therefore the one
+		of the parsing. The parsed content is then converted to its compact
+		form (see PdmsCache) and released.
+		Only the output is bounded: primitives are tessellated one at a time
+		and merged in a batch mesh that is flushed to the output as soon as it
+		reaches 'maxBatchTriangles' triangles.
+		- PLY: a single mesh. Vertices and triangles are streamed to temporary
+		files, then written with the default PLY format (see PlyFilter).
+		- BIN: one mesh per batch (with its source names, see ccMesh::getSourceName).
+		If there's more than one batch, each one is saved in its own file
+		('<base>_part<N>.bin' next to 'outputFilename').
+		An up-to-date cache of the macro is used if it exists (see SetCaching),
+		but the cache file is only (re)written if 'updateCache' is true.
+	**/
+	static CC_FILE_ERROR ConvertFile(QString filename, QString outputFilename, ConversionFormat format, unsigned maxBatchTriangles = 1000000, bool updateCache = false);
+
 	//inherited from FileIOFilter
 	virtual bool importSupported() const { return true; }
 	virtual CC_FILE_ERROR loadFile(QString filename, ccHObject& container, LoadParameters& parameters);
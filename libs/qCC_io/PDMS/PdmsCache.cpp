@@ -0,0 +1,436 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "PdmsCache.h"
+
+//Qt
+#include <QTemporaryFile>
+
+//system
+#include <map>
+#include <string>
+#include <assert.h>
+#include <string.h>
+
+static const char c_magic[8] = {'P','D','M','S','C','A','C','H'};
+static const uint32_t c_byteOrder = 0x01020304;
+
+//! Sections alignment (in bytes)
+static const size_t c_alignment = 8;
+
+static inline size_t Align(size_t offset)
+{
+	return (offset + c_alignment - 1) & ~(c_alignment - 1);
+}
+
+//! Strings section (names interned by the parser: the same name is always the same pointer)
+struct StringsSection
+{
+	std::string data;
+	std::map<const char*, uint32_t> offsets;
+
+	uint32_t add(const char* str)
+	{
+		std::map<const char*, uint32_t>::const_iterator it = offsets.find(str);
+		if (it != offsets.end())
+			return it->second;
+
+		uint32_t offset = static_cast<uint32_t>(data.size());
+		data.append(str,strlen(str)+1);
+		offsets[str] = offset;
+		return offset;
+	}
+};
+
+PdmsCache::PdmsCache()
+	: m_data(0)
+{
+}
+
+PdmsCache::~PdmsCache()
+{
+	clear();
+}
+
+QString PdmsCache::GetFilename(const QString& sourceFilename)
+{
+	return sourceFilename + ".pdmscache";
+}
+
+void PdmsCache::clear()
+{
+	if (m_file.isOpen())
+	{
+		if (m_data)
+			m_file.unmap(const_cast<uchar*>(m_data));
+		m_file.close();
+	}
+	m_buffer.clear();
+	m_data = 0;
+}
+
+bool PdmsCache::GetPrimitiveParameters(PdmsObjects::GenericItem* item, std::vector<PointCoordinateType>& params, bool& unsupported)
+{
+	params.clear();
+	unsupported = false;
+
+	switch (item->getType())
+	{
+	case PDMS_SCYLINDER:
+		{
+			PdmsObjects::SCylinder* pdmsCyl = static_cast<PdmsObjects::SCylinder*>(item);
+			params.push_back(pdmsCyl->diameter/2);
+			params.push_back(pdmsCyl->height);
+		}
+		break;
+	case PDMS_CTORUS:
+		{
+			PdmsObjects::CTorus* pdmsCTor = static_cast<PdmsObjects::CTorus*>(item);
+			params.push_back(pdmsCTor->inside_radius);
+			params.push_back(pdmsCTor->outside_radius);
+			params.push_back(pdmsCTor->angle/**M_PI/180.0*/);
+		}
+		break;
+	case PDMS_RTORUS:
+		{
+			PdmsObjects::RTorus* pdmsRTor = static_cast<PdmsObjects::RTorus*>(item);
+			params.push_back(pdmsRTor->inside_radius);
+			params.push_back(pdmsRTor->outside_radius);
+			params.push_back(pdmsRTor->angle/**M_PI/180.0*/);
+			params.push_back(pdmsRTor->height);
+		}
+		break;
+	case PDMS_DISH:
+		{
+			PdmsObjects::Dish* pdmsDish = static_cast<PdmsObjects::Dish*>(item);
+			params.push_back(pdmsDish->diameter/2);
+			params.push_back(pdmsDish->height);
+			params.push_back(pdmsDish->radius);
+		}
+		break;
+	case PDMS_CONE:
+		{
+			PdmsObjects::Cone* pdmsCone = static_cast<PdmsObjects::Cone*>(item);
+			params.push_back(pdmsCone->dbottom/2);
+			params.push_back(pdmsCone->dtop/2);
+			params.push_back(pdmsCone->height);
+		}
+		break;
+	case PDMS_SNOUT:
+		{
+			PdmsObjects::Snout* pdmsSnout = static_cast<PdmsObjects::Snout*>(item);
+			params.push_back(pdmsSnout->dbottom/2);
+			params.push_back(pdmsSnout->dtop/2);
+			params.push_back(pdmsSnout->height);
+			params.push_back(pdmsSnout->xoff);
+			params.push_back(pdmsSnout->yoff);
+		}
+		break;
+	case PDMS_BOX:
+		{
+			PdmsObjects::Box* pdmsBox = static_cast<PdmsObjects::Box*>(item);
+			params.push_back(pdmsBox->lengths.x);
+			params.push_back(pdmsBox->lengths.y);
+			params.push_back(pdmsBox->lengths.z);
+		}
+		break;
+	case PDMS_EXTRU:
+		{
+			PdmsObjects::Extrusion* pdmsExtru = static_cast<PdmsObjects::Extrusion*>(item);
+			size_t count = pdmsExtru->loop->loop.size();
+			if (count == 0)
+				return false;
+
+			params.reserve(1+2*count);
+			params.push_back(pdmsExtru->height);
+			for (std::vector<PdmsObjects::Vertex*>::const_iterator it=pdmsExtru->loop->loop.begin();it!=pdmsExtru->loop->loop.end();++it)
+			{
+				params.push_back((*it)->v.x);
+				params.push_back((*it)->v.y);
+			}
+		}
+		break;
+	default:
+		//pyramids, negative boxes and extrusions, etc.
+		unsupported = true;
+		return false;
+	}
+
+	return true;
+}
+
+bool PdmsCache::build(PdmsObjects::GenericItem* root, int64_t sourceSize, int64_t sourceTime)
+{
+	clear();
+
+	if (!root)
+		return false;
+
+	std::vector<Group> groups;
+	std::vector<Element> elements;
+	std::vector<PointCoordinateType> params;
+	StringsSection strings;
+	Header header;
+
+	try
+	{
+		//groups (in breadth-first order, see the class description)
+		std::vector<PdmsObjects::GroupElement*> groupItems;
+		//a single element is stored in a (virtual) root group
+		std::vector<PdmsObjects::DesignElement*> rootElements;
+		if (root->isGroupElement())
+		{
+			groupItems.push_back(static_cast<PdmsObjects::GroupElement*>(root));
+		}
+		else
+		{
+			groupItems.push_back(0);
+			rootElements.push_back(static_cast<PdmsObjects::DesignElement*>(root));
+		}
+
+		std::vector<PointCoordinateType> elementParams;
+		for (size_t i=0; i<groupItems.size(); ++i)
+		{
+			PdmsObjects::GroupElement* groupItem = groupItems[i];
+			const std::vector<PdmsObjects::DesignElement*>& groupElements = (groupItem ? groupItem->elements : rootElements);
+
+			Group group;
+			memset(&group,0,sizeof(Group));
+			if (groupItem)
+			{
+				group.name = strings.add(groupItem->name);
+				group.level = static_cast<uint32_t>(groupItem->getType());
+			}
+			else
+			{
+				group.name = strings.add("");
+				group.level = static_cast<uint32_t>(PDMS_INVALID_TOKEN);
+			}
+
+			//elements
+			group.firstElement = static_cast<uint32_t>(elements.size());
+			for (std::vector<PdmsObjects::DesignElement*>::const_iterator it = groupElements.begin(); it != groupElements.end(); ++it)
+			{
+				PdmsObjects::DesignElement* item = *it;
+
+				Element element;
+				memset(&element,0,sizeof(Element));
+				element.type = static_cast<uint32_t>(item->getType());
+
+				bool unsupported = false;
+				if (!GetPrimitiveParameters(item,elementParams,unsupported))
+				{
+					if (!unsupported)
+						continue;
+					element.flags = UNSUPPORTED;
+				}
+
+				element.name = strings.add(item->name);
+
+				element.firstParam = params.size();
+				element.paramCount = static_cast<uint32_t>(elementParams.size());
+				params.insert(params.end(),elementParams.begin(),elementParams.end());
+
+				assert(item->isCoordinateSystemUpToDate);
+				for (unsigned c=0; c<3; ++c)
+				{
+					element.position[c] = item->position.u[c];
+					for (unsigned l=0; l<3; ++l)
+						element.orientation[3*c+l] = item->orientation[c].u[l];
+				}
+
+				elements.push_back(element);
+			}
+			group.elementCount = static_cast<uint32_t>(elements.size()) - group.firstElement;
+
+			//sub-groups
+			group.firstSubGroup = static_cast<uint32_t>(groupItems.size());
+			if (groupItem)
+				groupItems.insert(groupItems.end(),groupItem->subhierarchy.begin(),groupItem->subhierarchy.end());
+			group.subGroupCount = static_cast<uint32_t>(groupItems.size()) - group.firstSubGroup;
+
+			groups.push_back(group);
+		}
+
+		//offsets are stored on 32 bits
+		if (strings.data.size() > 0xFFFFFFFF || elements.size() > 0xFFFFFFFF || groups.size() > 0xFFFFFFFF)
+			return false;
+
+		//whole cache
+		memset(&header,0,sizeof(Header));
+		memcpy(header.magic,c_magic,8);
+		header.version = c_version;
+		header.byteOrder = c_byteOrder;
+		header.coordSize = sizeof(PointCoordinateType);
+		header.sourceSize = sourceSize;
+		header.sourceTime = sourceTime;
+		header.groupCount = groups.size();
+		header.elementCount = elements.size();
+		header.paramCount = params.size();
+		header.stringsSize = strings.data.size();
+		header.groupsOffset = Align(sizeof(Header));
+		header.elementsOffset = Align(header.groupsOffset + groups.size() * sizeof(Group));
+		header.paramsOffset = Align(header.elementsOffset + elements.size() * sizeof(Element));
+		header.stringsOffset = Align(header.paramsOffset + params.size() * sizeof(PointCoordinateType));
+
+		m_buffer.resize(static_cast<size_t>(header.stringsOffset + strings.data.size()),0);
+	}
+	catch(std::bad_alloc)
+	{
+		m_buffer.clear();
+		return false;
+	}
+
+	uchar* data = &(m_buffer[0]);
+	memcpy(data, &header, sizeof(Header));
+	if (!groups.empty())
+		memcpy(data + header.groupsOffset, &(groups[0]), groups.size() * sizeof(Group));
+	if (!elements.empty())
+		memcpy(data + header.elementsOffset, &(elements[0]), elements.size() * sizeof(Element));
+	if (!params.empty())
+		memcpy(data + header.paramsOffset, &(params[0]), params.size() * sizeof(PointCoordinateType));
+	if (!strings.data.empty())
+		memcpy(data + header.stringsOffset, strings.data.data(), strings.data.size());
+
+	m_data = data;
+
+	return true;
+}
+
+bool PdmsCache::isValid(size_t dataSize) const
+{
+	if (dataSize < sizeof(Header))
+		return false;
+
+	const Header& h = header();
+	if (	memcmp(h.magic,c_magic,8) != 0
+		||	h.version != c_version
+		||	h.byteOrder != c_byteOrder
+		||	h.coordSize != sizeof(PointCoordinateType) )
+	{
+		return false;
+	}
+
+	//sections
+	if (	h.groupCount == 0
+		||	h.groupsOffset % c_alignment != 0
+		||	h.elementsOffset % c_alignment != 0
+		||	h.paramsOffset % c_alignment != 0
+		||	h.groupsOffset < sizeof(Header)
+		||	h.groupsOffset > dataSize
+		||	h.groupCount > (dataSize - h.groupsOffset) / sizeof(Group)
+		||	h.elementsOffset > dataSize
+		||	h.elementCount > (dataSize - h.elementsOffset) / sizeof(Element)
+		||	h.paramsOffset > dataSize
+		||	h.paramCount > (dataSize - h.paramsOffset) / sizeof(PointCoordinateType)
+		||	h.stringsOffset > dataSize
+		||	h.stringsSize > dataSize - h.stringsOffset
+		||	h.stringsSize == 0
+		||	string(static_cast<uint32_t>(h.stringsSize-1))[0] != 0 )
+	{
+		return false;
+	}
+
+	//groups (the sub-groups are always stored after their parent: no cycle)
+	for (uint64_t i=0; i<h.groupCount; ++i)
+	{
+		const Group& g = group(static_cast<size_t>(i));
+		if (	g.name >= h.stringsSize
+			||	g.firstElement > h.elementCount
+			||	g.elementCount > h.elementCount - g.firstElement
+			||	(g.subGroupCount != 0 && g.firstSubGroup <= i)
+			||	g.firstSubGroup > h.groupCount
+			||	g.subGroupCount > h.groupCount - g.firstSubGroup )
+		{
+			return false;
+		}
+	}
+
+	//elements
+	for (uint64_t i=0; i<h.elementCount; ++i)
+	{
+		const Element& e = element(static_cast<size_t>(i));
+		if (	e.name >= h.stringsSize
+			||	e.firstParam > h.paramCount
+			||	e.paramCount > h.paramCount - e.firstParam )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool PdmsCache::load(const QString& filename, int64_t sourceSize, int64_t sourceTime)
+{
+	clear();
+
+	m_file.setFileName(filename);
+	if (!m_file.exists() || !m_file.open(QIODevice::ReadOnly))
+		return false;
+
+	qint64 fileSize = m_file.size();
+	if (fileSize < static_cast<qint64>(sizeof(Header)))
+	{
+		clear();
+		return false;
+	}
+
+	m_data = m_file.map(0,fileSize);
+	if (!m_data)
+	{
+		clear();
+		return false;
+	}
+
+	if (	!isValid(static_cast<size_t>(fileSize))
+		||	header().sourceSize != sourceSize
+		||	header().sourceTime != sourceTime )
+	{
+		clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool PdmsCache::save(const QString& filename) const
+{
+	if (!m_data || m_buffer.empty())
+		return false;
+
+	//the cache is written in a temporary file first (in the same directory),
+	//so that an interrupted write never leaves a truncated cache behind
+	QTemporaryFile file(filename + ".XXXXXX");
+	if (!file.open())
+		return false;
+
+	qint64 size = static_cast<qint64>(m_buffer.size());
+	if (file.write(reinterpret_cast<const char*>(m_data),size) != size || !file.flush())
+		return false; //the temporary file is automatically removed
+
+	file.close();
+
+	//QFile::rename won't overwrite an existing file
+	if (QFile::exists(filename) && !QFile::remove(filename))
+		return false;
+	if (!file.rename(filename))
+		return false;
+
+	file.setAutoRemove(false);
+	return true;
+}
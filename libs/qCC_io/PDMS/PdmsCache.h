@@ -0,0 +1,195 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef PDMS_CACHE_HEADER
+#define PDMS_CACHE_HEADER
+
+#include "PdmsTools.h"
+
+//Qt
+#include <QFile>
+#include <QString>
+
+//system
+#include <vector>
+#include <stdint.h>
+
+using namespace PdmsTools;
+
+//! Binary cache of a parsed PDMS macro
+/** Stores everything the PDMS filter needs from a parsed hierarchy: the
+	groups (names and hierarchy) and the primitives (names, resolved position
+	and orientation, parameters). The file layout is the in-memory layout: a
+	cache file is simply mapped and read in place (see load), without running
+	the lexer and the parser at all.
+
+	Layout: a Header, then the groups, elements, parameters and strings
+	sections (offsets in the header, 8-bytes aligned). Groups are stored so
+	that the sub-groups and the elements of each group are contiguous. Group
+	#0 is the root (its content goes directly in the destination container).
+
+	Caches are only valid on the same kind of machine (byte order and size of
+	PointCoordinateType are checked when loading).
+**/
+class PdmsCache
+{
+public:
+
+	//! Current format version
+	static const uint32_t c_version = 1;
+
+	//! File header
+	struct Header
+	{
+		//! "PDMSCACH"
+		char magic[8];
+		//! Format version (see c_version)
+		uint32_t version;
+		//! Byte order check (0x01020304 in native byte order)
+		uint32_t byteOrder;
+		//! sizeof(PointCoordinateType)
+		uint32_t coordSize;
+		//! Padding
+		uint32_t reserved;
+		//! Source file size (in bytes)
+		int64_t sourceSize;
+		//! Source file last modification time (ms since epoch)
+		int64_t sourceTime;
+		//! Number of groups
+		uint64_t groupCount;
+		//! Number of elements
+		uint64_t elementCount;
+		//! Number of parameters (all elements)
+		uint64_t paramCount;
+		//! Size of the strings section (in bytes)
+		uint64_t stringsSize;
+		//! Sections offsets (from the begining of the file)
+		uint64_t groupsOffset, elementsOffset, paramsOffset, stringsOffset;
+	};
+
+	//! Group (see PdmsObjects::GroupElement)
+	struct Group
+	{
+		//! Name (offset in the strings section)
+		uint32_t name;
+		//! Hierarchy level (token)
+		uint32_t level;
+		//! Elements
+		uint32_t firstElement, elementCount;
+		//! Sub-groups
+		uint32_t firstSubGroup, subGroupCount;
+	};
+
+	//! Element flags
+	enum ElementFlags
+	{
+		//! Primitive not supported (no parameters)
+		UNSUPPORTED = 1
+	};
+
+	//! Element (primitive)
+	struct Element
+	{
+		//! Name (offset in the strings section)
+		uint32_t name;
+		//! Type (token)
+		uint32_t type;
+		//! Flags (see ElementFlags)
+		uint32_t flags;
+		//! Number of parameters
+		uint32_t paramCount;
+		//! First parameter (index in the parameters section)
+		uint64_t firstParam;
+		//! Position
+		PointCoordinateType position[3];
+		//! Orientation (X, Y and Z axes)
+		PointCoordinateType orientation[9];
+	};
+
+	//! Default constructor
+	PdmsCache();
+	//! Destructor
+	~PdmsCache();
+
+	//! Returns the cache filename of a PDMS macro
+	static QString GetFilename(const QString& sourceFilename);
+
+	//! Returns the parameters of a PDMS primitive
+	/** These are the parameters of the corresponding CC primitive (radius instead of
+		diameter, etc.). Two elements with the same type and parameters are the same
+		primitive (up to their transformation).
+		\param item PDMS element
+		\param params output parameters
+		\param unsupported set to true if the primitive is not supported yet
+		\return false if the element can't be converted
+	**/
+	static bool GetPrimitiveParameters(PdmsObjects::GenericItem* item, std::vector<PointCoordinateType>& params, bool& unsupported);
+
+	//! Builds the cache of a parsed hierarchy
+	/** \param root root of the parsed hierarchy
+		\param sourceSize source file size
+		\param sourceTime source file last modification time (ms since epoch)
+		\return false if not enough memory
+	**/
+	bool build(PdmsObjects::GenericItem* root, int64_t sourceSize, int64_t sourceTime);
+
+	//! Maps a cache file
+	/** Fails if the file is not a valid cache of a source with the given size and modification time.
+	**/
+	bool load(const QString& filename, int64_t sourceSize, int64_t sourceTime);
+
+	//! Saves the cache
+	/** The file is first written under a temporary name, then renamed.
+	**/
+	bool save(const QString& filename) const;
+
+	//! Releases the cache
+	void clear();
+
+	//! Returns whether the cache is empty
+	bool isEmpty() const { return m_data == 0; }
+
+	//! Returns the header
+	const Header& header() const { return *reinterpret_cast<const Header*>(m_data); }
+	//! Returns a group
+	const Group& group(size_t index) const { return reinterpret_cast<const Group*>(m_data + header().groupsOffset)[index]; }
+	//! Returns an element
+	const Element& element(size_t index) const { return reinterpret_cast<const Element*>(m_data + header().elementsOffset)[index]; }
+	//! Returns the parameters of an element
+	const PointCoordinateType* params(const Element& element) const { return reinterpret_cast<const PointCoordinateType*>(m_data + header().paramsOffset) + element.firstParam; }
+	//! Returns a string
+	const char* string(uint32_t offset) const { return reinterpret_cast<const char*>(m_data + header().stringsOffset) + offset; }
+
+protected:
+
+	//! Checks the whole content (offsets, ranges, etc.)
+	bool isValid(size_t dataSize) const;
+
+	//! Cache content (either m_buffer or the mapped file)
+	const uchar* m_data;
+	//! Built cache
+	std::vector<uchar> m_buffer;
+	//! Mapped file
+	QFile m_file;
+
+private:
+	//forbidden
+	PdmsCache(const PdmsCache&);
+	PdmsCache& operator=(const PdmsCache&);
+};
+
+#endif //PDMS_CACHE_HEADER
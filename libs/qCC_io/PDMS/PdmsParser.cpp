@@ -23,16 +23,183 @@
 #include <cstdlib>
 #include <stdio.h>
 #include <assert.h>
+#include <algorithm>
 
 //////////// STRING HANDLING ////////////////////
 inline void upperStr(char *s) {while(*s) {if(((*s)>='a')&&((*s)<='z')) (*s)+='A'-'a'; s++;}}
 
+////////////////////////////
+// PDMS KEYWORDS
+////////////////////////////
+
+//! PDMS keyword
+struct PdmsKeyword
+{
+	//! Full keyword
+	const char* str;
+	//! Corresponding token
+	Token token;
+	//! Minimal abbreviation size (0 = full keyword only)
+	int minSize;
+};
+
+//! PDMS keywords table
+/** Every abbreviation of a keyword (down to 'minSize' characters) is recognized.
+	If two keywords share an abbreviation, the last one in this table wins.
+**/
+static const PdmsKeyword c_pdmsKeywords[] = {
+	{"NEW",           PDMS_CREATE,           3},
+	{"AND",           PDMS_AND,              3},
+	{"IS",            PDMS_IS,               2},
+	{"WRT",           PDMS_WRT,              3},
+	{"LAST",          PDMS_LAST,             4},
+	{"GROUP",         PDMS_GROUP,            2},
+	{"WORLD",         PDMS_WORLD,            4},
+	{"SITE",          PDMS_SITE,             3},
+	{"ZONE",          PDMS_ZONE,             3},
+	{"EQUIPMENT",     PDMS_EQUIPMENT,        3},
+	{"STRUCTURE",     PDMS_STRUCTURE,        3},
+	{"SUBSTRUCTURE",  PDMS_SUBSTRUCTURE,     4},
+	{"END",           PDMS_END,              3},
+	{"NAME",          PDMS_NAME,             4},
+	{"SLCYLINDER",    PDMS_SCYLINDER,        3},
+	{"CYLINDER",      PDMS_SCYLINDER,        3},
+	{"CTORUS",        PDMS_CTORUS,           4},
+	{"RTORUS",        PDMS_RTORUS,           4},
+	{"DISH",          PDMS_DISH,             3},
+	{"CONE",          PDMS_CONE,             3},
+	{"BOX",           PDMS_BOX,              3},
+	{"NBOX",          PDMS_NBOX,             4},
+	{"PYRAMID",       PDMS_PYRAMID,          4},
+	{"SNOUT",         PDMS_SNOUT,            4},
+	{"EXTRUSION",     PDMS_EXTRU,            5},
+	{"NXTRUSION",     PDMS_NEXTRU,           5},
+	{"LOOP",          PDMS_LOOP,             4},
+	{"VERTEX",        PDMS_VERTEX,           4},
+	{"EST",           PDMS_EST,              1},
+	{"NORTH",         PDMS_NORTH,            1},
+	{"UP",            PDMS_UP,               1},
+	{"WEST",          PDMS_WEST,             1},
+	{"SOUTH",         PDMS_SOUTH,            1},
+	{"DOWN",          PDMS_DOWN,             1},
+	{"X",             PDMS_X,                1},
+	{"Y",             PDMS_Y,                1},
+	{"Z",             PDMS_Z,                1},
+	{"DIAMETER",      PDMS_DIAMETER,         3},
+	{"RADIUS",        PDMS_RADIUS,           3},
+	{"HEIGHT",        PDMS_HEIGHT,           3},
+	{"XTSHEAR",       PDMS_X_TOP_SHEAR,      4},
+	{"XBSHEAR",       PDMS_X_BOTTOM_SHEAR,   4},
+	{"YTSHEAR",       PDMS_Y_TOP_SHEAR,      4},
+	{"YBSHEAR",       PDMS_Y_BOTTOM_SHEAR,   4},
+	{"XBOTTOM",       PDMS_X_BOTTOM,         4},
+	{"YBOTTOM",       PDMS_Y_BOTTOM,         4},
+	{"XTOP",          PDMS_X_TOP,            4},
+	{"YTOP",          PDMS_Y_TOP,            4},
+	{"XOFF",          PDMS_X_OFF,            4},
+	{"YOFF",          PDMS_Y_OFF,            4},
+	{"RINSIDE",       PDMS_INSIDE_RADIUS,    4},
+	{"ROUTSIDE",      PDMS_OUTSIDE_RADIUS,   4},
+	{"XLENGTH",       PDMS_XLENGTH,          4},
+	{"YLENGTH",       PDMS_YLENGTH,          4},
+	{"ZLENGTH",       PDMS_ZLENGTH,          4},
+	{"ANGLE",         PDMS_ANGLE,            4},
+	{"DTOP",          PDMS_TOP_DIAMETER,     4},
+	{"DBOTTOM",       PDMS_BOTTOM_DIAMETER,  5},
+	{"AT",            PDMS_POSITION,         2},
+	{"POSITION",      PDMS_POSITION,         3},
+	{"ORIENTED",      PDMS_ORIENTATION,      3},
+	{"METRE",         PDMS_METRE,            1},
+	{"MILLIMETRE",    PDMS_MILLIMETRE,       3},
+	{"MM",            PDMS_MILLIMETRE,       2},
+	{"OWNER",         PDMS_OWNER,            3},
+	{"RETURN",        PDMS_RETURN,           6},
+};
+
+//! Prefix tree of all the PDMS keywords abbreviations
+/** Built once from the (static) keywords table. Looking a token up doesn't
+	allocate anything and costs one array access per character.
+**/
+class PdmsKeywordTrie
+{
+public:
+
+	PdmsKeywordTrie()
+	{
+		m_nodes.resize(1);
+		for (size_t i=0; i<sizeof(c_pdmsKeywords)/sizeof(PdmsKeyword); ++i)
+			insert(c_pdmsKeywords[i]);
+	}
+
+	//! Returns the token corresponding to a (upper case) string, or PDMS_UNKNOWN
+	Token find(const char* str) const
+	{
+		unsigned index = 0;
+		for (; *str; ++str)
+		{
+			unsigned c = static_cast<unsigned char>(*str) - 'A';
+			if (c >= c_alphabetSize)
+				return PDMS_UNKNOWN;
+			index = m_nodes[index].children[c];
+			if (index == 0)
+				return PDMS_UNKNOWN;
+		}
+		return m_nodes[index].token;
+	}
+
+protected:
+
+	static const unsigned c_alphabetSize = 26;
+
+	struct Node
+	{
+		unsigned short children[c_alphabetSize];
+		Token token;
+
+		Node() : token(PDMS_UNKNOWN) { memset(children, 0, sizeof(children)); }
+	};
+
+	void insert(const PdmsKeyword& keyword)
+	{
+		int n = (int)strlen(keyword.str);
+		int minSize = keyword.minSize;
+		if (minSize == 0 || minSize > n)
+			minSize = n;
+
+		unsigned index = 0;
+		for (int i=0; i<n; ++i)
+		{
+			unsigned c = static_cast<unsigned char>(keyword.str[i]) - 'A';
+			assert(c < c_alphabetSize);
+			if (m_nodes[index].children[c] == 0)
+			{
+				m_nodes[index].children[c] = static_cast<unsigned short>(m_nodes.size());
+				m_nodes.push_back(Node());
+			}
+			index = m_nodes[index].children[c];
+			if (i+1 >= minSize)
+				m_nodes[index].token = keyword.token;
+		}
+	}
+
+	std::vector<Node> m_nodes;
+};
+
+//! Unique (read-only) keywords tree
+static const PdmsKeywordTrie s_keywords;
+
 ////////////////////////////
 // PDMS LEXER
 ////////////////////////////
 
 PdmsLexer::PdmsLexer()
+	: loadedObject(NULL)
+	, currentToken(PDMS_INVALID_TOKEN)
+	, tokenString(tokenBuffer)
+	, stop(false)
+	, metaGroupMask(0)
 {
+	tokenBuffer[0] = nextBuffer[0] = '\0';
 }
 
 bool PdmsLexer::initializeSession()
@@ -42,86 +209,17 @@ bool PdmsLexer::initializeSession()
 	stop = false;
 	memset(tokenBuffer, 0, c_max_buff_size);
 	memset(nextBuffer, 0, c_max_buff_size);
+	tokenString = tokenBuffer;
 	metaGroupMask = 0;
 
-	dictionnary.clear();
-	pushIntoDictionnary("NEW",          PDMS_CREATE,            3);
-	pushIntoDictionnary("AND",          PDMS_AND,               3);
-	pushIntoDictionnary("IS",           PDMS_IS,                2);
-	pushIntoDictionnary("WRT",          PDMS_WRT,               3);
-	pushIntoDictionnary("LAST",         PDMS_LAST,              4);
-	pushIntoDictionnary("GROUP",        PDMS_GROUP,             2);
-	pushIntoDictionnary("WORLD",        PDMS_WORLD,             4);
-	pushIntoDictionnary("SITE",         PDMS_SITE,              3);
-	pushIntoDictionnary("ZONE",         PDMS_ZONE,              3);
-	pushIntoDictionnary("EQUIPMENT",    PDMS_EQUIPMENT,         3);
-	pushIntoDictionnary("STRUCTURE",    PDMS_STRUCTURE,         3);
-	pushIntoDictionnary("SUBSTRUCTURE", PDMS_SUBSTRUCTURE,      4);
-	pushIntoDictionnary("END",          PDMS_END,               3);
-	pushIntoDictionnary("NAME",         PDMS_NAME,              4);
-	pushIntoDictionnary("SLCYLINDER",   PDMS_SCYLINDER,         3);
-	pushIntoDictionnary("CYLINDER",   	PDMS_SCYLINDER,         3);
-	pushIntoDictionnary("CTORUS",      	PDMS_CTORUS,            4);
-	pushIntoDictionnary("RTORUS",      	PDMS_RTORUS,            4);
-	pushIntoDictionnary("DISH",        	PDMS_DISH,              3);
-	pushIntoDictionnary("CONE",         PDMS_CONE,              3);
-	pushIntoDictionnary("BOX",          PDMS_BOX,               3);
-	pushIntoDictionnary("NBOX",         PDMS_NBOX,              4);
-	pushIntoDictionnary("PYRAMID",      PDMS_PYRAMID,           4);
-	pushIntoDictionnary("SNOUT",        PDMS_SNOUT,             4);
-	pushIntoDictionnary("EXTRUSION",    PDMS_EXTRU,             5);
-	pushIntoDictionnary("NXTRUSION",    PDMS_NEXTRU,            5);
-	pushIntoDictionnary("LOOP",         PDMS_LOOP,              4);
-	pushIntoDictionnary("VERTEX",       PDMS_VERTEX,            4);
-	pushIntoDictionnary("EST",          PDMS_EST,               1);
-	pushIntoDictionnary("NORTH",        PDMS_NORTH,             1);
-	pushIntoDictionnary("UP",           PDMS_UP,                1);
-	pushIntoDictionnary("WEST",         PDMS_WEST,              1);
-	pushIntoDictionnary("SOUTH",        PDMS_SOUTH,             1);
-	pushIntoDictionnary("DOWN",         PDMS_DOWN,              1);
-	pushIntoDictionnary("X",            PDMS_X,                 1);
-	pushIntoDictionnary("Y",            PDMS_Y,                 1);
-	pushIntoDictionnary("Z",            PDMS_Z,                 1);
-	pushIntoDictionnary("DIAMETER",     PDMS_DIAMETER,          3);
-	pushIntoDictionnary("RADIUS",       PDMS_RADIUS,            3);
-	pushIntoDictionnary("HEIGHT",       PDMS_HEIGHT,            3);
-	pushIntoDictionnary("XTSHEAR",      PDMS_X_TOP_SHEAR,       4);
-	pushIntoDictionnary("XBSHEAR",      PDMS_X_BOTTOM_SHEAR,    4);
-	pushIntoDictionnary("YTSHEAR",      PDMS_Y_TOP_SHEAR,       4);
-	pushIntoDictionnary("YBSHEAR",      PDMS_Y_BOTTOM_SHEAR,    4);
-	pushIntoDictionnary("XBOTTOM",      PDMS_X_BOTTOM,          4);
-	pushIntoDictionnary("YBOTTOM",      PDMS_Y_BOTTOM,          4);
-	pushIntoDictionnary("XTOP",         PDMS_X_TOP,             4);
-	pushIntoDictionnary("YTOP",         PDMS_Y_TOP,             4);
-	pushIntoDictionnary("XOFF",         PDMS_X_OFF,             4);
-	pushIntoDictionnary("YOFF",         PDMS_Y_OFF,             4);
-	pushIntoDictionnary("RINSIDE",      PDMS_INSIDE_RADIUS,     4);
-	pushIntoDictionnary("ROUTSIDE",     PDMS_OUTSIDE_RADIUS,    4);
-	pushIntoDictionnary("XLENGTH",      PDMS_XLENGTH,           4);
-	pushIntoDictionnary("YLENGTH",      PDMS_YLENGTH,           4);
-	pushIntoDictionnary("ZLENGTH",      PDMS_ZLENGTH,           4);
-	pushIntoDictionnary("ANGLE",        PDMS_ANGLE,             4);
-	pushIntoDictionnary("DTOP",         PDMS_TOP_DIAMETER,      4);
-	pushIntoDictionnary("DBOTTOM",      PDMS_BOTTOM_DIAMETER,   5);
-	pushIntoDictionnary("AT",           PDMS_POSITION,          2);
-	pushIntoDictionnary("POSITION",     PDMS_POSITION,          3);
-	pushIntoDictionnary("ORIENTED",     PDMS_ORIENTATION,       3);
-	pushIntoDictionnary("METRE",        PDMS_METRE,             1);
-	pushIntoDictionnary("MILLIMETRE",   PDMS_MILLIMETRE,        3);
-	pushIntoDictionnary("MM",           PDMS_MILLIMETRE,        2);
-	pushIntoDictionnary("OWNER",        PDMS_OWNER,             3);
-	pushIntoDictionnary("RETURN",       PDMS_RETURN,            6);
-
 	return true;
 }
 
 void PdmsLexer::closeSession(bool destroyLoadedObject)
 {
-	dictionnary.clear();
-	if (destroyLoadedObject && loadedObject)
-	{
-		PdmsObjects::Stack::Detroy(loadedObject);
-	}
+	//the loaded object memory is owned by the parser context
+	if (destroyLoadedObject)
+		loadedObject = NULL;
 }
 
 bool PdmsLexer::gotoNextToken()
@@ -186,37 +284,39 @@ bool PdmsLexer::gotoNextToken()
 void PdmsLexer::parseCurrentToken()
 {
 	currentToken = PDMS_UNKNOWN;
-	if(tokenBuffer[0] == '/')
+	if(tokenString[0] == '/')
 		currentToken = PDMS_NAME_STR;
-	else if(strncmp(tokenBuffer, "$*", 2)==0)
+	else if(strncmp(tokenString, "$*", 2)==0)
 		currentToken = PDMS_COMMENT_LINE;
-	else if(strncmp(tokenBuffer, "$(", 2)==0)
+	else if(strncmp(tokenString, "$(", 2)==0)
 		currentToken = PDMS_COMMENT_BLOCK;
-	else if(tokenBuffer[0]=='-' || ('0'<=tokenBuffer[0] && tokenBuffer[0]<='9'))
+	else if(tokenString[0]=='-' || ('0'<=tokenString[0] && tokenString[0]<='9'))
 		currentToken = PDMS_NUM_VALUE;
-	else if(strcmp(tokenBuffer, "ENDHANDLE")==0)
+	else if(strcmp(tokenString, "ENDHANDLE")==0)
 		currentToken = PDMS_UNUSED;
-	else if(strncmp(tokenBuffer, "HANDLE", 6)==0)
+	else if(strncmp(tokenString, "HANDLE", 6)==0)
 	{
 		skipHandleCommand();
 		currentToken = PDMS_UNUSED;
 	}
 	else
 	{
-		std::map<std::string, Token>::const_iterator location;
-		location = dictionnary.find(std::string(tokenBuffer));
-		if(location != dictionnary.end())
-			currentToken = location->second;
+		currentToken = KeywordToken(tokenString);
 	}
 }
 
+Token PdmsLexer::KeywordToken(const char* str)
+{
+	return s_keywords.find(str);
+}
+
 PointCoordinateType PdmsLexer::valueFromBuffer()
 {
-	size_t index = strlen(tokenBuffer);
+	size_t index = strlen(tokenString);
 	size_t length = 0;
 	while (index > 0) //go back until we meet a number symbol
 	{
-		if ((tokenBuffer[index-1]>='0' && tokenBuffer[index-1]<='9') || tokenBuffer[index-1]=='.')
+		if ((tokenString[index-1]>='0' && tokenString[index-1]<='9') || tokenString[index-1]=='.')
 			break;
 		index--;
 		length++;
@@ -225,31 +325,32 @@ PointCoordinateType PdmsLexer::valueFromBuffer()
 	//Read units
 	if (length > 0)
 	{
-		strcpy(nextBuffer, &(tokenBuffer[index]));
-		memset(&(tokenBuffer[index]), 0, length);
+		strcpy(nextBuffer, &(tokenString[index]));
+		memset(&(tokenString[index]), 0, length);
 	}
 
 	//Replace comma
-	length = strlen(tokenBuffer);
+	length = strlen(tokenString);
 	for (index=0; index<length; index++)
-		if (tokenBuffer[index]==',')
-			tokenBuffer[index]='.';
+		if (tokenString[index]==',')
+			tokenString[index]='.';
 
 	//convert value
-	PointCoordinateType value = (PointCoordinateType)atof(tokenBuffer);
+	PointCoordinateType value = (PointCoordinateType)atof(tokenString);
 
 	return value;
 }
 
 const char* PdmsLexer::nameFromBuffer() const
 {
-	return &tokenBuffer[1];
+	return &tokenString[1];
 }
 
 bool PdmsLexer::moveForward()
 {
 	if(strlen(nextBuffer))
 	{
+		tokenString = tokenBuffer;
 		strcpy(tokenBuffer, nextBuffer);
 		memset(nextBuffer, 0, c_max_str_length);
 		return true;
@@ -257,15 +358,6 @@ bool PdmsLexer::moveForward()
 	return false;
 }
 
-void PdmsLexer::pushIntoDictionnary(const char *str, Token token, int minSize)
-{
-	int n = (int)strlen(str);
-	if (minSize == 0 || minSize > n)
-		minSize= n ;
-	for (; minSize<=n; minSize++)
-		dictionnary[std::string(str).substr(0, minSize)] = token;
-}
-
 PdmsFileSession::PdmsFileSession(std::string filename)
 	: m_filename(filename)
 	, m_currentLine(-1)
@@ -468,6 +560,378 @@ void PdmsFileSession::printWarning(const char* str)
 		std::cerr << "[" << m_filename << "]@[line " << m_currentLine << "]::[" << tokenBuffer << "] : " << str << std::endl;
 }
 
+////////////////////////////
+// PDMS BUFFERED FILE SESSION
+////////////////////////////
+
+inline bool isBlank(char c) {return (c==' ' || c=='\t' || c=='\r' || c=='\n');}
+
+//! Moves the file cursor (large files friendly)
+static bool SeekFile(FILE* file, size_t offset)
+{
+#ifdef _MSC_VER
+	return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+	return fseek(file, static_cast<long>(offset), SEEK_SET) == 0;
+#endif
+}
+
+PdmsBufferedFileSession::PdmsBufferedFileSession(std::string filename, size_t blockSize)
+	: m_filename(filename)
+	, m_currentLine(-1)
+	, m_eol(false)
+	, m_eof(false)
+	, m_file(0)
+	, m_blockSize(std::max<size_t>(blockSize, 2*c_max_buff_size)) //a whole token must always fit in a block
+	, m_pos(0)
+	, m_end(0)
+	, m_fileEnd(false)
+	, m_bufferOffset(0)
+	, m_nextChunk(0)
+	, m_chunkToken(false)
+{
+	//whole file by default
+	m_range.begin = 0;
+	m_range.end = static_cast<size_t>(-1);
+	m_range.firstLine = m_range.lastLine = 1;
+}
+
+bool PdmsBufferedFileSession::initializeSession()
+{
+	PdmsLexer::initializeSession();
+	//binary mode: we handle '\r' ourselves (and it's much faster)
+	m_file = fopen(m_filename.c_str(), "rb");
+	if (!m_file)
+		return false;
+	if (m_range.begin != 0 && !SeekFile(m_file, m_range.begin))
+	{
+		fclose(m_file);
+		m_file = NULL;
+		return false;
+	}
+
+	//no need for a big buffer if we only read a small part of the file
+	size_t bufferSize = m_blockSize;
+	if (m_range.end != static_cast<size_t>(-1))
+		bufferSize = std::min(bufferSize, std::max<size_t>(m_range.end - m_range.begin, 2*c_max_buff_size));
+
+	try
+	{
+		//one more byte to be able to terminate the last token in place
+		m_buffer.resize(bufferSize+1);
+	}
+	catch(std::bad_alloc)
+	{
+		fclose(m_file);
+		m_file = NULL;
+		return false;
+	}
+
+	m_pos = m_end = 0;
+	m_fileEnd = false;
+	m_bufferOffset = m_range.begin;
+	m_nextChunk = 0;
+	m_chunkToken = false;
+	m_currentLine = m_range.firstLine;
+	m_eol = false;
+	m_eof = false;
+
+	return true;
+}
+
+void PdmsBufferedFileSession::closeSession(bool destroyLoadedObject)
+{
+	if (m_file)
+	{
+		fclose(m_file);
+		m_file = NULL;
+	}
+	std::vector<char>().swap(m_buffer);
+	tokenString = tokenBuffer;
+	tokenBuffer[0] = '\0';
+
+	PdmsLexer::closeSession(destroyLoadedObject);
+}
+
+size_t PdmsBufferedFileSession::fillBuffer(size_t keepFrom)
+{
+	assert(keepFrom <= m_end);
+	size_t kept = m_end - keepFrom;
+	if (kept && keepFrom)
+		memmove(&(m_buffer[0]), &(m_buffer[keepFrom]), kept);
+	m_pos -= std::min(m_pos, keepFrom);
+	m_end = kept;
+	m_bufferOffset += keepFrom;
+
+	if (!m_fileEnd && m_file)
+	{
+		size_t toRead = (m_buffer.size()-1) - kept;
+		//don't read past the end of the range
+		size_t readPos = m_bufferOffset + kept;
+		if (m_range.end != static_cast<size_t>(-1))
+			toRead = std::min(toRead, m_range.end > readPos ? m_range.end - readPos : 0);
+		size_t read = toRead ? fread(&(m_buffer[kept]), 1, toRead, m_file) : 0;
+		if (read < toRead)
+			m_fileEnd = true;
+		m_end += read;
+	}
+
+	return kept;
+}
+
+int PdmsBufferedFileSession::nextChar()
+{
+	if (m_pos == m_end)
+	{
+		if (m_fileEnd)
+			return EOF;
+		fillBuffer(m_end);
+		if (m_pos == m_end)
+			return EOF;
+	}
+	return static_cast<unsigned char>(m_buffer[m_pos++]);
+}
+
+bool PdmsBufferedFileSession::getTokenRange(size_t& begin, size_t& end) const
+{
+	if (m_buffer.empty() || tokenString < &(m_buffer[0]) || tokenString >= &(m_buffer[0]) + m_end)
+		return false;
+
+	begin = m_bufferOffset + static_cast<size_t>(tokenString - &(m_buffer[0]));
+	end = begin + strlen(tokenString);
+	return true;
+}
+
+void PdmsBufferedFileSession::parseCurrentToken()
+{
+	if (m_chunkToken)
+	{
+		m_chunkToken = false;
+		currentToken = PDMS_CHUNK;
+	}
+	else if(m_eof && tokenString[0] == '\0')
+		currentToken = PDMS_EOS;
+	else
+		PdmsLexer::parseCurrentToken();
+}
+
+bool PdmsBufferedFileSession::moveForward()
+{
+	if(PdmsLexer::moveForward()) return true;
+
+	m_eol = false;
+
+	//skip blanks
+	while (true)
+	{
+		if (m_pos == m_end)
+		{
+			if (!m_fileEnd)
+				fillBuffer(m_end);
+			if (m_pos == m_end)
+			{
+				m_eof = true;
+				tokenBuffer[0] = '\0';
+				tokenString = tokenBuffer;
+				return false;
+			}
+		}
+		char c = m_buffer[m_pos];
+		if (c == '\n')
+			m_currentLine++;
+		else if (!isBlank(c))
+			break;
+		m_pos++;
+	}
+
+	//chunks are parsed apart: we jump over them
+	if (m_nextChunk < m_chunks.size() && m_bufferOffset + m_pos == m_chunks[m_nextChunk].begin)
+	{
+		const PdmsFileRange& chunk = m_chunks[m_nextChunk++];
+		if (chunk.end <= m_bufferOffset + m_end)
+		{
+			m_pos = chunk.end - m_bufferOffset;
+		}
+		else
+		{
+			if (!SeekFile(m_file, chunk.end))
+			{
+				printWarning("Failed to skip chunk");
+				return false;
+			}
+			m_bufferOffset = chunk.end;
+			m_pos = m_end = 0;
+			m_fileEnd = false;
+		}
+		m_currentLine = chunk.lastLine;
+		m_chunkToken = true;
+		strcpy(tokenBuffer, "(CHUNK)");
+		tokenString = tokenBuffer;
+		return true;
+	}
+
+	//read token (in place)
+	size_t start = m_pos;
+	while (true)
+	{
+		if (m_pos == m_end)
+		{
+			if (!m_fileEnd)
+			{
+				//the token is truncated: we keep it and read the next block
+				fillBuffer(start);
+				start = 0;
+			}
+			if (m_pos == m_end)
+			{
+				m_eof = true;
+				break;
+			}
+		}
+		char c = m_buffer[m_pos];
+		if (isBlank(c))
+		{
+			if (c == '\n')
+			{
+				m_eol = true;
+				m_currentLine++;
+			}
+			break;
+		}
+		if (m_pos-start >= static_cast<size_t>(c_max_buff_size))
+		{
+			printWarning("Buffer overflow");
+			return false;
+		}
+		m_pos++;
+	}
+
+	//terminate token by overwriting the delimiter (there's always one more byte at the end of the buffer)
+	m_buffer[m_pos] = '\0';
+	tokenString = &(m_buffer[start]);
+	if (m_pos != m_end)
+		m_pos++;
+
+	if(tokenString[0] != '/')
+		upperStr(tokenString);
+	return true;
+}
+
+void PdmsBufferedFileSession::skipComment()
+{
+	int car, commentBlockLevel;
+	bool commentSymb;
+	char *ptr1, *ptr2;
+	int n;
+
+	switch(currentToken)
+	{
+	case PDMS_COMMENT_LINE:
+		//skip line only if the end of line has not been read in current buffer
+		if(!m_eol)
+		{
+			n = 0;
+			do{
+				car = nextChar();
+				if(car=='\t' || car=='\r') car=' ';
+				tokenBuffer[n] = car;
+				if(((n+1)<c_max_buff_size) && ((car!=' ') || (n>0 && tokenBuffer[n-1]!=' '))) n++;
+			} while(car!=EOF && (char)car!='\n');
+			if(car == '\n')
+				m_currentLine++;
+			tokenBuffer[n>0 ? n-1 : 0] = '\0';
+			tokenString = tokenBuffer;
+		}
+		m_eol = false;
+		break;
+	case PDMS_COMMENT_BLOCK:
+		//comment block opening symbol has been met. Search for comment block ending symbol
+		//don't forget that some other comments could be embeded in this comment
+		commentSymb = false;
+		commentBlockLevel = 1;
+		n = 0;
+		do{
+			car = nextChar();
+			if(car=='\n') m_currentLine++;
+			if(car=='\n' || car=='\t' || car=='\r') car = ' ';
+			if(car=='$') commentSymb = true;
+			else if(car=='(' && commentSymb) commentBlockLevel++;
+			else if(car==')' && commentSymb) commentBlockLevel--;
+			else
+			{
+				commentSymb = false;
+				tokenBuffer[n] = car;
+				if(((n+1)<c_max_buff_size) && ((car!=' ') || (n>0 && tokenBuffer[n-1]!=' '))) n++;
+			}
+		} while(car!=EOF && commentBlockLevel>0);
+		tokenBuffer[n>0 ? n-1 : 0] = '\0';
+		tokenString = tokenBuffer;
+		m_eol = false;
+		break;
+	default:
+		break;
+	}
+
+	upperStr(tokenString);
+	if(strncmp(tokenString, "ENTERING IN GROUP:", 18)==0)
+	{
+		currentToken = PDMS_ENTER_METAGROUP;
+		//The meta group name starts after the "entering in group:" statement, after the last slash
+		//But we still store the whole path
+		ptr2 = &(tokenString[18]);
+		while((*ptr2)==' ') {ptr2++;}
+		//Copy the meta group name at the begining of the token
+		tokenString[0] = '/';
+		ptr1 = &(tokenString[1]);
+		while((*ptr2) && (*ptr2)!=' ')
+		{
+			*ptr1 = *ptr2;
+			ptr1++;
+			ptr2++;
+		}
+		*ptr1 = '\0';
+		metaGroupMask = 0;
+	}
+	else if(strncmp(tokenString, "LEAVING GROUP", 13)==0)
+	{
+		currentToken = PDMS_LEAVE_METAGROUP;
+		metaGroupMask = 0;
+	}
+}
+
+void PdmsBufferedFileSession::skipHandleCommand()
+{
+	int opened=0, state=0, car;
+
+	//Search for "HANDLE(...)" in the current token first
+	for(const char* c=tokenString; *c; ++c)
+	{
+		if((*c)=='(') {opened++; state++;}
+		else if((*c)==')') state--;
+		if(opened>0 && state==0)
+			return;
+	}
+	//"HANDLE(...) does not lie in the current token, then search it in the file
+	while(!(opened>0 && state==0))
+	{
+		car = nextChar();
+		if(car==EOF) break;
+		if(car=='\n') m_currentLine++;
+		else if(car=='(') {opened++; state++;}
+		else if(car==')') state--;
+	}
+	tokenBuffer[0] = '\0';
+	tokenString = tokenBuffer;
+}
+
+void PdmsBufferedFileSession::printWarning(const char* str)
+{
+	if(currentToken == PDMS_EOS)
+		std::cerr << "[" << m_filename << "]@postprocessing : " << str << std::endl;
+	else
+		std::cerr << "[" << m_filename << "]@[line " << m_currentLine << "]::[" << tokenString << "] : " << str << std::endl;
+}
+
 ///////////////////////////
 // PDMS PARSER
 ///////////////////////////
@@ -486,14 +950,9 @@ PdmsParser::~PdmsParser()
 		delete currentCommand;
 		currentCommand = 0;
 	}
-	
-	if (currentItem)
-	{
-		currentItem = currentItem->getRoot();
-		PdmsObjects::Stack::Detroy(currentItem);
-	}
 
-	PdmsObjects::Stack::Clear();
+	//releases all the parsed items
+	context.clear();
 }
 
 void PdmsParser::linkWithSession(PdmsLexer *s)
@@ -502,7 +961,7 @@ void PdmsParser::linkWithSession(PdmsLexer *s)
 	currentCommand = NULL;
 	currentItem = NULL;
 	root = NULL;
-	PdmsCommands::DistanceValue::setWorkingUnit(PDMS_MILLIMETRE);
+	context.workingUnit = PDMS_MILLIMETRE;
 }
 
 bool PdmsParser::processCurrentToken()
@@ -544,6 +1003,20 @@ bool PdmsParser::processCurrentToken()
 		}
 		break;
 	
+	case PDMS_CHUNK:
+		//A chunk always starts with a new element (PDMS_CREATE)
+		if (currentCommand)
+		{
+			if (currentCommand->handle(PDMS_CREATE))
+			{
+				session->printWarning("Unexpected chunk");
+				return false;
+			}
+			if (!executeCurrentCommand())
+				return false;
+		}
+		return processChunk();
+
 	default:
 		//If there is an active command
 		if (currentCommand)
@@ -553,38 +1026,14 @@ bool PdmsParser::processCurrentToken()
 				return true;
 			
 			//Else, the token must be a new command. We execute the active command and delete it
-			PdmsObjects::GenericItem* item = currentItem;
-			bool success = currentCommand->execute(item);
-			delete currentCommand;
-			currentCommand = NULL;
-			if (!success)
-			{
-				assert(false);
-				session->printWarning("Unable to resolve previous command (this token may be unexpected in current command)");
+			if (!executeCurrentCommand())
 				return false;
-			}
-			//The command execution could have changed the current item
-			if (item)
-			{
-				currentItem = item;
-			}
-			else if (currentItem)
-			{
-				if (!root)
-				{
-					root = currentItem->getRoot();
-					currentItem = NULL;
-				}
-				else
-				{
-					assert(false);
-					session->printWarning("Trying to create a second root for elements hierarchy");
-					return false;
-				}
-			}
 		}
 		if (currentToken == PDMS_RETURN)
 		{
+			//a chunk can't stop the whole parsing
+			if (context.isChunk())
+				return false;
 			session->finish();
 		}
 		else
@@ -603,9 +1052,57 @@ bool PdmsParser::processCurrentToken()
 	return true;
 }
 
+bool PdmsParser::executeCurrentCommand()
+{
+	assert(currentCommand);
+
+	PdmsObjects::GenericItem* item = currentItem;
+	bool success = currentCommand->execute(item, context);
+	delete currentCommand;
+	currentCommand = NULL;
+	if (!success)
+	{
+		//chunks may fail (they are parsed sequentially afterwards, see PdmsChunkedParser)
+		assert(context.isChunk());
+		session->printWarning("Unable to resolve previous command (this token may be unexpected in current command)");
+		return false;
+	}
+	//The command execution could have changed the current item
+	if (item)
+	{
+		currentItem = item;
+	}
+	else if (currentItem)
+	{
+		//a chunk can't go back to its ancestors
+		if (context.isChunk())
+			return false;
+
+		if (!root)
+		{
+			root = currentItem->getRoot();
+			currentItem = NULL;
+		}
+		else
+		{
+			assert(false);
+			session->printWarning("Trying to create a second root for elements hierarchy");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool PdmsParser::processChunk()
+{
+	session->printWarning("Unexpected chunk");
+	return false;
+}
+
 bool PdmsParser::parseSessionContent()
 {
-	PdmsObjects::Stack::Init();
+	context.clear();
 
 	if (!session  || !session->initializeSession())
 	{
@@ -620,6 +1117,14 @@ bool PdmsParser::parseSessionContent()
 			return false;
 		}
 	}
+
+	//A chunk is stitched to the whole hierarchy afterwards (see PdmsChunkedParser)
+	if (context.isChunk())
+	{
+		session->closeSession(false);
+		return (currentItem != NULL);
+	}
+
 	//If the hierarchy root has not yet been computed, do it now.
 	if (!root)
 		root = currentItem->getRoot();
@@ -644,3 +1149,275 @@ PdmsObjects::GenericItem* PdmsParser::getLoadedObject(bool forgetIt)
 	}
 	return result;
 }
+
+///////////////////////////
+// PDMS CHUNKED PARSER
+///////////////////////////
+
+//! Pre-scans a PDMS file to find its top-level blocks (NEW SITE/ZONE ... END)
+/** Relies on the lexer itself so that the blocks boundaries match the tokens
+	of a sequential parse.
+**/
+class PdmsChunkScanner : public PdmsBufferedFileSession
+{
+public:
+	PdmsChunkScanner(std::string filename) : PdmsBufferedFileSession(filename) {}
+
+	bool scan(std::vector<PdmsFileRange>& chunks, size_t minChunkSize)
+	{
+		if (!initializeSession())
+			return false;
+
+		int depth = 0;
+		bool inChunk = false;
+		int chunkDepth = 0;
+		PdmsFileRange chunk;
+		bool afterCreate = false;
+
+		while (gotoNextToken())
+		{
+			//meta group tokens are generated by the lexer (they don't lie in the file)
+			size_t begin = 0, end = 0;
+			bool inFile = (metaGroupMask == 0 && getTokenRange(begin, end));
+			unsigned line = m_currentLine - (m_eol ? 1 : 0);
+
+			switch (currentToken)
+			{
+			case PDMS_CREATE:
+				++depth;
+				if (!inChunk && inFile)
+				{
+					chunk.begin = begin;
+					chunk.firstLine = line;
+					afterCreate = true;
+					continue;
+				}
+				break;
+			case PDMS_SITE:
+			case PDMS_ZONE:
+				if (afterCreate)
+				{
+					inChunk = true;
+					chunkDepth = depth-1;
+				}
+				break;
+			case PDMS_END:
+				--depth;
+				if (inChunk && depth <= chunkDepth)
+				{
+					inChunk = false;
+					if (inFile && depth == chunkDepth)
+					{
+						chunk.end = end;
+						chunk.lastLine = line;
+						if (chunk.end - chunk.begin >= minChunkSize)
+						{
+							try
+							{
+								chunks.push_back(chunk);
+							}
+							catch(std::bad_alloc)
+							{
+								closeSession();
+								return false;
+							}
+						}
+					}
+				}
+				break;
+			case PDMS_RETURN:
+				finish();
+				break;
+			default:
+				break;
+			}
+			afterCreate = false;
+		}
+
+		closeSession();
+		return true;
+	}
+
+	//reimplemented from PdmsBufferedFileSession
+	virtual void printWarning(const char* str) {}
+};
+
+//! Chunk session
+/** Chunks parsing failures are not errors (the file is then parsed sequentially)
+**/
+class PdmsChunkSession : public PdmsBufferedFileSession
+{
+public:
+	PdmsChunkSession(std::string filename) : PdmsBufferedFileSession(filename) {}
+
+	//reimplemented from PdmsBufferedFileSession
+	virtual void printWarning(const char* str) {}
+};
+
+PdmsChunkedParser::PdmsChunkedParser(std::string filename)
+	: PdmsParser()
+	, m_filename(filename)
+	, m_session(filename)
+	, m_nextChunk(0)
+{
+}
+
+PdmsChunkedParser::~PdmsChunkedParser()
+{
+	clearChunks();
+}
+
+void PdmsChunkedParser::clearChunks()
+{
+	for (size_t i=0; i<m_chunks.size(); ++i)
+	{
+		delete m_chunks[i].parser;
+		delete m_chunks[i].session;
+	}
+	m_chunks.clear();
+	m_nextChunk = 0;
+}
+
+size_t PdmsChunkedParser::prepare(size_t minChunkSize)
+{
+	clearChunks();
+
+	std::vector<PdmsFileRange> ranges;
+	PdmsChunkScanner scanner(m_filename);
+	if (!scanner.scan(ranges, minChunkSize))
+		return 0;
+
+	try
+	{
+		m_chunks.resize(ranges.size());
+	}
+	catch(std::bad_alloc)
+	{
+		return 0;
+	}
+
+	for (size_t i=0; i<ranges.size(); ++i)
+	{
+		m_chunks[i].range = ranges[i];
+		m_chunks[i].session = NULL;
+		m_chunks[i].parser = NULL;
+		m_chunks[i].parsed = false;
+	}
+
+	return m_chunks.size();
+}
+
+bool PdmsChunkedParser::parseChunk(size_t index)
+{
+	if (index >= m_chunks.size())
+		return false;
+
+	Chunk& chunk = m_chunks[index];
+	if (chunk.parsed)
+		return true;
+	if (chunk.parser) //already failed
+		return false;
+
+	try
+	{
+		chunk.session = new PdmsChunkSession(m_filename);
+		chunk.parser = new PdmsParser();
+	}
+	catch(std::bad_alloc)
+	{
+		delete chunk.session;
+		chunk.session = NULL;
+		return false;
+	}
+
+	chunk.session->setRange(chunk.range);
+	chunk.parser->context.setChunkMode(true);
+	chunk.parser->linkWithSession(chunk.session);
+	chunk.parsed = chunk.parser->parseSessionContent();
+
+	return chunk.parsed;
+}
+
+bool PdmsChunkedParser::processChunk()
+{
+	if (m_nextChunk >= m_chunks.size())
+		return false;
+
+	Chunk& chunk = m_chunks[m_nextChunk++];
+	if (!chunk.parsed)
+		return false;
+
+	PdmsParser* parser = chunk.parser;
+
+	//the chunk root must be its first element
+	PdmsObjects::GenericItem* chunkRoot = parser->currentItem->getRoot();
+	const std::vector<PdmsObjects::GenericItem*>& elements = parser->context.getElementsStack();
+	if (elements.empty() || elements.front() != chunkRoot)
+		return false;
+
+	if (!context.stitch(parser->context, chunkRoot, currentItem))
+		return false;
+
+	//we continue from where the chunk parser stopped
+	currentItem = parser->currentItem;
+	assert(!currentCommand);
+	currentCommand = parser->currentCommand;
+	parser->currentCommand = NULL;
+	parser->currentItem = NULL;
+
+	delete chunk.parser;
+	chunk.parser = NULL;
+	delete chunk.session;
+	chunk.session = NULL;
+
+	return true;
+}
+
+bool PdmsChunkedParser::parseFileContent()
+{
+	//the chunks that can't be parsed apart (e.g. their first element is closed
+	//before their end) are simply left to the sequential parse
+	{
+		std::vector<Chunk> validChunks;
+		for (size_t i=0; i<m_chunks.size(); ++i)
+		{
+			if (parseChunk(i))
+			{
+				validChunks.push_back(m_chunks[i]);
+			}
+			else
+			{
+				delete m_chunks[i].parser;
+				delete m_chunks[i].session;
+			}
+		}
+		m_chunks.swap(validChunks);
+	}
+
+	if (!m_chunks.empty())
+	{
+		std::vector<PdmsFileRange> ranges;
+		ranges.reserve(m_chunks.size());
+		for (size_t i=0; i<m_chunks.size(); ++i)
+			ranges.push_back(m_chunks[i].range);
+
+		m_session.setChunks(ranges);
+		m_nextChunk = 0;
+		linkWithSession(&m_session);
+		bool success = (parseSessionContent() && m_nextChunk == m_chunks.size());
+		clearChunks();
+		m_session.setChunks(std::vector<PdmsFileRange>());
+		if (success)
+			return true;
+
+		//the result could differ from the sequential one: we parse the whole file sequentially
+		if (currentCommand)
+		{
+			delete currentCommand;
+			currentCommand = NULL;
+		}
+	}
+
+	linkWithSession(&m_session);
+	return parseSessionContent();
+}
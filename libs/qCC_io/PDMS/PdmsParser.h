@@ -22,7 +22,8 @@
 
 //system
 #include <string>
-#include <map>
+#include <vector>
+#include <stdio.h>
 
 using namespace PdmsTools;
 
@@ -48,8 +49,14 @@ public:
 
 	Token getCurrentToken() const {return currentToken;}
 	PdmsObjects::GenericItem* getLoadedObject() const {return loadedObject;}
-	const char* getBufferContent() const {return tokenBuffer;}
+	const char* getBufferContent() const {return tokenString;}
 	void setLoadedObject(PdmsObjects::GenericItem *o) {loadedObject = o;}
+
+	//! Returns the token corresponding to a keyword (or to one of its abbreviations)
+	/** \param str upper case string
+		\return PDMS_UNKNOWN if the string is not a keyword
+	**/
+	static Token KeywordToken(const char* str);
 	
 protected:
 
@@ -58,11 +65,14 @@ protected:
 	PdmsObjects::GenericItem *loadedObject;
 	Token currentToken;
 	char tokenBuffer[c_max_buff_size], nextBuffer[c_max_buff_size];
-	std::map<std::string, Token> dictionnary;
+	//! Current token (null-terminated)
+	/** Points to tokenBuffer by default, but sessions may make it point
+		directly to their own input buffer (to avoid useless copies).
+	**/
+	char* tokenString;
 	bool stop;
 	char metaGroupMask;
 
-	void pushIntoDictionnary(const char *str, Token token, int minSize=0);
 	virtual void parseCurrentToken();
 	virtual void skipComment() = 0;
 	virtual void skipHandleCommand() = 0;
@@ -91,6 +101,90 @@ protected:
 	virtual void skipHandleCommand();
 };
 
+//! Part of a PDMS file
+struct PdmsFileRange
+{
+	//! First byte (offset)
+	size_t begin;
+	//! Last byte (offset) + 1
+	size_t end;
+	//! Line of the first token
+	unsigned firstLine;
+	//! Line of the last token
+	unsigned lastLine;
+};
+
+//! Buffered PDMS file session
+/** Reads the file by large blocks and tokenizes it in place: the current
+	token is a view on the block buffer instead of a copy (only comments
+	and truncated units still go through tokenBuffer).
+**/
+class PdmsBufferedFileSession : public PdmsLexer
+{
+public:
+	//! Default block size (in bytes)
+	static const size_t c_default_block_size = (1 << 22);
+
+	PdmsBufferedFileSession(std::string filename, size_t blockSize = c_default_block_size);
+	virtual ~PdmsBufferedFileSession() {closeSession();}
+	virtual bool initializeSession();
+	virtual void closeSession(bool destroyLoadedObject=false);
+	virtual void printWarning(const char* str);
+
+	//! Restricts the session to a part of the file
+	/** Must be called before initializeSession. The range must start and end at token boundaries.
+	**/
+	void setRange(const PdmsFileRange& range) {m_range = range;}
+
+	//! Sets the parts of the file that are parsed apart (chunks)
+	/** Each of them is replaced by a single PDMS_CHUNK token. Must be called before
+		initializeSession. Ranges must be sorted and start and end at token boundaries.
+	**/
+	void setChunks(const std::vector<PdmsFileRange>& chunks) {m_chunks = chunks;}
+
+protected:
+	virtual void parseCurrentToken();
+	virtual bool moveForward();
+	virtual void skipComment();
+	virtual void skipHandleCommand();
+
+	//! Reads the next block (keeping the bytes after 'keepFrom' at the begining of the buffer)
+	/** \return the number of bytes actually moved at the begining of the buffer
+	**/
+	size_t fillBuffer(size_t keepFrom);
+	//! Returns the next character (or EOF)
+	int nextChar();
+	//! Returns the current token position in the file (only if the token lies in the buffer)
+	bool getTokenRange(size_t& begin, size_t& end) const;
+
+	std::string m_filename;
+	unsigned m_currentLine;
+	bool m_eol, m_eof;
+	FILE* m_file;
+
+	//! Block buffer
+	std::vector<char> m_buffer;
+	//! Block size
+	size_t m_blockSize;
+	//! Current read position in buffer
+	size_t m_pos;
+	//! Number of valid bytes in buffer
+	size_t m_end;
+	//! Whether the end of file has been reached while filling the buffer
+	bool m_fileEnd;
+	//! Offset of the buffer first byte in the file
+	size_t m_bufferOffset;
+
+	//! Part of the file to read
+	PdmsFileRange m_range;
+	//! Parts of the file parsed apart
+	std::vector<PdmsFileRange> m_chunks;
+	//! Next chunk
+	size_t m_nextChunk;
+	//! Whether the current token is a chunk
+	bool m_chunkToken;
+};
+
 //PDMS Parser
 /** Use this parser the following way:
 	1- create any Pdms session
@@ -104,7 +198,7 @@ class PdmsParser
 public:
 	//! Default constructor
 	PdmsParser();
-	~PdmsParser();
+	virtual ~PdmsParser();
 
 	void reset();
 	void linkWithSession(PdmsLexer *s);
@@ -114,10 +208,78 @@ public:
 protected:
 
 	bool processCurrentToken();
+	//! Executes (and releases) the current command
+	bool executeCurrentCommand();
+	//! Handles a PDMS_CHUNK token (see PdmsChunkedParser)
+	virtual bool processChunk();
 
 	PdmsLexer *session;
 	PdmsCommands::Command *currentCommand;
 	PdmsObjects::GenericItem *currentItem, *root;
+
+	//! Parsing context (owns all the parsed items)
+	/** Each parser has its own context: several parsers can safely run
+		in parallel (in different threads).
+	**/
+	PdmsTools::ParsingContext context;
+
+	friend class PdmsChunkedParser;
+};
+
+//! Chunked PDMS file parser
+/** Splits a (big) file at its top-level hierarchy blocks (NEW SITE/ZONE ... END)
+	so that they can be parsed concurrently:
+	1- prepare pre-scans the file to find the blocks (chunks)
+	2- parseChunk parses a chunk (can be called from several threads at once)
+	3- parseFileContent parses the rest of the file and stitches the chunks to the
+	hierarchy, in file order (see ParsingContext::stitch).
+	The result is the same as the one of PdmsParser::parseSessionContent. If this
+	can't be guaranteed (e.g. a chunk refers to an unknown item or changes its
+	ancestors) parseFileContent simply parses the whole file sequentially.
+**/
+class PdmsChunkedParser : public PdmsParser
+{
+public:
+	//! Default minimal chunk size (in bytes)
+	static const size_t c_default_min_chunk_size = (1 << 20);
+
+	PdmsChunkedParser(std::string filename);
+	virtual ~PdmsChunkedParser();
+
+	//! Finds the chunks
+	/** Smaller blocks are left to the sequential parse.
+		\return the number of chunks
+	**/
+	size_t prepare(size_t minChunkSize = c_default_min_chunk_size);
+	//! Returns the number of chunks
+	size_t getChunkCount() const {return m_chunks.size();}
+	//! Parses a chunk
+	bool parseChunk(size_t index);
+	//! Parses the file (with the already parsed chunks)
+	bool parseFileContent();
+
+protected:
+
+	//reimplemented from PdmsParser
+	virtual bool processChunk();
+
+	//! Releases the chunks
+	void clearChunks();
+
+	//! Chunk
+	struct Chunk
+	{
+		PdmsFileRange range;
+		PdmsBufferedFileSession* session;
+		PdmsParser* parser;
+		bool parsed;
+	};
+
+	std::string m_filename;
+	PdmsBufferedFileSession m_session;
+	std::vector<Chunk> m_chunks;
+	//! Next chunk to stitch
+	size_t m_nextChunk;
 };
 
 #endif //PDMS_PARSER_HEADER
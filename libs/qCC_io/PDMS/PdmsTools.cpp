@@ -22,7 +22,7 @@
 #include <iostream>
 #include <stdlib.h>
 #include <assert.h>
-#include <set>
+#include <algorithm>
 
 //qCC_db
 //#include <ccLog.h>
@@ -39,52 +39,403 @@ using namespace PdmsObjects;
 /////////// FUNCTIONS ////////////
 #define PDMS_SQR(a) (a*a)
 
-/////////// GLOBALS ////////////
-Token DistanceValue::workingUnit = PDMS_MILLIMETRE;
-static GroupElement defaultWorld(PDMS_WORLD);
+static size_t NameHash(const char* str)
+{
+	//FNV-1a
+	size_t h = 2166136261U;
+	for (; *str; ++str)
+		h = (h ^ static_cast<unsigned char>(*str)) * 16777619U;
+	return h;
+}
 
 ///////////////////////////////
-// ITEM STACK
+// PARSING CONTEXT
 ///////////////////////////////
-typedef std::set<PdmsObjects::GenericItem*> ElementsStack;
-ElementsStack s_elementsStack;
 
-void PdmsObjects::Stack::Init()
+//! Arena block size (in bytes)
+static const size_t c_arenaBlockSize = (1 << 20);
+//! First arena block size (in bytes)
+/** Blocks grow up to c_arenaBlockSize (small chunks only need small arenas)
+**/
+static const size_t c_arenaFirstBlockSize = (1 << 12);
+
+typedef std::vector<PdmsObjects::GenericItem*> ElementsStack;
+typedef std::vector<const char*> StringBucket;
+
+ParsingContext::ParsingContext()
+	: workingUnit(PDMS_MILLIMETRE)
+	, m_arenaBlockPos(0)
+	, m_arenaBlockEnd(0)
+	, m_stringPoolCount(0)
+	, m_defaultWorld(NULL)
+	, m_chunkMode(false)
+{
+}
+
+void ParsingContext::clear()
 {
-	assert(s_elementsStack.empty());
-	s_elementsStack.clear();
+	names.clear();
+	m_elementsStack.clear();
+	m_stringPool.clear();
+	m_stringPoolCount = 0;
+	m_defaultWorld = NULL;
+	m_lookups.clear();
+	m_deferredReferences.clear();
+
+	//items don't own anything in the arena: we can destroy them in any order
+	for (size_t i=0; i<m_arenaItems.size(); ++i)
+		m_arenaItems[i]->~GenericItem();
+	ElementsStack().swap(m_arenaItems);
+
+	for (size_t i=0; i<m_arenaBlocks.size(); ++i)
+		delete[] m_arenaBlocks[i];
+	m_arenaBlocks.clear();
+	m_arenaBlockPos = m_arenaBlockEnd = 0;
 }
 
-void PdmsObjects::Stack::Clear()
+void ParsingContext::destroy(GenericItem* &item)
 {
-	//DGM: warning, while deleting some entities, the stack may be modified!!!
-	while (!s_elementsStack.empty())
+	if (item)
 	{
-		GenericItem* item = *(s_elementsStack.begin());
-		s_elementsStack.erase(item);
-		if (item)
+		names.remove(item);
+		//the item is most probably one of the last ones
+		for (ElementsStack::reverse_iterator it = m_elementsStack.rbegin(); it != m_elementsStack.rend(); ++it)
 		{
-			//ccLog::Print(QString("[PDMS] Should be deleting %1").arg(item->name));
-			delete item;
+			if (*it == item)
+			{
+				m_elementsStack.erase(--(it.base()));
+				break;
+			}
 		}
+		item = 0;
 	}
-	s_elementsStack.clear();
 }
 
-void PdmsObjects::Stack::Detroy(GenericItem* &item)
+bool ParsingContext::push(GenericItem* item)
 {
-	if (item)
+	try
+	{
+		m_elementsStack.push_back(item);
+	}
+	catch(std::exception &pex)
+	{
+		memalert(pex,m_elementsStack.size());
+		return false;
+	}
+	return true;
+}
+
+GroupElement* ParsingContext::getDefaultWorld()
+{
+	//the default world of a chunk wouldn't be the one of the main hierarchy
+	if (m_chunkMode)
+		return NULL;
+	if (!m_defaultWorld)
+		m_defaultWorld = create<GroupElement>(PDMS_WORLD);
+	return m_defaultWorld;
+}
+
+void* ParsingContext::allocate(size_t size, size_t alignment)
+{
+	size_t pos = (m_arenaBlockPos + alignment-1) & ~(alignment-1);
+	if (m_arenaBlocks.empty() || pos + size > m_arenaBlockEnd)
 	{
-		//ccLog::Print(QString("[PDMS] Destroying %1").arg((item)->name));
-		if (s_elementsStack.find(item) != s_elementsStack.end())
+		size_t blockSize = std::min(c_arenaBlockSize, std::max(c_arenaFirstBlockSize, 2*m_arenaBlockEnd));
+		blockSize = std::max(blockSize, size);
+		try
 		{
-			s_elementsStack.erase(item);
-			delete item;
+			m_arenaBlocks.reserve(m_arenaBlocks.size()+1);
+			m_arenaBlocks.push_back(new char[blockSize]);
 		}
-		item = 0;
+		catch(std::exception &nex)
+		{
+			memalert(nex,blockSize);
+			return NULL;
+		}
+		pos = 0;
+		m_arenaBlockEnd = blockSize;
+	}
+
+	m_arenaBlockPos = pos + size;
+	return m_arenaBlocks.back() + pos;
+}
+
+void ParsingContext::track(GenericItem* item)
+{
+	try
+	{
+		m_arenaItems.push_back(item);
+	}
+	catch(std::exception &pex)
+	{
+		memfail(pex,m_arenaItems.size());
 	}
 }
 
+const char* ParsingContext::intern(const char* str)
+{
+	if (!str || str[0] == '\0')
+		return "";
+
+	size_t h = NameHash(str);
+	if (!m_stringPool.empty())
+	{
+		const StringBucket& bucket = m_stringPool[h % m_stringPool.size()];
+		for (size_t i=0; i<bucket.size(); ++i)
+			if (strcmp(bucket[i], str) == 0)
+				return bucket[i];
+	}
+
+	size_t length = strlen(str);
+	char* copy = static_cast<char*>(allocate(length+1, 1));
+	if (!copy)
+		return "";
+	memcpy(copy, str, length+1);
+
+	try
+	{
+		//grow the table (and dispatch the strings again) if it's too crowded
+		if (m_stringPoolCount >= m_stringPool.size())
+		{
+			std::vector<StringBucket> newPool(std::max<size_t>(64, 2*m_stringPool.size()));
+			for (size_t i=0; i<m_stringPool.size(); ++i)
+				for (size_t j=0; j<m_stringPool[i].size(); ++j)
+					newPool[NameHash(m_stringPool[i][j]) % newPool.size()].push_back(m_stringPool[i][j]);
+			m_stringPool.swap(newPool);
+		}
+		m_stringPool[h % m_stringPool.size()].push_back(copy);
+		++m_stringPoolCount;
+	}
+	catch(std::exception &pex)
+	{
+		memfail(pex,m_stringPoolCount);
+	}
+
+	return copy;
+}
+
+///////////////////////////////
+// NAME INDEX
+///////////////////////////////
+
+void PdmsObjects::NameIndex::clear()
+{
+	m_buckets.clear();
+	m_count = 0;
+}
+
+void PdmsObjects::NameIndex::insert(GenericItem* item)
+{
+	if (!item || item->name[0] == '\0')
+		return;
+
+	try
+	{
+		//grow the table (and dispatch the items again) if it's too crowded
+		if (m_count >= m_buckets.size())
+		{
+			std::vector<Bucket> newBuckets(std::max<size_t>(64, 2*m_buckets.size()));
+			for (size_t i=0; i<m_buckets.size(); ++i)
+				for (size_t j=0; j<m_buckets[i].size(); ++j)
+					newBuckets[NameHash(m_buckets[i][j]->name) % newBuckets.size()].push_back(m_buckets[i][j]);
+			m_buckets.swap(newBuckets);
+		}
+
+		m_buckets[NameHash(item->name) % m_buckets.size()].push_back(item);
+		++m_count;
+	}
+	catch(std::exception &pex)
+	{
+		memfail(pex,m_count);
+	}
+}
+
+void PdmsObjects::NameIndex::remove(GenericItem* item)
+{
+	if (!item || item->name[0] == '\0' || m_buckets.empty())
+		return;
+
+	Bucket& bucket = m_buckets[NameHash(item->name) % m_buckets.size()];
+	for (size_t i=0; i<bucket.size(); ++i)
+	{
+		if (bucket[i] == item)
+		{
+			bucket[i] = bucket.back();
+			bucket.pop_back();
+			--m_count;
+			return;
+		}
+	}
+}
+
+//! Returns whether 'scope->scan(...)' can reach 'item'
+/** Only the group elements are scanned recursively.
+**/
+static bool IsScannedFrom(GenericItem* item, GenericItem* scope)
+{
+	while (item != scope)
+	{
+		item = item->owner;
+		if (!item || !item->isGroupElement())
+			return false;
+	}
+	return true;
+}
+
+GenericItem* PdmsObjects::NameIndex::find(const char* name, GenericItem* scope) const
+{
+	if (!scope || !name || name[0] == '\0' || m_buckets.empty())
+		return NULL;
+
+	GenericItem* result = NULL;
+	const Bucket& bucket = m_buckets[NameHash(name) % m_buckets.size()];
+	for (size_t i=0; i<bucket.size(); ++i)
+	{
+		if (strcmp(bucket[i]->name, name) == 0 && IsScannedFrom(bucket[i], scope))
+		{
+			//Several items share this name: only the hierarchy order can tell which one comes first
+			if (result)
+				return scope->scan(name);
+			result = bucket[i];
+		}
+	}
+
+	return result;
+}
+
+void PdmsObjects::NameIndex::merge(const NameIndex& index)
+{
+	for (size_t i=0; i<index.m_buckets.size(); ++i)
+		for (size_t j=0; j<index.m_buckets[i].size(); ++j)
+			insert(index.m_buckets[i][j]);
+}
+
+///////////////////////////////
+// CHUNKS
+///////////////////////////////
+
+GenericItem* ParsingContext::findName(const char* name, GenericItem* scope)
+{
+	GenericItem* result = names.find(name, scope);
+
+	//the whole hierarchy is bigger than the chunk one: we'll have to check this result when stitching
+	if (m_chunkMode && scope && !scope->owner)
+	{
+		NameLookup lookup;
+		lookup.name = intern(name);
+		lookup.result = result;
+		try
+		{
+			m_lookups.push_back(lookup);
+		}
+		catch(std::exception &pex)
+		{
+			memfail(pex,m_lookups.size());
+		}
+	}
+
+	return result;
+}
+
+bool ParsingContext::deferReference(GenericItem* item, int slot, const char* name)
+{
+	if (!m_chunkMode || !item || slot < -1 || slot > 2)
+		return false;
+
+	DeferredReference ref;
+	ref.item = item;
+	ref.slot = slot;
+	ref.name = intern(name);
+	try
+	{
+		m_deferredReferences.push_back(ref);
+	}
+	catch(std::exception &pex)
+	{
+		memalert(pex,m_deferredReferences.size());
+		return false;
+	}
+	return true;
+}
+
+bool ParsingContext::stitch(ParsingContext& chunk, GenericItem* root, GenericItem* owner)
+{
+	if (!root || root->owner || chunk.m_defaultWorld)
+		return false;
+
+	//Without owner, the chunk root is a hierarchy root as well: the chunk parse was already the same as a sequential one
+	if (!owner)
+	{
+		if (!chunk.m_deferredReferences.empty())
+			return false;
+	}
+	else
+	{
+		if (!stitchReferences(chunk, owner))
+			return false;
+
+		//Same as ElementCreation::execute
+		if (!owner->push(root))
+			return false;
+		root->creator = root->owner;
+
+		//The chunk items found by name must still be reachable from the whole hierarchy
+		if (!chunk.m_lookups.empty() && !IsScannedFrom(root, owner->getRoot()))
+			return false;
+	}
+
+	//Transfer the chunk items (the chunk arena blocks are inserted before ours, as we keep filling the last one)
+	try
+	{
+		m_elementsStack.insert(m_elementsStack.end(), chunk.m_elementsStack.begin(), chunk.m_elementsStack.end());
+		m_arenaItems.insert(m_arenaItems.end(), chunk.m_arenaItems.begin(), chunk.m_arenaItems.end());
+		m_arenaBlocks.insert(m_arenaBlocks.begin(), chunk.m_arenaBlocks.begin(), chunk.m_arenaBlocks.end());
+	}
+	catch(std::exception &pex)
+	{
+		memfail(pex,chunk.m_arenaItems.size());
+	}
+	names.merge(chunk.names);
+
+	//the chunk doesn't own anything anymore
+	chunk.m_arenaBlocks.clear();
+	chunk.m_arenaItems.clear();
+	chunk.clear();
+
+	return true;
+}
+
+bool ParsingContext::stitchReferences(ParsingContext& chunk, GenericItem* owner)
+{
+	//Whole hierarchy (as seen from the chunk in a sequential parse)
+	GenericItem* scope = owner->getRoot();
+
+	//The names found in the chunk must not match any item parsed before (otherwise
+	//a sequential parse could have returned another item)
+	for (size_t i=0; i<chunk.m_lookups.size(); ++i)
+	{
+		const NameLookup& lookup = chunk.m_lookups[i];
+		if (lookup.result && names.find(lookup.name, scope))
+			return false;
+	}
+
+	//Deferred references must be resolved with the items parsed before the chunk
+	//(we do it before pushing the chunk root, as scan could reach the chunk items)
+	for (size_t i=0; i<chunk.m_deferredReferences.size(); ++i)
+	{
+		const DeferredReference& ref = chunk.m_deferredReferences[i];
+		GenericItem* result = names.find(ref.name, scope);
+		if (!result)
+			return false;
+		if (ref.slot < 0)
+			ref.item->positionReference = result;
+		else
+			ref.item->orientationReferences[ref.slot] = result;
+	}
+
+	return true;
+}
+
 ///////////////////////////////
 // PDMS COMMANDS IMPLEMENTATION
 ///////////////////////////////
@@ -116,7 +467,7 @@ PointCoordinateType NumericalValue::getValue() const
 	}
 }
 
-bool NumericalValue::execute(PdmsObjects::GenericItem* &item) const
+bool NumericalValue::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
 	return item ? item->setValue(command, getValue()) : false;
 }
@@ -131,7 +482,7 @@ bool DistanceValue::handle(Token t)
 	return true;
 }
 
-PointCoordinateType DistanceValue::getValueInWorkingUnit() const
+PointCoordinateType DistanceValue::getValueInWorkingUnit(Token workingUnit) const
 {
 	if (unit == PDMS_MILLIMETRE && workingUnit == PDMS_METRE)
 		return value / static_cast<PointCoordinateType>(1000);
@@ -141,9 +492,9 @@ PointCoordinateType DistanceValue::getValueInWorkingUnit() const
 	return value;
 }
 
-bool DistanceValue::execute(PdmsObjects::GenericItem* &item) const
+bool DistanceValue::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
-	return item ? item->setValue(command, getValueInWorkingUnit()) : false;
+	return item ? item->setValue(command, getValueInWorkingUnit(context.workingUnit)) : false;
 }
 
 Reference& Reference::operator=(const Reference &ref)
@@ -201,24 +552,25 @@ int Reference::isSet() const
 	return nb;
 }
 
-bool Reference::execute(PdmsObjects::GenericItem* &item) const
+bool Reference::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
 	//Handle the PDMS_LAST command
 	if (command == PDMS_LAST)
 	{
-		if (s_elementsStack.size() < 2)
+		const ElementsStack& elementsStack = context.getElementsStack();
+		if (elementsStack.size() < 2)
 			return false;
-		ElementsStack::const_reverse_iterator it = s_elementsStack.rbegin(); it++;
+		ElementsStack::const_reverse_iterator it = elementsStack.rbegin(); it++;
 		if (isSet() == 1)
 		{
-			for( ; it != s_elementsStack.rend(); ++it)
+			for( ; it != elementsStack.rend(); ++it)
 			{
 				if (isNameReference() && strcmp(refname,(*it)->name) == 0)
 					break;
 				if (isTokenReference() && (*it)->getType() == token)
 					break;
 			}
-			if (it == s_elementsStack.rend())
+			if (it == elementsStack.rend())
 				return false;
 		}
 		item = *it;
@@ -230,17 +582,17 @@ bool Reference::execute(PdmsObjects::GenericItem* &item) const
 	{
 		//Redirect to an ending command
 		ElementEnding endCommand(PDMS_OWNER);
-		return endCommand.execute(item);
+		return endCommand.execute(item, context);
 	}
 
 	GenericItem* result = NULL;
 	//Search for the referenced item depending on the reference type
 	if (isNameReference())
 	{
-		//Use the hierarchy scanning function given the requested object name
-		if (item)
+		//Look for the requested object name in the whole hierarchy
+		if (!item)
 			return false;
-		result = item->getRoot()->scan(refname);
+		result = context.findName(refname, item->getRoot());
 	}
 	//Request for an element (hierachical or design element only)
 	else if (isTokenReference())
@@ -252,7 +604,7 @@ bool Reference::execute(PdmsObjects::GenericItem* &item) const
 			while (result && result->getType()>token)
 				result = result->owner;
 			if (!result)
-				result = &defaultWorld;
+				result = context.getDefaultWorld();
 		}
 		else if (PdmsToken::isDesignElement(token))
 		{
@@ -327,7 +679,7 @@ bool Coordinates::isValid() const
 	return true;
 }
 
-bool Coordinates::getVector(CCVector3 &u) const
+bool Coordinates::getVector(CCVector3 &u, Token workingUnit) const
 {
 	bool ok[3] = {false, false, false};
 	u = CCVector3(0,0,0);
@@ -343,34 +695,34 @@ bool Coordinates::getVector(CCVector3 &u) const
 		{
 		case PDMS_X:
 		case PDMS_EST:
-			u[0] = coords[i].getValueInWorkingUnit();
+			u[0] = coords[i].getValueInWorkingUnit(workingUnit);
 			ok[0] = true;
 			break;
 
 		case PDMS_WEST:
-			u[0] = -coords[i].getValueInWorkingUnit();
+			u[0] = -coords[i].getValueInWorkingUnit(workingUnit);
 			ok[0] = true;
 			break;
 
 		case PDMS_Y:
 		case PDMS_NORTH:
-			u[1] = coords[i].getValueInWorkingUnit();
+			u[1] = coords[i].getValueInWorkingUnit(workingUnit);
 			ok[1] = true;
 			break;
 
 		case PDMS_SOUTH:
-			u[1] = -coords[i].getValueInWorkingUnit();
+			u[1] = -coords[i].getValueInWorkingUnit(workingUnit);
 			ok[1] = true;
 			break;
 
 		case PDMS_Z:
 		case PDMS_UP:
-			u[2] = coords[i].getValueInWorkingUnit();
+			u[2] = coords[i].getValueInWorkingUnit(workingUnit);
 			ok[2] = true;
 			break;
 
 		case PDMS_DOWN:
-			u[2] = -coords[i].getValueInWorkingUnit();
+			u[2] = -coords[i].getValueInWorkingUnit(workingUnit);
 			ok[2] = true;
 			break;
 
@@ -448,7 +800,7 @@ bool Position::isValid() const
 	return true;
 }
 
-bool Position::execute(PdmsObjects::GenericItem* &item) const
+bool Position::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
 	if (!item)
 		return false;
@@ -458,13 +810,18 @@ bool Position::execute(PdmsObjects::GenericItem* &item) const
 	if (ref.isValid())
 	{
 		refpos = item;
-		if (!ref.execute(refpos))
-			return false;
+		if (!ref.execute(refpos, context))
+		{
+			//the referenced item may lie in another chunk
+			if (ref.command != PDMS_WRT || !ref.isNameReference() || !context.deferReference(item, -1, ref.refname))
+				return false;
+			refpos = NULL;
+		}
 	}
 	
 	//Get position point
 	CCVector3 p;
-	position.getVector(p);
+	position.getVector(p, context.workingUnit);
 	item->setPosition(p);
 	item->positionReference = refpos;
 	
@@ -551,7 +908,7 @@ bool Orientation::isValid() const
 	return true;
 }
 
-bool Orientation::getAxes(CCVector3 &x, CCVector3 &y, CCVector3 &z) const
+bool Orientation::getAxes(CCVector3 &x, CCVector3 &y, CCVector3 &z, Token workingUnit) const
 {
 	x = y = z = CCVector3(0,0,0);
 
@@ -565,36 +922,36 @@ bool Orientation::getAxes(CCVector3 &x, CCVector3 &y, CCVector3 &z) const
 		{
 		case PDMS_X:
 		case PDMS_EST:
-			if (!axisFromCoords(orientation[i],x))
+			if (!axisFromCoords(orientation[i],x,workingUnit))
 				return false;
 			break;
 		
 		case PDMS_WEST:
-			if (!axisFromCoords(orientation[i],x))
+			if (!axisFromCoords(orientation[i],x,workingUnit))
 				return false;
 			x *= -1.;
 			break;
 		
 		case PDMS_Y:
 		case PDMS_NORTH:
-			if (!axisFromCoords(orientation[i],y))
+			if (!axisFromCoords(orientation[i],y,workingUnit))
 				return false;
 			break;
 		
 		case PDMS_SOUTH:
-			if (!axisFromCoords(orientation[i],y))
+			if (!axisFromCoords(orientation[i],y,workingUnit))
 				return false;
 			y *= -1.;
 			break;
 		
 		case PDMS_Z:
 		case PDMS_UP:
-			if (!axisFromCoords(orientation[i],z))
+			if (!axisFromCoords(orientation[i],z,workingUnit))
 				return false;
 			break;
 		
 		case PDMS_DOWN:
-			if (!axisFromCoords(orientation[i],z))
+			if (!axisFromCoords(orientation[i],z,workingUnit))
 				return false;
 			z *= -1.;
 			break;
@@ -607,9 +964,9 @@ bool Orientation::getAxes(CCVector3 &x, CCVector3 &y, CCVector3 &z) const
 	return nb != 0;
 }
 
-bool Orientation::axisFromCoords(const Coordinates &coords, CCVector3 &u)
+bool Orientation::axisFromCoords(const Coordinates &coords, CCVector3 &u, Token workingUnit)
 {
-	if (!coords.getVector(u))
+	if (!coords.getVector(u, workingUnit))
 		return false;
 
 	if (coords.getNbComponents(true) == 2)
@@ -632,7 +989,7 @@ int Orientation::getNbComponents() const
 	return nb;
 }
 
-bool Orientation::execute(PdmsObjects::GenericItem* &item) const
+bool Orientation::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
 	if (!item)
 		return false;
@@ -644,27 +1001,34 @@ bool Orientation::execute(PdmsObjects::GenericItem* &item) const
 		if (refs[i].isValid())
 		{
 			refori = item;
-			if (!refs[i].execute(refori))
-				return false;
+			if (!refs[i].execute(refori, context))
+			{
+				//the referenced item may lie in another chunk
+				if (refs[i].command != PDMS_WRT || !refs[i].isNameReference() || !context.deferReference(item, static_cast<int>(i), refs[i].refname))
+					return false;
+				refori = NULL;
+			}
 		}
 		item->orientationReferences[i] = refori;
 	}
 	
 	//Get position point
 	CCVector3 x, y, z;
-	if (!getAxes(x, y, z))
+	if (!getAxes(x, y, z, context.workingUnit))
 		return false;
 	
 	item->setOrientation(x, y, z);
 	return true;
 }
 
-bool Name::execute(PdmsObjects::GenericItem* &item) const
+bool Name::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
 	if (!item)
 		return false;
 	
-	strcpy(item->name, name);
+	context.names.remove(item);
+	item->name = context.intern(name);
+	context.names.insert(item);
 	
 	return true;
 }
@@ -745,7 +1109,7 @@ const char* ElementCreation::GetDefaultElementName(Token token)
 	return 0;
 }
 
-bool ElementCreation::execute(PdmsObjects::GenericItem* &item) const
+bool ElementCreation::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
 	GenericItem* newElement = NULL;
 	switch (elementType)
@@ -757,46 +1121,46 @@ bool ElementCreation::execute(PdmsObjects::GenericItem* &item) const
 	case PDMS_EQUIPMENT:
 	case PDMS_STRUCTURE:
 	case PDMS_SUBSTRUCTURE:
-		try { newElement = new GroupElement(elementType); } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<GroupElement>(elementType);
 		break;
 	
 	//PDMS elements
 	case PDMS_SCYLINDER:
-		try { newElement = new SCylinder; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<SCylinder>();
 		break;
 	case PDMS_CTORUS:
-		try { newElement = new CTorus; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<CTorus>();
 		break;
 	case PDMS_RTORUS:
-		try { newElement = new RTorus; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<RTorus>();
 		break;
 	case PDMS_DISH:
-		try { newElement = new Dish; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<Dish>();
 		break;
 	case PDMS_CONE:
-		try { newElement = new Cone; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<Cone>();
 		break;
 	case PDMS_BOX:
 	case PDMS_NBOX:
-		try { newElement = new Box; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<Box>();
 		static_cast<Box*>(newElement)->negative = (elementType == PDMS_NBOX);
 		break;
 	case PDMS_PYRAMID:
-		try { newElement = new Pyramid; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<Pyramid>();
 		break;
 	case PDMS_SNOUT:
-		try { newElement = new Snout; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<Snout>();
 		break;
 	case PDMS_EXTRU:
 	case PDMS_NEXTRU:
-		try { newElement = new Extrusion; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<Extrusion>();
 		static_cast<Extrusion*>(newElement)->negative = (elementType == PDMS_NEXTRU);
 		break;
 	case PDMS_LOOP:
-		try { newElement = new Loop; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<Loop>();
 		break;
 	case PDMS_VERTEX:
-		try { newElement = new Vertex; } catch(std::exception &nex) {memalert(nex,1); return false;}
+		newElement = context.create<Vertex>();
 		break;
 	default:
 		break;
@@ -807,7 +1171,7 @@ bool ElementCreation::execute(PdmsObjects::GenericItem* &item) const
 
 	const char* name = GetDefaultElementName(elementType);
 	if (name)
-		strcpy(newElement->name,name);
+		newElement->name = name;
 
 	//If the path is changed during the creation, do it now
 	if (path.size() > 1)
@@ -815,17 +1179,17 @@ bool ElementCreation::execute(PdmsObjects::GenericItem* &item) const
 		if (!item)
 		{
 			//delete newElement;
-			PdmsObjects::Stack::Detroy(newElement);
+			context.destroy(newElement);
 			return false;
 		}
 		PdmsObjects::GenericItem* mitem = item->getRoot();
 		for (unsigned i=0; i+1<path.size(); i++)
 		{
-			mitem = mitem->scan(path[i].c_str());
+			mitem = context.findName(path[i].c_str(), mitem);
 			if (!mitem)
 			{
 				//delete newElement;
-				PdmsObjects::Stack::Detroy(newElement);
+				context.destroy(newElement);
 				return false;
 			}
 		}
@@ -836,29 +1200,21 @@ bool ElementCreation::execute(PdmsObjects::GenericItem* &item) const
 	if (item && !item->push(newElement))
 	{
 		//delete newElement;
-		PdmsObjects::Stack::Detroy(newElement);
+		context.destroy(newElement);
 		return false;
 	}
 	
 	newElement->creator = newElement->owner;
 	if (path.size())
-		strcpy(newElement->name, path.back().c_str());
-	try
-	{
-		s_elementsStack.insert(newElement);
-	}
-	catch(std::exception &pex)
-	{
-		memalert(pex,1);
-		PdmsObjects::Stack::Detroy(newElement);
-		//delete newElement;
+		newElement->name = context.intern(path.back().c_str());
+	if (!context.push(newElement))
 		return false;
-	}
+	context.names.insert(newElement);
 	item = newElement;
 	return true;
 }
 
-bool ElementEnding::execute(PdmsObjects::GenericItem* &item) const
+bool ElementEnding::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
 	GenericItem* result = NULL;
 	switch (command)
@@ -873,7 +1229,7 @@ bool ElementEnding::execute(PdmsObjects::GenericItem* &item) const
 			return true;
 		//In the general case, we have to find the references item (default : this one), and go back to its creator
 		result = item;
-		if (end.isValid() && !end.execute(result))
+		if (end.isValid() && !end.execute(result, context))
 		{
 			return false;
 		}
@@ -882,7 +1238,7 @@ bool ElementEnding::execute(PdmsObjects::GenericItem* &item) const
 		result = result->creator;
 		break;
 	case PDMS_LAST:
-		if (!end.execute(result))
+		if (!end.execute(result, context))
 			return false;
 		break;
 	default:
@@ -923,7 +1279,7 @@ bool ElementCreation::splitPath(const char *str)
 }
 
 
-bool HierarchyNavigation::execute(PdmsObjects::GenericItem* &item) const
+bool HierarchyNavigation::execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const
 {
 	GenericItem* result = item;
 	if (!result || !isValid())
@@ -936,15 +1292,12 @@ bool HierarchyNavigation::execute(PdmsObjects::GenericItem* &item) const
 	//If we went to the root, we have to create a new hierarchy level and set it as the new root
 	if (!result)
 	{
-		try
-		{
-			result = new GroupElement(command);
-		}
-		catch (std::exception &nex)
-		{
-			memfail(nex,1);
+		//a chunk root is not the hierarchy root
+		if (context.isChunk())
+			return false;
+		result = context.create<GroupElement>(command);
+		if (!result)
 			return false;
-		}
 		result->push(item);
 	}
 
@@ -1033,7 +1386,7 @@ GenericItem::GenericItem()
 	orientation[0] = CCVector3(0,0,0); orientation[0][0] = 1;
 	orientation[1] = CCVector3(0,0,0); orientation[1][1] = 1;
 	orientation[2] = CCVector3(0,0,0); orientation[2][2] = 1;
-	name[0] = '\0';
+	name = "";
 }
 
 bool GenericItem::setPosition(const CCVector3 &p)
@@ -1171,19 +1524,6 @@ bool GenericItem::scan(Token t, std::vector<GenericItem *> &array)
 	return false;
 }
 
-DesignElement::~DesignElement()
-{
-	for (std::list<DesignElement*>::iterator it=nelements.begin(); it!=nelements.end(); it++)
-	{
-		GenericItem* item = *it;
-		if (item)
-		{
-			Stack::Detroy(item);
-		}
-	}
-	nelements.clear();
-}
-
 bool DesignElement::push(GenericItem *i)
 {
 	if (i->isDesignElement())
@@ -1216,10 +1556,10 @@ bool DesignElement::push(GenericItem *i)
 
 void DesignElement::remove(GenericItem *i)
 {
-	for (std::list<DesignElement*>::iterator it=nelements.begin(); it!= nelements.end();)
+	for (std::vector<DesignElement*>::iterator it=nelements.begin(); it!= nelements.end();)
 	{
 		if (*it == i)
-			nelements.erase(it);
+			it = nelements.erase(it);
 		else
 			it++;
 	}
@@ -1230,31 +1570,11 @@ GroupElement::GroupElement(Token l)
 	level = l;
 	elements.clear();
 	subhierarchy.clear();
-	memset(name,0,c_max_str_length);
-}
-
-GroupElement::~GroupElement()
-{
-	clear(true);
 }
 
-void GroupElement::clear(bool del)
+void GroupElement::clear()
 {
-	if (del)
-	{
-		for (std::list<DesignElement*>::iterator eit = elements.begin(); eit != elements.end(); eit++)
-		{
-			GenericItem* item = *eit;
-			if (*eit)
-				Stack::Detroy(item);
-		}
-		for (std::list<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
-		{
-			GenericItem* item = *hit;
-			if (*hit)
-				Stack::Detroy(item);
-		}
-	}
+	//children live in the parsing context arena
 	elements.clear();
 	subhierarchy.clear();
 }
@@ -1312,7 +1632,7 @@ bool GroupElement::push(GenericItem *i)
 
 void GroupElement::remove(GenericItem *i)
 {
-	for (std::list<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
+	for (std::vector<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
 	{
 		if (*hit == i)
 		{
@@ -1321,7 +1641,7 @@ void GroupElement::remove(GenericItem *i)
 		}
 	}
 
-	for (std::list<DesignElement*>::iterator eit = elements.begin(); eit != elements.end(); eit++)
+	for (std::vector<DesignElement*>::iterator eit = elements.begin(); eit != elements.end(); eit++)
 	{
 		if (*eit == i)
 		{
@@ -1340,10 +1660,10 @@ bool GroupElement::convertCoordinateSystem()
 
 	if (!GenericItem::convertCoordinateSystem())
 		return false;
-	for (std::list<DesignElement*>::iterator eit = elements.begin(); eit != elements.end(); eit++)
+	for (std::vector<DesignElement*>::iterator eit = elements.begin(); eit != elements.end(); eit++)
 		if (!(*eit)->convertCoordinateSystem())
 			return false;
-	for (std::list<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
+	for (std::vector<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
 		if (!(*hit)->convertCoordinateSystem())
 			return false;
 	return true;
@@ -1353,9 +1673,9 @@ GenericItem* GroupElement::scan(const char* str)
 {
 	//scan all elements contained in this group, begining with this one, while none matches the requested name
 	GenericItem *item=GenericItem::scan(str);
-	for (std::list<DesignElement*>::iterator eit = elements.begin(); eit != elements.end() && !item; eit++)
+	for (std::vector<DesignElement*>::iterator eit = elements.begin(); eit != elements.end() && !item; eit++)
 		item = (*eit)->scan(str);
-	for (std::list<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end() && !item; hit++)
+	for (std::vector<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end() && !item; hit++)
 		item = (*hit)->scan(str);
 	return item;
 }
@@ -1364,9 +1684,9 @@ bool GroupElement::scan(Token t, std::vector<GenericItem*> &items)
 {
 	GenericItem::scan(t, items);
 	size_t size = items.size();
-	for (std::list<DesignElement*>::iterator eit = elements.begin(); eit!=elements.end(); eit++)
+	for (std::vector<DesignElement*>::iterator eit = elements.begin(); eit!=elements.end(); eit++)
 		(*eit)->scan(t, items);
-	for (std::list<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
+	for (std::vector<GroupElement*>::iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
 		(*hit)->scan(t, items);
 	return (items.size() > size);
 }
@@ -1399,14 +1719,14 @@ std::pair<int,int> GroupElement::write(std::ostream &output, int nbtabs) const
 
 	std::pair<int,int> nb(1,0);
 
-	for (std::list<GroupElement*>::const_iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
+	for (std::vector<GroupElement*>::const_iterator hit = subhierarchy.begin(); hit != subhierarchy.end(); hit++)
 	{
 		std::pair<int,int> n = (*hit)->write(output, nbtabs+1);
 		nb.first += n.first;
 		nb.second += n.second;
 	}
 
-	for (std::list<DesignElement*>::const_iterator eit = elements.begin(); eit != elements.end(); eit++)
+	for (std::vector<DesignElement*>::const_iterator eit = elements.begin(); eit != elements.end(); eit++)
 	{
 		std::pair<int,int> n = (*eit)->write(output, nbtabs+1);
 		nb.first += n.first;
@@ -1833,10 +2153,10 @@ bool Loop::push(GenericItem *i)
 
 void Loop::remove(GenericItem *i)
 {
-	for (std::list<Vertex*>::iterator it = loop.begin(); it != loop.end(); )
+	for (std::vector<Vertex*>::iterator it = loop.begin(); it != loop.end(); )
 	{
 		if ((*it) == i)
-			loop.erase(it);
+			it = loop.erase(it);
 		else
 			it++;
 	}
@@ -1869,8 +2189,8 @@ PointCoordinateType Extrusion::surface() const
 	PointCoordinateType p = 0;
 	if (loop)
 	{
-		std::list<Vertex*>::const_iterator it1 = loop->loop.begin();
-		std::list<Vertex*>::const_iterator it2 = it1; ++it2;
+		std::vector<Vertex*>::const_iterator it1 = loop->loop.begin();
+		std::vector<Vertex*>::const_iterator it2 = it1; ++it2;
 		while (it1 != loop->loop.end())
 		{
 			if (it2 == loop->loop.end())
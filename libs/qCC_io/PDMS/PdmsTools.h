@@ -23,8 +23,8 @@
 #include <CCConst.h>
 
 //system
-#include <list>
 #include <vector>
+#include <new>
 #include <ostream>
 #include <string.h>
 
@@ -118,7 +118,9 @@ namespace PdmsTools
 		PDMS_ORIENTATION,
 		//Units system
 		PDMS_METRE,
-		PDMS_MILLIMETRE
+		PDMS_MILLIMETRE,
+		//Parser use (a whole block parsed apart, see PdmsChunkedParser)
+		PDMS_CHUNK
 	};
 
 	namespace PdmsToken
@@ -157,7 +159,9 @@ namespace PdmsTools
 			GenericItem *orientationReferences[3];
 
 			//! Name
-			char name[c_max_str_length];
+			/** Either a static string or a string interned by ParsingContext::intern (never NULL).
+			**/
+			const char* name;
 
 			//! Default constructor
 			GenericItem();
@@ -192,13 +196,28 @@ namespace PdmsTools
 			bool completeOrientation();
 		};
 
-		//! Item stack
-		class Stack
+		//! Items names index
+		/** Hash table of the items (by name), updated each time an item is
+			created, renamed or destroyed. It is used to resolve name references
+			without scanning the whole hierarchy.
+		**/
+		class NameIndex
 		{
 		public:
-			static void Init();
-			static void Clear();
-			static void Detroy(GenericItem* &item);
+			NameIndex() : m_count(0) {}
+
+			void clear();
+			void insert(GenericItem* item);
+			void remove(GenericItem* item);
+			//! Returns the item with the given name that 'scope->scan(name)' would return
+			GenericItem* find(const char* name, GenericItem* scope) const;
+			//! Inserts all the items of another index
+			void merge(const NameIndex& index);
+
+		protected:
+			typedef std::vector<GenericItem*> Bucket;
+			std::vector<Bucket> m_buckets;
+			size_t m_count;
 		};
 
 		//! Design element
@@ -206,10 +225,9 @@ namespace PdmsTools
 		{
 		public :
 			bool negative;
-			std::list<DesignElement*> nelements;
+			std::vector<DesignElement*> nelements;
 
 			DesignElement() : negative(false) {}
-			virtual ~DesignElement();
 
 			//reimplemented from GenericItem
 			virtual bool isDesignElement() {return true;}
@@ -225,16 +243,15 @@ namespace PdmsTools
 		{
 		public :
 			Token level;
-			std::list<DesignElement*> elements;
-			std::list<GroupElement*> subhierarchy;
+			std::vector<DesignElement*> elements;
+			std::vector<GroupElement*> subhierarchy;
 
 			GroupElement(Token l);
-			virtual ~GroupElement();
 
 			//GroupElement(const Model* model);
 			//virtual bool push(const Shape* shape);
 
-			virtual void clear(bool del=false);
+			virtual void clear();
 
 			//reimplemented from GenericItem
 			virtual bool push(GenericItem *i);
@@ -407,18 +424,9 @@ namespace PdmsTools
 		class Loop : public DesignElement
 		{
 		public:
-			std::list<Vertex*> loop;
+			std::vector<Vertex*> loop;
 
 			Loop() {}
-			virtual ~Loop()
-			{
-				while (!loop.empty())
-				{
-					GenericItem* v = loop.back();
-					Stack::Detroy(v);
-					loop.pop_back();
-				}
-			}
 
 			//reimplemented from GenericItem
 			virtual bool push(GenericItem *i);
@@ -435,7 +443,6 @@ namespace PdmsTools
 			PointCoordinateType height;
 
 			Extrusion() : loop(0), height(0.0f) {}
-			virtual ~Extrusion() {if(loop) { GenericItem* i = loop; Stack::Detroy(i); } }
 
 			//reimplemented from GenericItem
 			virtual void remove(Loop *l) {if (l==loop) loop=NULL;}
@@ -450,6 +457,149 @@ namespace PdmsTools
 	};
 
 
+	//! Parsing context
+	/** Holds everything a parse needs (items, names, working unit, etc.).
+		Each parser has its own context, so that several macros can be parsed
+		concurrently.
+
+		All the items are allocated in an arena (by large blocks) and are only
+		released all at once, by clear. Names are stored in the same arena (and
+		shared by all the items with the same name).
+	**/
+	class ParsingContext
+	{
+	public:
+		ParsingContext();
+		~ParsingContext() {clear();}
+
+		//! Working unit (all distances are converted to this unit)
+		Token workingUnit;
+		//! Items names index
+		PdmsObjects::NameIndex names;
+
+		//! Releases the arena (i.e. all the items and names created so far)
+		void clear();
+		//! Removes an item from the stack and the names index (its memory is only released by clear)
+		void destroy(PdmsObjects::GenericItem* &item);
+
+		//! Creates a new item in the arena
+		template<class T> T* create()
+		{
+			void* mem = allocate(sizeof(T));
+			if (!mem)
+				return NULL;
+			T* item = new (mem) T();
+			track(item);
+			return item;
+		}
+
+		//! Creates a new item in the arena (with one constructor argument)
+		template<class T, class A> T* create(A a)
+		{
+			void* mem = allocate(sizeof(T));
+			if (!mem)
+				return NULL;
+			T* item = new (mem) T(a);
+			track(item);
+			return item;
+		}
+
+		//! Pushes an item on the stack (last created items are used by PDMS_LAST)
+		bool push(PdmsObjects::GenericItem* item);
+		//! Returns the stack of items (by creation order)
+		const std::vector<PdmsObjects::GenericItem*>& getElementsStack() const {return m_elementsStack;}
+
+		//! Returns the unique copy of a string (stored in the arena)
+		const char* intern(const char* str);
+
+		//! Returns the default world (owner of the orphan groups)
+		/** Always NULL in chunk mode.
+		**/
+		PdmsObjects::GroupElement* getDefaultWorld();
+
+		//! Looks for an item by its name (see NameIndex::find)
+		/** In chunk mode, the lookups in the whole hierarchy are recorded (to be checked by stitch).
+		**/
+		PdmsObjects::GenericItem* findName(const char* name, PdmsObjects::GenericItem* scope);
+
+		//! Sets chunk mode
+		/** In chunk mode, the items are parsed apart from their ancestors, and
+			stitched afterwards to the main hierarchy (see stitch). Everything that
+			would depend on the missing ancestors either fails or is recorded.
+		**/
+		void setChunkMode(bool state) {m_chunkMode = state;}
+		//! Returns whether chunk mode is enabled
+		bool isChunk() const {return m_chunkMode;}
+
+		//! Defers the resolution of a 'WRT /NAME' reference to the stitching step (chunk mode only)
+		/** \param item item holding the reference
+			\param slot -1 for the position reference, 0 to 2 for the orientation ones
+			\param name referenced name
+		**/
+		bool deferReference(PdmsObjects::GenericItem* item, int slot, const char* name);
+
+		//! Stitches a chunk to this context hierarchy
+		/** The chunk root is pushed in 'owner' (as if it was created there) and all
+			the chunk items are transferred to this context. Deferred references are
+			resolved at this time.
+			\return false if the result could differ from a sequential parse
+		**/
+		bool stitch(ParsingContext& chunk, PdmsObjects::GenericItem* root, PdmsObjects::GenericItem* owner);
+
+	protected:
+
+		//! Allocates memory in the arena
+		void* allocate(size_t size, size_t alignment = c_arena_alignment);
+		//! Tracks an item so that it is properly destroyed by clear
+		void track(PdmsObjects::GenericItem* item);
+		//! Checks the chunk lookups and resolves its deferred references (see stitch)
+		bool stitchReferences(ParsingContext& chunk, PdmsObjects::GenericItem* owner);
+
+		//! Arena allocations alignment
+		static const size_t c_arena_alignment = 16;
+
+		//! Registered items (by creation order)
+		std::vector<PdmsObjects::GenericItem*> m_elementsStack;
+		//! Arena blocks
+		std::vector<char*> m_arenaBlocks;
+		//! Current arena block free space
+		size_t m_arenaBlockPos, m_arenaBlockEnd;
+		//! Items living in the arena (to call their destructors)
+		std::vector<PdmsObjects::GenericItem*> m_arenaItems;
+		//! Interned strings (hash table)
+		std::vector< std::vector<const char*> > m_stringPool;
+		//! Number of interned strings
+		size_t m_stringPoolCount;
+		//! Default world
+		PdmsObjects::GroupElement* m_defaultWorld;
+
+		//! Name lookup (chunk mode)
+		struct NameLookup
+		{
+			const char* name;
+			PdmsObjects::GenericItem* result;
+		};
+		//! Deferred reference (chunk mode)
+		struct DeferredReference
+		{
+			PdmsObjects::GenericItem* item;
+			int slot;
+			const char* name;
+		};
+
+		//! Chunk mode
+		bool m_chunkMode;
+		//! Lookups in the whole hierarchy (chunk mode)
+		std::vector<NameLookup> m_lookups;
+		//! Deferred references (chunk mode)
+		std::vector<DeferredReference> m_deferredReferences;
+
+	private:
+		//forbidden
+		ParsingContext(const ParsingContext&);
+		ParsingContext& operator=(const ParsingContext&);
+	};
+
 	namespace PdmsCommands
 	{
 
@@ -469,7 +619,7 @@ namespace PdmsTools
 			virtual bool handle(const char* str) {return false;}
 			virtual bool handle(Token t) {return false;}
 			virtual bool isValid() const {return false;}
-			virtual bool execute(PdmsObjects::GenericItem* &item) const {return false;}
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const {return false;}
 		};
 
 		class NumericalValue : public Command
@@ -482,21 +632,19 @@ namespace PdmsTools
 			virtual bool handle(PointCoordinateType numvalue);
 			virtual bool isValid() const;
 			virtual PointCoordinateType getValue() const;
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 		};
 
 		class DistanceValue : public NumericalValue
 		{
 		public:
 			Token unit;
-			static Token workingUnit;
 
 			DistanceValue(Token t=PDMS_INVALID_TOKEN) : NumericalValue(t), unit(PDMS_INVALID_TOKEN) {}
-			static void setWorkingUnit(Token wu) {workingUnit=wu;}
 			virtual bool handle(Token t);
 			virtual bool handle(PointCoordinateType numvalue) {return NumericalValue::handle(numvalue);}
-			PointCoordinateType getValueInWorkingUnit() const;
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			PointCoordinateType getValueInWorkingUnit(Token workingUnit) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 		};
 
 		class Reference : public Command
@@ -513,7 +661,7 @@ namespace PdmsTools
 			virtual bool isValid() const;
 			virtual bool isNameReference() const;
 			virtual bool isTokenReference() const;
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 
 		protected:
 			int isSet() const;
@@ -529,7 +677,7 @@ namespace PdmsTools
 			virtual bool handle(Token t);
 			virtual bool handle(PointCoordinateType numvalue);
 			virtual bool isValid() const;
-			bool getVector(CCVector3 &u) const;
+			bool getVector(CCVector3 &u, Token workingUnit) const;
 			int getNbComponents(bool onlyset=false) const;
 		};
 
@@ -545,7 +693,7 @@ namespace PdmsTools
 			virtual bool handle(PointCoordinateType numvalue);
 			virtual bool handle(const char* str);
 			virtual bool isValid() const;
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 		};
 
 		class Orientation : public Command
@@ -561,12 +709,12 @@ namespace PdmsTools
 			virtual bool handle(PointCoordinateType numvalue);
 			virtual bool handle(const char* str);
 			virtual bool isValid() const;
-			bool getAxes(CCVector3 &x, CCVector3 &y, CCVector3 &z) const;
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			bool getAxes(CCVector3 &x, CCVector3 &y, CCVector3 &z, Token workingUnit) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 
 		protected:
 			int getNbComponents() const;
-			static bool axisFromCoords(const Coordinates &coords, CCVector3 &u);
+			static bool axisFromCoords(const Coordinates &coords, CCVector3 &u, Token workingUnit);
 		};
 
 		class Name : public Command
@@ -586,7 +734,7 @@ namespace PdmsTools
 			{
 				return strlen(name) > 0;
 			}
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 		};
 
 		class ElementCreation : public Command
@@ -599,7 +747,7 @@ namespace PdmsTools
 			virtual bool handle(const char*str);
 			virtual bool handle(Token t);
 			bool isValid() const;
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 
 			static const char* GetDefaultElementName(Token token);
 
@@ -616,7 +764,7 @@ namespace PdmsTools
 			virtual bool handle(Token t) {end.command=command; return end.handle(t);}
 			virtual bool handle(const char* str) {end.command=command; return end.handle(str);}
 			virtual bool isValid() const {if(!end.command) return true; return end.isValid();}
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 		};
 
 		class HierarchyNavigation : public Command
@@ -624,7 +772,7 @@ namespace PdmsTools
 		public:
 			HierarchyNavigation(Token t) : Command(t) {}
 			virtual bool isValid() const {return (PdmsToken::isGroupElement(command));}
-			virtual bool execute(PdmsObjects::GenericItem* &item) const;
+			virtual bool execute(PdmsObjects::GenericItem* &item, ParsingContext& context) const;
 		};
 
 	};
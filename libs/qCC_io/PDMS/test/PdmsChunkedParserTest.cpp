@@ -0,0 +1,209 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//! Checks that PdmsChunkedParser gives the same hierarchy as PdmsParser
+/** Usage: PdmsChunkedParserTest [macro files...]
+	Each macro is parsed sequentially then by chunks (concurrently) and both
+	hierarchies are compared (see GenericItem::write). Without any argument,
+	a synthetic macro is generated and tested. Returns 0 if all files match.
+	Build: PdmsChunkedParserTest.vcxproj (or, with gcc:
+	g++ -I.. -I../../../../IGIT/include -I$QTDIR/include -I$QTDIR/include/QtCore
+	../PdmsTools.cpp ../PdmsParser.cpp PdmsChunkedParserTest.cpp -lQtCore)
+**/
+
+#include "PdmsParser.h"
+
+//Qt
+#include <QtConcurrentMap>
+
+//system
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <sstream>
+
+//! Min chunk size (small enough to split the test files in many chunks)
+static const size_t c_test_min_chunk_size = (1 << 10);
+
+//! Chunk parsing job (same as in PDMSFilter)
+struct PdmsChunkJob
+{
+	PdmsChunkedParser* parser;
+	size_t index;
+};
+
+static void ParseChunk_MT(const PdmsChunkJob& job)
+{
+	job.parser->parseChunk(job.index);
+}
+
+//! Parses a file sequentially and writes the resulting hierarchy
+static bool ParseSequential(const std::string& filename, std::string& output)
+{
+	PdmsBufferedFileSession session(filename);
+	PdmsParser parser;
+	parser.linkWithSession(&session);
+	if (!parser.parseSessionContent())
+		return false;
+
+	PdmsTools::PdmsObjects::GenericItem* root = parser.getLoadedObject(false);
+	if (!root)
+		return false;
+
+	std::ostringstream stream;
+	root->write(stream);
+	output = stream.str();
+	return true;
+}
+
+//! Parses a file by chunks and writes the resulting hierarchy
+static bool ParseChunked(const std::string& filename, std::string& output, size_t& chunkCount)
+{
+	PdmsChunkedParser parser(filename);
+	chunkCount = parser.prepare(c_test_min_chunk_size);
+	if (chunkCount > 1)
+	{
+		std::vector<PdmsChunkJob> jobs(chunkCount);
+		for (size_t i=0; i<chunkCount; ++i)
+		{
+			jobs[i].parser = &parser;
+			jobs[i].index = i;
+		}
+		QtConcurrent::blockingMap(jobs, ParseChunk_MT);
+	}
+
+	if (!parser.parseFileContent())
+		return false;
+
+	PdmsTools::PdmsObjects::GenericItem* root = parser.getLoadedObject(false);
+	if (!root)
+		return false;
+
+	std::ostringstream stream;
+	root->write(stream);
+	output = stream.str();
+	return true;
+}
+
+//! Deterministic pseudo-random generator (so that the synthetic macro never changes)
+static unsigned NextRandom(unsigned& seed, unsigned maxValue)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 16) & 0x7fff) % (maxValue+1);
+}
+
+//! Generates a synthetic macro (several sites with various elements, comments, etc.)
+static bool GenerateMacro(const std::string& filename, unsigned siteCount, unsigned elementCount)
+{
+	FILE* fp = fopen(filename.c_str(), "wt");
+	if (!fp)
+		return false;
+
+	unsigned seed = 1;
+	fprintf(fp, "$* header comment\n$( block $( nested $) comment $)\nNEW WORLD /W\n");
+	for (unsigned s=0; s<siteCount; ++s)
+	{
+		fprintf(fp, "NEW SITE /SITE%u\n", s);
+		fprintf(fp, "$* entering in group: /meta%u extra\n", s);
+		for (unsigned z=0; z<3; ++z)
+		{
+			fprintf(fp, "new zone /Z%u_%u\n", s, z);
+			for (unsigned e=0; e<elementCount; ++e)
+			{
+				char name[64];
+				sprintf(name, "/E%u_%u_%u", s, z, e);
+				switch (NextRandom(seed,5))
+				{
+				case 0:
+					fprintf(fp, "NEW SLCY %s\n DIAM %umm HEI %u.5\n AT X %u Y %u Z %u\n ORI X is N and Z is U\nEND\n", name, 1+NextRandom(seed,98), 1+NextRandom(seed,998), e, z, s);
+					break;
+				case 1:
+					fprintf(fp, "NEW CTORUS %s\n RINS 10 ROUT 2,5m ANGLE 90\n AT E %u N 3 U -4\nEND\n", name, e);
+					break;
+				case 2:
+					fprintf(fp, "NEW BOX %s XLEN 1 YLEN 2 ZLEN 3\n POS W 5 S 6 D 7\nEND\n", name);
+					break;
+				case 3:
+					fprintf(fp, "NEW CONE %s DTOP 1 DBOTTOM 2 HEIGHT 3\tAT X 1\nEND\n", name);
+					break;
+				case 4:
+					fprintf(fp, "NEW DISH %s DIAM 4 HEI 1 RAD 2 $* trailing comment\nEND\n", name);
+					break;
+				default:
+					fprintf(fp, "HANDLE (ANY\n) ENDHANDLE\nNEW SNOUT %s DTOP 1 DBOTTOM 2 HEIGHT 3 XOFF 1 YOFF 2\nEND\n", name);
+					break;
+				}
+			}
+			fprintf(fp, "END\n");
+		}
+		fprintf(fp, "$* leaving group\n");
+		fprintf(fp, "END\n");
+	}
+	fprintf(fp, "END\n");
+
+	fclose(fp);
+	return true;
+}
+
+//! Tests a file
+static bool TestFile(const std::string& filename)
+{
+	std::string sequential, chunked;
+	size_t chunkCount = 0;
+	if (!ParseSequential(filename, sequential))
+	{
+		printf("[%s] sequential parsing failed\n", filename.c_str());
+		return false;
+	}
+	if (!ParseChunked(filename, chunked, chunkCount))
+	{
+		printf("[%s] chunked parsing failed\n", filename.c_str());
+		return false;
+	}
+	if (sequential != chunked)
+	{
+		printf("[%s] hierarchies differ (%u chunks)\n", filename.c_str(), static_cast<unsigned>(chunkCount));
+		return false;
+	}
+
+	printf("[%s] OK (%u chunks)\n", filename.c_str(), static_cast<unsigned>(chunkCount));
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	bool success = true;
+
+	if (argc > 1)
+	{
+		for (int i=1; i<argc; ++i)
+			success &= TestFile(argv[i]);
+	}
+	else
+	{
+		std::string filename("PdmsChunkedParserTest.mac");
+		if (!GenerateMacro(filename, 20, 30))
+		{
+			printf("Failed to generate '%s'\n", filename.c_str());
+			return 1;
+		}
+		success = TestFile(filename);
+		remove(filename.c_str());
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//! Checks that loading a directory of macros in parallel gives the same result as loading them sequentially
+/** Usage: PdmsDirectoryLoadTest [directory]
+	All the macros of the directory (*.mac, *.pdms, *.pdmsmac) are parsed
+	and converted to their cache (see PdmsCache::build) the same way as
+	PDMSFilter::LoadFiles does: first sequentially, then concurrently (one
+	job per file on the global thread pool, big files being themselves split
+	in chunks). The content of each cache must be the same in both cases.
+	Without any argument, a directory of synthetic macros (of various sizes)
+	is generated and tested. Returns 0 if all files match.
+	Build: PdmsDirectoryLoadTest.vcxproj (or, with gcc:
+	g++ -I.. -I../../../../IGIT/include -I$QTDIR/include -I$QTDIR/include/QtCore
+	../PdmsTools.cpp ../PdmsParser.cpp ../PdmsCache.cpp PdmsDirectoryLoadTest.cpp -lQtCore)
+**/
+
+#include "PdmsCache.h"
+#include "PdmsParser.h"
+
+//Qt
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QStringList>
+#include <QtConcurrentMap>
+
+//system
+#include <stdio.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//! File loading job (same as in PDMSFilter)
+struct PdmsLoadJob
+{
+	QString filename;
+	//! Cache content (see WriteCache)
+	std::string content;
+	bool success;
+};
+
+//! Chunk parsing job (same as in PDMSFilter)
+struct PdmsChunkJob
+{
+	PdmsChunkedParser* parser;
+	size_t index;
+};
+
+static void ParseChunk_MT(const PdmsChunkJob& job)
+{
+	job.parser->parseChunk(job.index);
+}
+
+//! Writes the content of a cache (groups, elements and parameters)
+static void WriteCache(const PdmsCache& cache, std::string& output)
+{
+	std::ostringstream stream;
+	const PdmsCache::Header& header = cache.header();
+	stream << header.groupCount << " groups, " << header.elementCount << " elements, " << header.paramCount << " parameters\n";
+
+	for (uint64_t i=0; i<header.groupCount; ++i)
+	{
+		const PdmsCache::Group& group = cache.group(static_cast<size_t>(i));
+		stream << "G " << cache.string(group.name) << ' ' << group.level
+			<< ' ' << group.firstElement << ' ' << group.elementCount
+			<< ' ' << group.firstSubGroup << ' ' << group.subGroupCount << '\n';
+	}
+
+	for (uint64_t i=0; i<header.elementCount; ++i)
+	{
+		const PdmsCache::Element& element = cache.element(static_cast<size_t>(i));
+		stream << "E " << cache.string(element.name) << ' ' << element.type << ' ' << element.flags;
+		const PointCoordinateType* params = cache.params(element);
+		for (uint32_t j=0; j<element.paramCount; ++j)
+			stream << ' ' << params[j];
+		for (unsigned j=0; j<3; ++j)
+			stream << ' ' << element.position[j];
+		for (unsigned j=0; j<9; ++j)
+			stream << ' ' << element.orientation[j];
+		stream << '\n';
+	}
+
+	output = stream.str();
+}
+
+//! Parses a macro and builds its cache (same as PDMSFilter's ParseFile)
+static void Load_MT(PdmsLoadJob& job)
+{
+	job.success = false;
+	job.content.clear();
+
+	PdmsChunkedParser parser(qPrintable(job.filename));
+
+	//big files are split at their top-level blocks, parsed concurrently
+	if (QFileInfo(job.filename).size() >= static_cast<qint64>(2*PdmsChunkedParser::c_default_min_chunk_size))
+	{
+		size_t chunkCount = parser.prepare();
+		if (chunkCount > 1)
+		{
+			std::vector<PdmsChunkJob> jobs(chunkCount);
+			for (size_t i=0; i<chunkCount; ++i)
+			{
+				jobs[i].parser = &parser;
+				jobs[i].index = i;
+			}
+			QtConcurrent::blockingMap(jobs, ParseChunk_MT);
+		}
+	}
+
+	if (!parser.parseFileContent())
+		return;
+
+	PdmsTools::PdmsObjects::GenericItem* root = parser.getLoadedObject(true);
+	if (!root)
+		return;
+
+	PdmsCache cache;
+	if (!cache.build(root, 0, 0))
+		return;
+
+	WriteCache(cache, job.content);
+	job.success = true;
+}
+
+//! Deterministic pseudo-random generator (so that the synthetic macros never change)
+static unsigned NextRandom(unsigned& seed, unsigned maxValue)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 16) & 0x7fff) % (maxValue+1);
+}
+
+//! Generates a synthetic macro (several sites with various elements)
+static bool GenerateMacro(const QString& filename, unsigned fileIndex, unsigned siteCount, unsigned elementCount)
+{
+	FILE* fp = fopen(qPrintable(filename), "wt");
+	if (!fp)
+		return false;
+
+	unsigned seed = fileIndex + 1;
+	fprintf(fp, "NEW WORLD /W%u\n", fileIndex);
+	for (unsigned s=0; s<siteCount; ++s)
+	{
+		fprintf(fp, "NEW SITE /F%u_SITE%u\n", fileIndex, s);
+		for (unsigned z=0; z<3; ++z)
+		{
+			fprintf(fp, "NEW ZONE /F%u_Z%u_%u\n", fileIndex, s, z);
+			for (unsigned e=0; e<elementCount; ++e)
+			{
+				char name[64];
+				sprintf(name, "/F%u_E%u_%u_%u", fileIndex, s, z, e);
+				switch (NextRandom(seed,4))
+				{
+				case 0:
+					fprintf(fp, "NEW SLCY %s\n DIAM %umm HEI %u.5\n AT X %u Y %u Z %u\n ORI X is N 1 and Z is U 1\nEND\n", name, 1+NextRandom(seed,98), 1+NextRandom(seed,998), e, z, s);
+					break;
+				case 1:
+					fprintf(fp, "NEW CTORUS %s\n RINS 10 ROUT 2,5m ANGLE 90\n AT E %u N 3 U -4\nEND\n", name, e);
+					break;
+				case 2:
+					fprintf(fp, "NEW BOX %s XLEN %u YLEN 2 ZLEN 3\n POS W 5 S 6 D 7\nEND\n", name, 1+NextRandom(seed,9));
+					break;
+				case 3:
+					fprintf(fp, "NEW CONE %s DTOP 1 DBOTTOM 2 HEIGHT 3\tAT X 1\nEND\n", name);
+					break;
+				default:
+					fprintf(fp, "NEW DISH %s DIAM 4 HEI 1 RAD 2\nEND\n", name);
+					break;
+				}
+			}
+			fprintf(fp, "END\n");
+		}
+		fprintf(fp, "END\n");
+	}
+	fprintf(fp, "END\n");
+
+	fclose(fp);
+	return true;
+}
+
+//! Generates a directory of synthetic macros (of various sizes, the first one being split in chunks)
+static bool GenerateDirectory(const QString& dirname, QStringList& filenames)
+{
+	if (!QDir().mkpath(dirname))
+		return false;
+
+	const unsigned fileCount = 16;
+	for (unsigned i=0; i<fileCount; ++i)
+	{
+		QString filename = QDir(dirname).absoluteFilePath(QString("zone%1.mac").arg(i,2,10,QChar('0')));
+		unsigned siteCount = (i == 0 ? 20 : 2 + i%5);
+		unsigned elementCount = (i == 0 ? 800 : 200 * (1 + i%4));
+		if (!GenerateMacro(filename, i, siteCount, elementCount))
+			return false;
+		filenames << filename;
+	}
+
+	return true;
+}
+
+//! Returns the PDMS macros of a directory (same filters as PDMSFilter::LoadDirectory)
+static QStringList GetMacros(const QString& dirname)
+{
+	QDir dir(dirname);
+	QStringList nameFilters;
+	nameFilters << "*.mac" << "*.pdms" << "*.pdmsmac";
+	QStringList entries = dir.entryList(nameFilters, QDir::Files | QDir::Readable, QDir::Name);
+
+	QStringList filenames;
+	for (int i=0; i<entries.size(); ++i)
+		filenames << dir.absoluteFilePath(entries[i]);
+	return filenames;
+}
+
+//! Loads the macros sequentially then concurrently and compares the results
+static bool TestFiles(const QStringList& filenames)
+{
+	std::vector<PdmsLoadJob> sequential(filenames.size()), concurrent(filenames.size());
+	for (int i=0; i<filenames.size(); ++i)
+		sequential[i].filename = concurrent[i].filename = filenames[i];
+
+	QElapsedTimer timer;
+	timer.start();
+	for (size_t i=0; i<sequential.size(); ++i)
+		Load_MT(sequential[i]);
+	double sequentialTime = timer.nsecsElapsed() / 1.0e9;
+
+	timer.start();
+	QtConcurrent::blockingMap(concurrent, Load_MT);
+	double concurrentTime = timer.nsecsElapsed() / 1.0e9;
+
+	bool success = true;
+	for (size_t i=0; i<sequential.size(); ++i)
+	{
+		if (!sequential[i].success || !concurrent[i].success)
+		{
+			printf("[%s] loading failed\n", qPrintable(filenames[static_cast<int>(i)]));
+			success = false;
+		}
+		else if (sequential[i].content != concurrent[i].content)
+		{
+			printf("[%s] results differ\n", qPrintable(filenames[static_cast<int>(i)]));
+			success = false;
+		}
+	}
+
+	printf("%u files: sequential %.3f s, concurrent %.3f s (x%.1f): %s\n",
+		static_cast<unsigned>(filenames.size()), sequentialTime, concurrentTime, concurrentTime > 0 ? sequentialTime / concurrentTime : 0.0, success ? "OK" : "FAILED");
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	bool success = true;
+
+	if (argc > 1)
+	{
+		QStringList filenames = GetMacros(QString(argv[1]));
+		if (filenames.empty())
+		{
+			printf("No PDMS macro in directory '%s'\n", argv[1]);
+			return 1;
+		}
+		success = TestFiles(filenames);
+	}
+	else
+	{
+		QString dirname("PdmsDirectoryLoadTest");
+		QStringList filenames;
+		if (!GenerateDirectory(dirname, filenames))
+		{
+			printf("Failed to generate directory '%s'\n", qPrintable(dirname));
+			return 1;
+		}
+		success = TestFiles(GetMacros(dirname));
+		for (int i=0; i<filenames.size(); ++i)
+			QFile::remove(filenames[i]);
+		QDir().rmdir(dirname);
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,338 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//! Micro-benchmark of the PDMS keywords classification
+/** Usage: PdmsKeywordBenchmark [token count in millions]
+	The keywords prefix tree (see PdmsLexer::KeywordToken) is compared to the
+	former dictionary (a std::map of all the keywords abbreviations, queried
+	with a temporary std::string):
+	1- both must give the same token for every abbreviation and for a large
+	set of non-keywords
+	2- a list of random tokens (5 millions by default) is classified with both
+	3- the same tokens are written in a synthetic macro, which is then
+	tokenized by a PdmsBufferedFileSession (each token is checked).
+	Returns 0 if the tree always gives the same tokens as the dictionary.
+	Build: PdmsKeywordBenchmark.vcxproj (or, with gcc:
+	g++ -O2 -I.. -I../../../../IGIT/include -I$QTDIR/include -I$QTDIR/include/QtCore
+	../PdmsTools.cpp ../PdmsParser.cpp PdmsKeywordBenchmark.cpp -lQtCore)
+**/
+
+#include "PdmsParser.h"
+
+//Qt
+#include <QElapsedTimer>
+
+//system
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+//! Former keywords dictionary (all the abbreviations of all the keywords)
+typedef std::map<std::string, Token> KeywordsDictionary;
+
+//! Adds a keyword and its abbreviations to the dictionary (former PdmsLexer::pushIntoDictionnary)
+static void PushIntoDictionary(KeywordsDictionary& dictionary, const char* str, Token token, int minSize)
+{
+	int n = (int)strlen(str);
+	if (minSize == 0 || minSize > n)
+		minSize = n;
+	for (; minSize<=n; minSize++)
+		dictionary[std::string(str).substr(0, minSize)] = token;
+}
+
+//! Builds the former dictionary (same keywords, in the same order)
+static void BuildDictionary(KeywordsDictionary& dictionary)
+{
+	PushIntoDictionary(dictionary, "NEW",          PDMS_CREATE,            3);
+	PushIntoDictionary(dictionary, "AND",          PDMS_AND,               3);
+	PushIntoDictionary(dictionary, "IS",           PDMS_IS,                2);
+	PushIntoDictionary(dictionary, "WRT",          PDMS_WRT,               3);
+	PushIntoDictionary(dictionary, "LAST",         PDMS_LAST,              4);
+	PushIntoDictionary(dictionary, "GROUP",        PDMS_GROUP,             2);
+	PushIntoDictionary(dictionary, "WORLD",        PDMS_WORLD,             4);
+	PushIntoDictionary(dictionary, "SITE",         PDMS_SITE,              3);
+	PushIntoDictionary(dictionary, "ZONE",         PDMS_ZONE,              3);
+	PushIntoDictionary(dictionary, "EQUIPMENT",    PDMS_EQUIPMENT,         3);
+	PushIntoDictionary(dictionary, "STRUCTURE",    PDMS_STRUCTURE,         3);
+	PushIntoDictionary(dictionary, "SUBSTRUCTURE", PDMS_SUBSTRUCTURE,      4);
+	PushIntoDictionary(dictionary, "END",          PDMS_END,               3);
+	PushIntoDictionary(dictionary, "NAME",         PDMS_NAME,              4);
+	PushIntoDictionary(dictionary, "SLCYLINDER",   PDMS_SCYLINDER,         3);
+	PushIntoDictionary(dictionary, "CYLINDER",     PDMS_SCYLINDER,         3);
+	PushIntoDictionary(dictionary, "CTORUS",       PDMS_CTORUS,            4);
+	PushIntoDictionary(dictionary, "RTORUS",       PDMS_RTORUS,            4);
+	PushIntoDictionary(dictionary, "DISH",         PDMS_DISH,              3);
+	PushIntoDictionary(dictionary, "CONE",         PDMS_CONE,              3);
+	PushIntoDictionary(dictionary, "BOX",          PDMS_BOX,               3);
+	PushIntoDictionary(dictionary, "NBOX",         PDMS_NBOX,              4);
+	PushIntoDictionary(dictionary, "PYRAMID",      PDMS_PYRAMID,           4);
+	PushIntoDictionary(dictionary, "SNOUT",        PDMS_SNOUT,             4);
+	PushIntoDictionary(dictionary, "EXTRUSION",    PDMS_EXTRU,             5);
+	PushIntoDictionary(dictionary, "NXTRUSION",    PDMS_NEXTRU,            5);
+	PushIntoDictionary(dictionary, "LOOP",         PDMS_LOOP,              4);
+	PushIntoDictionary(dictionary, "VERTEX",       PDMS_VERTEX,            4);
+	PushIntoDictionary(dictionary, "EST",          PDMS_EST,               1);
+	PushIntoDictionary(dictionary, "NORTH",        PDMS_NORTH,             1);
+	PushIntoDictionary(dictionary, "UP",           PDMS_UP,                1);
+	PushIntoDictionary(dictionary, "WEST",         PDMS_WEST,              1);
+	PushIntoDictionary(dictionary, "SOUTH",        PDMS_SOUTH,             1);
+	PushIntoDictionary(dictionary, "DOWN",         PDMS_DOWN,              1);
+	PushIntoDictionary(dictionary, "X",            PDMS_X,                 1);
+	PushIntoDictionary(dictionary, "Y",            PDMS_Y,                 1);
+	PushIntoDictionary(dictionary, "Z",            PDMS_Z,                 1);
+	PushIntoDictionary(dictionary, "DIAMETER",     PDMS_DIAMETER,          3);
+	PushIntoDictionary(dictionary, "RADIUS",       PDMS_RADIUS,            3);
+	PushIntoDictionary(dictionary, "HEIGHT",       PDMS_HEIGHT,            3);
+	PushIntoDictionary(dictionary, "XTSHEAR",      PDMS_X_TOP_SHEAR,       4);
+	PushIntoDictionary(dictionary, "XBSHEAR",      PDMS_X_BOTTOM_SHEAR,    4);
+	PushIntoDictionary(dictionary, "YTSHEAR",      PDMS_Y_TOP_SHEAR,       4);
+	PushIntoDictionary(dictionary, "YBSHEAR",      PDMS_Y_BOTTOM_SHEAR,    4);
+	PushIntoDictionary(dictionary, "XBOTTOM",      PDMS_X_BOTTOM,          4);
+	PushIntoDictionary(dictionary, "YBOTTOM",      PDMS_Y_BOTTOM,          4);
+	PushIntoDictionary(dictionary, "XTOP",         PDMS_X_TOP,             4);
+	PushIntoDictionary(dictionary, "YTOP",         PDMS_Y_TOP,             4);
+	PushIntoDictionary(dictionary, "XOFF",         PDMS_X_OFF,             4);
+	PushIntoDictionary(dictionary, "YOFF",         PDMS_Y_OFF,             4);
+	PushIntoDictionary(dictionary, "RINSIDE",      PDMS_INSIDE_RADIUS,     4);
+	PushIntoDictionary(dictionary, "ROUTSIDE",     PDMS_OUTSIDE_RADIUS,    4);
+	PushIntoDictionary(dictionary, "XLENGTH",      PDMS_XLENGTH,           4);
+	PushIntoDictionary(dictionary, "YLENGTH",      PDMS_YLENGTH,           4);
+	PushIntoDictionary(dictionary, "ZLENGTH",      PDMS_ZLENGTH,           4);
+	PushIntoDictionary(dictionary, "ANGLE",        PDMS_ANGLE,             4);
+	PushIntoDictionary(dictionary, "DTOP",         PDMS_TOP_DIAMETER,      4);
+	PushIntoDictionary(dictionary, "DBOTTOM",      PDMS_BOTTOM_DIAMETER,   5);
+	PushIntoDictionary(dictionary, "AT",           PDMS_POSITION,          2);
+	PushIntoDictionary(dictionary, "POSITION",     PDMS_POSITION,          3);
+	PushIntoDictionary(dictionary, "ORIENTED",     PDMS_ORIENTATION,       3);
+	PushIntoDictionary(dictionary, "METRE",        PDMS_METRE,             1);
+	PushIntoDictionary(dictionary, "MILLIMETRE",   PDMS_MILLIMETRE,        3);
+	PushIntoDictionary(dictionary, "MM",           PDMS_MILLIMETRE,        2);
+	PushIntoDictionary(dictionary, "OWNER",        PDMS_OWNER,             3);
+	PushIntoDictionary(dictionary, "RETURN",       PDMS_RETURN,            6);
+}
+
+//! Former classification (temporary string + dictionary look-up)
+static Token DictionaryToken(const KeywordsDictionary& dictionary, const char* str)
+{
+	KeywordsDictionary::const_iterator location = dictionary.find(std::string(str));
+	return (location != dictionary.end() ? location->second : PDMS_UNKNOWN);
+}
+
+//! Deterministic pseudo-random generator (so that the synthetic tokens never change)
+static unsigned NextRandom(unsigned& seed, unsigned maxValue)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xffffff) % (maxValue+1);
+}
+
+//! Checks that the tree gives the same token as the dictionary
+static bool CheckToken(const KeywordsDictionary& dictionary, const std::string& str)
+{
+	Token expected = DictionaryToken(dictionary, str.c_str());
+	Token token = PdmsLexer::KeywordToken(str.c_str());
+	if (token != expected)
+	{
+		printf("'%s': token %i (%i expected)\n", str.c_str(), static_cast<int>(token), static_cast<int>(expected));
+		return false;
+	}
+	return true;
+}
+
+//! Checks all the abbreviations, their one-letter extensions and all the 1 to 3 letters words
+static bool CheckAllKeywords(const KeywordsDictionary& dictionary)
+{
+	bool success = true;
+	unsigned count = 0;
+
+	for (KeywordsDictionary::const_iterator it = dictionary.begin(); it != dictionary.end(); ++it)
+	{
+		success &= CheckToken(dictionary, it->first);
+		for (char c='A'; c<='Z'; ++c)
+			success &= CheckToken(dictionary, it->first + c);
+		count += 27;
+	}
+
+	char word[4] = {0, 0, 0, 0};
+	for (int length=1; length<=3; ++length)
+	{
+		unsigned combinations = 1;
+		for (int i=0; i<length; ++i)
+			combinations *= 26;
+		for (unsigned n=0; n<combinations; ++n)
+		{
+			unsigned m = n;
+			for (int i=0; i<length; ++i, m/=26)
+				word[i] = static_cast<char>('A' + m%26);
+			word[length] = '\0';
+			success &= CheckToken(dictionary, word);
+			++count;
+		}
+	}
+
+	//non-alphabetical characters
+	success &= CheckToken(dictionary, "NEW_");
+	success &= CheckToken(dictionary, "X1");
+	success &= CheckToken(dictionary, "(ANY");
+	success &= CheckToken(dictionary, "");
+	count += 4;
+
+	printf("[check] %u strings tested: %s\n", count, success ? "OK" : "FAILED");
+	return success;
+}
+
+//! Generates random tokens (keywords abbreviations, lower case keywords, names, values and unknown words)
+static void GenerateTokens(const KeywordsDictionary& dictionary, unsigned count, std::vector<std::string>& tokens)
+{
+	std::vector<std::string> keywords;
+	for (KeywordsDictionary::const_iterator it = dictionary.begin(); it != dictionary.end(); ++it)
+		keywords.push_back(it->first);
+
+	unsigned seed = 1;
+	tokens.resize(count);
+	char buffer[64];
+	for (unsigned i=0; i<count; ++i)
+	{
+		unsigned type = NextRandom(seed, 9);
+		if (type < 6)
+		{
+			tokens[i] = keywords[NextRandom(seed, static_cast<unsigned>(keywords.size())-1)];
+		}
+		else if (type == 6)
+		{
+			sprintf(buffer, "/NAME%u", NextRandom(seed, 100000));
+			tokens[i] = buffer;
+		}
+		else if (type == 7)
+		{
+			sprintf(buffer, "%u.%u", NextRandom(seed, 10000), NextRandom(seed, 99));
+			tokens[i] = buffer;
+		}
+		else
+		{
+			//unknown word (often starting like a keyword)
+			unsigned length = 1 + NextRandom(seed, 9);
+			for (unsigned j=0; j<length; ++j)
+				buffer[j] = static_cast<char>('A' + NextRandom(seed, 25));
+			buffer[length] = '\0';
+			//the lexer skips HANDLE commands
+			if (strncmp(buffer, "HANDLE", 6) == 0 || strcmp(buffer, "ENDHANDLE") == 0)
+				buffer[0] = 'Q';
+			tokens[i] = buffer;
+		}
+	}
+}
+
+//! Expected lexer token (see PdmsLexer::parseCurrentToken)
+static Token ExpectedToken(const KeywordsDictionary& dictionary, const std::string& str)
+{
+	if (str[0] == '/')
+		return PDMS_NAME_STR;
+	if (str[0] == '-' || ('0' <= str[0] && str[0] <= '9'))
+		return PDMS_NUM_VALUE;
+	return DictionaryToken(dictionary, str.c_str());
+}
+
+//! Times the classification of the tokens with the dictionary and with the tree
+static bool BenchmarkClassification(const KeywordsDictionary& dictionary, const std::vector<std::string>& tokens)
+{
+	std::vector<Token> dictionaryTokens(tokens.size()), treeTokens(tokens.size());
+
+	QElapsedTimer timer;
+	timer.start();
+	for (size_t i=0; i<tokens.size(); ++i)
+		dictionaryTokens[i] = DictionaryToken(dictionary, tokens[i].c_str());
+	double dictionaryTime = timer.nsecsElapsed() / 1.0e9;
+
+	timer.start();
+	for (size_t i=0; i<tokens.size(); ++i)
+		treeTokens[i] = PdmsLexer::KeywordToken(tokens[i].c_str());
+	double treeTime = timer.nsecsElapsed() / 1.0e9;
+
+	bool success = (dictionaryTokens == treeTokens);
+	printf("[classification] %u tokens: dictionary %.3f s, tree %.3f s (x%.1f): %s\n",
+		static_cast<unsigned>(tokens.size()), dictionaryTime, treeTime, treeTime > 0 ? dictionaryTime / treeTime : 0.0, success ? "OK" : "FAILED");
+	return success;
+}
+
+//! Writes the tokens in a macro and tokenizes it
+static bool BenchmarkTokenization(const KeywordsDictionary& dictionary, const std::vector<std::string>& tokens, const std::string& filename)
+{
+	FILE* fp = fopen(filename.c_str(), "wt");
+	if (!fp)
+	{
+		printf("Failed to generate '%s'\n", filename.c_str());
+		return false;
+	}
+	for (size_t i=0; i<tokens.size(); ++i)
+	{
+		//one out of two keywords is written in lower case (the lexer converts it)
+		std::string str = tokens[i];
+		if (i % 2 && str[0] != '/')
+			for (size_t j=0; j<str.size(); ++j)
+				str[j] = static_cast<char>(tolower(str[j]));
+		fprintf(fp, (i % 8) == 7 ? "%s\n" : "%s ", str.c_str());
+	}
+	fclose(fp);
+
+	QElapsedTimer timer;
+	timer.start();
+	PdmsBufferedFileSession session(filename);
+	bool success = session.initializeSession();
+	size_t count = 0;
+	while (success && session.gotoNextToken())
+	{
+		Token token = session.getCurrentToken();
+		if (count >= tokens.size() || token != ExpectedToken(dictionary, tokens[count]))
+		{
+			printf("token #%u: %i (expected '%s')\n", static_cast<unsigned>(count), static_cast<int>(token), count < tokens.size() ? tokens[count].c_str() : "");
+			success = false;
+		}
+		++count;
+	}
+	session.closeSession();
+	double time = timer.nsecsElapsed() / 1.0e9;
+	success &= (count == tokens.size());
+
+	printf("[tokenization] %u tokens: %.3f s: %s\n", static_cast<unsigned>(count), time, success ? "OK" : "FAILED");
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned tokenCount = 5000000;
+	if (argc > 1 && atoi(argv[1]) > 0)
+		tokenCount = static_cast<unsigned>(atoi(argv[1])) * 1000000;
+
+	KeywordsDictionary dictionary;
+	BuildDictionary(dictionary);
+
+	bool success = CheckAllKeywords(dictionary);
+
+	std::vector<std::string> tokens;
+	GenerateTokens(dictionary, tokenCount, tokens);
+	success &= BenchmarkClassification(dictionary, tokens);
+
+	std::string filename("PdmsKeywordBenchmark.mac");
+	success &= BenchmarkTokenization(dictionary, tokens, filename);
+	remove(filename.c_str());
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//! Regression benchmark of the PDMS name references resolution
+/** Usage: PdmsNameReferenceBenchmark [reference count in thousands]
+	Generates a macro with 100k named elements (by default), each of them
+	being positioned (and one out of two oriented) 'WRT /NAME' of a random
+	previous element. The macro is parsed (name references are resolved
+	through the names index, see PdmsObjects::NameIndex) and each resolved
+	reference is compared to the item that a scan of the whole hierarchy
+	would return (GroupElement::scan, i.e. the former resolution). The cost
+	of the former resolution is extrapolated from a sample of references.
+	Returns 0 if all references are resolved as with a scan.
+	Build: PdmsNameReferenceBenchmark.vcxproj (or, with gcc:
+	g++ -O2 -I.. -I../../../../IGIT/include -I$QTDIR/include -I$QTDIR/include/QtCore
+	../PdmsTools.cpp ../PdmsParser.cpp PdmsNameReferenceBenchmark.cpp -lQtCore)
+**/
+
+#include "PdmsParser.h"
+
+//Qt
+#include <QElapsedTimer>
+
+//system
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace PdmsTools::PdmsObjects;
+
+//! Number of elements per zone
+static const unsigned c_elements_per_zone = 1000;
+//! Number of references used to extrapolate the cost of the former resolution
+static const unsigned c_scan_sample_size = 1000;
+
+//! Deterministic pseudo-random generator (so that the synthetic macro never changes)
+static unsigned NextRandom(unsigned& seed, unsigned maxValue)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xffffff) % (maxValue+1);
+}
+
+//! Generated reference
+struct NameReference
+{
+	//! Element name (without the leading '/', as stored by the parser)
+	std::string element;
+	//! Referenced item name (same)
+	std::string target;
+	//! Whether the orientation refers to the item as well
+	bool oriented;
+};
+
+//! Generates the macro (and returns the references it contains)
+static bool GenerateMacro(const std::string& filename, unsigned elementCount, std::vector<NameReference>& references)
+{
+	FILE* fp = fopen(filename.c_str(), "wt");
+	if (!fp)
+		return false;
+
+	references.resize(elementCount);
+	unsigned seed = 1;
+	char name[64];
+
+	fprintf(fp, "NEW WORLD /W\nNEW SITE /S\n");
+	for (unsigned i=0; i<elementCount; ++i)
+	{
+		if (i % c_elements_per_zone == 0)
+		{
+			if (i != 0)
+				fprintf(fp, "END\n");
+			fprintf(fp, "NEW ZONE /Z%u\n", i / c_elements_per_zone);
+		}
+
+		NameReference& ref = references[i];
+		sprintf(name, "B%u", i);
+		ref.element = name;
+		if (i == 0)
+		{
+			ref.target = "S";
+		}
+		else
+		{
+			sprintf(name, "B%u", NextRandom(seed, i-1));
+			ref.target = name;
+		}
+		ref.oriented = (i % 2 == 1);
+
+		fprintf(fp, "NEW BOX /%s XLEN 1 YLEN 2 ZLEN 3\n POS E %u N 2 U 3 WRT /%s\n", ref.element.c_str(), i % 100, ref.target.c_str());
+		if (ref.oriented)
+			fprintf(fp, " ORI X is N 1 WRT /%s\n", ref.target.c_str());
+		fprintf(fp, "END\n");
+	}
+	fprintf(fp, "END\nEND\nEND\n");
+
+	fclose(fp);
+	return true;
+}
+
+//! Indexes the hierarchy items by name, in the same order as GroupElement::scan (first match wins)
+static void IndexItems(GenericItem* item, std::map<std::string, GenericItem*>& items)
+{
+	items.insert(std::make_pair(std::string(item->name), item));
+	if (!item->isGroupElement())
+		return;
+
+	GroupElement* group = static_cast<GroupElement*>(item);
+	for (size_t i=0; i<group->elements.size(); ++i)
+		IndexItems(group->elements[i], items);
+	for (size_t i=0; i<group->subhierarchy.size(); ++i)
+		IndexItems(group->subhierarchy[i], items);
+}
+
+//! Checks the resolved references
+static bool CheckReferences(GenericItem* root, const std::vector<NameReference>& references)
+{
+	std::map<std::string, GenericItem*> items;
+	IndexItems(root, items);
+
+	unsigned errors = 0;
+	for (size_t i=0; i<references.size(); ++i)
+	{
+		const NameReference& ref = references[i];
+		std::map<std::string, GenericItem*>::const_iterator element = items.find(ref.element);
+		std::map<std::string, GenericItem*>::const_iterator target = items.find(ref.target);
+		if (element == items.end() || target == items.end())
+		{
+			++errors;
+			continue;
+		}
+		if (element->second->positionReference != target->second)
+			++errors;
+		if (ref.oriented && element->second->orientationReferences[0] != target->second)
+			++errors;
+	}
+
+	printf("[check] %u references: %s\n", static_cast<unsigned>(references.size()), errors == 0 ? "OK" : "FAILED");
+	if (errors)
+		printf("\t%u wrong references\n", errors);
+	return errors == 0;
+}
+
+//! Times the former resolution (scan of the whole hierarchy) on a sample of references
+static void TimeScans(GenericItem* root, const std::vector<NameReference>& references)
+{
+	size_t step = std::max<size_t>(1, references.size() / c_scan_sample_size);
+	unsigned count = 0;
+
+	QElapsedTimer timer;
+	timer.start();
+	for (size_t i=0; i<references.size(); i+=step, ++count)
+		root->scan(references[i].target.c_str());
+	double time = timer.nsecsElapsed() / 1.0e9;
+
+	printf("[former resolution] %u scans: %.3f s (~%.1f s for all the references)\n", count, time, count ? time * references.size() / count : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned elementCount = 100000;
+	if (argc > 1 && atoi(argv[1]) > 0)
+		elementCount = static_cast<unsigned>(atoi(argv[1])) * 1000;
+
+	std::string filename("PdmsNameReferenceBenchmark.mac");
+	std::vector<NameReference> references;
+	if (!GenerateMacro(filename, elementCount, references))
+	{
+		printf("Failed to generate '%s'\n", filename.c_str());
+		return 1;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	PdmsBufferedFileSession session(filename);
+	PdmsParser parser;
+	parser.linkWithSession(&session);
+	bool success = parser.parseSessionContent();
+	double time = timer.nsecsElapsed() / 1.0e9;
+	remove(filename.c_str());
+
+	GenericItem* root = (success ? parser.getLoadedObject(false) : NULL);
+	if (!root)
+	{
+		printf("Failed to parse the macro\n");
+		return 1;
+	}
+	root = root->getRoot();
+	printf("[parsing] %u elements: %.3f s\n", elementCount, time);
+
+	success = CheckReferences(root, references);
+	TimeScans(root, references);
+
+	return success ? 0 : 1;
+}
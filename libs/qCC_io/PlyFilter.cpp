@@ -72,6 +72,11 @@ void PlyFilter::SetDefaultOutputFormat(e_ply_storage_mode format)
 	s_defaultOutputFormat = format;
 }
 
+e_ply_storage_mode PlyFilter::GetDefaultOutputFormat()
+{
+	return s_defaultOutputFormat;
+}
+
 CC_FILE_ERROR PlyFilter::saveToFile(ccHObject* entity, QString filename, SaveParameters& parameters)
 {
 	e_ply_storage_mode outputFormat = s_defaultOutputFormat;
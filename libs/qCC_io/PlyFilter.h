@@ -65,6 +65,7 @@ public:
 	static inline QString GetFileFilter() { return "PLY mesh (*.ply)"; }
 	static inline QString GetDefaultExtension() { return "ply"; }
 	static void SetDefaultOutputFormat(e_ply_storage_mode format);
+	static e_ply_storage_mode GetDefaultOutputFormat();
 
 	//inherited from FileIOFilter
 	virtual bool importSupported() const { return true; }
@@ -25,18 +25,25 @@
 #include <qlocale.h>
 #include<qtimer.h>
 #include<qdatetime.h>
+#include <QSettings>
+
+//CCLib
+#include <DgmOctree.h>
 
 //qCC_db
 #include <ccTimer.h>
 #include <ccNormalVectors.h>
 #include <ccColorScalesManager.h>
+#include <ccPointCloud.h>
 
 
 //qCC_io
 #include <FileIOFilter.h>
+#include <PDMS/PDMSFilter.h>
 
 #include "mainwindow.h"
 #include "ccCommandLineParser.h"
+#include "ccPersistentSettings.h"
 
 
 
@@ -90,6 +97,38 @@ int main(int argc, char *argv[]){
 	ccNormalVectors::GetUniqueInstance(); //force pre-computed normals array initialization
 	ccColorScalesManager::GetUniqueInstance(); //force pre-computed color tables initialization
 
+	//max. number of threads of the octree-based processes (see 'Tools > Max. number of threads')
+	{
+		QSettings settings;
+		CCLib::DgmOctree::SetMaxThreadCount(settings.value(ccPS::MaxThreadCount(),0).toInt());
+	}
+
+	//compact octrees (see 'Tools > Compact octrees')
+	{
+		QSettings settings;
+		CCLib::DgmOctree::SetCompactStorageByDefault(settings.value(ccPS::CompactOctrees(),false).toBool());
+	}
+
+	//octrees saved in BIN files (see 'Tools > Save octrees in BIN files')
+	{
+		QSettings settings;
+		ccPointCloud::SetOctreeSaving(settings.value(ccPS::SaveOctrees(),false).toBool());
+	}
+
+#ifdef CC_PDMS_SUPPORT
+	//instancing of identical PDMS primitives (see 'Tools > PDMS: share identical primitives')
+	{
+		QSettings settings;
+		PDMSFilter::SetInstancing(settings.value(ccPS::PdmsInstancing(),false).toBool());
+	}
+
+	//merging of the PDMS groups primitives (see 'Tools > PDMS: merge the primitives of each group')
+	{
+		QSettings settings;
+		PDMSFilter::SetGroupMerging(settings.value(ccPS::PdmsGroupMerging(),false).toBool());
+	}
+#endif
+
 	int result = 0;
 	if (commandLine){
 		//command line processing (no GUI)
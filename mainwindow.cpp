@@ -8,10 +8,16 @@
 
 //qCC io
 #include "BinFilter.h"
+#include <PDMS/PDMSFilter.h>
 
 //qCC_db
 #include <ccGenericPointCloud.h>
+#include <ccPointCloud.h>
+#include <ccOctree.h>
 #include <ccCameraSensor.h>
+#include <ccGenericPrimitive.h>
+#include <ccMesh.h>
+#include <ccProgressDialog.h>
 
 //db_tree
 #include<ccDBRoot.h>
@@ -36,6 +42,7 @@
 #include <QInputDialog>
 #include <QTextStream>
 #include <QColorDialog>
+#include <QThread>
 
 
 //System
@@ -44,6 +51,7 @@
 #include <assert.h>
 #include <cfloat>
 #include <iostream>
+#include <set>
 
 
 //==========================global variables===================================//
@@ -133,8 +141,33 @@ MainWindow::MainWindow()
 
 	}
 
+	//lazy tessellation of primitives (enabled by default, see 'Tools > Lazy tessellation of primitives')
+	{
+		bool lazyTessellation = settings.value(ccPS::LazyTessellation(),true).toBool();
+		ccGenericPrimitive::SetLazyTessellation(lazyTessellation);
+		actionLazyTessellation->setChecked(lazyTessellation);
+	}
+
+	//compact octrees (the setting is applied at startup, see main.cpp)
+	actionCompactOctrees->setChecked(CCLib::DgmOctree::CompactStorageByDefault());
+	//octrees saved in BIN files (idem)
+	actionSaveOctrees->setChecked(ccPointCloud::OctreeSavingEnabled());
+#ifdef CC_PDMS_SUPPORT
+	//instancing of identical PDMS primitives (idem)
+	actionPdmsInstancing->setChecked(PDMSFilter::IsInstancingEnabled());
+	//merging of the PDMS groups primitives (idem)
+	actionPdmsGroupMerging->setChecked(PDMSFilter::IsGroupMergingEnabled());
+#else
+	actionPdmsInstancing->setEnabled(false);
+	actionPdmsGroupMerging->setEnabled(false);
+#endif
+
 	connectActions();
 
+	// background tessellation of primitives (see addToDB)
+	m_backgroundTessellationTimer.setInterval(500);
+	connect(&m_backgroundTessellationTimer, SIGNAL(timeout()), this, SLOT(refreshAfterBackgroundTessellation()));
+
 	// create new 3D view
 	new3DView();
 
@@ -170,6 +203,14 @@ void MainWindow::connectActions(){
 	connect(actionCreateCameraSensor,			SIGNAL(triggered()),	this,		SLOT(doActionCreateCameraSensor()));
 	connect(actionCreateCameraSensorFromFile,   SIGNAL(triggered()),    this,       SLOT(doActionCreateCameraSensorFromFile()));
 	connect(actionTextureGeneration,         SIGNAL(triggered()),    this,       SLOT(doActionTextureGeneration()));
+	connect(actionReorderInOctreeOrder,      SIGNAL(triggered()),    this,       SLOT(doActionReorderInOctreeOrder()));
+	connect(actionOctreeSearchStatistics,    SIGNAL(toggled(bool)),  this,       SLOT(doActionToggleOctreeSearchStatistics(bool)));
+	connect(actionMaxThreadCount,            SIGNAL(triggered()),    this,       SLOT(doActionSetMaxThreadCount()));
+	connect(actionLazyTessellation,          SIGNAL(toggled(bool)),  this,       SLOT(doActionToggleLazyTessellation(bool)));
+	connect(actionCompactOctrees,            SIGNAL(toggled(bool)),  this,       SLOT(doActionToggleCompactOctrees(bool)));
+	connect(actionSaveOctrees,               SIGNAL(toggled(bool)),  this,       SLOT(doActionToggleSaveOctrees(bool)));
+	connect(actionPdmsInstancing,            SIGNAL(toggled(bool)),  this,       SLOT(doActionTogglePdmsInstancing(bool)));
+	connect(actionPdmsGroupMerging,          SIGNAL(toggled(bool)),  this,       SLOT(doActionTogglePdmsGroupMerging(bool)));
 	
 
 	//"Display"  menu
@@ -361,6 +402,7 @@ void MainWindow::enableUIItems(dbTreeSelectionInfo& selInfo){
 	bool exactlyOneCameraSensor = (selInfo.cameraSensorCount == 1);
 	actionCreateCameraSensor->setEnabled(atLeastOneCloud);
 	actionCheckPointsInsideFrustrum->setEnabled(exactlyOneCameraSensor);
+	actionReorderInOctreeOrder->setEnabled(atLeastOneCloud);
 }
 
 //===================================ApplyCCLibAlgorthim===============================//
@@ -404,6 +446,57 @@ void MainWindow::addToDB(const QStringList& filenames,
 	
 }
 
+//! Returns whether an entity (or one of its children) shares geometry with mesh instances
+static bool HasSharedGeometry(ccHObject* obj, const std::set<ccHObject*>& prototypes)
+{
+	if (prototypes.find(obj) != prototypes.end())
+		return true;
+	if (obj->isA(CC_TYPES::MESH) && static_cast<ccMesh*>(obj)->getPrototype())
+		return true;
+
+	for (unsigned i=0; i<obj->getChildrenNumber(); ++i)
+		if (HasSharedGeometry(obj->getChild(i),prototypes))
+			return true;
+
+	return false;
+}
+
+//! Applies a transformation to an entity and its children (same as ccHObject::applyGLTransformation_recursive)
+/** Mesh instances (see ccMesh::createInstance) share the geometry of their
+	prototype: the transformation is only composed with their own (display)
+	transformation, and the prototypes geometry (expressed in the instances
+	local frame) is left untouched.
+**/
+static void ApplyTransformation_recursive(ccHObject* obj, const ccGLMatrix& mat, const std::set<ccHObject*>& prototypes)
+{
+	//prototypes stay in the local frame of their instances
+	if (prototypes.find(obj) != prototypes.end())
+		return;
+
+	ccGLMatrix trans = mat;
+	if (obj->isGLTransEnabled())
+		trans = mat * obj->getGLTransformation();
+
+	//instances: only their display transformation is updated
+	if (obj->isA(CC_TYPES::MESH) && static_cast<ccMesh*>(obj)->getPrototype()){
+		obj->setGLTransformation(trans);
+		return;
+	}
+
+	//no shared geometry: standard way
+	if (!HasSharedGeometry(obj,prototypes)){
+		obj->applyGLTransformation_recursive(&trans);
+		return;
+	}
+
+	//containers of instances and prototypes (i.e. groups) only pass the transformation on
+	for (unsigned i=0; i<obj->getChildrenNumber(); ++i)
+		ApplyTransformation_recursive(obj->getChild(i),trans,prototypes);
+
+	if (obj->isGLTransEnabled())
+		obj->resetGLTransformation();
+}
+
 //==================================addToDB===========================================//
 void MainWindow::addToDB(ccHObject* obj, bool updateZoom, 
 	                                     bool autoExpandDBTree, 
@@ -433,7 +526,21 @@ void MainWindow::addToDB(ccHObject* obj, bool updateZoom,
 				mat.toIdentity();
 				mat.data()[0] = mat.data()[5] = mat.data()[10] = static_cast<float>(scale);
 				mat.setTranslation(Pshift);
-				obj->applyGLTransformation_recursive(&mat);
+
+				//mesh instances share the geometry of their prototype: it mustn't be transformed
+				std::set<ccHObject*> prototypes;
+				ccHObject::Container meshes;
+				obj->filterChildren(meshes,true,CC_TYPES::MESH);
+				meshes.push_back(obj);
+				for (size_t i=0; i<meshes.size(); ++i){
+					if (meshes[i]->isA(CC_TYPES::MESH) && static_cast<ccMesh*>(meshes[i])->getPrototype())
+						prototypes.insert(static_cast<ccMesh*>(meshes[i])->getPrototype());
+				}
+
+				if (prototypes.empty())
+					obj->applyGLTransformation_recursive(&mat);
+				else
+					ApplyTransformation_recursive(obj,mat,prototypes);
 				//ccConsole::Warning(QString("Entity '%1' has been translated: (%2,%3,%4) and rescaled of a factor %5 [original position will be restored when saving]").arg(obj->getName()).arg(Pshift.x,0,'f',2).arg(Pshift.y,0,'f',2).arg(Pshift.z,0,'f',2).arg(scale,0,'f',6));
 			    ccConsole::Warning(QString(" '%1' ƽ: (%2,%3,%4) ţ %5 [洢ʱָԭʼ]").arg(obj->getName()).arg(Pshift.x,0,'f',2).arg(Pshift.y,0,'f',2).arg(Pshift.z,0,'f',2).arg(scale,0,'f',6));
 			}
@@ -483,6 +590,37 @@ void MainWindow::addToDB(ccHObject* obj, bool updateZoom,
 
 	//eventually we update the corresponding display
 	assert(obj->getDisplay());
+
+	//lazily tessellated primitives are built in the background (nearest first)
+	if (ccGenericPrimitive::LazyTessellationEnabled()){
+		ccHObject::Container primitives;
+		obj->filterChildren(primitives,true,CC_TYPES::PRIMITIVE);
+		if (obj->isKindOf(CC_TYPES::PRIMITIVE))
+			primitives.push_back(obj);
+
+		std::vector<ccGenericPrimitive*> toTessellate;
+		for (size_t i=0; i<primitives.size(); ++i){
+			ccGenericPrimitive* prim = static_cast<ccGenericPrimitive*>(primitives[i]);
+			if (!prim->isTessellated())
+				toTessellate.push_back(prim);
+		}
+
+		if (!toTessellate.empty()){
+			CCVector3 viewCenter;
+			if (updateZoom){
+				viewCenter = obj->getBB_recursive().getCenter();
+			}
+			else{
+				const CCVector3d& pivot = static_cast<ccGLWindow*>(obj->getDisplay())->getViewportParameters().pivotPoint;
+				viewCenter = CCVector3(	static_cast<PointCoordinateType>(pivot.x),
+										static_cast<PointCoordinateType>(pivot.y),
+										static_cast<PointCoordinateType>(pivot.z));
+			}
+			ccGenericPrimitive::StartBackgroundTessellation(toTessellate,viewCenter);
+			m_backgroundTessellationTimer.start();
+		}
+	}
+
 	if (updateZoom){
 		static_cast<ccGLWindow*>(obj->getDisplay())->zoomGlobal(); //automatically calls ccGLWindow::redraw
 	}
@@ -493,6 +631,19 @@ void MainWindow::addToDB(ccHObject* obj, bool updateZoom,
 
 }
 
+//=========================refreshAfterBackgroundTessellation=========================//
+void MainWindow::refreshAfterBackgroundTessellation(){
+	//last refresh once all primitives are ready
+	if (!ccGenericPrimitive::IsBackgroundTessellationRunning())
+		m_backgroundTessellationTimer.stop();
+
+	//the tessellated primitives don't flag the displays for refresh (they are built by another thread)
+	QList<QMdiSubWindow*> windows = m_mdiArea->subWindowList();
+	for(int i=0; i<windows.size(); i++){
+		static_cast<ccGLWindow*>(windows.at(i)->widget())->redraw();
+	}
+}
+
 
 //=================================loadTexturedResults================================//
 void MainWindow::loadTexturedResults(QString ResultsDir){
@@ -963,6 +1114,145 @@ void MainWindow:: doActionTextureGeneration(){
 	loadPMVSCameras("./TempData.nvm.cmvs/00/txt");
 }
 
+//====================================doActionReorderInOctreeOrder==================//
+void MainWindow::doActionReorderInOctreeOrder(){
+
+	ccProgressDialog pDlg(false,this);
+
+	ccHObject::Container selectedEntities = m_selectedEntities;
+	for (size_t i=0; i<selectedEntities.size(); ++i){
+		ccHObject* ent = selectedEntities[i];
+		if (!ent->isA(CC_TYPES::POINT_CLOUD))
+			continue;
+
+		ccPointCloud* cloud = static_cast<ccPointCloud*>(ent);
+		if (cloud->reorderInOctreeOrder(&pDlg)){
+			ccConsole::Print(QString("[Reorder] Cloud '%1': %2 points reordered in octree order").arg(cloud->getName()).arg(cloud->size()));
+			cloud->prepareDisplayForRefresh();
+		}
+		//otherwise an error message has already been issued
+	}
+
+	refreshAll();
+	updateUI();
+}
+
+//====================================doActionToggleOctreeSearchStatistics==========//
+void MainWindow::doActionToggleOctreeSearchStatistics(bool state){
+
+	ccOctree::EnableSearchStatisticsLog(state);
+
+	if (state)
+		ccConsole::Print("[Octree] Search statistics enabled: they will be displayed at the end of each octree-based process");
+	else
+		ccConsole::Print("[Octree] Search statistics disabled");
+}
+
+//====================================doActionToggleLazyTessellation================//
+void MainWindow::doActionToggleLazyTessellation(bool state){
+
+	//only applies to the primitives created (or modified) afterwards
+	ccGenericPrimitive::SetLazyTessellation(state);
+
+	QSettings settings;
+	settings.setValue(ccPS::LazyTessellation(),state);
+
+	if (state)
+		ccConsole::Print("[Primitives] Lazy tessellation enabled: new primitives will be tessellated in the background (or when needed)");
+	else
+		ccConsole::Print("[Primitives] Lazy tessellation disabled");
+}
+
+//====================================doActionToggleCompactOctrees==================//
+void MainWindow::doActionToggleCompactOctrees(bool state){
+
+	//only applies to the octrees computed afterwards
+	CCLib::DgmOctree::SetCompactStorageByDefault(state);
+
+	QSettings settings;
+	settings.setValue(ccPS::CompactOctrees(),state);
+
+	if (state)
+		ccConsole::Print("[Octree] New octrees will be stored in compact form (less memory, slightly slower searches)");
+	else
+		ccConsole::Print("[Octree] New octrees will be stored in standard form");
+}
+
+//====================================doActionToggleSaveOctrees=====================//
+void MainWindow::doActionToggleSaveOctrees(bool state){
+
+	ccPointCloud::SetOctreeSaving(state);
+
+	QSettings settings;
+	settings.setValue(ccPS::SaveOctrees(),state);
+
+	if (state)
+		ccConsole::Print("[BIN] The clouds octree will be saved along with them (no need to recompute it after loading)");
+	else
+		ccConsole::Print("[BIN] The clouds octree won't be saved anymore");
+}
+
+//====================================doActionTogglePdmsInstancing==================//
+void MainWindow::doActionTogglePdmsInstancing(bool state){
+
+	//only applies to the PDMS files loaded afterwards
+#ifdef CC_PDMS_SUPPORT
+	PDMSFilter::SetInstancing(state);
+#endif
+
+	QSettings settings;
+	settings.setValue(ccPS::PdmsInstancing(),state);
+
+	if (state)
+		ccConsole::Print("[PDMS] Identical primitives will share the same geometry (instances of a hidden prototype)");
+	else
+		ccConsole::Print("[PDMS] Each primitive will have its own geometry");
+}
+
+//====================================doActionTogglePdmsGroupMerging================//
+void MainWindow::doActionTogglePdmsGroupMerging(bool state){
+
+	//only applies to the PDMS files loaded afterwards
+#ifdef CC_PDMS_SUPPORT
+	PDMSFilter::SetGroupMerging(state);
+#endif
+
+	QSettings settings;
+	settings.setValue(ccPS::PdmsGroupMerging(),state);
+
+	if (state)
+		ccConsole::Print("[PDMS] The primitives of each group will be merged in a single mesh (takes precedence over instancing)");
+	else
+		ccConsole::Print("[PDMS] The primitives of each group will be kept separate");
+}
+
+//====================================doActionSetMaxThreadCount=====================//
+void MainWindow::doActionSetMaxThreadCount(){
+
+	bool ok = false;
+	int count = QInputDialog::getInt(	this,
+										"Max. number of threads",
+										QString("Threads used by the octree-based processes (0 = all the %1 cores)").arg(QThread::idealThreadCount()),
+										CCLib::DgmOctree::GetMaxThreadCount(),
+										0,
+										1024,
+										1,
+										&ok);
+	if (!ok)
+		return;
+
+	CCLib::DgmOctree::SetMaxThreadCount(count);
+
+	//the setting is applied again at startup (see main.cpp)
+	QSettings settings;
+	settings.setValue(ccPS::MaxThreadCount(),count);
+
+	if (count == 0)
+		ccConsole::Print("[Octree] Octree-based processes will use all the cores");
+	else
+		ccConsole::Print(QString("[Octree] Octree-based processes will use at most %1 thread(s)").arg(count));
+}
+
 //====================================update3DViewsMenu============================//
 void MainWindow::update3DViewsMenu(){
 	menu3DViews->clear();
@@ -30,6 +30,7 @@
 #include<qmdiarea.h>
 #include<qmdisubwindow.h>
 #include <QThread>
+#include <QTimer>
 
 #include "PointCloudGenDlg.h"
 class QMdiArea;
@@ -157,6 +158,9 @@ protected slots:
 	// update UI
 	void updateUIWithSelection();
 
+	//! Refreshes the displays while primitives are tessellated in the background
+	void refreshAfterBackgroundTessellation();
+
 
 protected slots:
 
@@ -171,6 +175,22 @@ protected slots:
 	void doActionCreateCameraSensorFromFile();
 	//Edit->PointCloudGeneration
 	void doActionTextureGeneration();
+	//'Tools->Reorder points (octree)'
+	void doActionReorderInOctreeOrder();
+	//'Tools->Octree search statistics'
+	void doActionToggleOctreeSearchStatistics(bool state);
+	//'Tools->Max. number of threads'
+	void doActionSetMaxThreadCount();
+	//'Tools->Lazy tessellation of primitives'
+	void doActionToggleLazyTessellation(bool state);
+	//'Tools->Compact octrees'
+	void doActionToggleCompactOctrees(bool state);
+	//'Tools->Save octrees in BIN files'
+	void doActionToggleSaveOctrees(bool state);
+	//'Tools->PDMS: share identical primitives'
+	void doActionTogglePdmsInstancing(bool state);
+	//'Tools->PDMS: merge the primitives of each group'
+	void doActionTogglePdmsGroupMerging(bool state);
 
 	// "Menu 3DVeiws"
 	void update3DViewsMenu();  // 3Dӽǲ˵
@@ -286,6 +306,9 @@ public:
 
 	QThread m_thread;
 
+	//! Periodic refresh during the background tessellation of primitives
+	QTimer m_backgroundTessellationTimer;
+
 };
 
 #endif // MAINWINDOW_H